@@ -48,6 +48,7 @@
 #include <rok4/utils/ResourceLocator.h>
 
 #include "core/Utils.h"
+#include "core/XmlWriter.h"
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -150,23 +151,30 @@ public:
 
     /**
      * \~french \brief Ajoute un noeud WMS correpondant à l'attribution
-     * \param[in] parent Noeud auquel ajouter celui de l'attribution
+     * \param[in] writer Document XML en cours d'écriture
      * \~english \brief Add a WMS node corresponding to attribution
-     * \param[in] parent Node to whom add the attribution node
+     * \param[in] writer XML document being written
      */
-    void add_node_wms(ptree& parent) {
-        ptree& node = parent.add("Attribution", "");
-        node.add("Title", title);
-        node.add("OnlineResource.<xmlattr>.xlink:href", href);
-        node.add("OnlineResource.<xmlattr>.xlink:type", "simple");
+    void add_node_wms(XmlWriter& writer) {
+        writer.start_element("Attribution");
+        writer.element("Title", title);
+        writer.start_element("OnlineResource");
+        writer.attribute("xlink:href", href);
+        writer.attribute("xlink:type", "simple");
+        writer.end_element();
 
         if (logo != NULL) {
-            node.add("LogoURL.<xmlattr>.width", width);
-            node.add("LogoURL.<xmlattr>.height", height);
-            node.add("LogoURL.Format", logo->get_format());
-            node.add("LogoURL.OnlineResource.<xmlattr>.xlink:href", logo->get_href());
-            node.add("LogoURL.OnlineResource.<xmlattr>.xlink:type", "simple");
+            writer.start_element("LogoURL");
+            writer.attribute("width", width);
+            writer.attribute("height", height);
+            writer.element("Format", logo->get_format());
+            writer.start_element("OnlineResource");
+            writer.attribute("xlink:href", logo->get_href());
+            writer.attribute("xlink:type", "simple");
+            writer.end_element();
+            writer.end_element();
         }
+        writer.end_element();
     }
 
     /**
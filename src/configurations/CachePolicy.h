@@ -0,0 +1,230 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file configurations/CachePolicy.h
+ * \~french
+ * \brief Définition de la classe CachePolicy, politique de mise en cache des réponses par les clients et les CDN
+ * \~english
+ * \brief Define the CachePolicy class, responses caching policy for clients and CDN
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+
+#include <rok4/utils/Configuration.h>
+
+#include "core/Request.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * Une instance CachePolicy porte les durées de mise en cache (en secondes) émises dans l'en-tête Cache-Control, ainsi que la clé de substitution (Surrogate-Key) permettant aux CDN d'invalider les réponses d'une couche. Une durée négative n'est pas définie.
+ * \brief Gestion d'une politique de cache HTTP
+ * \~english
+ * A CachePolicy owns caching durations (in seconds) sent in the Cache-Control header, and the surrogate key (Surrogate-Key) allowing CDN to purge a layer's responses. A negative duration is undefined.
+ * \brief HTTP cache policy handler
+ */
+class CachePolicy : public Configuration {
+
+private:
+    int max_age;
+    int s_maxage;
+    int stale_while_revalidate;
+    /**
+     * \~french \brief Durée de cache des réponses 404 (tuiles hors limites)
+     * \~english \brief Caching duration of 404 responses (out of limits tiles)
+     */
+    int not_found_max_age;
+    std::string surrogate_key;
+
+    bool parse_duration(json11::Json& doc, std::string name, std::string section, int& duration) {
+        if (doc[name].is_number() && doc[name].int_value() >= 0) {
+            duration = doc[name].int_value();
+        } else if (! doc[name].is_null()) {
+            error_message = section + "." + name + " have to be a positive integer";
+            return false;
+        }
+        return true;
+    }
+
+    static int min_duration(int d1, int d2) {
+        if (d1 < 0) return d2;
+        if (d2 < 0) return d1;
+        return std::min(d1, d2);
+    }
+
+public:
+    /**
+     * \~french
+     * \brief Constructeur d'une politique vide
+     * \~english
+     * \brief Empty policy constructor
+     */
+    CachePolicy() : max_age(-1), s_maxage(-1), stale_while_revalidate(-1), not_found_max_age(-1) {}
+
+    /**
+     * \~french
+     * Crée une politique à partir d'une section JSON
+     * \brief Constructeur
+     * \param[in] doc Objet JSON
+     * \param[in] section Nom de la section, pour les messages d'erreur
+     * \~english
+     * Create a policy from a JSON section
+     * \brief Constructor
+     * \param[in] doc JSON object
+     * \param[in] section Section name, for error messages
+     */
+    CachePolicy(json11::Json doc, std::string section) : max_age(-1), s_maxage(-1), stale_while_revalidate(-1), not_found_max_age(-1) {
+        if (doc.is_null()) {
+            return;
+        } else if (! doc.is_object()) {
+            error_message = section + " have to be an object";
+            return;
+        }
+
+        if (! parse_duration(doc, "max_age", section, max_age)) return;
+        if (! parse_duration(doc, "s_maxage", section, s_maxage)) return;
+        if (! parse_duration(doc, "stale_while_revalidate", section, stale_while_revalidate)) return;
+        if (! parse_duration(doc, "not_found_max_age", section, not_found_max_age)) return;
+
+        if (doc["surrogate_key"].is_string()) {
+            surrogate_key = doc["surrogate_key"].string_value();
+        } else if (! doc["surrogate_key"].is_null()) {
+            error_message = section + ".surrogate_key have to be a string";
+            return;
+        }
+    }
+
+    /**
+     * \~french
+     * \brief Constructeur par surcharge : les valeurs définies dans la seconde politique remplacent celles de la première
+     * \~english
+     * \brief Override constructor : values defined in the second policy replace the first one's
+     */
+    CachePolicy(const CachePolicy& base, const CachePolicy& over) : Configuration() {
+        max_age = (over.max_age >= 0 ? over.max_age : base.max_age);
+        s_maxage = (over.s_maxage >= 0 ? over.s_maxage : base.s_maxage);
+        stale_while_revalidate = (over.stale_while_revalidate >= 0 ? over.stale_while_revalidate : base.stale_while_revalidate);
+        not_found_max_age = (over.not_found_max_age >= 0 ? over.not_found_max_age : base.not_found_max_age);
+        surrogate_key = (over.surrogate_key != "" ? over.surrogate_key : base.surrogate_key);
+    }
+
+    /**
+     * \~french
+     * \brief Restreint la politique par une autre, pour une réponse combinant plusieurs couches
+     * \details Les durées les plus courtes sont conservées, les clés de substitution sont cumulées
+     * \~english
+     * \brief Restrict the policy with another one, for a response combining several layers
+     * \details Shortest durations are kept, surrogate keys are accumulated
+     */
+    void restrict(const CachePolicy& other) {
+        max_age = min_duration(max_age, other.max_age);
+        s_maxage = min_duration(s_maxage, other.s_maxage);
+        stale_while_revalidate = min_duration(stale_while_revalidate, other.stale_while_revalidate);
+        not_found_max_age = min_duration(not_found_max_age, other.not_found_max_age);
+        if (surrogate_key == "") {
+            surrogate_key = other.surrogate_key;
+        } else if (other.surrogate_key != "") {
+            surrogate_key += " " + other.surrogate_key;
+        }
+    }
+
+    void set_default_surrogate_key(std::string key) {
+        if (surrogate_key == "") surrogate_key = key;
+    }
+
+    /**
+     * \~french
+     * \brief Valeur de l'en-tête Cache-Control, vide si aucune durée n'est définie
+     * \~english
+     * \brief Cache-Control header value, empty if no duration is defined
+     */
+    std::string get_cache_control() const {
+        std::string cc;
+        if (max_age >= 0) cc += ", max-age=" + std::to_string(max_age);
+        if (s_maxage >= 0) cc += ", s-maxage=" + std::to_string(s_maxage);
+        if (stale_while_revalidate >= 0) cc += ", stale-while-revalidate=" + std::to_string(stale_while_revalidate);
+        if (cc == "") return cc;
+        return "public" + cc;
+    }
+
+    /**
+     * \~french
+     * \brief Ajoute les en-têtes de cache d'une réponse valide
+     * \details La clé de substitution est émise même sans durée de cache, pour permettre la purge par le CDN
+     * \~english
+     * \brief Add cache headers of a valid response
+     * \details Surrogate key is sent even without cache duration, to allow CDN purge
+     */
+    void add_headers(Request* req) const {
+        std::string cc = get_cache_control();
+        if (cc != "") {
+            req->add_response_header("Cache-Control", cc);
+        }
+        // La politique par défaut peut compléter celle d'une couche : la clé de la couche est conservée
+        if (surrogate_key != "" && ! req->has_response_header("Surrogate-Key")) {
+            req->add_response_header("Surrogate-Key", surrogate_key);
+        }
+    }
+
+    /**
+     * \~french
+     * \brief Ajoute les en-têtes de cache d'une réponse 404
+     * \~english
+     * \brief Add cache headers of a 404 response
+     */
+    void add_not_found_headers(Request* req) const {
+        if (not_found_max_age >= 0) {
+            req->add_response_header("Cache-Control", "public, max-age=" + std::to_string(not_found_max_age));
+        }
+        if (surrogate_key != "") {
+            req->add_response_header("Surrogate-Key", surrogate_key);
+        }
+    }
+
+    /**
+     * \~french
+     * \brief Destructeur par défaut
+     * \~english
+     * \brief Default destructor
+     */
+    ~CachePolicy() {}
+};
@@ -51,6 +51,8 @@ using boost::property_tree::ptree;
 
 #include <rok4/utils/Configuration.h>
 
+#include "core/XmlWriter.h"
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -168,74 +170,89 @@ public:
 
     /**
      * \~french \brief Ajoute un noeud WMTS correpondant au contact
-     * \param[in] parent Noeud auquel ajouter celui du contact
+     * \param[in] writer Document XML en cours d'écriture
      * \~english \brief Add a WMTS node corresponding to contact
-     * \param[in] parent Node to whom add the contact node
+     * \param[in] writer XML document being written
      */
-    void add_node_wmts(ptree& parent) {
-        ptree& node = parent.add("ows:ServiceContact", "");
-        node.add("ows:IndividualName", individual_name);
-        node.add("ows:PositionName", individual_position);
+    void add_node_wmts(XmlWriter& writer) {
+        writer.start_element("ows:ServiceContact");
+        writer.element("ows:IndividualName", individual_name);
+        writer.element("ows:PositionName", individual_position);
 
-        node.add("ows:ContactInfo.ows:Phone.ows:Voice", voice);
-        node.add("ows:ContactInfo.ows:Phone.ows:Facsimile", facsimile);
+        writer.start_element("ows:ContactInfo");
+        writer.start_element("ows:Phone");
+        writer.element("ows:Voice", voice);
+        writer.element("ows:Facsimile", facsimile);
+        writer.end_element();
         
-        node.add("ows:ContactInfo.ows:Address.ows:DeliveryPoint", delivery_point);
-        node.add("ows:ContactInfo.ows:Address.ows:City", city);
-        node.add("ows:ContactInfo.ows:Address.ows:AdministrativeArea", administrative_area);
-        node.add("ows:ContactInfo.ows:Address.ows:PostalCode", post_code);
-        node.add("ows:ContactInfo.ows:Address.ows:Country", country);
-        node.add("ows:ContactInfo.ows:Address.ows:ElectronicMailAddress", email);
+        writer.start_element("ows:Address");
+        writer.element("ows:DeliveryPoint", delivery_point);
+        writer.element("ows:City", city);
+        writer.element("ows:AdministrativeArea", administrative_area);
+        writer.element("ows:PostalCode", post_code);
+        writer.element("ows:Country", country);
+        writer.element("ows:ElectronicMailAddress", email);
+        writer.end_element();
+        writer.end_element();
+        writer.end_element();
     }
 
     /**
      * \~french \brief Ajoute un noeud WMS correpondant au contact
-     * \param[in] parent Noeud auquel ajouter celui du contact
+     * \param[in] writer Document XML en cours d'écriture
      * \~english \brief Add a WMS node corresponding to contact
-     * \param[in] parent Node to whom add the contact node
+     * \param[in] writer XML document being written
      */
-    void add_node_wms(ptree& parent, std::string organization) {
-        ptree& node = parent.add("ContactInformation", "");
-        node.add("ContactPersonPrimary.ContactPerson", individual_name);
-        node.add("ContactPersonPrimary.ContactOrganization", organization);
-        node.add("ContactPosition", individual_position);
-
-        node.add("ContactAddress.AddressType", address_type);
-        node.add("ContactAddress.Address", delivery_point);
-        node.add("ContactAddress.City", city);
-        node.add("ContactAddress.StateOrProvince", administrative_area);
-        node.add("ContactAddress.PostCode", post_code);
-        node.add("ContactAddress.Country", country);
-
-        node.add("ContactVoiceTelephone", voice);
-        node.add("ContactFacsimileTelephone", facsimile);
-        node.add("ContactElectronicMailAddress", email);
+    void add_node_wms(XmlWriter& writer, std::string organization) {
+        writer.start_element("ContactInformation");
+        writer.start_element("ContactPersonPrimary");
+        writer.element("ContactPerson", individual_name);
+        writer.element("ContactOrganization", organization);
+        writer.end_element();
+        writer.element("ContactPosition", individual_position);
+
+        writer.start_element("ContactAddress");
+        writer.element("AddressType", address_type);
+        writer.element("Address", delivery_point);
+        writer.element("City", city);
+        writer.element("StateOrProvince", administrative_area);
+        writer.element("PostCode", post_code);
+        writer.element("Country", country);
+        writer.end_element();
 
+        writer.element("ContactVoiceTelephone", voice);
+        writer.element("ContactFacsimileTelephone", facsimile);
+        writer.element("ContactElectronicMailAddress", email);
+        writer.end_element();
     }
 
     /**
      * \~french \brief Ajoute un noeud TMS correpondant au contact
-     * \param[in] parent Noeud auquel ajouter celui du contact
+     * \param[in] writer Document XML en cours d'écriture
      * \~english \brief Add a TMS node corresponding to contact
-     * \param[in] parent Node to whom add the contact node
+     * \param[in] writer XML document being written
      */
-    void add_node_tms(ptree& parent, std::string organization) {
-        ptree& node = parent.add("ContactInformation", "");
-        node.add("ContactPersonPrimary.ContactPerson", individual_name);
-        node.add("ContactPersonPrimary.ContactOrganization", organization);
-        node.add("ContactPosition", individual_position);
-
-        node.add("ContactAddress.AddressType", address_type);
-        node.add("ContactAddress.Address", delivery_point);
-        node.add("ContactAddress.City", city);
-        node.add("ContactAddress.StateOrProvince", administrative_area);
-        node.add("ContactAddress.PostCode", post_code);
-        node.add("ContactAddress.Country", country);
-
-        node.add("ContactVoiceTelephone", voice);
-        node.add("ContactFacsimileTelephone", facsimile);
-        node.add("ContactElectronicMailAddress", email);
+    void add_node_tms(XmlWriter& writer, std::string organization) {
+        writer.start_element("ContactInformation");
+        writer.start_element("ContactPersonPrimary");
+        writer.element("ContactPerson", individual_name);
+        writer.element("ContactOrganization", organization);
+        writer.end_element();
+        writer.element("ContactPosition", individual_position);
+
+        writer.start_element("ContactAddress");
+        writer.element("AddressType", address_type);
+        writer.element("Address", delivery_point);
+        writer.element("City", city);
+        writer.element("StateOrProvince", administrative_area);
+        writer.element("PostCode", post_code);
+        writer.element("Country", country);
+        writer.end_element();
 
+        writer.element("ContactVoiceTelephone", voice);
+        writer.element("ContactFacsimileTelephone", facsimile);
+        writer.element("ContactElectronicMailAddress", email);
+        writer.end_element();
     }
 
 };
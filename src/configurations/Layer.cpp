@@ -43,18 +43,21 @@
  * \brief Implement the Layer Class handling data layer.
  */
 
+#include <algorithm>
 #include <boost/format.hpp>
 #include <boost/log/trivial.hpp>
 #include <libgen.h>
 #include <fstream>
 #include <string>
 #include <iostream>
+#include <set>
 
 #include <rok4/utils/Pyramid.h>
 #include <rok4/utils/Utils.h>
 #include <rok4/style/Style.h>
 
 #include "configurations/Layer.h"
+#include "core/Books.h"
 #include "core/Inspire.h"
 
 bool is_style_handled(Style* style) {
@@ -81,6 +84,7 @@ bool Layer::parse(json11::Json& doc) {
     gfi_url = "";
     gfi_query_layers = "";
     gfi_layers = "";
+    gfi_bilinear = false;
 
     // Chargement
 
@@ -126,6 +130,16 @@ bool Layer::parse(json11::Json& doc) {
         return false;
     }
 
+    CachePolicy layer_cache_policy = CachePolicy(doc["cache"], "cache");
+    if (! layer_cache_policy.is_ok()) {
+        error_message = layer_cache_policy.get_error_message();
+        return false;
+    }
+    // Par défaut, la clé de substitution des réponses d'une couche est son identifiant
+    layer_cache_policy.set_default_surrogate_key(id);
+    tile_cache_policy = CachePolicy(services->tile_cache_policy, layer_cache_policy);
+    map_cache_policy = CachePolicy(services->map_cache_policy, layer_cache_policy);
+
     if (doc["attribution"].is_object()) {
         attribution = new Attribution(doc["attribution"].object_items());
         if (attribution->get_missing_field() != "") {
@@ -137,6 +151,11 @@ bool Layer::parse(json11::Json& doc) {
 
     /******************* PYRAMIDES *********************/
 
+    if (! doc["occupancy"].is_null() && ! doc["occupancy"].is_bool()) {
+        error_message = "occupancy have to be a boolean";
+        return false;
+    }
+
     std::vector<Pyramid*> pyramids;
     std::vector<std::string> top_levels;
     std::vector<std::string> bottom_levels;
@@ -167,7 +186,12 @@ bool Layer::parse(json11::Json& doc) {
                     return false;
                 }
 
-                Pyramid* p = new Pyramid( pyr_path );
+                Pyramid* p;
+                {
+                    // Le chargement recherche le TMS de la pyramide dans l'annuaire
+                    Books::SharedLock lock(Books::get_mutex());
+                    p = new Pyramid( pyr_path );
+                }
                 if ( ! p->is_ok() ) {
                     BOOST_LOG_TRIVIAL(error) << p->get_error_message();
                     error_message =  "Pyramid " + pyr_path +" cannot be loaded"  ;
@@ -192,6 +216,38 @@ bool Layer::parse(json11::Json& doc) {
         return false;
     }
 
+    // Occupation des niveaux, lue dans le fichier liste de chaque pyramide pour les niveaux qu'elle fournit
+    if (doc["occupancy"].is_bool() && doc["occupancy"].bool_value()) {
+        occupancy = new TileOccupancy();
+        for (int i = 0; i < pyramids.size(); i++) {
+            Level* bottom = pyramids.at(i)->get_level(bottom_levels.at(i));
+            Level* top = pyramids.at(i)->get_level(top_levels.at(i));
+            if (bottom == NULL || top == NULL) {
+                // La composition échouera
+                break;
+            }
+            double min_res = std::min(bottom->get_res(), top->get_res());
+            double max_res = std::max(bottom->get_res(), top->get_res());
+            std::set<std::string> levels_ids;
+            for (auto const& l : pyramids.at(i)->get_levels()) {
+                if (l.second->get_res() >= min_res && l.second->get_res() <= max_res) {
+                    levels_ids.insert(l.first);
+                }
+            }
+
+            std::string pyr_path = doc["pyramids"][i]["path"].string_value();
+            std::string list_path = pyr_path.substr(0, pyr_path.rfind(".json")) + ".list";
+            std::string list_error;
+            if (! occupancy->add_list(list_path, levels_ids, list_error)) {
+                // Sans occupation, les tuiles sont cherchées dans le stockage
+                BOOST_LOG_TRIVIAL(warning) << list_error << ", tiles occupancy is not used for layer " << id;
+                delete occupancy;
+                occupancy = NULL;
+                break;
+            }
+        }
+    }
+
     pyramid = new Pyramid(pyramids.at(0));
 
     BOOST_LOG_TRIVIAL(debug) << "pyramide composée de " << pyramids.size() << " pyramide(s)";
@@ -216,6 +272,10 @@ bool Layer::parse(json11::Json& doc) {
         return false;
     }
 
+    if (occupancy != NULL) {
+        occupancy->build(pyramid);
+    }
+
     /********************** Gestion de l'étendue des données */
 
     if (doc["bbox"].is_object()) {
@@ -283,6 +343,19 @@ bool Layer::parse(json11::Json& doc) {
                 if(doc["get_feature_info"]["type"].string_value().compare("PYRAMID") == 0) {
                     // Donnee elle-meme
                     gfi_type = "PYRAMID";
+
+                    if (doc["get_feature_info"]["interpolation"].is_string()) {
+                        std::string interpolation = doc["get_feature_info"]["interpolation"].string_value();
+                        if (interpolation == "linear") {
+                            gfi_bilinear = true;
+                        } else if (interpolation != "nn") {
+                            error_message = "get_feature_info.interpolation have to be 'nn' or 'linear'";
+                            return false;
+                        }
+                    } else if (! doc["get_feature_info"]["interpolation"].is_null()) {
+                        error_message = "get_feature_info.interpolation have to be a string";
+                        return false;
+                    }
                 }
                 else if(doc["get_feature_info"]["type"].string_value().compare("EXTERNALWMS") == 0) {
 
@@ -328,7 +401,7 @@ bool Layer::parse(json11::Json& doc) {
                 if (st.is_string()) {
                     std::string styleName = st.string_value();
                     
-                    Style* sty = StyleBook::get_style(styleName);
+                    Style* sty = Books::get_style(styleName);
                     if ( sty == NULL ) {
                         BOOST_LOG_TRIVIAL(warning) <<  "Style " << styleName <<" unknown or unloadable"  ;
                         continue;
@@ -349,7 +422,7 @@ bool Layer::parse(json11::Json& doc) {
         }
 
         if ( available_styles.size() == 0 ) {
-            Style* sty = StyleBook::get_style(services->default_style);
+            Style* sty = Books::get_style(services->default_style);
             if ( sty == NULL ) {
                 error_message =  "No valid style (even the default one), the layer is not valid"  ;
                 return false;
@@ -370,7 +443,7 @@ bool Layer::parse(json11::Json& doc) {
                     error_message =  "extra_tilematrixsets have to be a string array"  ;
                     return false;
                 }
-                TileMatrixSet* tms = TmsBook::get_tms(t.string_value());
+                TileMatrixSet* tms = Books::get_tms(t.string_value());
                 if ( tms == NULL ) {
                     BOOST_LOG_TRIVIAL(warning) <<  "TMS " << t.string_value() <<" unknown"  ;
                     continue;
@@ -548,7 +621,7 @@ void Layer::calculate_tilematrix_limits() {
     }
 }
 
-Layer::Layer(std::string path, ServicesConfiguration* s) : Configuration(path), pyramid(NULL), attribution(NULL) {
+Layer::Layer(std::string path, ServicesConfiguration* s, bool lazy) : Configuration(path), pyramid(NULL), occupancy(NULL), attribution(NULL), loaded(false) {
 
     services = s;
 
@@ -593,17 +666,25 @@ Layer::Layer(std::string path, ServicesConfiguration* s) : Configuration(path),
     }
     if (data != NULL) delete[] data;
 
+    if (lazy) {
+        // L'analyse, qui charge les pyramides, est faite au premier accès à la couche
+        descriptor = doc;
+        return;
+    }
+
     /********************** Parse */
 
     if (! parse(doc)) {
         return;
     }
 
+    loaded = true;
+
     return;
 }
 
 
-Layer::Layer(std::string layer_name, std::string content, ServicesConfiguration* s ) : Configuration(), id(layer_name), pyramid(NULL), attribution(NULL) {
+Layer::Layer(std::string layer_name, std::string content, ServicesConfiguration* s ) : Configuration(), id(layer_name), pyramid(NULL), occupancy(NULL), attribution(NULL), loaded(false) {
 
     services = s;
 
@@ -628,6 +709,8 @@ Layer::Layer(std::string layer_name, std::string content, ServicesConfiguration*
     if (! parse(doc)) {
         return;
     }
+
+    loaded = true;
     
     return;
 }
@@ -636,10 +719,40 @@ std::string Layer::get_id() {
     return id;
 }
 
+bool Layer::load() {
+    if (loaded) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(load_mtx);
+
+    // Un autre thread a pu charger la couche, ou échouer, pendant qu'on attendait
+    if (loaded || ! error_message.empty()) {
+        return loaded;
+    }
+
+    if (descriptor.is_null()) {
+        error_message = "No descriptor to parse";
+    }
+    else if (parse(descriptor)) {
+        BOOST_LOG_TRIVIAL(debug) << "Deferred loading of layer " << id << " done";
+        loaded = true;
+    } else {
+        BOOST_LOG_TRIVIAL(error) << "Cannot load layer " << id << ": " << error_message;
+    }
+
+    descriptor = json11::Json();
+
+    return loaded;
+}
+
+bool Layer::is_loaded() { return loaded; }
+
 Layer::~Layer() {
 
     if (attribution != NULL) delete attribution;
     if (pyramid != NULL) delete pyramid;
+    if (occupancy != NULL) delete occupancy;
     for (TileMatrixSetInfos* tmsi : available_tilematrixsets) {
         delete tmsi;
     }
@@ -686,6 +799,13 @@ TileMatrixLimits* Layer::get_tilematrix_limits(TileMatrixSet* tms, TileMatrix* t
     return NULL;
 }
 
+bool Layer::contain_tile(TileMatrixSet* tms, TileMatrix* tm, int column, int row) {
+    if (occupancy == NULL || tms->get_id() != pyramid->get_tms()->get_id()) {
+        return true;
+    }
+    return occupancy->contain_tile(tm->get_id(), column, row);
+}
+
 Style* Layer::get_style_by_identifier(std::string identifier) {
     for ( unsigned int i = 0; i < available_styles.size(); i++ ) {
         if ( identifier == available_styles[i]->get_identifier() )
@@ -722,9 +842,10 @@ std::string Layer::get_gfi_url() { return gfi_url; }
 std::map<std::string, std::string> Layer::get_gfi_extra_params() { return gfi_extra_params; }
 std::string Layer::get_gfi_layers() { return gfi_layers; }
 std::string Layer::get_gfi_query_layers() { return gfi_query_layers; }
+bool Layer::is_gfi_bilinear() { return gfi_bilinear; }
 Interpolation::KernelType Layer::get_resampling() { return resampling; }
 
-void Layer::add_node_wmts(ptree& parent, WmtsService* service, bool only_inspire, std::map< std::string, TileMatrixSetInfos*>* used_tms_list) {
+void Layer::add_node_wmts(XmlWriter& writer, WmtsService* service, bool only_inspire, std::map< std::string, TileMatrixSetInfos*>* used_tms_list) {
 
     if (! wmts) {
         return;
@@ -734,30 +855,36 @@ void Layer::add_node_wmts(ptree& parent, WmtsService* service, bool only_inspire
         return;
     }
 
-    ptree& node = parent.add("Layer", "");
-    node.add("ows:Title", title);
-    node.add("ows:Abstract", abstract);
+    writer.start_element("Layer");
+    writer.element("ows:Title", title);
+    writer.element("ows:Abstract", abstract);
 
     if ( keywords.size() != 0 ) {
-        ptree& keywords_node = node.add("ows:Keywords", "");
+        writer.start_element("ows:Keywords");
+        ptree keywords_tree;
         for ( Keyword k : keywords) {
-            k.add_node(keywords_node, "ows:Keyword");
+            k.add_node(keywords_tree, "ows:Keyword");
         }
+        writer.subtree(keywords_tree);
+        writer.end_element();
     }
 
     std::ostringstream os;
+    writer.start_element("ows:WGS84BoundingBox");
     os << geographic_bbox.xmin << " " << geographic_bbox.ymin;
-    node.add("ows:WGS84BoundingBox.ows:LowerCorner", os.str());
+    writer.element("ows:LowerCorner", os.str());
     os.str ( "" );
     os << geographic_bbox.xmax << " " << geographic_bbox.ymax;
-    node.add("ows:WGS84BoundingBox.ows:UpperCorner", os.str());
+    writer.element("ows:UpperCorner", os.str());
+    writer.end_element();
     
-    node.add("ows:Identifier", id);
+    writer.element("ows:Identifier", id);
     
     for ( Metadata m : metadata) {
-        m.add_node_wmts(node);
+        m.add_node_wmts(writer);
     }
 
+    ptree styles_tree;
     bool is_first = true;
     for ( Style* s : available_styles) {
         /*
@@ -770,32 +897,60 @@ void Layer::add_node_wmts(ptree& parent, WmtsService* service, bool only_inspire
         Cela permet de n'avoir à modifier que l'en tête de la tuile PNG pour que le style "soit appliqué"
         */
         if (s->is_identity() || (pyramid->get_channels() == 1 && pyramid->get_sample_compression() == Compression::PNG)) {
-            s->add_node_wmts(node, is_first);
+            s->add_node_wmts(styles_tree, is_first);
             is_first = false;
         }
     }
+    writer.subtree(styles_tree);
 
-    node.add("Format", Rok4Format::to_mime_type ( pyramid->get_format() ));
+    writer.element("Format", Rok4Format::to_mime_type ( pyramid->get_format() ));
 
     if (gfi_enabled){
         for ( unsigned int j = 0; j < services->get_available_infoformats()->size(); j++ ) {
-            node.add("InfoFormat", services->get_available_infoformats()->at ( j ));
+            writer.element("InfoFormat", services->get_available_infoformats()->at ( j ));
         }
     }
 
     // On ajoute les TMS disponibles avec les tuiles limites
 
     for (TileMatrixSetInfos* tmsi : available_tilematrixsets) {
-        ptree& tms_node = node.add("TileMatrixSetLink", "");
-        tms_node.add("TileMatrixSet", tmsi->request_id);
+        writer.start_element("TileMatrixSetLink");
+        writer.element("TileMatrixSet", tmsi->request_id);
 
-        ptree& tms_limits_node = tms_node.add("TileMatrixSetLimits", "");
+        writer.start_element("TileMatrixSetLimits");
         
         // Niveaux
+        ptree limits_tree;
         for ( unsigned int j = 0; j < tmsi->limits.size(); j++ ) { 
-            tmsi->limits.at(j).add_node(tms_limits_node);
+            tmsi->limits.at(j).add_node(limits_tree);
+        }
+        writer.subtree(limits_tree);
+
+        writer.end_element();
+        writer.end_element();
+
+        // Si la reprojection WMTS n'est pas activée, nous n'exposons que le premier TMS, celui natif
+        if (! services->tile_reprojection) {
+            break;
         }
+    }
+
+    writer.end_element();
+
+    add_used_tms_wmts(only_inspire, used_tms_list);
+}
+
+void Layer::add_used_tms_wmts(bool only_inspire, std::map< std::string, TileMatrixSetInfos*>* used_tms_list) {
+
+    if (! wmts) {
+        return;
+    }
 
+    if (only_inspire && ! wmts_inspire) {
+        return;
+    }
+
+    for (TileMatrixSetInfos* tmsi : available_tilematrixsets) {
         used_tms_list->emplace ( tmsi->request_id , tmsi );
 
         // Si la reprojection WMTS n'est pas activée, nous n'exposons que le premier TMS, celui natif
@@ -810,7 +965,7 @@ void Layer::add_node_wmts(ptree& parent, WmtsService* service, bool only_inspire
     }
 }
 
-void Layer::add_node_wms(ptree& parent, WmsService* service, bool only_inspire) {
+void Layer::add_node_wms(XmlWriter& writer, WmsService* service, bool only_inspire) {
 
     if (! wms) {
         return;
@@ -820,24 +975,27 @@ void Layer::add_node_wms(ptree& parent, WmsService* service, bool only_inspire)
         return;
     }
 
-    ptree& node = parent.add("Layer", "");
+    writer.start_element("Layer");
     if (gfi_enabled) {
-        node.add("<xmlattr>.queryable", "1");
+        writer.attribute("queryable", "1");
     }
 
-    node.add("Name", id);
-    node.add("Title", title);
-    node.add("Abstract", abstract);
+    writer.element("Name", id);
+    writer.element("Title", title);
+    writer.element("Abstract", abstract);
 
     if ( keywords.size() != 0 ) {
-        ptree& keywords_node = node.add("KeywordList", "");
+        writer.start_element("KeywordList");
+        ptree keywords_tree;
         for ( Keyword k : keywords) {
-            k.add_node(keywords_node, "Keyword");
+            k.add_node(keywords_tree, "Keyword");
         }
+        writer.subtree(keywords_tree);
+        writer.end_element();
     }
 
     for ( CRS* c : available_crss) {
-        node.add("CRS", c->get_request_code());
+        writer.element("CRS", c->get_request_code());
 
         // Si la reprojection WMS n'est pas activée, nous n'exposons que le premier CRS, celui natif
         if (! services->map_reprojection) {
@@ -845,7 +1003,8 @@ void Layer::add_node_wms(ptree& parent, WmsService* service, bool only_inspire)
         }
     }
 
-    geographic_bbox.add_node(node, true, true);
+    ptree bboxes_tree;
+    geographic_bbox.add_node(bboxes_tree, true, true);
 
     // BoundingBox
     if ( only_inspire ) {
@@ -858,7 +1017,7 @@ void Layer::add_node_wms(ptree& parent, WmsService* service, bool only_inspire)
             }
 
             bbox.reproject(CRS::get_epsg4326(), c);
-            bbox.add_node(node, false, c->is_lat_lon() );
+            bbox.add_node(bboxes_tree, false, c->is_lat_lon() );
 
             // Si la reprojection WMS n'est pas activée, nous n'exposons que la bbox en projection native
             if (! services->map_reprojection) {
@@ -876,32 +1035,36 @@ void Layer::add_node_wms(ptree& parent, WmsService* service, bool only_inspire)
                 }
 
                 bbox.reproject(CRS::get_epsg4326(), crs);
-                bbox.add_node(node, false, crs->is_lat_lon() );
+                bbox.add_node(bboxes_tree, false, crs->is_lat_lon() );
             }
         }
     } else {
-        BoundingBox<double> bbox = native_bbox;
-        native_bbox.add_node(node, false, pyramid->get_tms()->get_crs()->is_lat_lon() );
+        native_bbox.add_node(bboxes_tree, false, pyramid->get_tms()->get_crs()->is_lat_lon() );
     }
+    writer.subtree(bboxes_tree);
 
     if (attribution != NULL) {
-        attribution->add_node_wms(node);
+        attribution->add_node_wms(writer);
     }
     
     for ( Metadata m : metadata) {
-        m.add_node_wms(node);
+        m.add_node_wms(writer);
     }
 
+    ptree styles_tree;
     for ( Style* s : available_styles) {
-        s->add_node_wms(node);
+        s->add_node_wms(styles_tree);
     }
+    writer.subtree(styles_tree);
+
+    writer.element("MinScaleDenominator", pyramid->get_lowest_level()->get_res() * 1000 / 0.28);
+    writer.element("MaxScaleDenominator", pyramid->get_highest_level()->get_res() * 1000 / 0.28);
 
-    node.add("MinScaleDenominator", pyramid->get_lowest_level()->get_res() * 1000 / 0.28);
-    node.add("MaxScaleDenominator", pyramid->get_highest_level()->get_res() * 1000 / 0.28);
+    writer.end_element();
 }
 
 
-void Layer::add_node_tms(ptree& parent, TmsService* service) {
+void Layer::add_node_tms(XmlWriter& writer, TmsService* service) {
 
     if (! tms) {
         return;
@@ -909,135 +1072,113 @@ void Layer::add_node_tms(ptree& parent, TmsService* service) {
 
     std::string ln = std::regex_replace(title, std::regex("\""), "&quot;");
 
-    ptree& node = parent.add("TileMap", "");
-    node.add("<xmlattr>.title", ln);
-    node.add("<xmlattr>.srs", pyramid->get_tms()->get_crs()->get_request_code());
-    node.add("<xmlattr>.profile", "none");
-    node.add("<xmlattr>.extension", Rok4Format::to_extension ( pyramid->get_format() ));
-    node.add("<xmlattr>.href", service->get_endpoint_uri() + "/1.0.0/" + id);
+    writer.start_element("TileMap");
+    writer.attribute("title", ln);
+    writer.attribute("srs", pyramid->get_tms()->get_crs()->get_request_code());
+    writer.attribute("profile", "none");
+    writer.attribute("extension", Rok4Format::to_extension ( pyramid->get_format() ));
+    writer.attribute("href", service->get_endpoint_uri() + "/1.0.0/" + id);
+    writer.end_element();
 }
 
-json11::Json Layer::to_json_ogcapi(OgcApiService* service) {
+/**
+ * \~french \brief Écrit un lien OGC API, les clés dans l'ordre alphabétique
+ * \~english \brief Write an OGC API link, keys in alphabetical order
+ */
+static void write_link(JsonWriter& writer, std::string href, std::string rel, std::string type, std::string title, bool templated = false) {
+    writer.start_object();
+    writer.key("href"); writer.value(href);
+    writer.key("rel"); writer.value(rel);
+    if (templated) {
+        writer.key("templated"); writer.value(true);
+    }
+    writer.key("title"); writer.value(title);
+    writer.key("type"); writer.value(type);
+    writer.end_object();
+}
+
+void Layer::to_json_ogcapi(JsonWriter& writer, OgcApiService* service) {
 
     if (! ogcapi) {
-        return json11::Json::NUL;
+        writer.null();
+        return;
     }
 
-    json11::Json::object res = json11::Json::object {
-        { "id", id },
-        { "title", title },
-        { "description", abstract },
-        { "extent", geographic_bbox.to_json_ogcapi() }
-    };
+    bool data_tiles = (! raster && service->tiles_enabled());
+    bool map_tiles = (raster && service->tiles_enabled());
+
+    writer.start_object();
+
+    if (attribution != NULL) {
+        writer.key("attribution"); writer.value(attribution->get_title());
+    }
 
-    std::vector<json11::Json> links;
+    writer.key("crs");
+    writer.start_array();
+    writer.value(pyramid->get_tms()->get_crs()->get_url());
+    writer.end_array();
 
-    links.push_back(json11::Json::object {
-        { "href", service->get_endpoint_uri() + "/collections/" + id + "?f=json"},
-        { "rel", "self"},
-        { "type", "application/json"},
-        { "title", "this document"}
-    });
+    writer.key("dataTiles"); writer.value(data_tiles);
+    writer.key("dataType"); writer.value(raster ? "map" : "vector");
+    writer.key("description"); writer.value(abstract);
+    writer.key("extent"); writer.value(geographic_bbox.to_json_ogcapi());
+    writer.key("id"); writer.value(id);
+
+    writer.key("links");
+    writer.start_array();
+
+    write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "?f=json", "self", "application/json", "this document");
     
     for ( Metadata m : metadata) {
-        links.push_back(m.to_json_ogcapi("Dataset metadata", "describedby"));
+        m.to_json_ogcapi(writer, "Dataset metadata", "describedby");
     }
 
     if (raster) {
-        res["dataType"] = "map";
-        res["dataTiles"] = false;
         if (service->tiles_enabled()) {
-            links.push_back(json11::Json::object {
-                { "href", service->get_endpoint_uri() + "/collections/" + id + "/map/tiles?f=json"},
-                { "rel", "describedby"},
-                { "type", "application/json"},
-                { "title", "Tilesets list for " + id}
-            });
-            res["mapTiles"] = true;
-        } else {
-            res["mapTiles"] = false;
+            write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "/map/tiles?f=json", "describedby", "application/json", "Tilesets list for " + id);
         }
         if (service->maps_enabled()) {
-            links.push_back(json11::Json::object {
-                { "href", service->get_endpoint_uri() + "/collections/" + id + "/map?f={format}"},
-                { "rel", "map"},
-                { "type", "application/octet-stream"},
-                { "title", id + " as raster map with default style"},
-                { "templated", true}
-            });
+            write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "/map?f={format}", "map", "application/octet-stream", id + " as raster map with default style", true);
 
             // Lien vers l'image, pour chaque style disponible
             for(auto const& s: available_styles) {
-                links.push_back(json11::Json::object {
-                    { "href", service->get_endpoint_uri() + "/collections/" + id + "/styles/" + s->get_identifier() + "/map?f={format}"},
-                    { "rel", "map"},
-                { "type", "application/octet-stream"},
-                    { "title", id + " as raster map with style " + s->get_identifier()},
-                    { "templated", true}
-                });
+                write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "/styles/" + s->get_identifier() + "/map?f={format}", "map", "application/octet-stream", id + " as raster map with style " + s->get_identifier(), true);
             }
         }
     } else {
-        res["dataType"] = "vector";
-        res["mapTiles"] = false;  
         if (service->tiles_enabled()) {
-            links.push_back(json11::Json::object {
-                { "href", service->get_endpoint_uri() + "/collections/" + id + "/tiles?f=json"},
-                { "rel", "describedby"},
-                { "type", "application/json"},
-                { "title", "Tilesets list for " + id}
-            });
-            res["dataTiles"] = true;
-        } else {
-            res["dataTiles"] = false;
+            write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "/tiles?f=json", "describedby", "application/json", "Tilesets list for " + id);
         }
     }
 
-    res["links"] = links;
+    writer.end_array();
 
-    if (attribution != NULL) {
-        res["attribution"] = attribution->get_title();
-    }
+    writer.key("mapTiles"); writer.value(map_tiles);
+    writer.key("maxCellSize"); writer.value(pyramid->get_highest_level()->get_res());
+    writer.key("minCellSize"); writer.value(pyramid->get_lowest_level()->get_res());
+    writer.key("storageCrs"); writer.value(pyramid->get_tms()->get_crs()->get_url());
+    writer.key("title"); writer.value(title);
 
-    res["crs"] = json11::Json::array {
-        pyramid->get_tms()->get_crs()->get_url()
-    };
-
-    res["storageCrs"] = pyramid->get_tms()->get_crs()->get_url();
-
-    res["minCellSize"] = pyramid->get_lowest_level()->get_res();
-    res["maxCellSize"] = pyramid->get_highest_level()->get_res();
-
-    return res;
+    writer.end_object();
 }
 
-json11::Json Layer::to_json_tilesets(OgcApiService* service) {
-
-    json11::Json::object res = json11::Json::object {};
+void Layer::to_json_tilesets(JsonWriter& writer, OgcApiService* service) {
 
-    std::vector<json11::Json> links;
+    writer.start_object();
 
+    writer.key("links");
+    writer.start_array();
     if (raster) {
         // Interrogation de donnée raster
-        links.push_back(json11::Json::object {
-            { "href", service->get_endpoint_uri() + "/collections/" + id + "/map/tiles?f=json"},
-            { "rel", "self"},
-            { "type", "application/json"},
-            { "title", "this document"}
-        });
+        write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "/map/tiles?f=json", "self", "application/json", "this document");
     } else {
         // Interrogation de donnée vecteur
-        links.push_back(json11::Json::object {
-            { "href", service->get_endpoint_uri() + "/collections/" + id + "/tiles?f=json"},
-            { "rel", "self"},
-            { "type", "application/json"},
-            { "title", "this document"}
-        });
+        write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "/tiles?f=json", "self", "application/json", "this document");
     }
+    writer.end_array();
 
-    res["links"] = links;
-
-    std::vector<json11::Json> tilesets;
+    writer.key("tilesets");
+    writer.start_array();
 
     for (TileMatrixSetInfos* t : available_tilematrixsets) {
         std::string data_type;
@@ -1051,20 +1192,16 @@ json11::Json Layer::to_json_tilesets(OgcApiService* service) {
             tileset_uri = service->get_endpoint_uri() + "/collections/" + id + "/tiles/" + t->tms->get_id() + "?f=json";
         }
 
-        tilesets.push_back(json11::Json::object {
-            { "title", title },
-            { "dataType", data_type},
-            { "crs", t->tms->get_crs()->get_url()},
-            { "tileMatrixSetURI", service->get_endpoint_uri() + "/tileMatrixSets/" + t->tms->get_id() + "?f=json"},
-            { "links", json11::Json::array {
-                json11::Json::object {
-                    { "href", tileset_uri},
-                    { "rel", "describedby"},
-                    { "type", "application/json"},
-                    { "title", "Tileset " + t->tms->get_id() + " for " + id}
-                }
-            }}
-        });
+        writer.start_object();
+        writer.key("crs"); writer.value(t->tms->get_crs()->get_url());
+        writer.key("dataType"); writer.value(data_type);
+        writer.key("links");
+        writer.start_array();
+        write_link(writer, tileset_uri, "describedby", "application/json", "Tileset " + t->tms->get_id() + " for " + id);
+        writer.end_array();
+        writer.key("tileMatrixSetURI"); writer.value(service->get_endpoint_uri() + "/tileMatrixSets/" + t->tms->get_id() + "?f=json");
+        writer.key("title"); writer.value(title);
+        writer.end_object();
 
         // Si la reprojection tuilée n'est pas activée ou que c'est de la donnée vecteur, nous n'exposons que le premier TMS, celui natif
         if (! services->tile_reprojection || ! raster) {
@@ -1072,65 +1209,50 @@ json11::Json Layer::to_json_tilesets(OgcApiService* service) {
         }
     }
 
-    res["tilesets"] = tilesets;
+    writer.end_array();
 
-    return res;
+    writer.end_object();
 }
 
-json11::Json Layer::to_json_tileset(OgcApiService* service, TileMatrixSetInfos* tmsi) {
+void Layer::to_json_tileset(JsonWriter& writer, OgcApiService* service, TileMatrixSetInfos* tmsi) {
 
-    json11::Json::object res = json11::Json::object {
-        { "title", title},
-        { "description", abstract},
-        { "crs", tmsi->tms->get_crs()->get_url()},
-        { "tileMatrixSetURI", service->get_endpoint_uri() + "/tileMatrixSets/" + tmsi->tms->get_id() + "?f=json"},
-    };
+    writer.start_object();
 
-    std::vector<json11::Json> links;
+    writer.key("crs"); writer.value(tmsi->tms->get_crs()->get_url());
+    writer.key("dataType"); writer.value(raster ? "map" : "vector");
+    writer.key("description"); writer.value(abstract);
+
+    writer.key("links");
+    writer.start_array();
 
     if (raster) {
         // Interrogation de donnée raster
-        res["dataType"] = "map";
-        links.push_back(json11::Json::object {
-            { "href", service->get_endpoint_uri() + "/collections/" + id + "/map/tiles/" + tmsi->tms->get_id() + "?f=json"},
-            { "rel", "self"},
-            { "type", "application/json"},
-            { "title", "this document"}
-        });
+        write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "/map/tiles/" + tmsi->tms->get_id() + "?f=json", "self", "application/json", "this document");
         // Lien vers la tuile, pour chaque style disponible
         for(auto const& s: available_styles) {
-            links.push_back(json11::Json::object {
-                { "href", service->get_endpoint_uri() + "/collections/" + id + "/styles/" + s->get_identifier() + "/map/tiles/" + tmsi->tms->get_id() + "/{tileMatrix}/{tileRow}/{tileCol}?f=" + Rok4Format::to_ogcapi_format(pyramid->get_format())},
-                { "rel", "tiles"},
-                { "type", Rok4Format::to_mime_type(pyramid->get_format())},
-                { "title", id + " as raster tile with style " + s->get_identifier()},
-                { "templated", true}
-            });
+            write_link(writer, 
+                service->get_endpoint_uri() + "/collections/" + id + "/styles/" + s->get_identifier() + "/map/tiles/" + tmsi->tms->get_id() + "/{tileMatrix}/{tileRow}/{tileCol}?f=" + Rok4Format::to_ogcapi_format(pyramid->get_format()),
+                "tiles", Rok4Format::to_mime_type(pyramid->get_format()), id + " as raster tile with style " + s->get_identifier(), true
+            );
         }
 
     } else {
         // Interrogation de donnée vecteur
-        res["dataType"] = "vector";
-        links.push_back(json11::Json::object {
-            { "href", service->get_endpoint_uri() + "/collections/" + id + "/tiles/" + tmsi->tms->get_id() + "?f=json"},
-            { "rel", "self"},
-            { "type", "application/json"},
-            { "title", "this document"}
-        });
+        write_link(writer, service->get_endpoint_uri() + "/collections/" + id + "/tiles/" + tmsi->tms->get_id() + "?f=json", "self", "application/json", "this document");
         // Lien vers la tuile
-        links.push_back(json11::Json::object {
-            { "href", service->get_endpoint_uri() + "/collections/" + id + "/tiles/" + tmsi->tms->get_id() + "/{tileMatrix}/{tileRow}/{tileCol}?f=" + Rok4Format::to_ogcapi_format(pyramid->get_format())},
-            { "rel", "tiles"},
-            { "type", Rok4Format::to_mime_type(pyramid->get_format())},
-            { "title", id + " as vector tile"},
-            { "templated", true}
-        });
+        write_link(writer, 
+            service->get_endpoint_uri() + "/collections/" + id + "/tiles/" + tmsi->tms->get_id() + "/{tileMatrix}/{tileRow}/{tileCol}?f=" + Rok4Format::to_ogcapi_format(pyramid->get_format()),
+            "tiles", Rok4Format::to_mime_type(pyramid->get_format()), id + " as vector tile", true
+        );
     }
 
-    res["links"] = links;
-    res["tileMatrixSetLimits"] = tmsi->limits;
+    writer.end_array();
+
+    writer.key("tileMatrixSetLimits"); writer.value(json11::Json(tmsi->limits));
+    writer.key("tileMatrixSetURI"); writer.value(service->get_endpoint_uri() + "/tileMatrixSets/" + tmsi->tms->get_id() + "?f=json");
+    writer.key("title"); writer.value(title);
 
-    return res;
+    writer.end_object();
 }
 
 std::string Layer::get_description_tilejson(TmsService* service) {
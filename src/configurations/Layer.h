@@ -49,6 +49,8 @@ class Layer;
 
 #include <vector>
 #include <string>
+#include <mutex>
+#include <atomic>
 #include <boost/property_tree/ptree.hpp>
 using boost::property_tree::ptree;
 
@@ -64,6 +66,10 @@ using boost::property_tree::ptree;
 #include "configurations/Services.h"
 #include "configurations/Metadata.h"
 #include "configurations/Attribution.h"
+#include "configurations/CachePolicy.h"
+#include "configurations/TileOccupancy.h"
+#include "core/XmlWriter.h"
+#include "core/JsonWriter.h"
 
 #include "services/wmts/Service.h"
 #include "services/wms/Service.h"
@@ -171,6 +177,11 @@ private:
      * \~english \brief Tile pyramid
      */
     Pyramid* pyramid;
+    /**
+     * \~french \brief Occupation des niveaux de la pyramide par les dalles, NULL si non demandée
+     * \~english \brief Pyramid levels occupancy by slabs, NULL if not asked
+     */
+    TileOccupancy* occupancy;
 
     /**
      * \~french \brief Emprise des données en coordonnées géographique (WGS84)
@@ -253,6 +264,38 @@ private:
      * \~english \brief Additionnal query parameters for the service
      */
     std::map<std::string, std::string> gfi_extra_params;
+    /**
+     * \~french \brief GFI de type PYRAMID : interpolation bilinéaire des pixels sources, sinon plus proche voisin
+     * \~english \brief PYRAMID GFI : bilinear interpolation of source pixels, nearest neighbour otherwise
+     */
+    bool gfi_bilinear;
+
+    /**
+     * \~french \brief Politique de cache HTTP des tuiles, globale surchargée par celle de la couche
+     * \~english \brief Tiles HTTP cache policy, global one overriden by the layer's
+     */
+    CachePolicy tile_cache_policy;
+    /**
+     * \~french \brief Politique de cache HTTP des images, globale surchargée par celle de la couche
+     * \~english \brief Images HTTP cache policy, global one overriden by the layer's
+     */
+    CachePolicy map_cache_policy;
+
+    /**
+     * \~french \brief Descripteur JSON en attente d'analyse, pour un chargement différé
+     * \~english \brief JSON descriptor waiting to be parsed, for a deferred loading
+     */
+    json11::Json descriptor;
+    /**
+     * \~french \brief La couche est analysée et utilisable
+     * \~english \brief Layer is parsed and usable
+     */
+    std::atomic<bool> loaded;
+    /**
+     * \~french \brief Exclusion mutuelle du chargement différé
+     * \~english \brief Deferred loading mutual exclusion
+     */
+    std::mutex load_mtx;
 
     void calculate_bboxes();
     void calculate_native_tilematrix_limits();
@@ -265,13 +308,17 @@ public:
     * \~french
     * Crée un Layer à partir d'un fichier JSON
     * \brief Constructeur
+    * \details En chargement différé, seul le descripteur est lu : son analyse (pyramides, étendues, TMS) est faite par #load
     * \param[in] path Chemin vers le descripteur de couche
+    * \param[in] lazy Chargement différé
     * \~english
     * Create a Layer from a JSON file
     * \brief Constructor
+    * \details With a deferred loading, only the descriptor is read : it is parsed (pyramids, extents, TMS) by #load
     * \param[in] path Path to layer descriptor
+    * \param[in] lazy Deferred loading
     */
-    Layer(std::string path, ServicesConfiguration* services );
+    Layer(std::string path, ServicesConfiguration* services, bool lazy = false );
     /**
     * \~french
     * Crée un Layer à partir d'un contenu JSON
@@ -295,6 +342,26 @@ public:
      * \return identifier
      */
     std::string get_id();
+
+    /**
+     * \~french
+     * \brief Termine le chargement différé de la couche si nécessaire
+     * \details Les appels concurrents attendent la fin du chargement en cours. Un échec est définitif.
+     * \return vrai si la couche est utilisable
+     * \~english
+     * \brief Complete the layer's deferred loading if needed
+     * \details Concurrent calls wait for the current loading. A failure is final.
+     * \return true if layer is usable
+     */
+    bool load();
+
+    /**
+     * \~french
+     * \brief Indique si la couche est chargée et utilisable, sans déclencher son chargement
+     * \~english
+     * \brief Tell if layer is loaded and usable, without triggering its loading
+     */
+    bool is_loaded();
     
     /**
     * \~french
@@ -465,6 +532,16 @@ public:
      */
     TileMatrixLimits* get_tilematrix_limits(TileMatrixSet* tms, TileMatrix* tm) ;
 
+    /**
+     * \~french
+     * \brief La tuile peut-elle exister ?
+     * \details Dans le TMS natif et lorsque l'occupation de la pyramide est connue, la tuile n'existe pas si sa dalle est absente. Ce test n'accède pas au stockage.
+     * \~english
+     * \brief Can the tile exist ?
+     * \details In the native TMS and when pyramid occupancy is known, the tile does not exist if its slab is missing. This test does not access the storage.
+     */
+    bool contain_tile(TileMatrixSet* tms, TileMatrix* tm, int column, int row) ;
+
     /**
      * \~french
      * \brief Retourne l'emprise des données en coordonnées géographique (WGS84)
@@ -495,6 +572,22 @@ public:
      */
     Interpolation::KernelType get_resampling() ;
 
+    /**
+     * \~french
+     * \brief Récupère la politique de cache HTTP des tuiles
+     * \~english
+     * \brief Get tiles HTTP cache policy
+     */
+    const CachePolicy& get_tile_cache_policy() { return tile_cache_policy; } ;
+
+    /**
+     * \~french
+     * \brief Récupère la politique de cache HTTP des images
+     * \~english
+     * \brief Get images HTTP cache policy
+     */
+    const CachePolicy& get_map_cache_policy() { return map_cache_policy; } ;
+
     /**
      * \~french
      * \brief Retourne la liste des métadonnées associées
@@ -559,65 +652,89 @@ public:
      */
     std::map<std::string, std::string> get_gfi_extra_params() ;
 
+    /**
+     * \~french
+     * \brief Retourne vrai si le GFI de type PYRAMID interpole les pixels sources
+     * \~english
+     * \brief Return true if PYRAMID GFI interpolates source pixels
+     */
+    bool is_gfi_bilinear() ;
+
     /**
      * \~french \brief Ajoute un noeud WMS correpondant à la couche
-     * \param[in] parent Noeud auquel ajouter celui de la couche
+     * \param[in] writer Document XML en cours d'écriture
      * \param[in] service Service WMS appelant
      * \param[in] only_inspire Seulement si la couche est inspire
      * \~english \brief Add a WMS node corresponding to layer
-     * \param[in] parent Node to whom add the layer node
+     * \param[in] writer XML document being written
      * \param[in] service Calling WMS service
      * \param[in] only_inspire Only if layer is inspire compliant
      */
-    void add_node_wms(ptree& parent, WmsService* service, bool only_inspire);
+    void add_node_wms(XmlWriter& writer, WmsService* service, bool only_inspire);
 
     /**
      * \~french \brief Ajoute un noeud TMS correpondant à la couche
-     * \param[in] parent Noeud auquel ajouter celui de la couche
+     * \param[in] writer Document XML en cours d'écriture
      * \param[in] service Service TMS appelant
      * \~english \brief Add a TMS node corresponding to layer
-     * \param[in] parent Node to whom add the layer node
+     * \param[in] writer XML document being written
      * \param[in] service Calling TMS service
      */
-    void add_node_tms(ptree& parent, TmsService* service);
+    void add_node_tms(XmlWriter& writer, TmsService* service);
 
     /**
      * \~french \brief Ajoute un noeud WMTS correpondant à la couche
-     * \param[in] parent Noeud auquel ajouter celui de la couche
+     * \param[in] writer Document XML en cours d'écriture
      * \param[in] service Service WMTS appelant
      * \param[in] only_inspire Seulement si la couche est inspire
      * \param[in] used_tms_list TMS utilisés dans le service pour ajouter celui de la couche
      * \~english \brief Add a WMTS node corresponding to layer
-     * \param[in] parent Node to whom add the layer node
+     * \param[in] writer XML document being written
      * \param[in] service Calling WMTS service
      * \param[in] only_inspire Only if layer is inspire compliant
      * \param[in] used_tms_list Used TMS, to add the layer ones
      */
-    void add_node_wmts(ptree& parent, WmtsService* service, bool only_inspire, std::map< std::string, TileMatrixSetInfos*>* used_tms_list);
+    void add_node_wmts(XmlWriter& writer, WmtsService* service, bool only_inspire, std::map< std::string, TileMatrixSetInfos*>* used_tms_list);
+
+    /**
+     * \~french \brief Ajoute les TMS de la couche à ceux utilisés dans le service, sans construire son noeud WMTS
+     * \param[in] only_inspire Seulement si la couche est inspire
+     * \param[in] used_tms_list TMS utilisés dans le service pour ajouter celui de la couche
+     * \~english \brief Add layer TMS to the ones used in the service, without building its WMTS node
+     * \param[in] only_inspire Only if layer is inspire compliant
+     * \param[in] used_tms_list Used TMS, to add the layer ones
+     */
+    void add_used_tms_wmts(bool only_inspire, std::map< std::string, TileMatrixSetInfos*>* used_tms_list);
 
     /**
-     * \~french \brief Récupère la description OGC API de la couche au format JSON
+     * \~french \brief Écrit la description OGC API de la couche au format JSON
+     * \param[in] writer Document JSON en cours d'écriture
      * \param[in] service Service OGC API appelant
-     * \~english \brief Get layer OGC API description as JSON
+     * \~english \brief Write layer OGC API description as JSON
+     * \param[in] writer JSON document being written
      * \param[in] service Calling OGC API service
      */
-    json11::Json to_json_ogcapi(OgcApiService* service);
+    void to_json_ogcapi(JsonWriter& writer, OgcApiService* service);
 
     /**
-     * \~french \brief Récupère la description OGC API des TMS disponibles de la couche au format JSON
+     * \~french \brief Écrit la description OGC API des TMS disponibles de la couche au format JSON
+     * \param[in] writer Document JSON en cours d'écriture
      * \param[in] service Service OGC API appelant
-     * \~english \brief Get available TMS OGC API description for the layer as JSON
+     * \~english \brief Write available TMS OGC API description for the layer as JSON
+     * \param[in] writer JSON document being written
      * \param[in] service Calling OGC API service
      */
-    json11::Json to_json_tilesets(OgcApiService* service);
+    void to_json_tilesets(JsonWriter& writer, OgcApiService* service);
 
     /**
-     * \~french \brief Récupère la description OGC API de la couche pour un TMS en particulier au format JSON
+     * \~french \brief Écrit la description OGC API de la couche pour un TMS en particulier au format JSON
+     * \param[in] writer Document JSON en cours d'écriture
      * \param[in] service Service OGC API appelant
-     * \~english \brief Get layer OGC API description for an available TMS as JSON
+     * \~english \brief Write layer OGC API description for an available TMS as JSON
+     * \param[in] writer JSON document being written
      * \param[in] service Calling OGC API service
      */
-    json11::Json to_json_tileset(OgcApiService* service, TileMatrixSetInfos* tmsi);
+    void to_json_tileset(JsonWriter& writer, OgcApiService* service, TileMatrixSetInfos* tmsi);
 
     /**
      * \~french \brief Récupère la description TileJSON de la couche au format JSON
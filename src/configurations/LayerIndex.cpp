@@ -0,0 +1,171 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file configurations/LayerIndex.cpp
+ * \~french
+ * \brief Implémentation de la classe LayerIndex
+ * \~english
+ * \brief Implements classe LayerIndex
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "configurations/LayerIndex.h"
+#include "configurations/Layer.h"
+
+LayerIndex::LayerIndex(const std::map<std::string, Layer*>& layers) : root(0), complete(true) {
+
+    entries.reserve(layers.size());
+    for (std::map<std::string, Layer*>::const_iterator it = layers.begin(); it != layers.end(); ++it) {
+        // L'emprise géographique d'une couche n'est connue qu'une fois sa pyramide chargée
+        if (! it->second->is_loaded()) {
+            complete = false;
+            continue;
+        }
+        BoundingBox<double> bb = it->second->get_geographical_bbox();
+        Entry e;
+        e.box.xmin = bb.xmin;
+        e.box.ymin = bb.ymin;
+        e.box.xmax = bb.xmax;
+        e.box.ymax = bb.ymax;
+        e.id = it->first;
+        e.layer = it->second;
+        entries.push_back(e);
+    }
+
+    build();
+}
+
+void LayerIndex::build() {
+
+    if (entries.empty()) return;
+
+    // Éléments du niveau en cours de regroupement : emprise et référence (couche pour les feuilles, noeud au dessus)
+    std::vector<std::pair<Box, size_t> > level;
+    level.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        level.push_back(std::make_pair(entries.at(i).box, i));
+    }
+
+    bool leaf = true;
+    while (true) {
+        size_t count = level.size();
+        size_t pages = (count + NODE_CAPACITY - 1) / NODE_CAPACITY;
+        size_t slice_size = (size_t) std::ceil(std::sqrt((double) pages)) * NODE_CAPACITY;
+
+        std::sort(level.begin(), level.end(), [](const std::pair<Box, size_t>& a, const std::pair<Box, size_t>& b) {
+            return a.first.xmin + a.first.xmax < b.first.xmin + b.first.xmax;
+        });
+
+        std::vector<std::pair<Box, size_t> > upper;
+        upper.reserve(pages);
+        for (size_t slice = 0; slice < count; slice += slice_size) {
+            size_t slice_end = std::min(count, slice + slice_size);
+
+            std::sort(level.begin() + slice, level.begin() + slice_end, [](const std::pair<Box, size_t>& a, const std::pair<Box, size_t>& b) {
+                return a.first.ymin + a.first.ymax < b.first.ymin + b.first.ymax;
+            });
+
+            for (size_t c = slice; c < slice_end; c += NODE_CAPACITY) {
+                size_t c_end = std::min(slice_end, c + NODE_CAPACITY);
+
+                Node node;
+                node.box = level.at(c).first;
+                node.first = children.size();
+                node.count = c_end - c;
+                node.leaf = leaf;
+                for (size_t k = c; k < c_end; k++) {
+                    const Box& b = level.at(k).first;
+                    node.box.xmin = std::min(node.box.xmin, b.xmin);
+                    node.box.ymin = std::min(node.box.ymin, b.ymin);
+                    node.box.xmax = std::max(node.box.xmax, b.xmax);
+                    node.box.ymax = std::max(node.box.ymax, b.ymax);
+                    children.push_back(level.at(k).second);
+                }
+                nodes.push_back(node);
+                upper.push_back(std::make_pair(node.box, nodes.size() - 1));
+            }
+        }
+
+        if (upper.size() == 1) {
+            root = upper.front().second;
+            break;
+        }
+
+        level.swap(upper);
+        leaf = false;
+    }
+}
+
+void LayerIndex::query(const BoundingBox<double>& bbox, std::vector<std::pair<std::string, Layer*> >& layers) const {
+
+    if (nodes.empty()) return;
+
+    Box searched;
+    searched.xmin = bbox.xmin;
+    searched.ymin = bbox.ymin;
+    searched.xmax = bbox.xmax;
+    searched.ymax = bbox.ymax;
+
+    std::vector<size_t> found;
+    std::vector<size_t> stack;
+    stack.push_back(root);
+    while (! stack.empty()) {
+        const Node& node = nodes.at(stack.back());
+        stack.pop_back();
+        if (! overlaps(node.box, searched)) continue;
+
+        for (size_t k = node.first; k < node.first + node.count; k++) {
+            size_t child = children.at(k);
+            if (! node.leaf) {
+                stack.push_back(child);
+            } else if (overlaps(entries.at(child).box, searched)) {
+                found.push_back(child);
+            }
+        }
+    }
+
+    // Les couches sont restituées dans l'ordre de leur identifiant, comme sans index
+    std::sort(found.begin(), found.end());
+    layers.reserve(layers.size() + found.size());
+    for (size_t i : found) {
+        layers.push_back(std::make_pair(entries.at(i).id, entries.at(i).layer));
+    }
+}
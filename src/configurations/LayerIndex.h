@@ -0,0 +1,158 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file configurations/LayerIndex.h
+ * \~french
+ * \brief Définition de la classe LayerIndex, index spatial des emprises géographiques des couches
+ * \~english
+ * \brief Define the LayerIndex class, spatial index of layers geographic extents
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <rok4/utils/BoundingBox.h>
+
+class Layer;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * Un LayerIndex est un R-tree construit en une fois par la méthode STR (Sort-Tile-Recursive) : les emprises sont triées par abscisse, découpées en tranches verticales, elles-mêmes triées par ordonnée puis regroupées en noeuds pleins, et ainsi de suite jusqu'à la racine. Il n'est jamais modifié : une nouvelle version des couches entraîne un nouvel index.
+ *
+ * Seules les couches chargées sont indexées. Les emprises sont comparées bornes incluses, le test exact reste à la charge de l'appelant.
+ * \brief Index spatial des emprises géographiques des couches
+ * \~english
+ * A LayerIndex is a R-tree bulk loaded with STR (Sort-Tile-Recursive) method : extents are sorted by abscissa, split into vertical slices, themselves sorted by ordinate then grouped into full nodes, and so on up to the root. It is never modified : a new layers version leads to a new index.
+ *
+ * Only loaded layers are indexed. Extents are compared bounds included, the exact test is left to the caller.
+ * \brief Spatial index of layers geographic extents
+ */
+class LayerIndex {
+    friend class CppUnitLayerIndex;
+
+private:
+
+    /**
+     * \~french \brief Nombre maximal d'enfants d'un noeud
+     * \~english \brief Max children count of a node
+     */
+    static const size_t NODE_CAPACITY = 16;
+
+    struct Box {
+        double xmin, ymin, xmax, ymax;
+    };
+
+    struct Entry {
+        Box box;
+        std::string id;
+        Layer* layer;
+    };
+
+    /**
+     * \~french \brief Noeud, dont les enfants sont contigus dans #children : des couches pour une feuille, des noeuds sinon
+     * \~english \brief Node, whose children are contiguous in #children : layers for a leaf, nodes otherwise
+     */
+    struct Node {
+        Box box;
+        size_t first;
+        size_t count;
+        bool leaf;
+    };
+
+    /**
+     * \~french \brief Couches indexées, dans l'ordre de leur identifiant
+     * \~english \brief Indexed layers, in their identifier order
+     */
+    std::vector<Entry> entries;
+    std::vector<Node> nodes;
+    std::vector<size_t> children;
+    size_t root;
+
+    /**
+     * \~french \brief Toutes les couches étaient chargées à la construction
+     * \~english \brief All layers were loaded at build time
+     */
+    bool complete;
+
+    static bool overlaps(const Box& a, const Box& b) {
+        return a.xmin <= b.xmax && b.xmin <= a.xmax && a.ymin <= b.ymax && b.ymin <= a.ymax;
+    }
+
+    void build();
+
+public:
+
+    /**
+     * \~french
+     * \brief Construit l'index des couches chargées
+     * \param[in] layers Couches, indexées par leur identifiant
+     * \~english
+     * \brief Build the loaded layers index
+     * \param[in] layers Layers, indexed by their identifier
+     */
+    LayerIndex(const std::map<std::string, Layer*>& layers);
+
+    /**
+     * \~french
+     * \brief Liste les couches dont l'emprise géographique intersecte la bbox
+     * \param[in] bbox Emprise recherchée, en CRS84
+     * \param[out] layers Couches candidates, dans l'ordre de leur identifiant
+     * \~english
+     * \brief List layers whose geographic extent intersects the bbox
+     * \param[in] bbox Searched extent, in CRS84
+     * \param[out] layers Candidate layers, in their identifier order
+     */
+    void query(const BoundingBox<double>& bbox, std::vector<std::pair<std::string, Layer*> >& layers) const;
+
+    /**
+     * \~french
+     * \brief Toutes les couches étaient chargées à la construction
+     * \details Sinon, l'index doit être reconstruit pour prendre en compte les couches chargées depuis
+     * \~english
+     * \brief All layers were loaded at build time
+     * \details Otherwise, index have to be rebuilt to take into account layers loaded since
+     */
+    bool is_complete() const { return complete; };
+
+    size_t get_entries_count() const { return entries.size(); };
+};
@@ -0,0 +1,211 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file configurations/LayerRegistry.h
+ * \~french
+ * \brief Définition de la classe LayerRegistry, version figée de l'ensemble des couches
+ * \~english
+ * \brief Define the LayerRegistry class, frozen version of the layers set
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "configurations/LayerIndex.h"
+
+class Layer;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * Une instance LayerRegistry n'est jamais modifiée une fois publiée : une modification construit une nouvelle version, qui partage les couches inchangées. Les couches sont détenues par des pointeurs partagés : une couche retirée n'est supprimée qu'une fois libérées toutes les versions qui la contiennent, donc une fois finies les requêtes qui les utilisent.
+ * \brief Version immuable de l'ensemble des couches
+ * \~english
+ * A LayerRegistry is never modified once published : a modification builds a new version, sharing unchanged layers. Layers are owned by shared pointers : a removed layer is deleted only once all versions containing it are released, so once requests using them are done.
+ * \brief Immutable version of the layers set
+ */
+class LayerRegistry {
+
+public:
+
+    typedef std::vector<std::pair<std::string, std::shared_ptr<Layer> > > Entries;
+
+private:
+
+    /**
+     * \~french \brief Couches, indexées par leur identifiant
+     * \~english \brief Layers, indexed by their identifier
+     */
+    std::map<std::string, Layer*> layers;
+
+    /**
+     * \~french \brief Détenteurs des couches, garantissant leur durée de vie
+     * \~english \brief Layers owners, ensuring their lifetime
+     */
+    std::map<std::string, std::shared_ptr<Layer> > owners;
+
+    /**
+     * \~french \brief Numéro de version, incrémenté à chaque modification
+     * \~english \brief Version number, incremented by each modification
+     */
+    unsigned long version;
+
+    /**
+     * \~french \brief Index spatial des couches, construit à la première recherche (accès atomiques)
+     * \~english \brief Layers spatial index, built by the first search (atomic accesses)
+     */
+    mutable std::shared_ptr<const LayerIndex> spatial_index;
+
+    /**
+     * \~french \brief Copie les couches dans la version suivante, sans l'index spatial
+     * \~english \brief Copy layers into the next version, without the spatial index
+     */
+    std::shared_ptr<LayerRegistry> next_version() const {
+        std::shared_ptr<LayerRegistry> next = std::make_shared<LayerRegistry>();
+        next->layers = layers;
+        next->owners = owners;
+        next->version = version + 1;
+        return next;
+    }
+
+public:
+
+    /**
+     * \~french \brief Crée une version vide
+     * \~english \brief Create an empty version
+     */
+    LayerRegistry() : version(0) { };
+
+    /**
+     * \~french
+     * \brief Construit la version suivante avec les couches ajoutées
+     * \details Une couche dont l'identifiant est déjà présent n'est pas ajoutée et est retournée dans la liste des rejetées
+     * \param[in] added Couches à ajouter, avec leur identifiant
+     * \param[out] rejected Couches non ajoutées
+     * \~english
+     * \brief Build the next version with added layers
+     * \details A layer whose identifier is already present is not added and is returned in the rejected list
+     * \param[in] added Layers to add, with their identifier
+     * \param[out] rejected Not added layers
+     */
+    std::shared_ptr<LayerRegistry> with_layers(const Entries& added, Entries& rejected) const {
+        std::shared_ptr<LayerRegistry> next = next_version();
+        for (const std::pair<std::string, std::shared_ptr<Layer> >& e : added) {
+            if (next->owners.find(e.first) != next->owners.end()) {
+                rejected.push_back(e);
+                continue;
+            }
+            next->owners.emplace(e.first, e.second);
+            next->layers.emplace(e.first, e.second.get());
+        }
+        return next;
+    }
+
+    /**
+     * \~french
+     * \brief Construit la version suivante où la couche remplace celle de même identifiant
+     * \return NULL si aucune couche n'a cet identifiant
+     * \~english
+     * \brief Build the next version where the layer replaces the one with the same identifier
+     * \return NULL if no layer has this identifier
+     */
+    std::shared_ptr<LayerRegistry> with_replaced_layer(std::string id, std::shared_ptr<Layer> layer) const {
+        if (owners.find(id) == owners.end()) {
+            return std::shared_ptr<LayerRegistry>();
+        }
+        std::shared_ptr<LayerRegistry> next = next_version();
+        next->owners[id] = layer;
+        next->layers[id] = layer.get();
+        return next;
+    }
+
+    /**
+     * \~french
+     * \brief Construit la version suivante sans la couche
+     * \return NULL si aucune couche n'a cet identifiant
+     * \~english
+     * \brief Build the next version without the layer
+     * \return NULL if no layer has this identifier
+     */
+    std::shared_ptr<LayerRegistry> without_layer(std::string id) const {
+        if (owners.find(id) == owners.end()) {
+            return std::shared_ptr<LayerRegistry>();
+        }
+        std::shared_ptr<LayerRegistry> next = next_version();
+        next->owners.erase(id);
+        next->layers.erase(id);
+        return next;
+    }
+
+    const std::map<std::string, Layer*>& get_layers() const { return layers; };
+
+    Layer* get_layer(std::string id) const {
+        std::map<std::string, Layer*>::const_iterator it = layers.find ( id );
+        if ( it == layers.end() ) {
+            return NULL;
+        }
+        return it->second;
+    };
+
+    int get_layers_count() const { return layers.size(); };
+
+    unsigned long get_version() const { return version; };
+
+    /**
+     * \~french
+     * \brief Retourne l'index spatial des emprises géographiques des couches
+     * \details L'index est construit une fois par version. Tant que des couches sont en cours de chargement, il est reconstruit à chaque appel pour les prendre en compte.
+     * \~english
+     * \brief Return the spatial index of layers geographic extents
+     * \details Index is built once by version. While layers are being loaded, it is rebuilt by each call to take them into account.
+     */
+    std::shared_ptr<const LayerIndex> get_spatial_index() const {
+        std::shared_ptr<const LayerIndex> index = std::atomic_load(&spatial_index);
+        if (index && index->is_complete()) {
+            return index;
+        }
+        index = std::make_shared<LayerIndex>(layers);
+        std::atomic_store(&spatial_index, index);
+        return index;
+    };
+};
@@ -49,6 +49,9 @@ class Metadata;
 
 #include <rok4/utils/ResourceLocator.h>
 
+#include "core/XmlWriter.h"
+#include "core/JsonWriter.h"
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -183,38 +186,62 @@ public:
         node.add("<xmlattr>.href", href);
     }
 
+    /**
+     * \~french \brief Ajoute un noeud TMS correpondant à la métadonnée
+     * \param[in] writer Document XML en cours d'écriture
+     * \~english \brief Add a TMS node corresponding to metadata
+     * \param[in] writer XML document being written
+     */
+    void add_node_tms(XmlWriter& writer) {
+        writer.start_element("Metadata");
+        writer.attribute("type", type);
+        writer.attribute("mime-type", format);
+        writer.attribute("href", href);
+        writer.end_element();
+    }
+
     /**
      * \~french \brief Ajoute un noeud WMS correpondant à la métadonnée
-     * \param[in] parent Noeud auquel ajouter celui de la métadonnée
+     * \param[in] writer Document XML en cours d'écriture
      * \~english \brief Add a WMS node corresponding to metadata
-     * \param[in] parent Node to whom add the metadata node
+     * \param[in] writer XML document being written
      */
-    void add_node_wms(ptree& parent) {
-        ptree& node = parent.add("MetadataURL", "");
-        node.add("<xmlattr>.type", type);
-        node.add("Format", format);
-        node.add("OnlineResource.<xmlattr>.xlink:href", href);
-        node.add("OnlineResource.<xmlattr>.xlink:type", "simple");
+    void add_node_wms(XmlWriter& writer) {
+        writer.start_element("MetadataURL");
+        writer.attribute("type", type);
+        writer.element("Format", format);
+        writer.start_element("OnlineResource");
+        writer.attribute("xlink:href", href);
+        writer.attribute("xlink:type", "simple");
+        writer.end_element();
+        writer.end_element();
     }
 
     /**
      * \~french \brief Ajoute un noeud WMTS correpondant à la métadonnée
-     * \param[in] parent Noeud auquel ajouter celui de la métadonnée
+     * \param[in] writer Document XML en cours d'écriture
      * \~english \brief Add a WMTS node corresponding to metadata
-     * \param[in] parent Node to whom add the metadata node
+     * \param[in] writer XML document being written
      */
-    void add_node_wmts(ptree& parent) {
-        ptree& node = parent.add("ows:Metadata", "");
-        node.add("<xmlattr>.xlink:href", href);
+    void add_node_wmts(XmlWriter& writer) {
+        writer.start_element("ows:Metadata");
+        writer.attribute("xlink:href", href);
+        writer.end_element();
     }
 
-    json11::Json to_json_ogcapi(std::string title, std::string rel) const {
-        return json11::Json::object {
-            { "href", href },
-            { "type", type },
-            { "rel", rel },
-            { "title", title }
-        };
+    /**
+     * \~french \brief Écrit le lien OGC API correspondant à la métadonnée
+     * \param[in] writer Document JSON en cours d'écriture
+     * \~english \brief Write the OGC API link corresponding to metadata
+     * \param[in] writer JSON document being written
+     */
+    void to_json_ogcapi(JsonWriter& writer, std::string title, std::string rel) const {
+        writer.start_object();
+        writer.key("href"); writer.value(href);
+        writer.key("rel"); writer.value(rel);
+        writer.key("title"); writer.value(title);
+        writer.key("type"); writer.value(type);
+        writer.end_object();
     }
 };
 
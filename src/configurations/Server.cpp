@@ -36,8 +36,10 @@
  */
 
 #include "configurations/Server.h"
+#include "core/Books.h"
 #include <cmath>
 #include <fstream>
+#include <thread>
 
 bool ServerConfiguration::parse(json11::Json& doc) {
 
@@ -121,6 +123,181 @@ bool ServerConfiguration::parse(json11::Json& doc) {
         cache_validity = doc["cache"]["validity"].number_value();
     }
 
+    // tile cache
+    tile_cache_size = 0;
+    tile_cache_shards = DEFAULT_TILE_CACHE_SHARDS;
+    if (doc["tile_cache"].is_object()) {
+        if (doc["tile_cache"]["size"].is_number() && doc["tile_cache"]["size"].int_value() >= 0) {
+            tile_cache_size = doc["tile_cache"]["size"].int_value();
+        } else if (! doc["tile_cache"]["size"].is_null()) {
+            error_message = "tile_cache.size have to be a positive number";
+            return false;
+        }
+        if (doc["tile_cache"]["shards"].is_number() && doc["tile_cache"]["shards"].int_value() >= 1) {
+            tile_cache_shards = doc["tile_cache"]["shards"].int_value();
+        } else if (! doc["tile_cache"]["shards"].is_null()) {
+            error_message = "tile_cache.shards have to be a positive number";
+            return false;
+        }
+    } else if (! doc["tile_cache"].is_null()) {
+        error_message = "tile_cache have to be an object";
+        return false;
+    }
+
+    // map rendering
+    map_threads_count = 0;
+    map_threads_per_request = DEFAULT_MAP_THREADS_PER_REQUEST;
+    map_band_height = DEFAULT_MAP_BAND_HEIGHT;
+    if (doc["map_rendering"].is_object()) {
+        if (doc["map_rendering"]["threads"].is_number() && doc["map_rendering"]["threads"].int_value() >= 0) {
+            map_threads_count = doc["map_rendering"]["threads"].int_value();
+        } else if (! doc["map_rendering"]["threads"].is_null()) {
+            error_message = "map_rendering.threads have to be a positive number";
+            return false;
+        }
+        if (doc["map_rendering"]["threads_per_request"].is_number() && doc["map_rendering"]["threads_per_request"].int_value() >= 1) {
+            map_threads_per_request = doc["map_rendering"]["threads_per_request"].int_value();
+        } else if (! doc["map_rendering"]["threads_per_request"].is_null()) {
+            error_message = "map_rendering.threads_per_request have to be a strictly positive number";
+            return false;
+        }
+        if (doc["map_rendering"]["band_height"].is_number() && doc["map_rendering"]["band_height"].int_value() >= 16) {
+            map_band_height = doc["map_rendering"]["band_height"].int_value();
+        } else if (! doc["map_rendering"]["band_height"].is_null()) {
+            error_message = "map_rendering.band_height have to be a number greater than 16";
+            return false;
+        }
+    } else if (! doc["map_rendering"].is_null()) {
+        error_message = "map_rendering have to be an object";
+        return false;
+    }
+
+    // external requests
+    external_timeout = DEFAULT_EXTERNAL_TIMEOUT;
+    external_max_host_connections = DEFAULT_EXTERNAL_MAX_HOST_CONNECTIONS;
+    external_hedge_delay = 0;
+    external_cache_ttl = 0;
+    external_cache_size = DEFAULT_EXTERNAL_CACHE_SIZE;
+    if (doc["external_requests"].is_object()) {
+        json11::Json external = doc["external_requests"];
+        if (external["timeout"].is_number() && external["timeout"].int_value() >= 1) {
+            external_timeout = external["timeout"].int_value();
+        } else if (! external["timeout"].is_null()) {
+            error_message = "external_requests.timeout have to be a strictly positive number";
+            return false;
+        }
+        if (external["max_host_connections"].is_number() && external["max_host_connections"].int_value() >= 0) {
+            external_max_host_connections = external["max_host_connections"].int_value();
+        } else if (! external["max_host_connections"].is_null()) {
+            error_message = "external_requests.max_host_connections have to be a positive number";
+            return false;
+        }
+        if (external["hedge_delay"].is_number() && external["hedge_delay"].int_value() >= 0) {
+            external_hedge_delay = external["hedge_delay"].int_value();
+        } else if (! external["hedge_delay"].is_null()) {
+            error_message = "external_requests.hedge_delay have to be a positive number";
+            return false;
+        }
+        if (external["cache_ttl"].is_number() && external["cache_ttl"].int_value() >= 0) {
+            external_cache_ttl = external["cache_ttl"].int_value();
+        } else if (! external["cache_ttl"].is_null()) {
+            error_message = "external_requests.cache_ttl have to be a positive number";
+            return false;
+        }
+        if (external["cache_size"].is_number() && external["cache_size"].int_value() >= 0) {
+            external_cache_size = external["cache_size"].int_value();
+        } else if (! external["cache_size"].is_null()) {
+            error_message = "external_requests.cache_size have to be a positive number";
+            return false;
+        }
+    } else if (! doc["external_requests"].is_null()) {
+        error_message = "external_requests have to be an object";
+        return false;
+    }
+
+    // access log
+    access_log_output = "none";
+    access_log_file = DEFAULT_ACCESS_LOG_FILE;
+    access_log_buffer_size = DEFAULT_ACCESS_LOG_BUFFER_SIZE;
+    access_log_flush_interval = DEFAULT_ACCESS_LOG_FLUSH_INTERVAL;
+    if (doc["access_log"].is_object()) {
+        json11::Json access = doc["access_log"];
+        if (access["output"].is_string()) {
+            access_log_output = access["output"].string_value();
+            if ( access_log_output != "none" && access_log_output != "file" && access_log_output != "standard_output" ) {
+                error_message = "access_log.output '" + access_log_output + "' is unknown";
+                return false;
+            }
+        } else if (! access["output"].is_null()) {
+            error_message = "access_log.output have to be a string";
+            return false;
+        }
+        if (access["file"].is_string()) {
+            access_log_file = access["file"].string_value();
+        } else if (! access["file"].is_null()) {
+            error_message = "access_log.file have to be a string";
+            return false;
+        }
+        if (access["buffer_size"].is_number() && access["buffer_size"].int_value() >= 1) {
+            access_log_buffer_size = access["buffer_size"].int_value();
+        } else if (! access["buffer_size"].is_null()) {
+            error_message = "access_log.buffer_size have to be a strictly positive number";
+            return false;
+        }
+        if (access["flush_interval"].is_number() && access["flush_interval"].int_value() >= 1) {
+            access_log_flush_interval = access["flush_interval"].int_value();
+        } else if (! access["flush_interval"].is_null()) {
+            error_message = "access_log.flush_interval have to be a strictly positive number";
+            return false;
+        }
+    } else if (! doc["access_log"].is_null()) {
+        error_message = "access_log have to be an object";
+        return false;
+    }
+
+    // request timing
+    server_timing = false;
+    slow_request_threshold = 0;
+    if (doc["request_timing"].is_object()) {
+        json11::Json timing = doc["request_timing"];
+        if (timing["server_timing"].is_bool()) {
+            server_timing = timing["server_timing"].bool_value();
+        } else if (! timing["server_timing"].is_null()) {
+            error_message = "request_timing.server_timing have to be a boolean";
+            return false;
+        }
+        if (timing["slow_threshold"].is_number() && timing["slow_threshold"].int_value() >= 0) {
+            slow_request_threshold = timing["slow_threshold"].int_value();
+        } else if (! timing["slow_threshold"].is_null()) {
+            error_message = "request_timing.slow_threshold have to be a positive number";
+            return false;
+        }
+    } else if (! doc["request_timing"].is_null()) {
+        error_message = "request_timing have to be an object";
+        return false;
+    }
+
+    // layers loading
+    layers_loading_threads = DEFAULT_LAYERS_LOADING_THREADS;
+    layers_lazy_loading = false;
+    if (doc["layers_loading"].is_object()) {
+        if (doc["layers_loading"]["threads"].is_number() && doc["layers_loading"]["threads"].int_value() >= 1) {
+            layers_loading_threads = doc["layers_loading"]["threads"].int_value();
+        } else if (! doc["layers_loading"]["threads"].is_null()) {
+            error_message = "layers_loading.threads have to be a strictly positive number";
+            return false;
+        }
+        if (doc["layers_loading"]["lazy"].is_bool()) {
+            layers_lazy_loading = doc["layers_loading"]["lazy"].bool_value();
+        } else if (! doc["layers_loading"]["lazy"].is_null()) {
+            error_message = "layers_loading.lazy have to be a boolean";
+            return false;
+        }
+    } else if (! doc["layers_loading"].is_null()) {
+        error_message = "layers_loading have to be an object";
+        return false;
+    }
+
     // threads
     if (doc["threads"].is_null()) {
         std::cerr << "No threads, default value used" << std::endl;
@@ -131,6 +308,33 @@ bool ServerConfiguration::parse(json11::Json& doc) {
     } else {
         threads_count = doc["threads"].int_value();
     }
+    if (threads_count <= 0) {
+        // Autant de threads de traitement que de coeurs
+        threads_count = std::thread::hardware_concurrency();
+        if (threads_count <= 0) threads_count = DEFAULT_NB_THREAD;
+    }
+
+    // acceptors
+    if (doc["acceptors"].is_null()) {
+        std::cerr << "No acceptors, default value used" << std::endl;
+        acceptors_count = DEFAULT_NB_ACCEPTOR;
+    } else if (! doc["acceptors"].is_number() || doc["acceptors"].int_value() < 1) {
+        error_message = "acceptors have to be a positive number";
+        return false;
+    } else {
+        acceptors_count = doc["acceptors"].int_value();
+    }
+
+    // queue
+    if (doc["queue_size"].is_null()) {
+        std::cerr << "No queue_size, default value used" << std::endl;
+        queue_size = DEFAULT_QUEUE_SIZE;
+    } else if (! doc["queue_size"].is_number() || doc["queue_size"].int_value() < 1) {
+        error_message = "queue_size have to be a positive number";
+        return false;
+    } else {
+        queue_size = doc["queue_size"].int_value();
+    }
 
     // port
     if (doc["port"].is_null() || ! doc["port"].is_string() || doc["port"].string_value() == "") {
@@ -183,7 +387,7 @@ bool ServerConfiguration::parse(json11::Json& doc) {
             error_message = "configurations.styles have to be provided and be a string";
             return false;
         } else {
-            StyleBook::set_directory(configurationsSection["styles"].string_value());
+            Books::set_styles_directory(configurationsSection["styles"].string_value());
         }
 
         // tile_matrix_sets
@@ -191,7 +395,7 @@ bool ServerConfiguration::parse(json11::Json& doc) {
             error_message = "configurations.tile_matrix_sets have to be provided and be a string";
             return false;
         } else {
-            TmsBook::set_directory(configurationsSection["tile_matrix_sets"].string_value());
+            Books::set_tms_directory(configurationsSection["tile_matrix_sets"].string_value());
         }
     }
 
@@ -239,6 +443,10 @@ boost::log::v2_mt_posix::trivial::severity_level ServerConfiguration::get_log_le
 
 std::string ServerConfiguration::get_services_configuration_file() {return services_configuration_file;}
 std::string ServerConfiguration::get_layers_list() {return layers_list;}
+int ServerConfiguration::get_layers_loading_threads() {return layers_loading_threads;}
+bool ServerConfiguration::is_layers_lazy_loading() {return layers_lazy_loading;}
 
 int ServerConfiguration::get_threads_count() {return threads_count;}
+int ServerConfiguration::get_acceptors_count() {return acceptors_count;}
+int ServerConfiguration::get_queue_size() {return queue_size;}
 std::string ServerConfiguration::get_socket() {return socket;}
@@ -80,8 +80,12 @@ class ServerConfiguration : public Configuration
 
         std::string get_services_configuration_file() ;
         std::string get_layers_list() ;
+        int get_layers_loading_threads() ;
+        bool is_layers_lazy_loading() ;
         
         int get_threads_count() ;
+        int get_acceptors_count() ;
+        int get_queue_size() ;
         std::string get_socket() ;
 
     protected:
@@ -93,8 +97,24 @@ class ServerConfiguration : public Configuration
         int log_file_period;
         boost::log::v2_mt_posix::trivial::severity_level log_level;
 
+        /**
+         * \~french \brief Nombre de threads de traitement des requêtes (nombre de coeurs si 0)
+         * \~english \brief Request processing threads count (cores count if 0)
+         */
         int threads_count;
 
+        /**
+         * \~french \brief Nombre de threads d'acceptation des connexions FastCGI
+         * \~english \brief FastCGI connections accepting threads count
+         */
+        int acceptors_count;
+
+        /**
+         * \~french \brief Nombre maximal de requêtes acceptées en attente de traitement
+         * \~english \brief Max accepted requests count waiting for processing
+         */
+        int queue_size;
+
         /**
          * \~french \brief Taille du cache des index des dalles
          * \~english \brief Cache size
@@ -106,11 +126,106 @@ class ServerConfiguration : public Configuration
          */
         int cache_validity;
 
+        /**
+         * \~french \brief Taille du cache des tuiles encodées, en mégaoctets (désactivé si 0)
+         * \~english \brief Encoded tiles cache size, in megabytes (disabled if 0)
+         */
+        int tile_cache_size;
+        /**
+         * \~french \brief Nombre de sections du cache des tuiles
+         * \~english \brief Tiles cache shards count
+         */
+        int tile_cache_shards;
+
+        /**
+         * \~french \brief Nombre de threads de rendu parallèle des images (désactivé si 0)
+         * \~english \brief Images parallel rendering threads count (disabled if 0)
+         */
+        int map_threads_count;
+        /**
+         * \~french \brief Nombre maximal de bandes d'une image calculées simultanément
+         * \~english \brief Max bands count of an image computed at the same time
+         */
+        int map_threads_per_request;
+        /**
+         * \~french \brief Hauteur des bandes de rendu, en lignes
+         * \~english \brief Rendering bands height, in lines
+         */
+        int map_band_height;
+
+        /**
+         * \~french \brief Délai des requêtes vers les services externes, en secondes
+         * \~english \brief Requests to external services timeout, in seconds
+         */
+        int external_timeout;
+        /**
+         * \~french \brief Nombre maximal de connexions par service externe
+         * \~english \brief Max connections count per external service
+         */
+        int external_max_host_connections;
+        /**
+         * \~french \brief Délai avant relance d'une requête externe sans réponse, en millisecondes (pas de relance si 0)
+         * \~english \brief Delay before sending again an external request without response, in milliseconds (no retry if 0)
+         */
+        int external_hedge_delay;
+        /**
+         * \~french \brief Durée de validité des réponses externes en cache, en secondes (pas de cache si 0)
+         * \~english \brief Cached external responses validity, in seconds (no cache if 0)
+         */
+        int external_cache_ttl;
+        /**
+         * \~french \brief Nombre maximal de réponses externes en cache
+         * \~english \brief Max cached external responses count
+         */
+        int external_cache_size;
+
+        /**
+         * \~french \brief Sortie du journal d'accès : none, file ou standard_output
+         * \~english \brief Access log output : none, file or standard_output
+         */
+        std::string access_log_output;
+        /**
+         * \~french \brief Fichier du journal d'accès
+         * \~english \brief Access log file
+         */
+        std::string access_log_file;
+        /**
+         * \~french \brief Nombre d'enregistrements du tampon de chaque thread de traitement
+         * \~english \brief Records count of each worker thread buffer
+         */
+        int access_log_buffer_size;
+        /**
+         * \~french \brief Période d'écriture du journal d'accès, en millisecondes
+         * \~english \brief Access log writing period, in milliseconds
+         */
+        int access_log_flush_interval;
+
+        /**
+         * \~french \brief Émission de l'en-tête Server-Timing avec les durées des phases du traitement
+         * \~english \brief Server-Timing header emission with processing phases durations
+         */
+        bool server_timing;
+        /**
+         * \~french \brief Durée au-delà de laquelle une requête est journalisée avec le détail des phases, en millisecondes (désactivé si 0)
+         * \~english \brief Duration beyond which a request is logged with phases details, in milliseconds (disabled if 0)
+         */
+        int slow_request_threshold;
+
         /**
          * \~french \brief Fichier ou objet contenant la liste des descipteurs de couche
          * \~english \brief File or object containing layers' descriptors list
          */
         std::string layers_list;
+        /**
+         * \~french \brief Nombre de threads de chargement des couches
+         * \~english \brief Layers loading threads count
+         */
+        int layers_loading_threads;
+        /**
+         * \~french \brief Chargement des pyramides différé au premier accès à la couche
+         * \~english \brief Pyramids loading deferred to the first layer access
+         */
+        bool layers_lazy_loading;
 
         /**
          * \~french \brief Adresse du socket d'écoute (vide si lancement géré par un tiers)
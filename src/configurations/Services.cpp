@@ -35,6 +35,7 @@
  * knowledge of the CeCILL-C license and that you accept its terms.
  */
 
+#include <algorithm>
 #include <fstream>
 
 #include "configurations/Services.h"
@@ -59,6 +60,8 @@ bool ServicesConfiguration::parse(json11::Json& doc) {
 
     map_reprojection = true;
     tile_reprojection = false;
+    map_reprojection_tolerance = 0;
+    tile_reprojection_tolerance = 0;
 
     map_max_layers_count = 1;
     map_max_width = 5000;
@@ -149,11 +152,24 @@ bool ServicesConfiguration::parse(json11::Json& doc) {
             return false;
         }
 
+        // Cache HTTP
+        default_cache_policy = CachePolicy(global_section["cache"], "Services configuration: global.cache");
+        if (! default_cache_policy.is_ok()) {
+            error_message = default_cache_policy.get_error_message();
+            return false;
+        }
+
         // Map
         if (global_section["map"].is_object()) {
 
             json11::Json map_section = global_section["map"];
 
+            map_cache_policy = CachePolicy(map_section["cache"], "Services configuration: global.map.cache");
+            if (! map_cache_policy.is_ok()) {
+                error_message = map_cache_policy.get_error_message();
+                return false;
+            }
+
             if (map_section["reprojection"].is_bool()) {
                 map_reprojection = map_section["reprojection"].bool_value();
             } else if (! map_section["reprojection"].is_null()) {
@@ -161,6 +177,13 @@ bool ServicesConfiguration::parse(json11::Json& doc) {
                 return false;
             }
 
+            if (map_section["reprojection_tolerance"].is_number() && map_section["reprojection_tolerance"].number_value() >= 0) {
+                map_reprojection_tolerance = map_section["reprojection_tolerance"].number_value();
+            } else if (! map_section["reprojection_tolerance"].is_null()) {
+                error_message = "Services configuration: global.map.reprojection_tolerance have to be a positive number";
+                return false;
+            }
+
             if (map_section["formats"].is_array()) {
                 map_formats.clear();
                 for (json11::Json f : map_section["formats"].array_items()) {
@@ -318,7 +341,13 @@ bool ServicesConfiguration::parse(json11::Json& doc) {
         if (global_section["tile"].is_object()) {
 
             json11::Json tile_section = global_section["tile"];
-            
+
+            tile_cache_policy = CachePolicy(tile_section["cache"], "Services configuration: global.tile.cache");
+            if (! tile_cache_policy.is_ok()) {
+                error_message = tile_cache_policy.get_error_message();
+                return false;
+            }
+
             if (tile_section["reprojection"].is_bool()) {
                 tile_reprojection = tile_section["reprojection"].bool_value();
             } else if (! tile_section["reprojection"].is_null()) {
@@ -326,6 +355,13 @@ bool ServicesConfiguration::parse(json11::Json& doc) {
                 return false;
             }
 
+            if (tile_section["reprojection_tolerance"].is_number() && tile_section["reprojection_tolerance"].number_value() >= 0) {
+                tile_reprojection_tolerance = tile_section["reprojection_tolerance"].number_value();
+            } else if (! tile_section["reprojection_tolerance"].is_null()) {
+                error_message = "Services configuration: global.tile.reprojection_tolerance have to be a positive number";
+                return false;
+            }
+
 
         } else if (! global_section["tile"].is_null()) {
             error_message = "Services configuration: global.tile have to be an object";
@@ -417,10 +453,43 @@ bool ServicesConfiguration::parse(json11::Json& doc) {
         BOOST_LOG_TRIVIAL(info) <<  "OGC API service disabled";
     }
 
+    // ----------------------- Table de routage
+
+    // En cas de racines identiques, le premier service dans l'ordre de priorité l'emporte
+    Service* by_priority[] = {health_service, admin_service, tms_service, wmts_service, ogcapi_service, wms_service};
+    max_root_path_size = 0;
+    for (int rank = 0; rank < 6; rank++) {
+        Service* s = by_priority[rank];
+        if (s->is_enabled()) {
+            services_by_root_path.emplace(s->get_root_path(), std::make_pair(rank, s));
+            max_root_path_size = std::max(max_root_path_size, s->get_root_path().size());
+        }
+    }
+
     return true;
 }
 
-ServicesConfiguration::ServicesConfiguration(std::string path) : Configuration(path) {
+Service* ServicesConfiguration::get_service(const std::string& path) {
+
+    // On teste les préfixes du chemin s'arrêtant à la fin d'un segment, en commençant par la racine vide,
+    // jusqu'à la taille de la plus longue racine. Le service de meilleure priorité est retenu
+    std::pair<int, Service*> found(-1, NULL);
+    size_t end = 0;
+    while (true) {
+        std::map<std::string, std::pair<int, Service*> >::iterator it = services_by_root_path.find(path.substr(0, end));
+        if (it != services_by_root_path.end() && (found.second == NULL || it->second.first < found.first)) {
+            found = it->second;
+        }
+
+        if (end >= path.size() || end >= max_root_path_size) break;
+        end = path.find('/', end + 1);
+        if (end == std::string::npos) end = path.size();
+    }
+
+    return found.second;
+}
+
+ServicesConfiguration::ServicesConfiguration(std::string path) : Configuration(path), layers(std::make_shared<LayerRegistry>()), max_root_path_size(0), layer_loader(NULL) {
 
     std::cout << "Loading services configuration from file " << file_path << std::endl;
 
@@ -570,6 +639,9 @@ std::vector<CRS*>* ServicesConfiguration::get_map_available_crs() {
 }
 
 ServicesConfiguration::~ServicesConfiguration(){ 
+    // Arrêt du chargement des couches en arrière-plan, avant de supprimer ce qu'il utilise
+    if (layer_loader != NULL) delete layer_loader;
+
     delete tms_service;
     delete health_service;
     delete wmts_service;
@@ -578,10 +650,9 @@ ServicesConfiguration::~ServicesConfiguration(){
     delete ogcapi_service;
     delete contact;
 
-    // Les couches
-    std::map<std::string, Layer*>::iterator itLay;
-    for ( itLay = layers.begin(); itLay != layers.end(); itLay++ )
-        delete itLay->second;
+    // Les couches, supprimées avec la dernière version qui les contient
+    unpin_layers();
+    layers.reset();
 }
 
 bool ServicesConfiguration::is_enabled() {return enabled;}
@@ -592,24 +663,107 @@ void ServicesConfiguration::clean_cache() {
     tms_service->clean_cache();
     ogcapi_service->clean_cache();
 };
-std::map<std::string, Layer*>& ServicesConfiguration::get_layers() {return layers;}
-void ServicesConfiguration::add_layer(Layer* l) {
-    layers.insert ( std::pair<std::string, Layer *> ( l->get_id(), l ) );
+void ServicesConfiguration::invalidate_layer(std::string id) {
+    wms_service->invalidate_layer(id);
+    wmts_service->invalidate_layer(id);
+    tms_service->invalidate_layer(id);
+    ogcapi_service->invalidate_layer(id);
+};
+thread_local std::shared_ptr<const LayerRegistry> ServicesConfiguration::pinned_layers;
+thread_local ServicesConfiguration* ServicesConfiguration::pinned_owner = NULL;
+
+void ServicesConfiguration::pin_layers() {
+    pinned_layers = std::atomic_load(&layers);
+    pinned_owner = this;
+}
+void ServicesConfiguration::unpin_layers() {
+    if (pinned_owner == this) {
+        pinned_layers.reset();
+        pinned_owner = NULL;
+    }
+}
+std::shared_ptr<const LayerRegistry> ServicesConfiguration::get_pinned_layers() {
+    if (pinned_owner != this || ! pinned_layers) {
+        pin_layers();
+    }
+    return pinned_layers;
+}
+void ServicesConfiguration::publish_layers(std::shared_ptr<const LayerRegistry> next) {
+    std::atomic_store(&layers, next);
+    BOOST_LOG_TRIVIAL(debug) << "Layers version " << next->get_version() << " published";
+}
+
+bool ServicesConfiguration::are_pinned_layers_current() {
+    return get_pinned_layers() == std::atomic_load(&layers);
+}
+unsigned long ServicesConfiguration::get_pinned_layers_version() {
+    return get_pinned_layers()->get_version();
+}
+const std::map<std::string, Layer*>& ServicesConfiguration::get_layers() {
+    // La version figée est conservée par le thread, la référence reste valide jusqu'à unpin_layers
+    return get_pinned_layers()->get_layers();
+}
+void ServicesConfiguration::load_layers(std::vector<std::string>& descriptors, int threads, bool lazy) {
+    if (layer_loader != NULL) delete layer_loader;
+    layer_loader = new LayerLoader(this, threads, lazy);
+    layer_loader->load(descriptors);
+}
+std::shared_ptr<const LayerIndex> ServicesConfiguration::get_spatial_index() {
+    return get_pinned_layers()->get_spatial_index();
+}
+bool ServicesConfiguration::are_layers_loaded() {
+    return layer_loader == NULL || layer_loader->is_ready();
+}
+int ServicesConfiguration::add_layers(std::vector<Layer*>& added) {
+    LayerRegistry::Entries entries, rejected;
+    for (Layer* l : added) {
+        entries.push_back(std::make_pair(l->get_id(), std::shared_ptr<Layer>(l)));
+    }
+
+    std::lock_guard<std::mutex> lock(layers_mtx);
+    publish_layers(std::atomic_load(&layers)->with_layers(entries, rejected));
+
+    for (const std::pair<std::string, std::shared_ptr<Layer> >& e : rejected) {
+        BOOST_LOG_TRIVIAL(error) << "Layer " << e.first << " already exists, ignored";
+    }
+
+    return entries.size() - rejected.size();
+}
+bool ServicesConfiguration::add_layer(Layer* l) {
+    std::vector<Layer*> added(1, l);
+    return add_layers(added) == 1;
+}
+bool ServicesConfiguration::replace_layer(Layer* l) {
+    std::shared_ptr<Layer> layer(l);
+
+    std::lock_guard<std::mutex> lock(layers_mtx);
+    std::shared_ptr<const LayerRegistry> next = std::atomic_load(&layers)->with_replaced_layer(l->get_id(), layer);
+    if (! next) {
+        return false;
+    }
+    publish_layers(next);
+    return true;
+}
+bool ServicesConfiguration::delete_layer(std::string id) {
+    std::lock_guard<std::mutex> lock(layers_mtx);
+    std::shared_ptr<const LayerRegistry> next = std::atomic_load(&layers)->without_layer(id);
+    if (! next) {
+        return false;
+    }
+    publish_layers(next);
+    return true;
 }
 int ServicesConfiguration::get_layers_count() {
-    return layers.size();
+    return std::atomic_load(&layers)->get_layers_count();
 }
 Layer* ServicesConfiguration::get_layer(std::string id) {
-    std::map<std::string, Layer*>::iterator itLay = layers.find ( id );
-    if ( itLay == layers.end() ) {
+    Layer* layer = get_pinned_layers()->get_layer(id);
+    if ( layer == NULL ) {
         return NULL;
     }
-    return itLay->second;
-}
-void ServicesConfiguration::delete_layer(std::string id) {
-    std::map<std::string, Layer*>::iterator itLay = layers.find ( id );
-    if ( itLay != layers.end() ) {
-        delete itLay->second;
-        layers.erase(itLay);
+    // Chargement différé : la couche est chargée à son premier accès
+    if ( ! layer->load() ) {
+        return NULL;
     }
-}
\ No newline at end of file
+    return layer;
+}
@@ -47,6 +47,8 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <mutex>
 
 #include <rok4/utils/CRS.h>
 #include <rok4/utils/Configuration.h>
@@ -55,6 +57,9 @@
 #include "core/Rok4Server.h"
 #include "configurations/Metadata.h"
 #include "configurations/Contact.h"
+#include "configurations/CachePolicy.h"
+#include "configurations/LayerRegistry.h"
+#include "core/LayerLoader.h"
 #include "services/health/Service.h"
 #include "services/tms/Service.h"
 #include "services/wmts/Service.h"
@@ -94,9 +99,138 @@ class ServicesConfiguration : public Configuration
         AdminService* get_admin_service() {return admin_service;};
         OgcApiService* get_ogcapi_service() {return ogcapi_service;};
 
-        std::map<std::string, Layer*>& get_layers() ;
-        void add_layer(Layer* l) ;
-        void delete_layer(std::string id) ;
+        /**
+         * \~french
+         * \brief Retourne le service actif dont la racine préfixe le chemin
+         * \details La racine doit s'arrêter à la fin d'un segment du chemin, la racine vide préfixant tous les chemins. Si plusieurs racines conviennent, le premier service dans l'ordre de priorité l'emporte
+         * \param[in] path Chemin de la requête
+         * \return Service, NULL si aucun ne correspond
+         * \~english
+         * \brief Return the enabled service whose root prefixes the path
+         * \details Root path have to end at a path segment's end, empty root prefixing all paths. If several roots match, the first service in priority order wins
+         * \param[in] path Request path
+         * \return Service, NULL if none matches
+         */
+        Service* get_service(const std::string& path);
+
+        /**
+         * \~french
+         * \brief Fige, pour le thread courant, la version des couches vue
+         * \details Les couches obtenues restent valides jusqu'à #unpin_layers, même si elles sont modifiées ou supprimées entre temps. Un thread qui n'a pas figé les couches le fait à son premier accès.
+         * \~english
+         * \brief Freeze, for the current thread, the seen layers version
+         * \details Obtained layers stay valid until #unpin_layers, even if they are modified or removed meanwhile. A thread which did not freeze layers does it at its first access.
+         */
+        void pin_layers() ;
+
+        /**
+         * \~french
+         * \brief Libère la version des couches figée par le thread courant
+         * \~english
+         * \brief Release the layers version frozen by the current thread
+         */
+        void unpin_layers() ;
+
+        /**
+         * \~french
+         * \brief Retourne les couches de la version figée par le thread courant
+         * \~english
+         * \brief Return layers of the version frozen by the current thread
+         */
+        const std::map<std::string, Layer*>& get_layers() ;
+
+        /**
+         * \~french
+         * \brief Les couches figées par le thread courant sont-elles la dernière version publiée ?
+         * \details Un résultat calculé à partir des couches figées n'est mis en cache que si c'est le cas, après lecture de la génération du cache : une version publiée ensuite est suivie d'une invalidation
+         * \~english
+         * \brief Are layers frozen by the current thread the last published version ?
+         * \details A result computed from frozen layers is cached only if so, after reading cache's generation : a version published later is followed by an invalidation
+         */
+        bool are_pinned_layers_current() ;
+
+        /**
+         * \~french \brief Numéro de la version des couches figée par le thread courant
+         * \~english \brief Number of the layers version frozen by the current thread
+         */
+        unsigned long get_pinned_layers_version() ;
+
+        /**
+         * \~french
+         * \brief Retourne l'index spatial des couches de la version figée par le thread courant
+         * \details Chaque version publiée, notamment par les modifications de l'administration, a son propre index
+         * \~english
+         * \brief Return the layers spatial index of the version frozen by the current thread
+         * \details Each published version, especially by administration modifications, has its own index
+         */
+        std::shared_ptr<const LayerIndex> get_spatial_index() ;
+
+        /**
+         * \~french
+         * \brief Charge les couches listées, avec plusieurs threads
+         * \param[in] descriptors Chemins des descripteurs de couche
+         * \param[in] threads Nombre de threads de chargement
+         * \param[in] lazy Chargement différé des pyramides, poursuivi en arrière-plan
+         * \~english
+         * \brief Load listed layers, with several threads
+         * \param[in] descriptors Layer descriptors paths
+         * \param[in] threads Loading threads count
+         * \param[in] lazy Deferred pyramids loading, going on in background
+         */
+        void load_layers(std::vector<std::string>& descriptors, int threads, bool lazy) ;
+
+        /**
+         * \~french
+         * \brief Toutes les couches listées ont été chargées
+         * \details Tant que ce n'est pas le cas, les couches non chargées sont absentes des capacités
+         * \~english
+         * \brief All listed layers have been loaded
+         * \details Until then, unloaded layers are missing from capabilities
+         */
+        bool are_layers_loaded() ;
+        LayerLoader* get_layer_loader() { return layer_loader; };
+
+        /**
+         * \~french
+         * \brief Publie une nouvelle version des couches, avec les couches ajoutées
+         * \details Les couches dont l'identifiant est déjà présent ne sont pas ajoutées et sont supprimées
+         * \return Nombre de couches ajoutées
+         * \~english
+         * \brief Publish a new layers version, with added layers
+         * \details Layers whose identifier is already present are not added and are deleted
+         * \return Added layers count
+         */
+        int add_layers(std::vector<Layer*>& added) ;
+
+        /**
+         * \~french
+         * \brief Publie une nouvelle version des couches, avec la couche ajoutée
+         * \return Faux si l'identifiant est déjà présent, la couche est alors supprimée
+         * \~english
+         * \brief Publish a new layers version, with the added layer
+         * \return False if identifier is already present, layer is then deleted
+         */
+        bool add_layer(Layer* l) ;
+
+        /**
+         * \~french
+         * \brief Publie une nouvelle version des couches, où la couche remplace celle de même identifiant
+         * \return Faux si l'identifiant est absent, la couche est alors supprimée
+         * \~english
+         * \brief Publish a new layers version, where the layer replaces the one with the same identifier
+         * \return False if identifier is missing, layer is then deleted
+         */
+        bool replace_layer(Layer* l) ;
+
+        /**
+         * \~french
+         * \brief Publie une nouvelle version des couches, sans la couche
+         * \return Faux si l'identifiant est absent
+         * \~english
+         * \brief Publish a new layers version, without the layer
+         * \return False if identifier is missing
+         */
+        bool delete_layer(std::string id) ;
         int get_layers_count() ;
         Layer* get_layer(std::string id) ;
         
@@ -112,6 +246,17 @@ class ServicesConfiguration : public Configuration
         };
         bool are_crs_equals( std::string crs1, std::string crs2 );
 
+        /**
+         * \~french
+         * \brief Écart toléré en pixels pour la reprojection par grille de contrôle
+         * \return 0 pour la reprojection exacte
+         * \~english
+         * \brief Tolerated gap in pixels for control grid reprojection
+         * \return 0 for exact reprojection
+         */
+        double get_map_reprojection_tolerance() { return map_reprojection_tolerance; }
+        double get_tile_reprojection_tolerance() { return tile_reprojection_tolerance; }
+
         /**
          * \~french
          * \brief Teste la validité du info format
@@ -172,14 +317,37 @@ class ServicesConfiguration : public Configuration
          * \brief Remove cached responses
          */
         void clean_cache();
+
+        /**
+         * \~french
+         * \brief Invalide les réponses cachées concernant une couche
+         * \details Les capacités en cache restent servies pendant leur reconstruction en arrière-plan, seul le fragment de la couche est recalculé
+         * \~english
+         * \brief Invalidate cached responses about a layer
+         * \details Cached capabilities are still served while rebuilt in background, only the layer's fragment is computed again
+         */
+        void invalidate_layer(std::string id);
+
+        /**
+         * \~french
+         * \brief Politique de cache des réponses sans politique propre (capacités, métadonnées)
+         * \~english
+         * \brief Cache policy of responses without their own policy (capabilities, metadata)
+         */
+        const CachePolicy& get_default_cache_policy() { return default_cache_policy; };
         
     protected:
 
         /**
-         * \~french \brief Liste des couches disponibles
-         * \~english \brief Available layers list
+         * \~french \brief Version courante des couches, remplacée en bloc à chaque modification
+         * \~english \brief Current layers version, wholesale replaced by each modification
+         */
+        std::shared_ptr<const LayerRegistry> layers;
+        /**
+         * \~french \brief Exclusion mutuelle des modifications des couches, les lectures n'en ont pas besoin
+         * \~english \brief Layers modifications mutual exclusion, reads do not need it
          */
-        std::map<std::string, Layer*> layers;
+        std::mutex layers_mtx;
 
         /**
          * \~french \brief Activation générale des services
@@ -202,6 +370,7 @@ class ServicesConfiguration : public Configuration
 
         // Map
         bool map_reprojection;
+        double map_reprojection_tolerance;
         std::vector<std::string> map_formats;
 
         int map_max_layers_count;
@@ -214,6 +383,12 @@ class ServicesConfiguration : public Configuration
 
         // Tile
         bool tile_reprojection;
+        double tile_reprojection_tolerance;
+
+        // Cache HTTP
+        CachePolicy default_cache_policy;
+        CachePolicy map_cache_policy;
+        CachePolicy tile_cache_policy;
 
     private:
 
@@ -234,6 +409,39 @@ class ServicesConfiguration : public Configuration
         AdminService* admin_service;
         OgcApiService* ogcapi_service;
 
+        /**
+         * \~french \brief Services actifs et leur rang de priorité, indexés par leur racine
+         * \~english \brief Enabled services and their priority rank, indexed by their root path
+         */
+        std::map<std::string, std::pair<int, Service*> > services_by_root_path;
+
+        /**
+         * \~french \brief Taille de la plus longue racine
+         * \~english \brief Longest root path size
+         */
+        size_t max_root_path_size;
+
+        /**
+         * \~french \brief Chargeur des couches listées, NULL si aucune liste
+         * \~english \brief Listed layers loader, NULL if no list
+         */
+        LayerLoader* layer_loader;
+
+        /**
+         * \~french \brief Version des couches figée par le thread courant, et configuration à laquelle elle appartient
+         * \~english \brief Layers version frozen by the current thread, and configuration it belongs to
+         */
+        static thread_local std::shared_ptr<const LayerRegistry> pinned_layers;
+        static thread_local ServicesConfiguration* pinned_owner;
+
+        std::shared_ptr<const LayerRegistry> get_pinned_layers();
+
+        /**
+         * \~french \brief Publie une nouvelle version des couches (verrou des modifications tenu)
+         * \~english \brief Publish a new layers version (modifications lock held)
+         */
+        void publish_layers(std::shared_ptr<const LayerRegistry> next);
+
         std::map<std::string, std::vector<CRS*> > crs_equivalences;
 };
 
@@ -0,0 +1,258 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file configurations/TileOccupancy.cpp
+ * \~french
+ * \brief Implémentation de la classe TileOccupancy
+ * \~english
+ * \brief Implement the TileOccupancy class
+ */
+
+#include <algorithm>
+
+#include <boost/log/trivial.hpp>
+#include <rok4/utils/StoragePool.h>
+
+#include "configurations/TileOccupancy.h"
+
+/**
+ * \~french \brief Valeur d'un chiffre en base 36, -1 si invalide
+ * \~english \brief Base 36 digit value, -1 if invalid
+ */
+static int b36_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * \~french \brief Lecture d'un entier décimal positif
+ * \~english \brief Read a positive decimal integer
+ */
+static bool read_decimal(const std::string& s, uint32_t& value) {
+    if (s.empty() || s.size() > 9) return false;
+    value = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+bool TileOccupancy::decode_slab(const std::string& name, std::string& level, uint32_t& column, uint32_t& row) {
+
+    std::string base = name.substr(name.rfind('/') + 1);
+
+    if (base.compare(0, 5, "DATA_") == 0) {
+        // Stockage objet : DATA_<niveau>_<colonne>_<ligne>
+        size_t row_pos = base.rfind('_');
+        size_t column_pos = base.rfind('_', row_pos - 1);
+        if (column_pos == std::string::npos || column_pos < 5) return false;
+        level = base.substr(5, column_pos - 5);
+        return ! level.empty() && read_decimal(base.substr(column_pos + 1, row_pos - column_pos - 1), column) && read_decimal(base.substr(row_pos + 1), row);
+    }
+
+    // Stockage fichier : DATA/<niveau>/<chemin>.<extension>, les chiffres en base 36 de la colonne et de la ligne alternent dans le chemin
+    size_t data_pos = name.find("/DATA/");
+    if (data_pos == std::string::npos) return false;
+    size_t level_pos = data_pos + 6;
+    size_t path_pos = name.find('/', level_pos);
+    if (path_pos == std::string::npos) return false;
+    level = name.substr(level_pos, path_pos - level_pos);
+
+    size_t end = name.rfind('.');
+    if (end == std::string::npos || end < path_pos) end = name.size();
+
+    column = 0;
+    row = 0;
+    int digits = 0;
+    for (size_t i = path_pos + 1; i < end; i++) {
+        if (name[i] == '/') continue;
+        int d = b36_digit(name[i]);
+        if (d < 0) return false;
+        if (digits % 2 == 0) column = column * 36 + d;
+        else row = row * 36 + d;
+        digits++;
+    }
+
+    return ! level.empty() && digits > 0 && digits % 2 == 0 && digits <= 12;
+}
+
+bool TileOccupancy::add_list(std::string path, const std::set<std::string>& levels_ids, std::string& error) {
+
+    ContextType::eContextType storage_type;
+    std::string tray_name, fo_name;
+    ContextType::split_path(path, storage_type, fo_name, tray_name);
+
+    Context* context = StoragePool::get_context(storage_type, tray_name);
+    if (context == NULL) {
+        error = "Cannot add " + ContextType::to_string(storage_type) + " storage context to read list " + path;
+        return false;
+    }
+
+    int size = -1;
+    uint8_t* data = context->read_full(size, fo_name);
+    if (size < 0) {
+        error = "Cannot read list " + path;
+        if (data != NULL) delete[] data;
+        return false;
+    }
+
+    std::string content((char*) data, size);
+    delete[] data;
+
+    // Les niveaux diffusés sont présents même sans dalle : toutes leurs tuiles sont alors absentes
+    for (const std::string& l : levels_ids) {
+        pending[l];
+    }
+
+    // L'en-tête, qui donne les racines des chemins, se termine par une ligne '#'
+    bool header = true;
+    std::string level;
+    uint32_t column, row;
+    size_t start = 0;
+    while (start < content.size()) {
+        size_t end = content.find('\n', start);
+        if (end == std::string::npos) end = content.size();
+        std::string line = content.substr(start, end - start);
+        start = end + 1;
+
+        if (! line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        if (header) {
+            if (line == "#") header = false;
+            continue;
+        }
+
+        if (! decode_slab(line, level, column, row)) {
+            if (line.find("DATA") != std::string::npos) {
+                error = "Invalid slab name '" + line + "' in list " + path;
+                return false;
+            }
+            // Dalle de masque
+            continue;
+        }
+
+        std::map<std::string, std::vector<uint64_t> >::iterator it = pending.find(level);
+        if (it != pending.end() && levels_ids.count(level) != 0) {
+            it->second.push_back(((uint64_t) row << 32) | column);
+        }
+    }
+
+    if (header) {
+        error = "No header end in list " + path;
+        return false;
+    }
+
+    return true;
+}
+
+void TileOccupancy::build(Pyramid* pyramid) {
+
+    for (auto& p : pending) {
+        Level* level = pyramid->get_level(p.first);
+        if (level == NULL) continue;
+
+        std::vector<uint64_t>& slabs = p.second;
+        std::sort(slabs.begin(), slabs.end());
+        slabs.erase(std::unique(slabs.begin(), slabs.end()), slabs.end());
+        slabs_count += slabs.size();
+
+        LevelOccupancy lo;
+        lo.slab_width = level->get_slab_width();
+        lo.slab_height = level->get_slab_height();
+        lo.min_column = 0;
+        lo.min_row = 0;
+        lo.columns = 0;
+        lo.rows = 0;
+
+        if (! slabs.empty()) {
+            uint32_t max_column = 0, max_row = 0;
+            lo.min_column = UINT32_MAX;
+            lo.min_row = (uint32_t) (slabs.front() >> 32);
+            max_row = (uint32_t) (slabs.back() >> 32);
+            for (uint64_t s : slabs) {
+                uint32_t c = (uint32_t) s;
+                lo.min_column = std::min(lo.min_column, c);
+                max_column = std::max(max_column, c);
+            }
+            lo.columns = max_column - lo.min_column + 1;
+            lo.rows = max_row - lo.min_row + 1;
+        }
+
+        // La table de bits n'est retenue que si elle n'est pas plus volumineuse que la liste des indices
+        uint64_t words = ((uint64_t) lo.columns * lo.rows + 63) / 64;
+        if (! slabs.empty() && words <= slabs.size()) {
+            lo.bitmap.assign(words, 0);
+            for (uint64_t s : slabs) {
+                uint64_t bit = (uint64_t) ((uint32_t) (s >> 32) - lo.min_row) * lo.columns + ((uint32_t) s - lo.min_column);
+                lo.bitmap[bit / 64] |= ((uint64_t) 1 << (bit % 64));
+            }
+        } else {
+            lo.slabs.swap(slabs);
+            lo.slabs.shrink_to_fit();
+        }
+
+        levels[p.first] = std::move(lo);
+    }
+
+    pending.clear();
+
+    BOOST_LOG_TRIVIAL(debug) << "Occupation de " << levels.size() << " niveau(x) par " << slabs_count << " dalle(s)";
+}
+
+bool TileOccupancy::contain_tile(const std::string& level, int column, int row) const {
+
+    std::unordered_map<std::string, LevelOccupancy>::const_iterator it = levels.find(level);
+    if (it == levels.end()) return true;
+    if (column < 0 || row < 0) return false;
+
+    const LevelOccupancy& lo = it->second;
+    uint32_t c = column / lo.slab_width;
+    uint32_t r = row / lo.slab_height;
+
+    if (! lo.bitmap.empty()) {
+        if (c < lo.min_column || r < lo.min_row || c - lo.min_column >= lo.columns || r - lo.min_row >= lo.rows) return false;
+        uint64_t bit = (uint64_t) (r - lo.min_row) * lo.columns + (c - lo.min_column);
+        return (lo.bitmap[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    return std::binary_search(lo.slabs.begin(), lo.slabs.end(), ((uint64_t) r << 32) | c);
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file configurations/TileOccupancy.h
+ * \~french
+ * \brief Définition de la classe TileOccupancy, occupation des niveaux d'une pyramide par les dalles
+ * \~english
+ * \brief Define the TileOccupancy class, pyramid levels occupancy by slabs
+ */
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <rok4/utils/Pyramid.h>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * Une TileOccupancy donne, par niveau, les dalles présentes dans le stockage. Elle est construite à partir du fichier liste des pyramides (à côté du descripteur, avec l'extension .list), qui donne le nom de chaque dalle, au chargement de la couche.
+ *
+ * Une tuile dont la dalle est absente n'existe pas : la réponse 404 est donnée sans lire d'index ni solliciter le stockage. Par niveau, les dalles présentes sont conservées dans une table de bits couvrant leur étendue lorsqu'elle est assez remplie, et sinon sous forme de liste triée de leurs indices.
+ *
+ * Les dalles ajoutées aux pyramides après le chargement de la couche ne sont pas vues avant son rechargement.
+ * \brief Occupation des niveaux d'une pyramide par les dalles
+ * \~english
+ * A TileOccupancy gives, by level, slabs present in the storage. It is built from pyramids' list file (next to the descriptor, with .list extension), which gives each slab's name, when the layer is loaded.
+ *
+ * A tile whose slab is missing does not exist : the 404 response is given without reading index nor querying the storage. By level, present slabs are kept in a bitmap covering their extent when it is filled enough, and else as a sorted list of their indices.
+ *
+ * Slabs added to pyramids after layer loading are not seen before its reloading.
+ * \brief Pyramid levels occupancy by slabs
+ */
+class TileOccupancy {
+    friend class CppUnitTileOccupancy;
+
+private:
+
+    /**
+     * \~french \brief Occupation d'un niveau
+     * \~english \brief Level occupancy
+     */
+    struct LevelOccupancy {
+        /**
+         * \~french \brief Nombre de tuiles dans la largeur et la hauteur d'une dalle
+         * \~english \brief Tiles count in a slab's width and height
+         */
+        int slab_width;
+        int slab_height;
+
+        /**
+         * \~french \brief Étendue des dalles présentes, pour la table de bits
+         * \~english \brief Present slabs extent, for the bitmap
+         */
+        uint32_t min_column;
+        uint32_t min_row;
+        uint32_t columns;
+        uint32_t rows;
+
+        /**
+         * \~french \brief Table de bits des dalles de l'étendue, vide si les indices sont listés
+         * \~english \brief Extent's slabs bitmap, empty if indices are listed
+         */
+        std::vector<uint64_t> bitmap;
+
+        /**
+         * \~french \brief Indices triés des dalles présentes (ligne sur les 32 bits de poids fort), si pas de table de bits
+         * \~english \brief Present slabs sorted indices (row on the 32 most significant bits), if no bitmap
+         */
+        std::vector<uint64_t> slabs;
+    };
+
+    /**
+     * \~french \brief Occupation par identifiant de niveau
+     * \~english \brief Occupancy by level identifier
+     */
+    std::unordered_map<std::string, LevelOccupancy> levels;
+
+    /**
+     * \~french \brief Indices des dalles lues, par niveau, en attente de construction
+     * \~english \brief Read slabs indices, by level, waiting for build
+     */
+    std::map<std::string, std::vector<uint64_t> > pending;
+
+    /**
+     * \~french \brief Nombre de dalles présentes
+     * \~english \brief Present slabs count
+     */
+    size_t slabs_count;
+
+    /**
+     * \~french
+     * \brief Extrait le niveau et les indices d'une dalle de données à partir de son nom
+     * \details Les noms en stockage fichier (DATA/<niveau>/<chemin en base 36>) et objet (DATA_<niveau>_<colonne>_<ligne>) sont reconnus
+     * \return false si le nom n'est pas celui d'une dalle de données
+     * \~english
+     * \brief Extract data slab's level and indices from its name
+     * \details File (DATA/<level>/<base 36 path>) and object (DATA_<level>_<column>_<row>) storage names are recognized
+     * \return false if name is not a data slab's one
+     */
+    static bool decode_slab(const std::string& name, std::string& level, uint32_t& column, uint32_t& row);
+
+public:
+
+    /**
+     * \~french \brief Crée une occupation vide
+     * \~english \brief Create an empty occupancy
+     */
+    TileOccupancy() : slabs_count(0) { };
+
+    /**
+     * \~french
+     * \brief Lit le fichier liste d'une pyramide
+     * \param[in] path Chemin du fichier liste
+     * \param[in] levels_ids Niveaux de la pyramide diffusés, les dalles des autres niveaux sont ignorées
+     * \param[out] error Message d'erreur
+     * \return false si le fichier n'a pas pu être lu ou n'est pas valide
+     * \~english
+     * \brief Read a pyramid's list file
+     * \param[in] path List file path
+     * \param[in] levels_ids Broadcast pyramid levels, slabs of other levels are ignored
+     * \param[out] error Error message
+     * \return false if file could not be read or is not valid
+     */
+    bool add_list(std::string path, const std::set<std::string>& levels_ids, std::string& error);
+
+    /**
+     * \~french
+     * \brief Construit l'occupation des niveaux à partir des dalles lues
+     * \param[in] pyramid Pyramide diffusée, pour la taille des dalles
+     * \~english
+     * \brief Build levels occupancy from read slabs
+     * \param[in] pyramid Broadcast pyramid, for slabs size
+     */
+    void build(Pyramid* pyramid);
+
+    /**
+     * \~french
+     * \brief La dalle de la tuile est-elle présente ?
+     * \details Vrai pour un niveau inconnu
+     * \~english
+     * \brief Is tile's slab present ?
+     * \details True for an unknown level
+     */
+    bool contain_tile(const std::string& level, int column, int row) const;
+
+    /**
+     * \~french \brief Nombre de dalles présentes
+     * \~english \brief Present slabs count
+     */
+    size_t get_slabs_count() const { return slabs_count; }
+};
@@ -0,0 +1,279 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/AccessLog.cpp
+ ** \~french
+ * \brief Implémentation de la classe AccessLog
+ ** \~english
+ * \brief Implements classe AccessLog
+ */
+
+#include <chrono>
+#include <string.h>
+#include <time.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "core/AccessLog.h"
+#include "core/Request.h"
+
+std::mutex AccessLog::rings_mtx;
+std::vector<AccessLog::Ring*> AccessLog::rings;
+thread_local AccessLog::Ring* AccessLog::ring = NULL;
+
+size_t AccessLog::ring_size = 0;
+int AccessLog::flush_interval = 0;
+FILE* AccessLog::output = NULL;
+bool AccessLog::close_output = false;
+
+std::thread AccessLog::writer_thread;
+std::mutex AccessLog::writer_mtx;
+std::condition_variable AccessLog::writer_cv;
+bool AccessLog::stopping = false;
+
+std::atomic<uint64_t> AccessLog::written(0);
+
+bool AccessLog::configure(std::string output_type, std::string file, int buffer_size, int interval) {
+    if (output_type == "file") {
+        output = fopen(file.c_str(), "a");
+        if (output == NULL) {
+            BOOST_LOG_TRIVIAL(error) << "Impossible d'ouvrir le journal d'accès " << file;
+            return false;
+        }
+        close_output = true;
+    } else if (output_type == "standard_output") {
+        output = stdout;
+        close_output = false;
+    } else {
+        return true;
+    }
+
+    ring_size = buffer_size;
+    flush_interval = interval;
+    stopping = false;
+    writer_thread = std::thread(AccessLog::loop);
+    return true;
+}
+
+void AccessLog::stop() {
+    if (output == NULL) return;
+
+    {
+        std::lock_guard<std::mutex> lock(writer_mtx);
+        stopping = true;
+    }
+    writer_cv.notify_one();
+    writer_thread.join();
+
+    if (close_output) {
+        fclose(output);
+    }
+    output = NULL;
+
+    // Les threads de traitement sont arrêtés, leurs tampons ne servent plus
+    std::lock_guard<std::mutex> lock(rings_mtx);
+    for (Ring* r : rings) {
+        delete r;
+    }
+    rings.clear();
+}
+
+void AccessLog::copy(char* dest, size_t size, const char* src, size_t length) {
+    if (length > size - 1) length = size - 1;
+    memcpy(dest, src, length);
+    dest[length] = '\0';
+}
+
+void AccessLog::log(Request* req, int64_t duration_ns) {
+    if (output == NULL) return;
+
+    Ring* r = ring;
+    if (r == NULL) {
+        // Premier enregistrement du thread : son tampon est alloué une fois pour toutes
+        r = new Ring();
+        r->records.resize(ring_size);
+        r->head.store(0);
+        r->tail.store(0);
+        r->dropped.store(0);
+        {
+            std::lock_guard<std::mutex> lock(rings_mtx);
+            rings.push_back(r);
+        }
+        ring = r;
+    }
+
+    uint64_t h = r->head.load(std::memory_order_relaxed);
+    if (h - r->tail.load(std::memory_order_acquire) >= r->records.size()) {
+        r->dropped.store(r->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& rec = r->records[h % r->records.size()];
+    rec.time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    rec.duration_ns = duration_ns;
+    rec.bytes = req->response_bytes;
+    rec.status = req->response_status;
+    rec.cache = req->cache_outcome;
+    copy(rec.method, METHOD_SIZE, req->method.data(), req->method.size());
+    copy(rec.layer, LAYER_SIZE, req->layer.data(), req->layer.size());
+
+    // Chemin suivi de la chaîne de requête brute, sans reconstruction
+    copy(rec.path, PATH_SIZE, req->path.data(), req->path.size());
+    const char* query = (req->fcgx_request != NULL) ? FCGX_GetParam("QUERY_STRING", req->fcgx_request->envp) : NULL;
+    if (query != NULL && query[0] != '\0') {
+        size_t used = strlen(rec.path);
+        if (used + 1 < PATH_SIZE - 1) {
+            rec.path[used] = '?';
+            copy(rec.path + used + 1, PATH_SIZE - used - 1, query, strlen(query));
+        }
+    }
+
+    r->head.store(h + 1, std::memory_order_release);
+}
+
+const char* AccessLog::cache_outcome_name(eCacheOutcome c) {
+    switch (c) {
+        case CACHE_HIT: return "hit";
+        case CACHE_MISS: return "miss";
+        case CACHE_SHARED: return "shared";
+        default: return "none";
+    }
+}
+
+/**
+ * \~french \brief Ajoute une chaîne JSON échappée
+ * \~english \brief Append an escaped JSON string
+ */
+static void append_json_string(std::string& buffer, const char* value) {
+    buffer.push_back('"');
+    for (const char* c = value; *c != '\0'; c++) {
+        if (*c == '"') buffer += "\\\"";
+        else if (*c == '\\') buffer += "\\\\";
+        else if ((unsigned char) *c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char) *c);
+            buffer += escaped;
+        }
+        else buffer.push_back(*c);
+    }
+    buffer.push_back('"');
+}
+
+void AccessLog::drain(std::string& buffer) {
+    std::vector<Ring*> current;
+    {
+        std::lock_guard<std::mutex> lock(rings_mtx);
+        current = rings;
+    }
+
+    uint64_t count = 0;
+    char line[128];
+    for (Ring* r : current) {
+        uint64_t t = r->tail.load(std::memory_order_relaxed);
+        uint64_t h = r->head.load(std::memory_order_acquire);
+        for (; t < h; t++) {
+            const Record& rec = r->records[t % r->records.size()];
+
+            time_t seconds = rec.time_us / 1000000;
+            struct tm utc;
+            gmtime_r(&seconds, &utc);
+            char date[32];
+            strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &utc);
+            snprintf(line, sizeof(line), "{\"time\":\"%s.%03dZ\",\"method\":", date, (int) ((rec.time_us / 1000) % 1000));
+            buffer += line;
+            append_json_string(buffer, rec.method);
+            buffer += ",\"path\":";
+            append_json_string(buffer, rec.path);
+            snprintf(line, sizeof(line), ",\"status\":%d,\"bytes\":%llu,\"duration_ms\":%.3f,\"layer\":", rec.status, (unsigned long long) rec.bytes, rec.duration_ns / 1e6);
+            buffer += line;
+            if (rec.layer[0] == '\0') {
+                buffer += "null";
+            } else {
+                append_json_string(buffer, rec.layer);
+            }
+            buffer += ",\"cache\":\"";
+            buffer += cache_outcome_name(rec.cache);
+            buffer += "\"}\n";
+            count++;
+        }
+        // Les emplacements lus sont rendus au producteur
+        r->tail.store(t, std::memory_order_release);
+    }
+
+    if (! buffer.empty()) {
+        fwrite(buffer.data(), 1, buffer.size(), output);
+        fflush(output);
+        buffer.clear();
+        written.fetch_add(count);
+    }
+}
+
+void AccessLog::loop() {
+    std::string buffer;
+    buffer.reserve(1 << 16);
+
+    std::unique_lock<std::mutex> lock(writer_mtx);
+    while (! stopping) {
+        writer_cv.wait_for(lock, std::chrono::milliseconds(flush_interval));
+        lock.unlock();
+        drain(buffer);
+        lock.lock();
+    }
+    lock.unlock();
+
+    // Derniers enregistrements, les threads de traitement sont arrêtés
+    drain(buffer);
+}
+
+uint64_t AccessLog::get_dropped() {
+    std::lock_guard<std::mutex> lock(rings_mtx);
+    uint64_t dropped = 0;
+    for (Ring* r : rings) {
+        dropped += r->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+json11::Json AccessLog::to_json() {
+    return json11::Json::object {
+        { "enabled", is_enabled() },
+        { "written", (double) written.load() },
+        { "dropped", (double) get_dropped() }
+    };
+}
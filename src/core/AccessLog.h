@@ -0,0 +1,208 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/AccessLog.h
+ ** \~french
+ * \brief Définition de la classe AccessLog
+ ** \~english
+ * \brief Define classe AccessLog
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rok4/thirdparty/json11.hpp>
+
+class Request;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Journal d'accès asynchrone, un enregistrement par requête
+ * \details Chaque thread de traitement dépose ses enregistrements, de taille fixe, dans son propre tampon circulaire (un seul producteur, un seul consommateur), sans verrou ni allocation. Un thread dédié vide périodiquement les tampons, formate les enregistrements (une ligne JSON chacun) et les écrit. Un tampon plein ne bloque jamais le thread de traitement : l'enregistrement est perdu et compté.
+ * \~english
+ * \brief Asynchronous access log, one record per request
+ * \details Each worker thread puts its fixed size records into its own ring buffer (single producer, single consumer), without lock nor allocation. A dedicated thread periodically empties buffers, formats records (one JSON line each) and writes them. A full buffer never blocks the worker thread : record is lost and counted.
+ */
+class AccessLog {
+
+public:
+
+    /**
+     * \~french \brief Issue de la recherche de la réponse dans le cache des tuiles
+     * \~english \brief Outcome of the response search in the tiles cache
+     */
+    enum eCacheOutcome {
+        CACHE_NONE,
+        CACHE_HIT,
+        CACHE_MISS,
+        CACHE_SHARED
+    };
+
+private:
+
+    static const size_t METHOD_SIZE = 8;
+    static const size_t PATH_SIZE = 256;
+    static const size_t LAYER_SIZE = 64;
+
+    /**
+     * \~french \brief Enregistrement de taille fixe, les chaînes trop longues sont tronquées
+     * \~english \brief Fixed size record, too long strings are truncated
+     */
+    struct Record {
+        int64_t time_us;
+        int64_t duration_ns;
+        uint64_t bytes;
+        int status;
+        eCacheOutcome cache;
+        char method[METHOD_SIZE];
+        char path[PATH_SIZE];
+        char layer[LAYER_SIZE];
+    };
+
+    /**
+     * \~french \brief Tampon circulaire d'un thread, les indices sont sur des lignes de cache distinctes
+     * \~english \brief Thread's ring buffer, indices are on distinct cache lines
+     */
+    struct Ring {
+        std::vector<Record> records;
+        char padding_head[64];
+        /**
+         * \~french \brief Prochain enregistrement écrit, modifié par le producteur seulement
+         * \~english \brief Next written record, modified by the producer only
+         */
+        std::atomic<uint64_t> head;
+        char padding_tail[64];
+        /**
+         * \~french \brief Prochain enregistrement lu, modifié par le consommateur seulement
+         * \~english \brief Next read record, modified by the consumer only
+         */
+        std::atomic<uint64_t> tail;
+        char padding_dropped[64];
+        std::atomic<uint64_t> dropped;
+    };
+
+    static std::mutex rings_mtx;
+    static std::vector<Ring*> rings;
+    static thread_local Ring* ring;
+
+    static size_t ring_size;
+    static int flush_interval;
+    static FILE* output;
+    static bool close_output;
+
+    static std::thread writer_thread;
+    static std::mutex writer_mtx;
+    static std::condition_variable writer_cv;
+    static bool stopping;
+
+    static std::atomic<uint64_t> written;
+
+    static const char* cache_outcome_name(eCacheOutcome c);
+
+    static void copy(char* dest, size_t size, const char* src, size_t length);
+
+    /**
+     * \~french \brief Vide les tampons dans la sortie (thread d'écriture)
+     * \~english \brief Empty buffers into the output (writer thread)
+     */
+    static void drain(std::string& buffer);
+
+    static void loop();
+
+public:
+
+    /**
+     * \~french
+     * \brief Ouvre la sortie et démarre le thread d'écriture
+     * \param[in] output_type Sortie : "file" ou "standard_output", le journal est désactivé sinon
+     * \param[in] file Chemin du fichier, pour la sortie "file"
+     * \param[in] buffer_size Nombre d'enregistrements du tampon de chaque thread
+     * \param[in] interval Intervalle entre deux vidages des tampons, en millisecondes
+     * \return Faux si le fichier ne peut être ouvert
+     * \~english
+     * \brief Open output and start the writer thread
+     * \param[in] output_type Output : "file" or "standard_output", log is disabled otherwise
+     * \param[in] file File path, for "file" output
+     * \param[in] buffer_size Records count of each thread's buffer
+     * \param[in] interval Delay between two buffers emptying, in milliseconds
+     * \return False if file cannot be opened
+     */
+    static bool configure(std::string output_type, std::string file, int buffer_size, int interval);
+
+    /**
+     * \~french
+     * \brief Arrête le thread d'écriture, une fois les tampons vidés, et ferme la sortie
+     * \~english
+     * \brief Stop the writer thread, once buffers are emptied, and close output
+     */
+    static void stop();
+
+    static bool is_enabled() { return output != NULL; }
+
+    /**
+     * \~french
+     * \brief Enregistre une requête traitée, sans bloquer
+     * \details À appeler par le thread de traitement, avant la libération de la requête FastCGI
+     * \param[in] req Requête, dont la réponse a été envoyée
+     * \param[in] duration_ns Durée de traitement, en nanosecondes
+     * \~english
+     * \brief Record a processed request, without blocking
+     * \details To call by the worker thread, before the FastCGI request release
+     * \param[in] req Request, whose response has been sent
+     * \param[in] duration_ns Processing duration, in nanoseconds
+     */
+    static void log(Request* req, int64_t duration_ns);
+
+    /**
+     * \~french \brief Nombre d'enregistrements perdus, faute de place dans les tampons
+     * \~english \brief Lost records count, for lack of space in buffers
+     */
+    static uint64_t get_dropped();
+
+    static json11::Json to_json();
+};
@@ -0,0 +1,271 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/ApproxTransformer.cpp
+ ** \~french
+ * \brief Implémentation de la classe ApproxTransformer
+ ** \~english
+ * \brief Implements classe ApproxTransformer
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+
+#include <boost/log/trivial.hpp>
+
+#include "core/ApproxTransformer.h"
+
+namespace {
+
+    /**
+     * \~french \brief Contexte et transformations PROJ d'un thread, libérés à sa fin
+     * \~english \brief Thread's PROJ context and transformations, released at its end
+     */
+    struct ProjHolder {
+        PJ_CONTEXT* context;
+        std::map<std::string, PJ*> transformations;
+
+        ProjHolder() : context(NULL) {}
+
+        ~ProjHolder() {
+            for (std::map<std::string, PJ*>::iterator it = transformations.begin(); it != transformations.end(); ++it) {
+                if (it->second != NULL) proj_destroy(it->second);
+            }
+            if (context != NULL) proj_context_destroy(context);
+        }
+    };
+
+    thread_local ProjHolder proj_holder;
+
+    inline double bilinear(const double* v, double u, double w) {
+        return (1 - w) * ((1 - u) * v[0] + u * v[1]) + w * ((1 - u) * v[2] + u * v[3]);
+    }
+}
+
+PJ* ApproxTransformer::get_transformation(CRS* from, CRS* to) {
+    std::string key = from->get_proj_code() + "\n" + to->get_proj_code();
+
+    std::map<std::string, PJ*>::iterator it = proj_holder.transformations.find(key);
+    if (it != proj_holder.transformations.end()) {
+        return it->second;
+    }
+
+    if (proj_holder.context == NULL) {
+        proj_holder.context = proj_context_create();
+    }
+
+    PJ* normalized = NULL;
+    PJ* raw = proj_create_crs_to_crs(proj_holder.context, from->get_proj_code().c_str(), to->get_proj_code().c_str(), NULL);
+    if (raw != NULL) {
+        // Ordre des axes est/nord, comme les emprises manipulées par le serveur
+        normalized = proj_normalize_for_visualization(proj_holder.context, raw);
+        proj_destroy(raw);
+    }
+
+    if (normalized == NULL) {
+        BOOST_LOG_TRIVIAL(warning) << "Impossible de créer la transformation PROJ de " << from->get_proj_code() << " vers " << to->get_proj_code();
+    }
+
+    // On mémorise aussi les échecs, pour ne pas réessayer à chaque requête
+    proj_holder.transformations[key] = normalized;
+    return normalized;
+}
+
+ApproxTransformer::ApproxTransformer(CRS* from, CRS* to, BoundingBox<double> bbox, int width, int height) :
+    bbox(bbox), width(width), height(height)
+{
+    resx = (bbox.xmax - bbox.xmin) / width;
+    resy = (bbox.ymax - bbox.ymin) / height;
+    transformation = get_transformation(from, to);
+    ok = (transformation != NULL && width > 0 && height > 0);
+}
+
+bool ApproxTransformer::transform_point(double i, double j, double& x, double& y) {
+    x = bbox.xmin + (i + 0.5) * resx;
+    y = bbox.ymax - (j + 0.5) * resy;
+
+    proj_trans_generic(transformation, PJ_FWD, &x, sizeof(double), 1, &y, sizeof(double), 1, NULL, 0, 0, NULL, 0, 0);
+
+    return (std::isfinite(x) && std::isfinite(y) && x != HUGE_VAL && y != HUGE_VAL);
+}
+
+bool ApproxTransformer::get_node(int i, int j, double& x, double& y) {
+    uint64_t key = ((uint64_t) j << 32) | (uint32_t) i;
+
+    std::unordered_map<uint64_t, std::pair<double, double> >::iterator it = nodes.find(key);
+    if (it != nodes.end()) {
+        x = it->second.first;
+        y = it->second.second;
+        return true;
+    }
+
+    if (! transform_point(i, j, x, y)) {
+        return false;
+    }
+
+    nodes[key] = std::make_pair(x, y);
+    return true;
+}
+
+bool ApproxTransformer::subdivide(int i0, int j0, int i1, int j1, double tolerance) {
+    Cell cell;
+    cell.i0 = i0; cell.j0 = j0; cell.i1 = i1; cell.j1 = j1;
+
+    if (! get_node(i0, j0, cell.x[0], cell.y[0])) return false;
+    if (! get_node(i1, j0, cell.x[1], cell.y[1])) return false;
+    if (! get_node(i0, j1, cell.x[2], cell.y[2])) return false;
+    if (! get_node(i1, j1, cell.x[3], cell.y[3])) return false;
+
+    bool split_i = (i1 - i0 > 1);
+    bool split_j = (j1 - j0 > 1);
+
+    if (split_i || split_j) {
+        int mi = (i0 + i1) / 2;
+        int mj = (j0 + j1) / 2;
+
+        // Centre et milieux des côtés
+        int tests[5][2] = { {mi, mj}, {mi, j0}, {mi, j1}, {i0, mj}, {i1, mj} };
+
+        double max_error = 0;
+        for (int t = 0; t < 5; t++) {
+            double ex, ey;
+            if (! get_node(tests[t][0], tests[t][1], ex, ey)) return false;
+
+            double u = (i1 == i0) ? 0 : (double) (tests[t][0] - i0) / (i1 - i0);
+            double w = (j1 == j0) ? 0 : (double) (tests[t][1] - j0) / (j1 - j0);
+            max_error = std::max(max_error, std::max(std::fabs(ex - bilinear(cell.x, u, w)), std::fabs(ey - bilinear(cell.y, u, w))));
+        }
+
+        if (max_error > tolerance) {
+            if (split_i && split_j) {
+                return subdivide(i0, j0, mi, mj, tolerance) && subdivide(mi, j0, i1, mj, tolerance)
+                    && subdivide(i0, mj, mi, j1, tolerance) && subdivide(mi, mj, i1, j1, tolerance);
+            } else if (split_i) {
+                return subdivide(i0, j0, mi, j1, tolerance) && subdivide(mi, j0, i1, j1, tolerance);
+            } else {
+                return subdivide(i0, j0, i1, mj, tolerance) && subdivide(i0, mj, i1, j1, tolerance);
+            }
+        }
+    }
+
+    bands.at(j0 / INITIAL_CELL_SIZE).push_back(cell);
+    return true;
+}
+
+bool ApproxTransformer::build(double tolerance) {
+    if (! ok) return false;
+
+    nodes.clear();
+    bands.clear();
+    bands.resize((height - 1) / INITIAL_CELL_SIZE + 1);
+
+    for (int j0 = 0; j0 == 0 || j0 < height - 1; j0 += INITIAL_CELL_SIZE) {
+        int j1 = std::min(j0 + INITIAL_CELL_SIZE, height - 1);
+        for (int i0 = 0; i0 == 0 || i0 < width - 1; i0 += INITIAL_CELL_SIZE) {
+            int i1 = std::min(i0 + INITIAL_CELL_SIZE, width - 1);
+            if (! subdivide(i0, j0, i1, j1, tolerance)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void ApproxTransformer::transform_line(int line, double* x, double* y) const {
+    size_t b = std::min((size_t) (line / INITIAL_CELL_SIZE), bands.size() - 1);
+
+    for (size_t c = 0; c < bands.at(b).size(); c++) {
+        const Cell& cell = bands.at(b).at(c);
+        if (line < cell.j0 || line > cell.j1) continue;
+
+        double w = (cell.j1 == cell.j0) ? 0 : (double) (line - cell.j0) / (cell.j1 - cell.j0);
+        // Interpolation verticale le long des côtés gauche et droit, puis horizontale
+        double lx = cell.x[0] + w * (cell.x[2] - cell.x[0]);
+        double rx = cell.x[1] + w * (cell.x[3] - cell.x[1]);
+        double ly = cell.y[0] + w * (cell.y[2] - cell.y[0]);
+        double ry = cell.y[1] + w * (cell.y[3] - cell.y[1]);
+
+        for (int i = cell.i0; i <= cell.i1; i++) {
+            double u = (cell.i1 == cell.i0) ? 0 : (double) (i - cell.i0) / (cell.i1 - cell.i0);
+            x[i] = lx + u * (rx - lx);
+            y[i] = ly + u * (ry - ly);
+        }
+    }
+}
+
+BoundingBox<double> ApproxTransformer::get_envelope() const {
+    BoundingBox<double> envelope(0, 0, 0, 0);
+    bool first = true;
+
+    for (std::unordered_map<uint64_t, std::pair<double, double> >::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        if (first) {
+            envelope.xmin = envelope.xmax = it->second.first;
+            envelope.ymin = envelope.ymax = it->second.second;
+            first = false;
+        } else {
+            envelope.xmin = std::min(envelope.xmin, it->second.first);
+            envelope.xmax = std::max(envelope.xmax, it->second.first);
+            envelope.ymin = std::min(envelope.ymin, it->second.second);
+            envelope.ymax = std::max(envelope.ymax, it->second.second);
+        }
+    }
+
+    return envelope;
+}
+
+void ApproxTransformer::get_lines_bounds(std::vector<double>& min_y, std::vector<double>& max_y) const {
+    min_y.assign(height, HUGE_VAL);
+    max_y.assign(height, -HUGE_VAL);
+
+    for (size_t b = 0; b < bands.size(); b++) {
+        for (size_t c = 0; c < bands.at(b).size(); c++) {
+            const Cell& cell = bands.at(b).at(c);
+            // L'interpolation étant bilinéaire, les extrema d'une ligne de la cellule sont encadrés par ceux des coins
+            double lo = std::min(std::min(cell.y[0], cell.y[1]), std::min(cell.y[2], cell.y[3]));
+            double hi = std::max(std::max(cell.y[0], cell.y[1]), std::max(cell.y[2], cell.y[3]));
+            for (int j = cell.j0; j <= cell.j1; j++) {
+                min_y[j] = std::min(min_y[j], lo);
+                max_y[j] = std::max(max_y[j], hi);
+            }
+        }
+    }
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/ApproxTransformer.h
+ ** \~french
+ * \brief Définition de la classe ApproxTransformer
+ ** \~english
+ * \brief Define classe ApproxTransformer
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include <proj.h>
+#include <rok4/utils/BoundingBox.h>
+#include <rok4/utils/CRS.h>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Conversion approchée des centres des pixels d'une image dans un autre CRS
+ * \details Seuls les noeuds d'une grille de contrôle sont convertis exactement par PROJ, les autres pixels étant interpolés de manière bilinéaire entre les coins de leur cellule. Une cellule est subdivisée tant que l'écart entre les positions exacte et interpolée de son centre ou du milieu d'un de ses côtés dépasse la tolérance.
+ *
+ * Les transformations PROJ sont créées une fois par thread et par couple de CRS.
+ * \~english
+ * \brief Approximate conversion of image pixels' centers into another CRS
+ * \details Only control grid nodes are exactly converted by PROJ, other pixels being bilinearly interpolated between their cell's corners. A cell is split as long as the gap between exact and interpolated positions of its center or of a side's middle exceeds the tolerance.
+ *
+ * PROJ transformations are created once per thread and per CRS couple.
+ */
+class ApproxTransformer {
+
+private:
+
+    /**
+     * \~french \brief Taille maximale des cellules initiales, en pixels
+     * \~english \brief Initial cells max size, in pixels
+     */
+    static const int INITIAL_CELL_SIZE = 64;
+
+    /**
+     * \~french \brief Cellule de la grille, bornes incluses, avec les coordonnées converties de ses coins
+     * \~english \brief Grid cell, bounds included, with its corners' converted coordinates
+     */
+    struct Cell {
+        int i0, j0, i1, j1;
+        // Coins haut gauche, haut droit, bas gauche, bas droit
+        double x[4];
+        double y[4];
+    };
+
+    /**
+     * \~french \brief Transformation PROJ, propre au thread
+     * \~english \brief PROJ transformation, thread's own
+     */
+    PJ* transformation;
+
+    /**
+     * \~french \brief Emprise de l'image dans le CRS de départ
+     * \~english \brief Image bbox in source CRS
+     */
+    BoundingBox<double> bbox;
+    int width;
+    int height;
+    double resx;
+    double resy;
+
+    /**
+     * \~french \brief Noeuds déjà convertis, indexés par ligne et colonne
+     * \~english \brief Already converted nodes, indexed by row and column
+     */
+    std::unordered_map<uint64_t, std::pair<double, double> > nodes;
+
+    /**
+     * \~french \brief Cellules finales, par bande de lignes des cellules initiales
+     * \~english \brief Final cells, by initial cells' rows band
+     */
+    std::vector<std::vector<Cell> > bands;
+
+    bool ok;
+
+    /**
+     * \~french \brief Convertit exactement un noeud, avec mémorisation
+     * \~english \brief Exactly convert a node, with memoization
+     */
+    bool get_node(int i, int j, double& x, double& y);
+
+    /**
+     * \~french \brief Subdivise une cellule jusqu'à respecter la tolérance
+     * \~english \brief Split a cell until tolerance is respected
+     */
+    bool subdivide(int i0, int j0, int i1, int j1, double tolerance);
+
+    /**
+     * \~french \brief Transformation PROJ entre deux CRS pour le thread courant
+     * \~english \brief PROJ transformation between two CRS for the current thread
+     */
+    static PJ* get_transformation(CRS* from, CRS* to);
+
+public:
+
+    /**
+     * \~french
+     * \brief Crée un convertisseur pour les pixels d'une image
+     * \param[in] from CRS de l'image
+     * \param[in] to CRS cible
+     * \param[in] bbox Emprise de l'image
+     * \param[in] width Largeur de l'image, en pixels
+     * \param[in] height Hauteur de l'image, en pixels
+     * \~english
+     * \brief Create a converter for an image's pixels
+     * \param[in] from Image CRS
+     * \param[in] to Target CRS
+     * \param[in] bbox Image bbox
+     * \param[in] width Image width, in pixels
+     * \param[in] height Image height, in pixels
+     */
+    ApproxTransformer(CRS* from, CRS* to, BoundingBox<double> bbox, int width, int height);
+
+    /**
+     * \~french \brief La transformation PROJ a-t-elle pu être créée ?
+     * \~english \brief Could PROJ transformation be created ?
+     */
+    bool is_ok() { return ok; }
+
+    /**
+     * \~french
+     * \brief Convertit exactement une position dans l'image, en pixels (centre du pixel en coordonnées entières)
+     * \~english
+     * \brief Exactly convert a position in image, in pixels (pixel's center with integer coordinates)
+     */
+    bool transform_point(double i, double j, double& x, double& y);
+
+    /**
+     * \~french
+     * \brief Construit la grille de contrôle
+     * \param[in] tolerance Écart maximal toléré, dans les unités du CRS cible
+     * \return false si un noeud n'a pas pu être converti
+     * \~english
+     * \brief Build control grid
+     * \param[in] tolerance Max tolerated gap, in target CRS units
+     * \return false if a node could not be converted
+     */
+    bool build(double tolerance);
+
+    /**
+     * \~french \brief Coordonnées converties des centres des pixels d'une ligne
+     * \~english \brief Converted coordinates of a line's pixels' centers
+     */
+    void transform_line(int line, double* x, double* y) const;
+
+    /**
+     * \~french \brief Emprise des coordonnées converties
+     * \~english \brief Converted coordinates bbox
+     */
+    BoundingBox<double> get_envelope() const;
+
+    /**
+     * \~french \brief Ordonnées converties minimale et maximale de chaque ligne
+     * \~english \brief Min and max converted ordinates of each line
+     */
+    void get_lines_bounds(std::vector<double>& min_y, std::vector<double>& max_y) const;
+};
@@ -0,0 +1,99 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/Books.cpp
+ ** \~french
+ * \brief Implémentation de la classe Books
+ ** \~english
+ * \brief Implements classe Books
+ */
+
+#include "core/Books.h"
+
+boost::shared_mutex Books::mtx;
+
+void Books::set_tms_directory(std::string directory) {
+    ExclusiveLock lock(mtx);
+    TmsBook::set_directory(directory);
+}
+
+void Books::set_styles_directory(std::string directory) {
+    ExclusiveLock lock(mtx);
+    StyleBook::set_directory(directory);
+}
+
+TileMatrixSet* Books::get_tms(std::string id) {
+    SharedLock lock(mtx);
+    return TmsBook::get_tms(id);
+}
+
+Style* Books::get_style(std::string id) {
+    SharedLock lock(mtx);
+    return StyleBook::get_style(id);
+}
+
+std::vector<TileMatrixSet*> Books::get_tmss() {
+    ExclusiveLock lock(mtx);
+    std::vector<TileMatrixSet*> tmss;
+    for (auto const& t : TmsBook::get_book()) {
+        tmss.push_back(t.second);
+    }
+    return tmss;
+}
+
+std::vector<std::string> Books::get_styles_ids() {
+    ExclusiveLock lock(mtx);
+    std::vector<std::string> styles;
+    for (auto const& s : StyleBook::get_book()) {
+        styles.push_back(s.first);
+    }
+    return styles;
+}
+
+void Books::send_to_trash() {
+    ExclusiveLock lock(mtx);
+    TmsBook::send_to_trash();
+    StyleBook::send_to_trash();
+}
+
+void Books::empty_trash() {
+    ExclusiveLock lock(mtx);
+    TmsBook::empty_trash();
+    StyleBook::empty_trash();
+}
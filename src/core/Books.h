@@ -0,0 +1,147 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/Books.h
+ ** \~french
+ * \brief Définition de la classe Books
+ ** \~english
+ * \brief Define classe Books
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <rok4/style/Style.h>
+#include <rok4/utils/TileMatrixSet.h>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Accès synchronisés aux annuaires globaux des TMS et des styles
+ * \details Lors d'un rechargement à chaud, les annuaires sont vidés puis remplis pendant que les requêtes continuent d'être traitées. Tous les accès du serveur passent donc par un verrou en lecture / écriture : la mise à la poubelle et sa vidange sont exclusives, les recherches et les chargements (dont celui d'une pyramide, qui recherche son TMS) sont partagés. Les parcours des annuaires sont exclusifs, un autre lecteur pouvant y ajouter un élément.
+ * \~english
+ * \brief Synchronized accesses to global TMS and styles books
+ * \details During a hot reload, books are emptied then filled while requests are still processed. All server accesses go through a read / write lock : sending to trash and emptying it are exclusive, lookups and loadings (pyramid's one included, looking up its TMS) are shared. Books browsing is exclusive, another reader being able to add an element.
+ */
+class Books {
+
+private:
+
+    static boost::shared_mutex mtx;
+
+public:
+
+    typedef boost::shared_lock<boost::shared_mutex> SharedLock;
+    typedef boost::unique_lock<boost::shared_mutex> ExclusiveLock;
+
+    /**
+     * \~french \brief Verrou à prendre en lecture pour tout autre accès aux annuaires, comme le chargement d'une pyramide
+     * \~english \brief Lock to take as reader for any other books access, as pyramid loading
+     */
+    static boost::shared_mutex& get_mutex() { return mtx; }
+
+    /**
+     * \~french \brief Dossier des TMS, pouvant être modifié lors d'un rechargement
+     * \~english \brief TMS directory, can be modified during a reload
+     */
+    static void set_tms_directory(std::string directory);
+
+    /**
+     * \~french \brief Dossier des styles, pouvant être modifié lors d'un rechargement
+     * \~english \brief Styles directory, can be modified during a reload
+     */
+    static void set_styles_directory(std::string directory);
+
+    /**
+     * \~french \brief Recherche ou chargement d'un TMS
+     * \return NULL si inconnu
+     * \~english \brief TMS lookup or loading
+     * \return NULL if unknown
+     */
+    static TileMatrixSet* get_tms(std::string id);
+
+    /**
+     * \~french \brief Recherche ou chargement d'un style
+     * \return NULL si inconnu
+     * \~english \brief Style lookup or loading
+     * \return NULL if unknown
+     */
+    static Style* get_style(std::string id);
+
+    /**
+     * \~french
+     * \brief TMS chargés
+     * \details Ils restent valides tant que la configuration des services de la requête est conservée
+     * \~english
+     * \brief Loaded TMS
+     * \details They stay valid as long as request's services configuration is kept
+     */
+    static std::vector<TileMatrixSet*> get_tmss();
+
+    /**
+     * \~french \brief Identifiants des styles chargés
+     * \~english \brief Loaded styles identifiers
+     */
+    static std::vector<std::string> get_styles_ids();
+
+    /**
+     * \~french
+     * \brief Met à la poubelle tous les TMS et styles
+     * \details Les prochains accès chargeront de nouvelles instances
+     * \~english
+     * \brief Send all TMS and styles to trash
+     * \details Next accesses will load new instances
+     */
+    static void send_to_trash();
+
+    /**
+     * \~french
+     * \brief Supprime les TMS et styles à la poubelle
+     * \details Aucune configuration les utilisant ne doit plus être en service
+     * \~english
+     * \brief Delete TMS and styles in trash
+     * \details No configuration using them have to be still in use
+     */
+    static void empty_trash();
+};
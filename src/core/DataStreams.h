@@ -38,9 +38,9 @@
 /**
  * \file core/DataStreams.h
  * \~french
- * \brief Définition des classes EmptyResponseDataStream et MessageDataStream
+ * \brief Définition des classes ContiguousDataStream, DataSourceDataStream, EmptyResponseDataStream, NotModifiedDataStream et MessageDataStream
  * \~english
- * \brief Define classes EmptyResponseDataStream and MessageDataStream
+ * \brief Define classes ContiguousDataStream, DataSourceDataStream, EmptyResponseDataStream, NotModifiedDataStream and MessageDataStream
  */
 
 #pragma once
@@ -48,8 +48,117 @@
 #include <string.h>
 #include <vector>
 
+#include <rok4/datasource/DataSource.h>
 #include <rok4/datastream/DataStream.h>
 
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Flux dont le contenu est déjà entièrement en mémoire, de manière contiguë
+ * \details Le contenu peut être envoyé directement, sans passer par un tampon intermédiaire
+ * \~english
+ * \brief Stream whose content is already entirely in memory, contiguously
+ * \details Content can be sent directly, without intermediate buffer
+ */
+class ContiguousDataStream : public DataStream {
+
+public:
+    /**
+     * \~french
+     * \brief Accès direct au contenu
+     * \param[out] size Taille du contenu
+     * \return Contenu, valide tant que le flux existe
+     * \~english
+     * \brief Direct access to the content
+     * \param[out] size Content size
+     * \return Content, valid as long as the stream exists
+     */
+    virtual const uint8_t* get_data ( size_t& size ) = 0;
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * Une instance de DataSourceDataStream expose sous forme de flux le contenu d'une source de données, lu en une fois à la construction.
+ * Contrairement à DataStreamFromDataSource, le contenu est accessible directement et envoyé sans copie dans un tampon intermédiaire.
+ * \brief Flux contigu d'une source de données
+ * \~english
+ * A DataSourceDataStream exposes as a stream a data source content, read once at construction.
+ * Unlike DataStreamFromDataSource, content is directly reachable and sent without copy in an intermediate buffer.
+ * \brief Contiguous stream from a data source
+ */
+class DataSourceDataStream : public ContiguousDataStream {
+private:
+    /**
+     * \~french Source de données, supprimée avec le flux
+     * \~english Data source, deleted with the stream
+     */
+    DataSource* source;
+
+    /**
+     * \~french Contenu de la source, NULL si la lecture a échoué
+     * \~english Source content, NULL if reading failed
+     */
+    const uint8_t* data;
+
+    /**
+     * \~french Taille du contenu
+     * \~english Content size
+     */
+    size_t data_size;
+
+    /**
+     * \~french Position courante dans le flux
+     * \~english Current stream position
+     */
+    size_t pos;
+
+public:
+    DataSourceDataStream ( DataSource* d ) : source ( d ), data_size ( 0 ), pos ( 0 ) {
+        data = source->get_data ( data_size );
+        if ( data == NULL ) data_size = 0;
+    }
+
+    ~DataSourceDataStream() {
+        source->release_data();
+        delete source;
+    }
+
+    /**
+     * \~french \brief Précise si le contenu de la source a pu être lu
+     * \~english \brief Tell if source content could be read
+     */
+    bool is_ok() {
+        return data != NULL;
+    }
+
+    size_t read ( uint8_t *buffer, size_t size ) {
+        if ( size > data_size - pos ) size = data_size - pos;
+        memcpy ( buffer, data + pos, size );
+        pos += size;
+        return size;
+    }
+    bool eof() {
+        return ( pos == data_size );
+    }
+    std::string get_type() {
+        return source->get_type();
+    }
+    std::string get_encoding() {
+        return source->get_encoding();
+    }
+    int get_http_status() {
+        return source->get_http_status();
+    }
+    unsigned int get_length(){
+        return data_size;
+    }
+    const uint8_t* get_data ( size_t& size ) {
+        size = data_size;
+        return data;
+    }
+};
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -86,6 +195,40 @@ public:
     }
 };
 
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * Une instance de NotModifiedDataStream définit une réponse sans contenu à une requête conditionnelle, la ressource n'ayant pas été modifiée.
+ * \brief Réponse 304
+ * \~english
+ * A NotModifiedDataStream defines a response without content to a conditional request, resource being not modified.
+ * \brief 304 response
+ */
+class NotModifiedDataStream : public DataStream {
+
+public:
+    NotModifiedDataStream() {}
+
+    size_t read ( uint8_t *buffer, size_t size ) {
+        return 0;
+    }
+    bool eof() {
+        return true;
+    }
+    std::string get_type() {
+        return "";
+    }
+    std::string get_encoding() {
+        return "";
+    }
+    int get_http_status() {
+        return 304;
+    }
+    unsigned int get_length(){
+        return 0;
+    }
+};
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -97,7 +240,7 @@ public:
  * \brief Streamed messages handler
  * \~ \see MessageDataSource
  */
-class MessageDataStream : public DataStream {
+class MessageDataStream : public ContiguousDataStream {
 private:
     /**
      * \~french Type MIME du message
@@ -148,6 +291,10 @@ public:
     unsigned int get_length(){
         return message.length();
     }
+    const uint8_t* get_data ( size_t& size ) {
+        size = message.length();
+        return ( const uint8_t* ) message.data();
+    }
 };
 
 
@@ -0,0 +1,110 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+/**
+ * \file core/EncodedDocument.cpp
+ ** \~french
+ * \brief Implémentation de la classe EncodedDocument
+ ** \~english
+ * \brief Implements classe EncodedDocument
+ */
+
+#include <zlib.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "core/EncodedDocument.h"
+#include "config.h"
+
+EncodedDocument::EncodedDocument ( std::string c, std::string t, bool complete ) : content ( c ), type ( t ), complete ( complete ) {
+    if ( complete ) {
+        gzip_content = gzip ( content, DOCUMENT_GZIP_LEVEL );
+        if ( gzip_content.size() >= content.size() ) {
+            gzip_content.clear();
+        }
+    }
+}
+
+std::string EncodedDocument::gzip ( const std::string& in, int level ) {
+    z_stream zstream;
+    zstream.zalloc = Z_NULL;
+    zstream.zfree = Z_NULL;
+    zstream.opaque = Z_NULL;
+
+    // 16 + 15 : fenêtre maximale avec en-tête gzip
+    if ( deflateInit2 ( &zstream, level, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+        BOOST_LOG_TRIVIAL(error) << "Impossible d'initialiser la compression gzip d'un document";
+        return "";
+    }
+
+    std::string out;
+    out.resize ( deflateBound ( &zstream, in.size() ) );
+
+    zstream.next_in = ( Bytef* ) in.data();
+    zstream.avail_in = in.size();
+    zstream.next_out = ( Bytef* ) &out[0];
+    zstream.avail_out = out.size();
+
+    int status = deflate ( &zstream, Z_FINISH );
+    size_t written = out.size() - zstream.avail_out;
+    deflateEnd ( &zstream );
+
+    if ( status != Z_STREAM_END ) {
+        BOOST_LOG_TRIVIAL(error) << "Echec de la compression gzip d'un document";
+        return "";
+    }
+
+    out.resize ( written );
+    return out;
+}
+
+DataStream* EncodedDocument::get_stream ( std::shared_ptr<const EncodedDocument> doc, Request* req ) {
+    if ( ! doc->is_complete() ) {
+        // Des couches sont en cours de chargement, le document ne doit pas être conservé par un cache intermédiaire
+        req->add_response_header ( "Cache-Control", "no-store" );
+    }
+
+    bool gzip = false;
+    if ( doc->has_gzip() ) {
+        // La réponse dépend de l'en-tête de la requête, les caches intermédiaires doivent en tenir compte
+        req->add_response_header ( "Vary", "Accept-Encoding" );
+        gzip = req->accepts_encoding ( "gzip" );
+    }
+    return new EncodedDocumentDataStream ( doc, gzip );
+}
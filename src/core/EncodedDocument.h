@@ -0,0 +1,170 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+/**
+ * \file core/EncodedDocument.h
+ ** \~french
+ * \brief Définition des classes EncodedDocument et EncodedDocumentDataStream
+ ** \~english
+ * \brief Define classes EncodedDocument and EncodedDocumentDataStream
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string.h>
+
+#include "core/DataStreams.h"
+#include "core/Request.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Document mis en cache, avec sa variante compressée
+ * \details La variante gzip est calculée une seule fois, à la construction. Elle n'est pas conservée si elle n'est pas plus petite que le document.
+ * \~english
+ * \brief Cached document, with its compressed variant
+ * \details Gzip variant is computed only once, at construction. It is not kept if not smaller than the document.
+ */
+class EncodedDocument {
+
+private:
+
+    std::string content;
+    std::string gzip_content;
+    std::string type;
+
+    /**
+     * \~french \brief Le document est complet (toutes les couches sont chargées)
+     * \~english \brief Document is complete (all layers are loaded)
+     */
+    bool complete;
+
+public:
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] c Contenu du document
+     * \param[in] t Type MIME
+     * \param[in] complete Le document est complet : sa variante gzip est calculée et il peut être mis en cache. Sinon, il n'est servi qu'une fois et ne doit pas être conservé par les caches HTTP
+     * \~english
+     * \brief Constructor
+     * \param[in] c Document content
+     * \param[in] t MIME type
+     * \param[in] complete Document is complete : its gzip variant is computed and it can be cached. Otherwise, it is served only once and must not be stored by HTTP caches
+     */
+    EncodedDocument ( std::string c, std::string t, bool complete );
+
+    const std::string& get_content() const { return content; }
+    const std::string& get_gzip_content() const { return gzip_content; }
+    const std::string& get_type() const { return type; }
+
+    bool has_gzip() const { return ! gzip_content.empty(); }
+    bool is_complete() const { return complete; }
+
+    /**
+     * \~french
+     * \brief Compresse un contenu au format gzip
+     * \return Contenu compressé, vide en cas d'erreur
+     * \~english
+     * \brief Compress a content with gzip format
+     * \return Compressed content, empty if error
+     */
+    static std::string gzip ( const std::string& in, int level );
+
+    /**
+     * \~french
+     * \brief Crée le flux de réponse, avec la variante acceptée par le client
+     * \details L'en-tête Vary est ajouté à la réponse lorsqu'une variante compressée existe. Un document incomplet est servi avec l'en-tête `Cache-Control: no-store`, la politique de cache globale ne s'appliquant alors pas.
+     * \~english
+     * \brief Create the response stream, with the variant accepted by the client
+     * \details Vary header is added to the response when a compressed variant exists. An incomplete document is served with `Cache-Control: no-store` header, global cache policy being then not applied.
+     */
+    static DataStream* get_stream ( std::shared_ptr<const EncodedDocument> doc, Request* req );
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Flux d'une variante d'un document en cache, sans copie
+ * \~english
+ * \brief Stream of a cached document variant, without copy
+ */
+class EncodedDocumentDataStream : public ContiguousDataStream {
+
+private:
+
+    std::shared_ptr<const EncodedDocument> document;
+    const std::string& data;
+    std::string encoding;
+    size_t pos;
+
+public:
+
+    EncodedDocumentDataStream ( std::shared_ptr<const EncodedDocument> d, bool gzip ) :
+        document ( d ), data ( gzip ? d->get_gzip_content() : d->get_content() ), encoding ( gzip ? "gzip" : "" ), pos ( 0 ) {}
+
+    size_t read ( uint8_t *buffer, size_t size ) {
+        if ( size > data.size() - pos ) size = data.size() - pos;
+        memcpy ( buffer, data.data() + pos, size );
+        pos += size;
+        return size;
+    }
+    bool eof() {
+        return ( pos == data.size() );
+    }
+    std::string get_type() {
+        return document->get_type();
+    }
+    std::string get_encoding() {
+        return encoding;
+    }
+    int get_http_status() {
+        return 200;
+    }
+    unsigned int get_length(){
+        return data.size();
+    }
+    const uint8_t* get_data ( size_t& size ) {
+        size = data.size();
+        return ( const uint8_t* ) data.data();
+    }
+};
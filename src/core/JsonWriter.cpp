@@ -0,0 +1,180 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+/**
+ * \file core/JsonWriter.cpp
+ ** \~french
+ * \brief Implémentation de la classe JsonWriter
+ ** \~english
+ * \brief Implements classe JsonWriter
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include "core/JsonWriter.h"
+
+JsonWriter::JsonWriter(size_t capacity) : after_key(false) {
+    buffer.reserve(capacity);
+}
+
+void JsonWriter::separate() {
+    if (after_key) {
+        after_key = false;
+        return;
+    }
+    if (! empty.empty()) {
+        if (! empty.back()) {
+            // Séparateur tel qu'écrit par json11
+            buffer.append(", ");
+        }
+        empty.back() = false;
+    }
+}
+
+void JsonWriter::append_escaped(const std::string& s) {
+    // Mêmes échappements que json11
+    buffer.push_back('"');
+    for (size_t i = 0; i < s.length(); i++) {
+        const char c = s[i];
+        if (c == '\\') {
+            buffer.append("\\\\");
+        } else if (c == '"') {
+            buffer.append("\\\"");
+        } else if (c == '\b') {
+            buffer.append("\\b");
+        } else if (c == '\f') {
+            buffer.append("\\f");
+        } else if (c == '\n') {
+            buffer.append("\\n");
+        } else if (c == '\r') {
+            buffer.append("\\r");
+        } else if (c == '\t') {
+            buffer.append("\\t");
+        } else if (static_cast<uint8_t>(c) <= 0x1f) {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\u%04x", c);
+            buffer.append(buf);
+        } else if (static_cast<uint8_t>(c) == 0xe2 && i + 2 < s.length() && static_cast<uint8_t>(s[i+1]) == 0x80 && static_cast<uint8_t>(s[i+2]) == 0xa8) {
+            buffer.append("\\u2028");
+            i += 2;
+        } else if (static_cast<uint8_t>(c) == 0xe2 && i + 2 < s.length() && static_cast<uint8_t>(s[i+1]) == 0x80 && static_cast<uint8_t>(s[i+2]) == 0xa9) {
+            buffer.append("\\u2029");
+            i += 2;
+        } else {
+            buffer.push_back(c);
+        }
+    }
+    buffer.push_back('"');
+}
+
+void JsonWriter::start_object() {
+    separate();
+    buffer.push_back('{');
+    empty.push_back(true);
+}
+
+void JsonWriter::end_object() {
+    buffer.push_back('}');
+    empty.pop_back();
+}
+
+void JsonWriter::start_array() {
+    separate();
+    buffer.push_back('[');
+    empty.push_back(true);
+}
+
+void JsonWriter::end_array() {
+    buffer.push_back(']');
+    empty.pop_back();
+}
+
+void JsonWriter::key(const std::string& k) {
+    separate();
+    append_escaped(k);
+    buffer.append(": ");
+    after_key = true;
+}
+
+void JsonWriter::value(const std::string& v) {
+    separate();
+    append_escaped(v);
+}
+
+void JsonWriter::value(const char* v) {
+    value(std::string(v));
+}
+
+void JsonWriter::value(int v) {
+    separate();
+    buffer.append(std::to_string(v));
+}
+
+void JsonWriter::value(double v) {
+    separate();
+    if (std::isfinite(v)) {
+        char buf[32];
+        snprintf(buf, sizeof buf, "%.17g", v);
+        buffer.append(buf);
+    } else {
+        buffer.append("null");
+    }
+}
+
+void JsonWriter::value(bool v) {
+    separate();
+    buffer.append(v ? "true" : "false");
+}
+
+void JsonWriter::null() {
+    separate();
+    buffer.append("null");
+}
+
+void JsonWriter::value(const json11::Json& v) {
+    separate();
+    v.dump(buffer);
+}
+
+void JsonWriter::raw(const std::string& content) {
+    separate();
+    buffer.append(content);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+/**
+ * \file core/JsonWriter.h
+ ** \~french
+ * \brief Définition de la classe JsonWriter
+ ** \~english
+ * \brief Define classe JsonWriter
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <rok4/thirdparty/json11.hpp>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Écriture séquentielle d'un document JSON dans un tampon
+ * \details Les valeurs sont écrites au fil de l'eau, sans objet intermédiaire. La sortie est identique à celle de json11::Json::dump, à condition d'écrire les clés d'un objet dans l'ordre alphabétique, comme json11 les trie.
+ * \~english
+ * \brief Sequential JSON document writing into a buffer
+ * \details Values are written on the fly, without intermediate object. Output is identical to the json11::Json::dump one, provided that object's keys are written in alphabetical order, as json11 sorts them.
+ */
+class JsonWriter {
+
+private:
+
+    std::string buffer;
+
+    /**
+     * \~french \brief Pour chaque objet ou tableau ouvert, aucun élément n'a encore été écrit
+     * \~english \brief For each opened object or array, no element has been written yet
+     */
+    std::vector<bool> empty;
+
+    /**
+     * \~french \brief Une clé vient d'être écrite, la valeur suit sans séparateur
+     * \~english \brief A key has just been written, value follows without separator
+     */
+    bool after_key;
+
+    void separate();
+
+    void append_escaped(const std::string& s);
+
+public:
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] capacity Taille réservée pour le tampon
+     * \~english
+     * \brief Constructor
+     * \param[in] capacity Reserved buffer size
+     */
+    JsonWriter(size_t capacity = 4096);
+
+    void start_object();
+    void end_object();
+    void start_array();
+    void end_array();
+
+    /**
+     * \~french \brief Écrit la clé de la prochaine valeur de l'objet ouvert
+     * \~english \brief Write the key of the opened object's next value
+     */
+    void key(const std::string& k);
+
+    void value(const std::string& v);
+    void value(const char* v);
+    void value(int v);
+    void value(double v);
+    void value(bool v);
+    void null();
+
+    /**
+     * \~french
+     * \brief Écrit une valeur json11
+     * \details Pour les valeurs fournies par la librairie
+     * \~english
+     * \brief Write a json11 value
+     * \details For values provided by the library
+     */
+    void value(const json11::Json& v);
+
+    /**
+     * \~french \brief Écrit une valeur déjà sérialisée (fragment en cache)
+     * \~english \brief Write an already serialized value (cached fragment)
+     */
+    void raw(const std::string& content);
+
+    const std::string& get_content() { return buffer; }
+};
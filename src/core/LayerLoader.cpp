@@ -0,0 +1,181 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/LayerLoader.cpp
+ ** \~french
+ * \brief Implémentation de la classe LayerLoader
+ ** \~english
+ * \brief Implements classe LayerLoader
+ */
+
+#include <algorithm>
+#include <set>
+
+#include <boost/log/trivial.hpp>
+
+#include "core/LayerLoader.h"
+#include "configurations/Services.h"
+#include "configurations/Layer.h"
+
+LayerLoader::LayerLoader(ServicesConfiguration* s, int threads, bool lazy_loading) : services(s), threads_count(threads), lazy(lazy_loading),
+    total(0), loaded(0), failed(0), ready(false), stopping(false), duration(0), running_workers(0), pending_next(0) {
+
+    if (threads_count < 1) {
+        threads_count = 1;
+    }
+}
+
+void LayerLoader::load(std::vector<std::string>& descriptors) {
+
+    start = std::chrono::steady_clock::now();
+
+    // Lecture et analyse des descripteurs en parallèle, chaque thread prenant le prochain descripteur non traité
+    std::vector<Layer*> layers(descriptors.size(), NULL);
+    std::atomic<size_t> next(0);
+
+    auto build = [&]() {
+        size_t i;
+        while ((i = next++) < descriptors.size()) {
+            layers.at(i) = new Layer(descriptors.at(i), services, lazy);
+        }
+    };
+
+    int count = std::min(threads_count, (int) descriptors.size());
+    std::vector<std::thread> builders;
+    for (int t = 1; t < count; t++) {
+        builders.push_back(std::thread(build));
+    }
+    build();
+    for (std::thread& t : builders) {
+        t.join();
+    }
+
+    // Ajout dans l'ordre de la liste, pour qu'un identifiant en double désigne toujours la même couche
+    std::vector<Layer*> valid_layers;
+    for (size_t i = 0; i < layers.size(); i++) {
+        Layer* layer = layers.at(i);
+        if ( layer->is_ok() ) {
+            valid_layers.push_back(layer);
+        } else {
+            BOOST_LOG_TRIVIAL(error) << "Cannot load layer " << descriptors.at(i) << ": " << layer->get_error_message();
+            delete layer;
+            failed++;
+        }
+    }
+
+    std::vector<std::string> ids;
+    std::set<std::string> seen;
+    for (Layer* layer : valid_layers) {
+        if (seen.insert(layer->get_id()).second) {
+            ids.push_back(layer->get_id());
+        }
+    }
+
+    // Une seule nouvelle version des couches pour toute la liste
+    int added = services->add_layers(valid_layers);
+    failed += valid_layers.size() - added;
+
+    total = descriptors.size();
+
+    if (! lazy || ids.empty()) {
+        loaded = added;
+        set_ready();
+        return;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << ids.size() << " layer(s) registered, pyramids loading goes on in background";
+
+    // Chargement des pyramides en arrière-plan : les couches déjà demandées par une requête sont simplement comptées
+    pending = ids;
+    running_workers = std::min(threads_count, (int) pending.size());
+    int workers_count = running_workers;
+    for (int t = 0; t < workers_count; t++) {
+        workers.push_back(std::thread(&LayerLoader::complete, this));
+    }
+}
+
+void LayerLoader::complete() {
+    size_t i;
+    while (! stopping && (i = pending_next++) < pending.size()) {
+        if (services->get_layer(pending.at(i)) != NULL) {
+            loaded++;
+        } else {
+            failed++;
+        }
+        // Les couches supprimées entre temps par l'API d'administration ne sont pas conservées par ce thread
+        services->unpin_layers();
+    }
+
+    if (--running_workers == 0 && ! stopping) {
+        // Dernier thread à finir
+        set_ready();
+        // Des réponses ont pu être mises en cache alors que des couches manquaient
+        services->clean_cache();
+    }
+}
+
+void LayerLoader::set_ready() {
+    duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    ready = true;
+    BOOST_LOG_TRIVIAL(info) << loaded << " layer(s) loaded, " << failed << " failure(s), in " << duration << " ms";
+}
+
+json11::Json LayerLoader::to_json() {
+    long elapsed = duration;
+    if (! ready) {
+        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return json11::Json::object {
+        { "ready", (bool) ready },
+        { "lazy", lazy },
+        { "threads", threads_count },
+        { "total", (int) total },
+        { "loaded", (int) loaded },
+        { "failed", (int) failed },
+        { "duration", (double) elapsed / 1000. }
+    };
+}
+
+LayerLoader::~LayerLoader() {
+    stopping = true;
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
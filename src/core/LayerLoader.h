@@ -0,0 +1,172 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/LayerLoader.h
+ ** \~french
+ * \brief Définition de la classe LayerLoader
+ ** \~english
+ * \brief Define classe LayerLoader
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rok4/thirdparty/json11.hpp>
+
+class ServicesConfiguration;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Chargement des couches d'une configuration des services
+ * \details Les descripteurs de couche sont lus et analysés par plusieurs threads, les couches sont ensuite ajoutées dans l'ordre de la liste. En chargement différé, seuls les descripteurs sont lus avant la mise en service : les pyramides sont chargées au premier accès à la couche, ou par les threads du chargeur qui continuent en arrière-plan. La configuration est prête quand toutes les couches ont été chargées.
+ * \~english
+ * \brief Layers loading of a services configuration
+ * \details Layer descriptors are read and parsed by several threads, layers are then added in the list order. With deferred loading, only descriptors are read before going live : pyramids are loaded at the first layer access, or by loader's threads which go on in background. Configuration is ready when all layers have been loaded.
+ */
+class LayerLoader {
+
+private:
+
+    ServicesConfiguration* services;
+
+    /**
+     * \~french \brief Nombre de threads de chargement
+     * \~english \brief Loading threads count
+     */
+    int threads_count;
+
+    /**
+     * \~french \brief Chargement différé des pyramides
+     * \~english \brief Deferred pyramids loading
+     */
+    bool lazy;
+
+    std::atomic<int> total;
+    std::atomic<int> loaded;
+    std::atomic<int> failed;
+    std::atomic<bool> ready;
+    std::atomic<bool> stopping;
+
+    std::chrono::steady_clock::time_point start;
+    std::atomic<long> duration;
+
+    /**
+     * \~french \brief Threads de chargement en arrière-plan
+     * \~english \brief Background loading threads
+     */
+    std::vector<std::thread> workers;
+    std::atomic<int> running_workers;
+
+    /**
+     * \~french \brief Identifiants des couches à charger en arrière-plan, et indice de la prochaine
+     * \~english \brief Identifiers of layers to load in background, and index of the next one
+     */
+    std::vector<std::string> pending;
+    std::atomic<size_t> pending_next;
+
+    /**
+     * \~french
+     * \brief Boucle d'un thread de chargement en arrière-plan
+     * \~english
+     * \brief Background loading thread loop
+     */
+    void complete();
+
+    void set_ready();
+
+public:
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] s Configuration des services à laquelle ajouter les couches
+     * \param[in] threads Nombre de threads de chargement
+     * \param[in] lazy_loading Chargement différé des pyramides
+     * \~english
+     * \brief Constructor
+     * \param[in] s Services configuration to add layers into
+     * \param[in] threads Loading threads count
+     * \param[in] lazy_loading Deferred pyramids loading
+     */
+    LayerLoader(ServicesConfiguration* s, int threads, bool lazy_loading);
+
+    /**
+     * \~french
+     * \brief Charge les couches listées
+     * \details Rend la main une fois toutes les couches enregistrées. En chargement différé, le chargement des pyramides continue en arrière-plan.
+     * \param[in] descriptors Chemins des descripteurs de couche
+     * \~english
+     * \brief Load listed layers
+     * \details Returns once all layers are registered. With deferred loading, pyramids loading goes on in background.
+     * \param[in] descriptors Layer descriptors paths
+     */
+    void load(std::vector<std::string>& descriptors);
+
+    /**
+     * \~french
+     * \brief Toutes les couches ont été chargées (ou ont échoué)
+     * \~english
+     * \brief All layers have been loaded (or failed)
+     */
+    bool is_ready() { return ready; }
+
+    /**
+     * \~french
+     * \brief Export JSON de l'avancement du chargement
+     * \~english
+     * \brief JSON export of loading progress
+     */
+    json11::Json to_json();
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details Interrompt le chargement en arrière-plan, après la couche en cours de chaque thread
+     * \~english
+     * \brief Destructor
+     * \details Stop background loading, after the current layer of each thread
+     */
+    ~LayerLoader();
+};
@@ -49,29 +49,39 @@
 #include <rok4/image/MergeImage.h>
 #include <rok4/image/StyledImage.h>
 
+#include <chrono>
+#include <cmath>
 #include <iomanip>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "configurations/Layer.h"
+#include "core/ParallelImage.h"
+#include "core/PointSampler.h"
+#include "core/RenderPool.h"
+#include "core/SingleFlight.h"
+#include "core/Tile.h"
+#include "core/TimedImage.h"
+#include "core/WarpedImage.h"
 
 namespace Map {
 
 /**
  * \~french
- * \brief Retourne l'image demandée
- * \return Flux de donnée
+ * \brief Construit la chaîne de traitement de l'image, en superposant les couches
+ * \details Le format des canaux, la valeur de nodata et le nombre de canaux finaux sont identifiés à partir des données en entrée, en prenant en compte les styles. La lecture des données, l'application des styles et la fusion des couches sont mesurées dans la trace (phases de rendu, de style et de fusion).
+ * \return Image, NULL en cas d'erreur
  * \~english
- * \brief Give the asked image
- * \return Data stream
+ * \brief Build image processing chain, merging layers
+ * \details Sample format, nodata value and final channels count are identified from input data, with styles. Data reading, styles application and layers merging are timed in the trace (render, style and merge phases).
+ * \return Image, NULL if error
  */
-static DataStream* get_map(
+static Image* build_image(
     ServicesConfiguration* services, bool reprojection, int max_tile_x, int max_tile_y,
-    std::vector<Layer*> layers, int width, int height, CRS* crs, BoundingBox<double> bbox, std::vector<Style*> styles,
-    std::string format, std::map<std::string, std::string> format_options, int dpi, std::string* error
+    std::vector<Layer*>& layers, int width, int height, CRS* crs, BoundingBox<double> bbox, std::vector<Style*>& styles, int dpi,
+    SampleFormat::eSampleFormat* sample_format_out, int* nodata_out, int* bands_out, Trace* trace, std::string* error
 ) {
-    // Traitement de la requête
-
     std::vector<Image*> images;
 
     // Le format des canaux sera identifié à partir des données en entrée, en prenant en compte le style
@@ -103,15 +113,27 @@ static DataStream* get_map(
             nodata = *(style->get_output_nodata_value(layers.at(i)->get_pyramid()->get_nodata_value()));
         }
 
-        Image* image = layers.at(i)->get_pyramid()->getbbox(max_tile_x, max_tile_y, bbox, width, height, crs, crs_equals, layers.at(i)->get_resampling(), dpi);
+        Image* image = NULL;
+
+        // Reprojection par grille de contrôle, la reprojection exacte reste utilisée si elle n'est pas applicable
+        if (! crs_equals && services->get_map_reprojection_tolerance() > 0) {
+            image = WarpedImage::create(
+                layers.at(i)->get_pyramid(), max_tile_x, max_tile_y, bbox, width, height, crs,
+                layers.at(i)->get_resampling(), dpi, services->get_map_reprojection_tolerance()
+            );
+        }
+
+        if (image == NULL) {
+            image = layers.at(i)->get_pyramid()->getbbox(max_tile_x, max_tile_y, bbox, width, height, crs, crs_equals, layers.at(i)->get_resampling(), dpi);
+        }
 
         if (image == NULL) {
             *error = "BBOX too big";
             return NULL;
         }
 
-        StyledImage* s_image = StyledImage::create(image, style);
-        image = s_image;
+        image = new TimedImage(image, trace, Trace::PHASE_RENDER);
+        image = new TimedImage(StyledImage::create(image, style), trace, Trace::PHASE_STYLE);
         images.push_back(image);
 
         // Le nombre final de canaux est celui maxiumum parmis les couches, c'est à dire celui de la donnée en prenant en compte le style
@@ -125,14 +147,30 @@ static DataStream* get_map(
     if (images.size() >= 2) {
         int background_value[bands];
         memset(background_value, 0, bands * sizeof(int));
-        final_image = MergeImage::create(images, bands, background_value, NULL, Merge::ALPHATOP);
+        final_image = new TimedImage(MergeImage::create(images, bands, background_value, NULL, Merge::ALPHATOP), trace, Trace::PHASE_MERGE);
     } else {
         final_image = images.at(0);
     }
 
-    final_image->set_bbox(bbox);
-    final_image->set_crs(crs);
+    *sample_format_out = sample_format;
+    *nodata_out = nodata;
+    *bands_out = bands;
+
+    return final_image;
+}
 
+/**
+ * \~french
+ * \brief Crée l'encodeur de l'image dans le format demandé
+ * \return Flux de donnée, NULL si le format des données et celui demandé ne sont pas compatibles (l'image est alors supprimée)
+ * \~english
+ * \brief Create the image encoder in the asked format
+ * \return Data stream, NULL if data format and asked one are not consistent (image is then deleted)
+ */
+static DataStream* create_encoder(
+    Image* final_image, SampleFormat::eSampleFormat sample_format, int nodata, int bands,
+    std::string format, std::map<std::string, std::string> format_options, std::string* error
+) {
     if (format == "image/png" && sample_format == SampleFormat::UINT8) {
         return new PNGEncoder(final_image, NULL);
     } else if (format == "image/tiff" || format == "image/geotiff") {
@@ -196,6 +234,232 @@ static DataStream* get_map(
     return NULL;
 }
 
+/**
+ * \~french
+ * \brief Calcule l'image demandée
+ * \details Les grandes images sont découpées en bandes de lignes, chacune avec sa propre chaîne de traitement, calculées en parallèle par le RenderPool
+ * \return Flux de donnée
+ * \~english
+ * \brief Compute the asked image
+ * \details Big images are split into rows bands, each one with its own processing chain, computed in parallel by the RenderPool
+ * \return Data stream
+ */
+static DataStream* compute_map(
+    ServicesConfiguration* services, bool reprojection, int max_tile_x, int max_tile_y,
+    std::vector<Layer*> layers, int width, int height, CRS* crs, BoundingBox<double> bbox, std::vector<Style*> styles,
+    std::string format, std::map<std::string, std::string> format_options, int dpi, Trace* trace, std::string* error
+) {
+    // Seule la chaîne de traitement est construite, les pixels sont calculés à l'encodage
+    Trace::Timer timer(trace, Trace::PHASE_BUILD);
+
+    // Traitement de la requête
+
+    SampleFormat::eSampleFormat sample_format;
+    int nodata;
+    int bands;
+
+    // La chaîne complète est toujours construite, pour valider la requête (reprojection, formats, limites de tuiles)
+    Image* final_image = build_image(services, reprojection, max_tile_x, max_tile_y, layers, width, height, crs, bbox, styles, dpi, &sample_format, &nodata, &bands, trace, error);
+    if (final_image == NULL) {
+        return NULL;
+    }
+
+    if (RenderPool::is_enabled_for(height)) {
+        int band_height = RenderPool::get_band_height();
+        double resy = (bbox.ymax - bbox.ymin) / height;
+
+        std::vector<Image*> band_images;
+        std::vector<int> first_lines;
+        for (int first_line = 0; first_line < height; first_line += band_height) {
+            int h = std::min(band_height, height - first_line);
+            BoundingBox<double> band_bbox = bbox;
+            band_bbox.ymax = bbox.ymax - first_line * resy;
+            band_bbox.ymin = (first_line + h == height ? bbox.ymin : band_bbox.ymax - h * resy);
+
+            SampleFormat::eSampleFormat band_sample_format;
+            int band_nodata, band_bands;
+            Image* band_image = build_image(services, reprojection, max_tile_x, max_tile_y, layers, width, h, crs, band_bbox, styles, dpi, &band_sample_format, &band_nodata, &band_bands, trace, error);
+            if (band_image == NULL) {
+                for (Image* i : band_images) delete i;
+                delete final_image;
+                return NULL;
+            }
+            band_images.push_back(band_image);
+            first_lines.push_back(first_line);
+        }
+
+        delete final_image;
+        // L'encodage attend les bandes calculées par le pool, celles calculées par le thread de la requête sont mesurées dans leurs phases
+        final_image = new TimedImage(new ParallelImage(
+            width, height, bands, bbox, band_images, first_lines,
+            sample_format == SampleFormat::FLOAT32, RenderPool::get_threads_per_request()
+        ), trace, Trace::PHASE_WAIT);
+    }
+
+    final_image->set_bbox(bbox);
+    final_image->set_crs(crs);
+
+    DataStream* encoder = create_encoder(final_image, sample_format, nodata, bands, format, format_options, error);
+    if (encoder == NULL) {
+        return NULL;
+    }
+
+    return new TimedDataStream(encoder, trace, Trace::PHASE_ENCODE);
+}
+
+/**
+ * \~french
+ * \brief Nombre maximal de pixels d'une image pour que les demandes simultanées identiques soient regroupées
+ * \details Le regroupement nécessite de garder l'image encodée en mémoire, ce qu'on évite pour les grandes images
+ * \~english
+ * \brief Image max pixels count for identical concurrent requests to be coalesced
+ * \details Coalescing needs to keep the encoded image in memory, which is avoided for big images
+ */
+static const long SINGLE_FLIGHT_MAX_PIXELS = 2048 * 2048;
+
+/**
+ * \~french \brief Écart toléré, en pixel, entre l'emprise demandée et celle d'une tuile de la pyramide
+ * \~english \brief Tolerated gap, in pixel, between asked bbox and a pyramid tile's one
+ */
+static const double ALIGNMENT_TOLERANCE = 1e-3;
+
+/**
+ * \~french
+ * \brief Retourne la tuile stockée correspondant exactement à l'image demandée
+ * \details L'image doit être celle d'une couche unique, avec un style sans effet, dans le CRS et le format de la pyramide, sans option de format. Sa résolution doit être celle d'un niveau, ses dimensions celles d'une tuile et son emprise calée sur les tuiles. La tuile est alors servie telle qu'elle est stockée, sans décodage ni encodage, en partageant le cache des tuiles.
+ *
+ * Une image à la résolution d'un niveau mais non calée sur les tuiles est assemblée par la pyramide par recopie des pixels, sans noyau de rééchantillonnage.
+ * \return Flux de donnée, NULL si l'image ne correspond pas à une tuile existante
+ * \~english
+ * \brief Give the stored tile matching exactly the asked image
+ * \details Image has to be a single layer one, with a style without effect, in the pyramid's CRS and format, without format option. Its resolution has to be a level's one, its dimensions a tile's ones and its bbox aligned on tiles. Tile is then served as stored, without decoding nor encoding, sharing the tiles cache.
+ *
+ * An image at a level resolution but not aligned on tiles is assembled by the pyramid by copying pixels, without resampling kernel.
+ * \return Data stream, NULL if image does not match an existing tile
+ */
+static DataStream* get_native_tile(
+    Request* req, ServicesConfiguration* services, Layer* layer, int width, int height, CRS* crs, BoundingBox<double> bbox, Style* style,
+    std::string& format, std::map<std::string, std::string>& format_options, int dpi
+) {
+    Pyramid* pyramid = layer->get_pyramid();
+
+    if (dpi != 0 || ! format_options.empty() || ! style->is_identity()) return NULL;
+    if (format != Rok4Format::to_mime_type(pyramid->get_format())) return NULL;
+
+    TileMatrixSet* tms = pyramid->get_tms();
+    if (! services->are_crs_equals(crs->get_request_code(), tms->get_crs()->get_request_code())) return NULL;
+
+    for (auto const& l : pyramid->get_levels()) {
+        TileMatrix* tm = l.second->get_tm();
+        if (tm->get_tile_width() != width || tm->get_tile_height() != height) continue;
+
+        // Les écarts sont exprimés en pixels du niveau
+        double res = tm->get_res();
+        if (fabs(bbox.xmax - bbox.xmin - res * width) / res > ALIGNMENT_TOLERANCE) continue;
+        if (fabs(bbox.ymax - bbox.ymin - res * height) / res > ALIGNMENT_TOLERANCE) continue;
+
+        double column = (bbox.xmin - tm->get_x0()) / res;
+        double row = (tm->get_y0() - bbox.ymax) / res;
+        if (fabs(column - round(column / width) * width) > ALIGNMENT_TOLERANCE) return NULL;
+        if (fabs(row - round(row / height) * height) > ALIGNMENT_TOLERANCE) return NULL;
+
+        int c = (int) round(column / width);
+        int r = (int) round(row / height);
+
+        // Hors des données, l'image de nodata est calculée
+        TileMatrixLimits* tml = layer->get_tilematrix_limits(tms, tm);
+        if (tml == NULL || ! tml->contain_tile(c, r) || ! layer->contain_tile(tms, tm, c, r)) return NULL;
+
+        std::shared_ptr<const TileCache::Entry> entry = Tile::get_entry(req, services, layer, tms, tm, c, r, format, style);
+        if (! entry) return NULL;
+
+        return new TileCacheDataStream(entry);
+    }
+
+    return NULL;
+}
+
+/**
+ * \~french
+ * \brief Ajoute à la réponse les en-têtes de cache d'une image combinant plusieurs couches
+ * \details Les durées les plus courtes des politiques des couches sont retenues, les clés de substitution sont cumulées.
+ * \~english
+ * \brief Add to response cache headers of an image combining several layers
+ * \details Shortest durations of layers' policies are kept, surrogate keys are accumulated.
+ */
+static void add_cache_headers(Request* req, std::vector<Layer*>& layers) {
+    if (layers.empty()) return;
+
+    CachePolicy policy = layers.at(0)->get_map_cache_policy();
+    for (unsigned int i = 1; i < layers.size(); i++) {
+        policy.restrict(layers.at(i)->get_map_cache_policy());
+    }
+    policy.add_headers(req);
+}
+
+/**
+ * \~french
+ * \brief Retourne l'image demandée
+ * \details Une image correspondant exactement à une tuile de la pyramide est servie telle qu'elle est stockée. Les demandes simultanées d'une même image (mêmes couches, styles, emprise, dimensions, format et options) ne donnent lieu qu'à un seul calcul
+ * \return Flux de donnée
+ * \~english
+ * \brief Give the asked image
+ * \details An image exactly matching a pyramid tile is served as stored. Concurrent requests of the same image (same layers, styles, bbox, dimensions, format and options) lead to only one computation
+ * \return Data stream
+ */
+static DataStream* get_map(
+    Request* req, ServicesConfiguration* services, bool reprojection, int max_tile_x, int max_tile_y,
+    std::vector<Layer*> layers, int width, int height, CRS* crs, BoundingBox<double> bbox, std::vector<Style*> styles,
+    std::string format, std::map<std::string, std::string> format_options, int dpi, std::string* error
+) {
+
+    if (layers.size() == 1) {
+        DataStream* d = get_native_tile(req, services, layers.at(0), width, height, crs, bbox, styles.at(0), format, format_options, dpi);
+        if (d != NULL) {
+            return d;
+        }
+    }
+
+    if ((long) width * (long) height > SINGLE_FLIGHT_MAX_PIXELS) {
+        // L'image est calculée au fil de son envoi
+        return compute_map(services, reprojection, max_tile_x, max_tile_y, layers, width, height, crs, bbox, styles, format, format_options, dpi, &req->trace, error);
+    }
+
+    // Clé de la requête normalisée
+    std::ostringstream key;
+    key << std::setprecision(17) << "map\n" << services << '\n' << services->get_pinned_layers_version() << '\n' << reprojection << '\n' << max_tile_x << '\n' << max_tile_y << '\n';
+    for (int i = 0; i < layers.size(); i++) {
+        key << layers.at(i)->get_id() << '\n' << styles.at(i)->get_identifier() << '\n';
+    }
+    key << width << '\n' << height << '\n' << crs->get_request_code() << '\n';
+    key << bbox.xmin << '\n' << bbox.ymin << '\n' << bbox.xmax << '\n' << bbox.ymax << '\n';
+    key << format << '\n' << dpi;
+    for (auto const& o : format_options) {
+        key << '\n' << o.first << ':' << o.second;
+    }
+
+    bool leader;
+    std::chrono::steady_clock::time_point waiting = std::chrono::steady_clock::now();
+    std::shared_ptr<const TileCache::Entry> entry = SingleFlight::run(key.str(), [&](std::string* error) -> std::shared_ptr<const TileCache::Entry> {
+        DataStream* d = compute_map(services, reprojection, max_tile_x, max_tile_y, layers, width, height, crs, bbox, styles, format, format_options, dpi, &req->trace, error);
+        if (d == NULL) {
+            return std::shared_ptr<const TileCache::Entry>();
+        }
+        Trace::Timer timer(&req->trace, Trace::PHASE_RENDER);
+        return std::shared_ptr<const TileCache::Entry>(TileCache::read_entry(d, ""));
+    }, error, &leader);
+
+    if (! leader) {
+        req->trace.add(Trace::PHASE_WAIT, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waiting).count());
+    }
+
+    if (! entry) {
+        return NULL;
+    }
+
+    return new TileCacheDataStream(entry);
+}
+
 /**
  * \~french
  * \brief Retourne les informations du pixel demandé
@@ -217,63 +481,12 @@ static DataStream* get_feature_info(
     std::string gfi_type = layer->get_gfi_type();
     if (gfi_type.compare("PYRAMID") == 0) {
 
-        // On cherche la valeur du pixel source sous le clique
-        bool crs_equals = services->are_crs_equals(crs->get_request_code(), layer->get_pyramid()->get_tms()->get_crs()->get_request_code());
-
-        if (! crs_equals && ! reprojection) {
-            *error = "Reprojection is not available";
-            return NULL;
-        }
-
-        Image* image = layer->get_pyramid()->getbbox(max_tile_x, max_tile_y, bbox, width, height, crs, crs_equals, layer->get_resampling(), dpi);
-
-        if (image == NULL) {
-            *error = "BBOX too big";
-            return NULL;
-        }
-
+        // On lit la valeur du pixel source sous le clic, sans calculer l'image demandée
         std::vector<std::string> gfi_data;
-        int bands = image->get_channels();
-        switch (layer->get_pyramid()->get_format()) {
-            case Rok4Format::TIFF_RAW_UINT8:
-            case Rok4Format::TIFF_JPG_UINT8:
-            case Rok4Format::TIFF_PNG_UINT8:
-            case Rok4Format::TIFF_LZW_UINT8:
-            case Rok4Format::TIFF_ZIP_UINT8:
-            case Rok4Format::TIFF_PKB_UINT8: {
-                uint8_t* data = new uint8_t[image->get_width() * bands * sizeof(uint8_t)];
-                image->get_line(data, j);
-                for (int b = 0; b < bands; b++) {
-                    std::stringstream ss;
-                    ss << (int)data[bands * i + b];
-                    gfi_data.push_back(ss.str());
-                }
-                delete[] data;
-                break;
-            }
-            case Rok4Format::TIFF_RAW_FLOAT32:
-            case Rok4Format::TIFF_LZW_FLOAT32:
-            case Rok4Format::TIFF_ZIP_FLOAT32:
-            case Rok4Format::TIFF_PKB_FLOAT32: {
-                float* data = new float[image->get_width() * bands * sizeof(float)];
-                image->get_line(data, j);
-                for (int b = 0; b < bands; b++) {
-                    std::stringstream ss;
-                    ss.setf(std::ios::fixed, std::ios::floatfield);
-                    ss.precision(2);
-                    ss << data[bands * i + b];
-                    gfi_data.push_back(ss.str());
-                }
-                delete[] data;
-                break;
-            }
-            default:
-                *error = "No readable data found";
-                return NULL;
+        if (! PointSampler::get_values(services, reprojection, layer, crs, bbox, width, height, i, j, layer->is_gfi_bilinear(), &gfi_data, error)) {
+            return NULL;
         }
 
-        delete image;
-
         return Utils::format_get_feature_info(gfi_data, info_format);
     } else if (gfi_type.compare("EXTERNALWMS") == 0) {
         BOOST_LOG_TRIVIAL(debug) << "GFI sur WMS externe, en projection native ou non";
@@ -300,7 +513,7 @@ static DataStream* get_feature_info(
 
         Request* gfi_request = new Request("GET", layer->get_gfi_url(), query_params);
 
-        RawDataStream* response = gfi_request->send();
+        DataStream* response = gfi_request->send();
         delete gfi_request;
 
         if (response == NULL) {
@@ -0,0 +1,326 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/Metrics.cpp
+ ** \~french
+ * \brief Implémentation de la classe Metrics
+ ** \~english
+ * \brief Implements classe Metrics
+ */
+
+#include <algorithm>
+#include <stdio.h>
+
+#include "core/Metrics.h"
+#include "core/AccessLog.h"
+#include "core/TileCache.h"
+
+const int Metrics::statuses[Metrics::STATUSES_COUNT - 1] = { 200, 204, 304, 400, 403, 404, 409, 500, 501, 503 };
+
+const uint64_t Metrics::buckets_bounds[Metrics::BUCKETS_COUNT - 1] = {
+    5000000ULL, 10000000ULL, 25000000ULL, 50000000ULL, 100000000ULL, 250000000ULL,
+    500000000ULL, 1000000000ULL, 2500000000ULL, 5000000000ULL, 10000000000ULL
+};
+const char* const Metrics::buckets_labels[Metrics::BUCKETS_COUNT] = {
+    "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1", "2.5", "5", "10", "+Inf"
+};
+
+const char* const Metrics::services_names[Metrics::SERVICES_COUNT] = {
+    "none", "health", "admin", "wms", "wmts", "tms", "ogcapi"
+};
+const char* const Metrics::operations_names[Metrics::OPERATIONS_COUNT] = {
+    "other", "capabilities", "tile", "map", "featureinfo", "admin"
+};
+
+std::mutex Metrics::slots_mtx;
+std::vector<Metrics::Slot*> Metrics::slots;
+thread_local Metrics::Slot* Metrics::slot = NULL;
+
+std::mutex Metrics::layers_mtx;
+std::unordered_map<std::string, int> Metrics::layers_indices;
+std::vector<std::string> Metrics::layers_names(1, "_other");
+thread_local std::unordered_map<std::string, int> Metrics::layers_cache;
+
+Metrics::Slot* Metrics::get_slot() {
+    if (slot == NULL) {
+        // Initialisation à zéro des compteurs
+        slot = new Slot();
+        std::lock_guard<std::mutex> lock(slots_mtx);
+        slots.push_back(slot);
+    }
+    return slot;
+}
+
+int Metrics::get_layer_index(const std::string& layer) {
+    std::unordered_map<std::string, int>::iterator it = layers_cache.find(layer);
+    if (it != layers_cache.end()) {
+        return it->second;
+    }
+
+    // Première requête du thread pour cette couche : l'indice commun est lu ou attribué
+    int index = 0;
+    {
+        std::lock_guard<std::mutex> lock(layers_mtx);
+        std::unordered_map<std::string, int>::iterator g = layers_indices.find(layer);
+        if (g != layers_indices.end()) {
+            index = g->second;
+        } else if (layers_names.size() < METRICS_MAX_LAYERS) {
+            index = layers_names.size();
+            layers_names.push_back(layer);
+            layers_indices.emplace(layer, index);
+        }
+    }
+    layers_cache.emplace(layer, index);
+    return index;
+}
+
+void Metrics::observe(Histogram& h, uint64_t duration_ns) {
+    int b = 0;
+    while (b < BUCKETS_COUNT - 1 && duration_ns > buckets_bounds[b]) b++;
+    add(h.buckets[b], 1);
+    add(h.sum_ns, duration_ns);
+}
+
+void Metrics::record(eService service, eOperation operation, int status, uint64_t bytes, uint64_t duration_ns, const std::string& layer) {
+    Slot* s = get_slot();
+
+    int st = 0;
+    while (st < STATUSES_COUNT - 1 && statuses[st] != status) st++;
+
+    add(s->requests[service][operation][st], 1);
+    add(s->bytes[service][operation], bytes);
+    observe(s->durations[service][operation], duration_ns);
+
+    if (! layer.empty()) {
+        LayerCounters& l = s->layers[get_layer_index(layer)];
+        add(l.requests, 1);
+        add(l.bytes, bytes);
+        observe(l.durations, duration_ns);
+    }
+}
+
+void Metrics::record_storage_read(uint64_t duration_ns) {
+    observe(get_slot()->storage_reads, duration_ns);
+}
+
+void Metrics::write_histogram(std::string& out, const std::string& name, const std::string& labels, const uint64_t* buckets, uint64_t sum_ns) {
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    uint64_t cumulated = 0;
+    for (int b = 0; b < BUCKETS_COUNT; b++) {
+        cumulated += buckets[b];
+        out += name + "_bucket{" + prefix + "le=\"" + buckets_labels[b] + "\"} " + std::to_string(cumulated) + "\n";
+    }
+    char sum[32];
+    snprintf(sum, sizeof(sum), "%.9f", sum_ns / 1e9);
+    std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    out += name + "_sum" + braces + " " + sum + "\n";
+    out += name + "_count" + braces + " " + std::to_string(cumulated) + "\n";
+}
+
+/**
+ * \~french \brief Échappement d'une valeur d'étiquette
+ * \~english \brief Label value escaping
+ */
+static std::string escape_label(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\') escaped += "\\\\";
+        else if (c == '"') escaped += "\\\"";
+        else if (c == '\n') escaped += "\\n";
+        else escaped.push_back(c);
+    }
+    return escaped;
+}
+
+std::string Metrics::to_prometheus(int top_layers) {
+
+    std::vector<Slot*> all;
+    {
+        std::lock_guard<std::mutex> lock(slots_mtx);
+        all = slots;
+    }
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(layers_mtx);
+        names = layers_names;
+    }
+
+    // Sommes sur l'ensemble des threads
+    std::vector<uint64_t> requests(SERVICES_COUNT * OPERATIONS_COUNT * STATUSES_COUNT, 0);
+    std::vector<uint64_t> bytes(SERVICES_COUNT * OPERATIONS_COUNT, 0);
+    std::vector<uint64_t> durations(SERVICES_COUNT * OPERATIONS_COUNT * BUCKETS_COUNT, 0);
+    std::vector<uint64_t> durations_sum(SERVICES_COUNT * OPERATIONS_COUNT, 0);
+    std::vector<uint64_t> storage(BUCKETS_COUNT, 0);
+    uint64_t storage_sum = 0;
+    std::vector<uint64_t> layers_requests(names.size(), 0);
+    std::vector<uint64_t> layers_bytes(names.size(), 0);
+    std::vector<uint64_t> layers_durations(names.size() * BUCKETS_COUNT, 0);
+    std::vector<uint64_t> layers_durations_sum(names.size(), 0);
+
+    for (Slot* s : all) {
+        for (int sv = 0; sv < SERVICES_COUNT; sv++) {
+            for (int op = 0; op < OPERATIONS_COUNT; op++) {
+                int so = sv * OPERATIONS_COUNT + op;
+                for (int st = 0; st < STATUSES_COUNT; st++) {
+                    requests[so * STATUSES_COUNT + st] += s->requests[sv][op][st].load(std::memory_order_relaxed);
+                }
+                bytes[so] += s->bytes[sv][op].load(std::memory_order_relaxed);
+                for (int b = 0; b < BUCKETS_COUNT; b++) {
+                    durations[so * BUCKETS_COUNT + b] += s->durations[sv][op].buckets[b].load(std::memory_order_relaxed);
+                }
+                durations_sum[so] += s->durations[sv][op].sum_ns.load(std::memory_order_relaxed);
+            }
+        }
+        for (int b = 0; b < BUCKETS_COUNT; b++) {
+            storage[b] += s->storage_reads.buckets[b].load(std::memory_order_relaxed);
+        }
+        storage_sum += s->storage_reads.sum_ns.load(std::memory_order_relaxed);
+        for (size_t l = 0; l < names.size(); l++) {
+            layers_requests[l] += s->layers[l].requests.load(std::memory_order_relaxed);
+            layers_bytes[l] += s->layers[l].bytes.load(std::memory_order_relaxed);
+            for (int b = 0; b < BUCKETS_COUNT; b++) {
+                layers_durations[l * BUCKETS_COUNT + b] += s->layers[l].durations.buckets[b].load(std::memory_order_relaxed);
+            }
+            layers_durations_sum[l] += s->layers[l].durations.sum_ns.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::string out;
+    out.reserve(65536);
+
+    out += "# HELP rok4_requests_total Processed requests\n";
+    out += "# TYPE rok4_requests_total counter\n";
+    for (int so = 0; so < SERVICES_COUNT * OPERATIONS_COUNT; so++) {
+        std::string labels = std::string("service=\"") + services_names[so / OPERATIONS_COUNT] + "\",operation=\"" + operations_names[so % OPERATIONS_COUNT] + "\"";
+        for (int st = 0; st < STATUSES_COUNT; st++) {
+            uint64_t count = requests[so * STATUSES_COUNT + st];
+            if (count == 0) continue;
+            std::string code = (st < STATUSES_COUNT - 1) ? std::to_string(statuses[st]) : "other";
+            out += "rok4_requests_total{" + labels + ",code=\"" + code + "\"} " + std::to_string(count) + "\n";
+        }
+    }
+
+    out += "# HELP rok4_response_bytes_total Sent bytes\n";
+    out += "# TYPE rok4_response_bytes_total counter\n";
+    for (int so = 0; so < SERVICES_COUNT * OPERATIONS_COUNT; so++) {
+        uint64_t count = 0;
+        for (int st = 0; st < STATUSES_COUNT; st++) count += requests[so * STATUSES_COUNT + st];
+        if (count == 0) continue;
+        out += std::string("rok4_response_bytes_total{service=\"") + services_names[so / OPERATIONS_COUNT] + "\",operation=\"" + operations_names[so % OPERATIONS_COUNT] + "\"} " + std::to_string(bytes[so]) + "\n";
+    }
+
+    out += "# HELP rok4_request_duration_seconds Requests processing duration\n";
+    out += "# TYPE rok4_request_duration_seconds histogram\n";
+    for (int so = 0; so < SERVICES_COUNT * OPERATIONS_COUNT; so++) {
+        const uint64_t* buckets = &durations[so * BUCKETS_COUNT];
+        if (std::all_of(buckets, buckets + BUCKETS_COUNT, [](uint64_t c) { return c == 0; })) continue;
+        std::string labels = std::string("service=\"") + services_names[so / OPERATIONS_COUNT] + "\",operation=\"" + operations_names[so % OPERATIONS_COUNT] + "\"";
+        write_histogram(out, "rok4_request_duration_seconds", labels, buckets, durations_sum[so]);
+    }
+
+    // Couches les plus sollicitées, les autres sont regroupées avec celles au delà de la capacité
+    std::vector<size_t> order;
+    for (size_t l = 1; l < names.size(); l++) {
+        if (layers_requests[l] != 0) order.push_back(l);
+    }
+    std::sort(order.begin(), order.end(), [&layers_requests](size_t a, size_t b) {
+        return layers_requests[a] > layers_requests[b];
+    });
+    if (order.size() > (size_t) top_layers) {
+        for (size_t k = top_layers; k < order.size(); k++) {
+            size_t l = order.at(k);
+            layers_requests[0] += layers_requests[l];
+            layers_bytes[0] += layers_bytes[l];
+            for (int b = 0; b < BUCKETS_COUNT; b++) {
+                layers_durations[b] += layers_durations[l * BUCKETS_COUNT + b];
+            }
+            layers_durations_sum[0] += layers_durations_sum[l];
+        }
+        order.resize(top_layers);
+    }
+    if (layers_requests[0] != 0) order.push_back(0);
+
+    out += "# HELP rok4_layer_requests_total Processed requests by layer\n";
+    out += "# TYPE rok4_layer_requests_total counter\n";
+    for (size_t l : order) {
+        out += "rok4_layer_requests_total{layer=\"" + escape_label(names.at(l)) + "\"} " + std::to_string(layers_requests[l]) + "\n";
+    }
+
+    out += "# HELP rok4_layer_response_bytes_total Sent bytes by layer\n";
+    out += "# TYPE rok4_layer_response_bytes_total counter\n";
+    for (size_t l : order) {
+        out += "rok4_layer_response_bytes_total{layer=\"" + escape_label(names.at(l)) + "\"} " + std::to_string(layers_bytes[l]) + "\n";
+    }
+
+    out += "# HELP rok4_layer_request_duration_seconds Requests processing duration by layer\n";
+    out += "# TYPE rok4_layer_request_duration_seconds histogram\n";
+    for (size_t l : order) {
+        write_histogram(out, "rok4_layer_request_duration_seconds", "layer=\"" + escape_label(names.at(l)) + "\"", &layers_durations[l * BUCKETS_COUNT], layers_durations_sum[l]);
+    }
+
+    out += "# HELP rok4_storage_read_duration_seconds Native tiles read duration from storage (index and data)\n";
+    out += "# TYPE rok4_storage_read_duration_seconds histogram\n";
+    write_histogram(out, "rok4_storage_read_duration_seconds", "", &storage[0], storage_sum);
+
+    uint64_t hits = TileCache::get_hits();
+    uint64_t misses = TileCache::get_misses();
+
+    out += "# HELP rok4_tile_cache_hits_total Tiles cache hits\n";
+    out += "# TYPE rok4_tile_cache_hits_total counter\n";
+    out += "rok4_tile_cache_hits_total " + std::to_string(hits) + "\n";
+    out += "# HELP rok4_tile_cache_misses_total Tiles cache misses\n";
+    out += "# TYPE rok4_tile_cache_misses_total counter\n";
+    out += "rok4_tile_cache_misses_total " + std::to_string(misses) + "\n";
+    out += "# HELP rok4_tile_cache_evictions_total Tiles cache evictions\n";
+    out += "# TYPE rok4_tile_cache_evictions_total counter\n";
+    out += "rok4_tile_cache_evictions_total " + std::to_string(TileCache::get_evictions()) + "\n";
+
+    char ratio[32];
+    snprintf(ratio, sizeof(ratio), "%.6f", (hits + misses) == 0 ? 0. : (double) hits / (hits + misses));
+    out += "# HELP rok4_tile_cache_hit_ratio Tiles cache hits ratio since start\n";
+    out += "# TYPE rok4_tile_cache_hit_ratio gauge\n";
+    out += std::string("rok4_tile_cache_hit_ratio ") + ratio + "\n";
+
+    out += "# HELP rok4_access_log_dropped_total Access log records lost because of a full buffer\n";
+    out += "# TYPE rok4_access_log_dropped_total counter\n";
+    out += "rok4_access_log_dropped_total " + std::to_string(AccessLog::get_dropped()) + "\n";
+
+    return out;
+}
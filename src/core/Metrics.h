@@ -0,0 +1,210 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/Metrics.h
+ ** \~french
+ * \brief Définition de la classe Metrics
+ ** \~english
+ * \brief Define classe Metrics
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "config.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Métriques des requêtes traitées, au format d'exposition Prometheus
+ * \details Chaque thread enregistre dans ses propres compteurs, qui ne sont écrits que par lui : l'enregistrement ne prend aucun verrou et ne fait aucune opération atomique de lecture-écriture. Les compteurs de tous les threads ne sont sommés qu'à la lecture des métriques.
+ *
+ * Les requêtes sont comptées par service, opération et code de statut, avec les octets envoyés et un histogramme des durées. Les mêmes compteurs sont tenus par couche, seules les couches les plus sollicitées étant détaillées à la lecture.
+ * \~english
+ * \brief Processed requests metrics, in Prometheus exposition format
+ * \details Each thread records into its own counters, written only by itself : recording takes no lock and does no atomic read-modify-write operation. Counters of all threads are summed only when metrics are read.
+ *
+ * Requests are counted by service, operation and status code, with sent bytes and a durations histogram. Same counters are kept by layer, only the most requested layers being detailed when read.
+ */
+class Metrics {
+
+public:
+
+    enum eService {
+        SERVICE_NONE,
+        SERVICE_HEALTH,
+        SERVICE_ADMIN,
+        SERVICE_WMS,
+        SERVICE_WMTS,
+        SERVICE_TMS,
+        SERVICE_OGCAPI,
+        SERVICES_COUNT
+    };
+
+    enum eOperation {
+        OTHER,
+        CAPABILITIES,
+        TILE,
+        MAP,
+        FEATUREINFO,
+        ADMIN,
+        OPERATIONS_COUNT
+    };
+
+private:
+
+    /**
+     * \~french \brief Nombre de codes de statut distingués, le dernier regroupant les autres
+     * \~english \brief Distinguished status codes count, the last one grouping the others
+     */
+    static const int STATUSES_COUNT = 11;
+    static const int statuses[STATUSES_COUNT - 1];
+
+    /**
+     * \~french \brief Nombre de classes des histogrammes, la dernière étant non bornée
+     * \~english \brief Histograms buckets count, the last one being unbounded
+     */
+    static const int BUCKETS_COUNT = 12;
+    static const uint64_t buckets_bounds[BUCKETS_COUNT - 1];
+    static const char* const buckets_labels[BUCKETS_COUNT];
+
+    static const char* const services_names[SERVICES_COUNT];
+    static const char* const operations_names[OPERATIONS_COUNT];
+
+    /**
+     * \~french \brief Histogramme des durées, classes non cumulées
+     * \~english \brief Durations histogram, not cumulated buckets
+     */
+    struct Histogram {
+        std::atomic<uint64_t> buckets[BUCKETS_COUNT];
+        std::atomic<uint64_t> sum_ns;
+    };
+
+    struct LayerCounters {
+        std::atomic<uint64_t> requests;
+        std::atomic<uint64_t> bytes;
+        Histogram durations;
+    };
+
+    /**
+     * \~french \brief Compteurs d'un thread, alloués à son premier enregistrement et jamais libérés
+     * \~english \brief Thread's counters, allocated by its first recording and never released
+     */
+    struct Slot {
+        std::atomic<uint64_t> requests[SERVICES_COUNT][OPERATIONS_COUNT][STATUSES_COUNT];
+        std::atomic<uint64_t> bytes[SERVICES_COUNT][OPERATIONS_COUNT];
+        Histogram durations[SERVICES_COUNT][OPERATIONS_COUNT];
+        Histogram storage_reads;
+        LayerCounters layers[METRICS_MAX_LAYERS];
+    };
+
+    static std::mutex slots_mtx;
+    static std::vector<Slot*> slots;
+    static thread_local Slot* slot;
+
+    /**
+     * \~french \brief Couches connues, par indice. L'indice 0 regroupe les couches au delà de la capacité
+     * \~english \brief Known layers, by index. Index 0 groups layers beyond capacity
+     */
+    static std::mutex layers_mtx;
+    static std::unordered_map<std::string, int> layers_indices;
+    static std::vector<std::string> layers_names;
+    static thread_local std::unordered_map<std::string, int> layers_cache;
+
+    static Slot* get_slot();
+    static int get_layer_index(const std::string& layer);
+
+    /**
+     * \~french \brief Incrémente un compteur du thread courant, sans opération de lecture-écriture atomique
+     * \~english \brief Increment a current thread's counter, without atomic read-modify-write operation
+     */
+    static void add(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static void observe(Histogram& h, uint64_t duration_ns);
+
+    static void write_histogram(std::string& out, const std::string& name, const std::string& labels, const uint64_t* buckets, uint64_t sum_ns);
+
+public:
+
+    /**
+     * \~french
+     * \brief Enregistre une requête traitée
+     * \param[in] service Service ayant traité la requête
+     * \param[in] operation Opération demandée
+     * \param[in] status Code de statut HTTP de la réponse
+     * \param[in] bytes Octets envoyés
+     * \param[in] duration_ns Durée de traitement, en nanosecondes
+     * \param[in] layer Couche concernée, vide si aucune
+     * \~english
+     * \brief Record a processed request
+     * \param[in] service Service which processed the request
+     * \param[in] operation Asked operation
+     * \param[in] status Response HTTP status code
+     * \param[in] bytes Sent bytes
+     * \param[in] duration_ns Processing duration, in nanoseconds
+     * \param[in] layer Concerned layer, empty if none
+     */
+    static void record(eService service, eOperation operation, int status, uint64_t bytes, uint64_t duration_ns, const std::string& layer);
+
+    /**
+     * \~french
+     * \brief Enregistre la lecture d'une tuile dans le stockage
+     * \~english
+     * \brief Record a tile read from storage
+     */
+    static void record_storage_read(uint64_t duration_ns);
+
+    /**
+     * \~french
+     * \brief Métriques au format d'exposition texte de Prometheus
+     * \param[in] top_layers Nombre de couches détaillées, les autres étant regroupées sous la couche "_other"
+     * \~english
+     * \brief Metrics in Prometheus text exposition format
+     * \param[in] top_layers Detailed layers count, others being grouped under the layer "_other"
+     */
+    static std::string to_prometheus(int top_layers);
+};
@@ -0,0 +1,191 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/ParallelImage.cpp
+ ** \~french
+ * \brief Implémentation de la classe ParallelImage
+ ** \~english
+ * \brief Implements classe ParallelImage
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/ParallelImage.h"
+#include "core/RenderPool.h"
+
+ParallelImage::ParallelImage(int width, int height, int channels, BoundingBox<double> bbox, std::vector<Image*> images, std::vector<int> first_lines, bool is_float, int max_parallel) :
+    Image(width, height, channels, bbox), first_lines(first_lines), max_parallel(std::max(max_parallel, 1)), first_kept(0), next_submitted(0)
+{
+    state = std::make_shared<State>();
+    state->width = width;
+    state->channels = channels;
+    state->is_float = is_float;
+    state->cancelled = false;
+    state->bands.resize(images.size());
+    for (unsigned int i = 0; i < images.size(); i++) {
+        state->bands.at(i).image = images.at(i);
+        state->bands.at(i).status = PENDING;
+    }
+}
+
+ParallelImage::~ParallelImage() {
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cancelled = true;
+
+    // Les bandes en cours de calcul lisent les données des couches, on attend qu'elles soient terminées
+    state->cv.wait(lock, [this] {
+        for (const Band& b : state->bands) {
+            if (b.status == RUNNING) return false;
+        }
+        return true;
+    });
+
+    // Les images sont détruites avec la requête, tant que les couches et les styles qu'elles utilisent sont valides
+    for (Band& b : state->bands) {
+        delete b.image;
+        b.image = NULL;
+    }
+}
+
+void ParallelImage::submitted(std::shared_ptr<State> state, int b) {
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        if (state->cancelled || state->bands.at(b).status != SUBMITTED) {
+            // Bande abandonnée ou déjà prise en charge par le thread de la requête
+            return;
+        }
+        state->bands.at(b).status = RUNNING;
+    }
+    compute(state.get(), b);
+}
+
+void ParallelImage::compute(State* state, int b) {
+    // La bande est marquée en cours de calcul : seul ce thread y accède jusqu'à la fin
+    Band& band = state->bands.at(b);
+    int line_size = state->width * state->channels;
+    int height = band.image->get_height();
+
+    std::vector<uint8_t> ui8;
+    std::vector<float> f32;
+    if (state->is_float) {
+        f32.resize((size_t) line_size * height);
+        for (int l = 0; l < height; l++) {
+            band.image->get_line(f32.data() + (size_t) l * line_size, l);
+        }
+    } else {
+        ui8.resize((size_t) line_size * height);
+        for (int l = 0; l < height; l++) {
+            band.image->get_line(ui8.data() + (size_t) l * line_size, l);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        band.ui8.swap(ui8);
+        band.f32.swap(f32);
+        band.status = DONE;
+    }
+    state->cv.notify_all();
+}
+
+template <typename S, typename T>
+static void convert_line(T* dst, const S* src, int size) {
+    for (int i = 0; i < size; i++) {
+        dst[i] = (T) src[i];
+    }
+}
+
+template <typename T>
+static void convert_line(T* dst, const T* src, int size) {
+    memcpy(dst, src, size * sizeof(T));
+}
+
+template <typename T>
+int ParallelImage::_getline(T* buffer, int line) {
+    if (line < 0 || line >= get_height()) {
+        return 0;
+    }
+
+    int b = std::upper_bound(first_lines.begin(), first_lines.end(), line) - first_lines.begin() - 1;
+    Band& band = state->bands.at(b);
+
+    {
+        std::unique_lock<std::mutex> lock(state->mtx);
+
+        // Les bandes précédentes ont été lues, on les libère
+        for (; first_kept < b; first_kept++) {
+            std::vector<uint8_t>().swap(state->bands.at(first_kept).ui8);
+            std::vector<float>().swap(state->bands.at(first_kept).f32);
+        }
+
+        // On confie au pool les bandes suivantes, dans la limite du parallélisme de la requête
+        for (; next_submitted < (int) state->bands.size() && next_submitted < b + max_parallel; next_submitted++) {
+            if (state->bands.at(next_submitted).status != PENDING) continue;
+            state->bands.at(next_submitted).status = SUBMITTED;
+            std::shared_ptr<State> s = state;
+            int i = next_submitted;
+            RenderPool::submit([s, i] { ParallelImage::submitted(s, i); });
+        }
+
+        // Bande pas encore commencée (pool occupé) ou déjà libérée (lecture dans le désordre) : on la calcule nous même
+        if (band.status == PENDING || band.status == SUBMITTED || (band.status == DONE && band.ui8.empty() && band.f32.empty())) {
+            band.status = RUNNING;
+            lock.unlock();
+            compute(state.get(), b);
+        } else {
+            state->cv.wait(lock, [&band] { return band.status == DONE; });
+        }
+    }
+
+    // Seul ce thread libère les bandes : la lecture se fait sans verrou
+    int line_size = get_width() * get_channels();
+    size_t offset = (size_t) (line - first_lines.at(b)) * line_size;
+    if (state->is_float) {
+        convert_line(buffer, band.f32.data() + offset, line_size);
+    } else {
+        convert_line(buffer, band.ui8.data() + offset, line_size);
+    }
+
+    return line_size;
+}
+
+int ParallelImage::get_line(uint8_t* buffer, int line) { return _getline(buffer, line); }
+int ParallelImage::get_line(uint16_t* buffer, int line) { return _getline(buffer, line); }
+int ParallelImage::get_line(float* buffer, int line) { return _getline(buffer, line); }
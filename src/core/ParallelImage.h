@@ -0,0 +1,181 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/ParallelImage.h
+ ** \~french
+ * \brief Définition de la classe ParallelImage
+ ** \~english
+ * \brief Define classe ParallelImage
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <rok4/image/Image.h>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Image calculée par bandes de lignes, en parallèle
+ * \details Chaque bande est une image indépendante (sa propre chaîne de traitement), calculée entièrement en mémoire par un thread du RenderPool. Les lignes sont lues dans l'ordre par l'encodeur : les bandes suivantes sont lancées au fur et à mesure, dans la limite du nombre de bandes simultanées par requête, et les bandes déjà lues sont libérées. Si une bande attendue n'a pas encore été prise en charge par le pool, elle est calculée par le thread appelant.
+ * \~english
+ * \brief Image computed by rows bands, in parallel
+ * \details Each band is an independent image (with its own processing chain), entirely computed in memory by a RenderPool thread. Lines are read in order by the encoder : following bands are started progressively, within the limit of bands computed at the same time for a request, and already read bands are released. If an expected band is not yet handled by the pool, it is computed by the calling thread.
+ */
+class ParallelImage : public Image {
+
+private:
+
+    enum eBandStatus {
+        PENDING,
+        SUBMITTED,
+        RUNNING,
+        DONE
+    };
+
+    struct Band {
+        Image* image;
+        eBandStatus status;
+        std::vector<uint8_t> ui8;
+        std::vector<float> f32;
+    };
+
+    /**
+     * \~french \brief État partagé avec les tâches du pool, qui peuvent se terminer après la destruction de l'image
+     * \~english \brief State shared with pool's tasks, which can end after image destruction
+     */
+    struct State {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<Band> bands;
+        int width;
+        int channels;
+        bool is_float;
+        bool cancelled;
+    };
+
+    std::shared_ptr<State> state;
+
+    /**
+     * \~french \brief Première ligne de chaque bande
+     * \~english \brief First line of each band
+     */
+    std::vector<int> first_lines;
+
+    /**
+     * \~french \brief Nombre maximal de bandes calculées simultanément
+     * \~english \brief Max bands count computed at the same time
+     */
+    int max_parallel;
+
+    /**
+     * \~french \brief Première bande encore en mémoire
+     * \~english \brief First band still in memory
+     */
+    int first_kept;
+
+    /**
+     * \~french \brief Prochaine bande à confier au pool
+     * \~english \brief Next band to submit to the pool
+     */
+    int next_submitted;
+
+    /**
+     * \~french
+     * \brief Tâche du pool : calcule la bande si elle n'a été ni abandonnée, ni prise en charge par le thread de la requête
+     * \~english
+     * \brief Pool's task : compute the band if neither dropped, nor handled by request's thread
+     */
+    static void submitted(std::shared_ptr<State> state, int b);
+
+    /**
+     * \~french
+     * \brief Calcule en mémoire une bande marquée en cours de calcul
+     * \~english
+     * \brief Compute in memory a band marked as running
+     */
+    static void compute(State* state, int b);
+
+    template<typename T>
+    int _getline(T* buffer, int line);
+
+public:
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] width Largeur de l'image
+     * \param[in] height Hauteur de l'image
+     * \param[in] channels Nombre de canaux
+     * \param[in] bbox Emprise de l'image
+     * \param[in] images Images des bandes, de haut en bas, dont l'image prend la propriété
+     * \param[in] first_lines Première ligne de chaque bande
+     * \param[in] is_float Les bandes sont calculées en flottant, sinon sur 8 bits
+     * \param[in] max_parallel Nombre maximal de bandes calculées simultanément
+     * \~english
+     * \brief Constructor
+     * \param[in] width Image width
+     * \param[in] height Image height
+     * \param[in] channels Channels count
+     * \param[in] bbox Image bounding box
+     * \param[in] images Bands images, from top to bottom, owned by the image
+     * \param[in] first_lines First line of each band
+     * \param[in] is_float Bands are computed as floats, otherwise on 8 bits
+     * \param[in] max_parallel Max bands count computed at the same time
+     */
+    ParallelImage(int width, int height, int channels, BoundingBox<double> bbox, std::vector<Image*> images, std::vector<int> first_lines, bool is_float, int max_parallel);
+
+    int get_line(uint8_t* buffer, int line);
+    int get_line(uint16_t* buffer, int line);
+    int get_line(float* buffer, int line);
+
+    /**
+     * \~french
+     * \brief Destructeur : les bandes non commencées sont abandonnées
+     * \details Les images des bandes sont détruites ici, les tâches du pool pas encore commencées ne gardent que l'état partagé.
+     * \~english
+     * \brief Destructor : not started bands are dropped
+     * \details Bands' images are deleted here, pool's tasks not yet started only keep the shared state.
+     */
+    virtual ~ParallelImage();
+};
@@ -0,0 +1,227 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "configurations/Layer.h"
+
+namespace PointSampler {
+
+/**
+ * \~french
+ * \brief Tuile source lue pour l'échantillonnage d'un point
+ * \~english
+ * \brief Source tile read to sample a point
+ */
+struct SourceTile {
+    int column;
+    int row;
+    Image* image;
+};
+
+/**
+ * \~french
+ * \brief Lit la valeur d'un pixel d'un niveau de la pyramide
+ * \details Seule la tuile contenant le pixel est lue. Les tuiles déjà lues sont conservées, pour les pixels voisins
+ * \param[out] values Valeurs des canaux, le nodata de la pyramide en dehors des données
+ * \return Faux si le pixel est en dehors des données
+ * \~english
+ * \brief Read a pyramid level's pixel value
+ * \details Only the tile containing the pixel is read. Already read tiles are kept, for neighbour pixels
+ * \param[out] values Channels values, pyramid's nodata outside data
+ * \return False if pixel is outside data
+ */
+static bool read_pixel(Pyramid* pyramid, Level* level, std::vector<SourceTile>& tiles, long column, long row, float* values) {
+    int channels = pyramid->get_channels();
+    int* nodata = pyramid->get_nodata_value();
+    for (int c = 0; c < channels; c++) values[c] = nodata[c];
+
+    TileMatrix* tm = level->get_tm();
+    if (column < 0 || row < 0) return false;
+
+    int tile_column = column / tm->get_tile_width();
+    int tile_row = row / tm->get_tile_height();
+    if (tile_column < (int) level->get_min_tile_col() || tile_column > (int) level->get_max_tile_col() || tile_row < (int) level->get_min_tile_row() || tile_row > (int) level->get_max_tile_row()) {
+        return false;
+    }
+
+    Image* image = NULL;
+    bool found = false;
+    for (SourceTile& t : tiles) {
+        if (t.column == tile_column && t.row == tile_row) {
+            image = t.image;
+            found = true;
+            break;
+        }
+    }
+    if (! found) {
+        image = level->get_tile(tile_column, tile_row, 0, 0, 0, 0, true);
+        tiles.push_back({tile_column, tile_row, image});
+    }
+    if (image == NULL) return false;
+
+    std::vector<float> line(image->get_width() * image->get_channels());
+    image->get_line(line.data(), row % tm->get_tile_height());
+    int i = column % tm->get_tile_width();
+    for (int c = 0; c < channels && c < image->get_channels(); c++) {
+        values[c] = line.at(i * image->get_channels() + c);
+    }
+    return true;
+}
+
+/**
+ * \~french
+ * \brief Valeurs de la donnée sous un pixel d'une image demandée, pour une couche de type PYRAMID
+ * \details Le pixel (I,J) est converti en coordonnées dans le CRS des données, le niveau est choisi comme pour le calcul de l'image et seule la tuile source contenant le point est lue. Avec l'interpolation bilinéaire, les quatre pixels sources voisins sont pondérés, sauf si l'un d'eux est du nodata.
+ * \param[in] bilinear Interpolation bilinéaire, sinon plus proche voisin
+ * \param[out] values Valeurs des canaux, mises en forme
+ * \return Faux en cas d'erreur, le message étant alors renseigné
+ * \~english
+ * \brief Data values under a pixel of an asked image, for a PYRAMID layer
+ * \details Pixel (I,J) is converted into coordinates in data CRS, the level is chosen as for the image computation and only the source tile containing the point is read. With bilinear interpolation, the four neighbour source pixels are weighted, unless one of them is nodata.
+ * \param[in] bilinear Bilinear interpolation, nearest neighbour otherwise
+ * \param[out] values Formatted channels values
+ * \return False if error, message is then filled
+ */
+static bool get_values(
+    ServicesConfiguration* services, bool reprojection, Layer* layer, CRS* crs, BoundingBox<double> bbox, int width, int height,
+    int i, int j, bool bilinear, std::vector<std::string>* values, std::string* error
+) {
+    Pyramid* pyramid = layer->get_pyramid();
+    CRS* data_crs = pyramid->get_tms()->get_crs();
+
+    bool crs_equals = services->are_crs_equals(crs->get_request_code(), data_crs->get_request_code());
+    if (! crs_equals && ! reprojection) {
+        *error = "Reprojection is not available";
+        return false;
+    }
+
+    SampleFormat::eSampleFormat sample_format = pyramid->get_sample_format();
+    if (sample_format != SampleFormat::UINT8 && sample_format != SampleFormat::FLOAT32) {
+        *error = "No readable data found";
+        return false;
+    }
+
+    // Emprise du pixel demandé, dans le CRS des données
+    double resx = (bbox.xmax - bbox.xmin) / width;
+    double resy = (bbox.ymax - bbox.ymin) / height;
+    BoundingBox<double> pixel = bbox;
+    pixel.xmin = bbox.xmin + i * resx;
+    pixel.xmax = pixel.xmin + resx;
+    pixel.ymax = bbox.ymax - j * resy;
+    pixel.ymin = pixel.ymax - resy;
+    if (! crs_equals && ! pixel.reproject(crs, data_crs, 2)) {
+        // Même réponse que l'ancien calcul par getbbox, qui échouait sur cette reprojection
+        *error = "BBOX too big";
+        return false;
+    }
+
+    double x = (pixel.xmin + pixel.xmax) / 2;
+    double y = (pixel.ymin + pixel.ymax) / 2;
+
+    // Niveau choisi comme pour le calcul de l'image demandée
+    Level* level = pyramid->get_best_level(pixel.xmax - pixel.xmin, pixel.ymax - pixel.ymin);
+    if (level == NULL) {
+        *error = "No readable data found";
+        return false;
+    }
+
+    TileMatrix* tm = level->get_tm();
+    double px = (x - tm->get_x0()) / tm->get_res();
+    double py = (tm->get_y0() - y) / tm->get_res();
+
+    int channels = pyramid->get_channels();
+    int* nodata = pyramid->get_nodata_value();
+    std::vector<float> result(channels);
+    std::vector<SourceTile> tiles;
+
+    bool nearest = true;
+    if (bilinear) {
+        // Pixels voisins, centres encadrant le point
+        long c0 = (long) std::floor(px - 0.5);
+        long r0 = (long) std::floor(py - 0.5);
+        double fx = (px - 0.5) - c0;
+        double fy = (py - 0.5) - r0;
+
+        std::vector<float> v(4 * channels);
+        bool complete = read_pixel(pyramid, level, tiles, c0, r0, &v[0]);
+        complete = read_pixel(pyramid, level, tiles, c0 + 1, r0, &v[channels]) && complete;
+        complete = read_pixel(pyramid, level, tiles, c0, r0 + 1, &v[2 * channels]) && complete;
+        complete = read_pixel(pyramid, level, tiles, c0 + 1, r0 + 1, &v[3 * channels]) && complete;
+
+        for (int k = 0; complete && k < 4 * channels; k++) {
+            if (v[k] == nodata[k % channels]) complete = false;
+        }
+
+        if (complete) {
+            nearest = false;
+            for (int c = 0; c < channels; c++) {
+                result[c] = (1 - fy) * ((1 - fx) * v[c] + fx * v[channels + c]) + fy * ((1 - fx) * v[2 * channels + c] + fx * v[3 * channels + c]);
+            }
+        }
+    }
+
+    if (nearest) {
+        read_pixel(pyramid, level, tiles, (long) std::floor(px), (long) std::floor(py), result.data());
+    }
+
+    for (SourceTile& t : tiles) {
+        delete t.image;
+    }
+
+    for (int c = 0; c < channels; c++) {
+        std::stringstream ss;
+        if (sample_format == SampleFormat::UINT8) {
+            ss << (int) std::lround(result[c]);
+        } else {
+            ss.setf(std::ios::fixed, std::ios::floatfield);
+            ss.precision(2);
+            ss << result[c];
+        }
+        values->push_back(ss.str());
+    }
+
+    return true;
+}
+
+};  // namespace PointSampler
@@ -38,125 +38,144 @@
 /**
  * \file core/Process.cpp
  ** \~french
- * \brief Implémentation des classes Threads et Process
+ * \brief Implémentation de la classe Process
  ** \~english
- * \brief Implements classes Threads and Process
+ * \brief Implements classe Process
  */
-#include <iostream>
-#include <stdio.h>
-#include <string.h>
-#include <sstream>
-#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <new>
+#include <pthread.h>
+#include <stdlib.h>
 
 #include "core/Process.h"
 
-std::map<long unsigned int, InfoThread> Process::threads;
+Process::ThreadSlot* Process::slots = NULL;
+int Process::slots_count = 0;
+std::atomic<int> Process::threads_count(0);
+thread_local Process::ThreadSlot* Process::current = NULL;
 long unsigned int Process::pid;
 long Process::time;
 
-// void Process::add() {
-//     pthread_t i = pthread_self();
-//     Process::add(i);
-// }
+void Process::init_threads(int count) {
+    if (slots != NULL) {
+        free(slots);
+        slots = NULL;
+    }
+    threads_count.store(0);
+    slots_count = count;
+    if (count <= 0) return;
+
+    // Un emplacement par ligne de cache, pour que les threads n'écrivent pas sur les mêmes lignes
+    void* memory = NULL;
+    if (posix_memalign(&memory, alignof(ThreadSlot), sizeof(ThreadSlot) * count) != 0) {
+        slots_count = 0;
+        return;
+    }
+    slots = (ThreadSlot*) memory;
+    for (int i = 0; i < count; i++) {
+        ThreadSlot* s = new (&slots[i]) ThreadSlot();
+        s->sequence.store(0);
+        s->pid.store(0);
+        s->status.store(eThreadStatus::UNKNOWN);
+        s->count.store(0);
+        s->start_ns.store(0);
+        s->duration_ns.store(0);
+    }
+}
+
+void Process::register_thread() {
+    int index = threads_count.load();
+    while (index < slots_count && ! threads_count.compare_exchange_weak(index, index + 1)) { }
+    if (index >= slots_count) {
+        current = NULL;
+        return;
+    }
 
-void Process::add(long unsigned int i) {
-    BOOST_LOG_TRIVIAL(debug) << "add" << "(call thread " << i << ")";
-    threads.insert(std::make_pair<long unsigned int, InfoThread>(std::move(i), InfoThread(i)));
+    current = &slots[index];
+    current->pid.store(pthread_self(), std::memory_order_relaxed);
+    status(eThreadStatus::PENDING);
 }
 
 void Process::status(eThreadStatus value) {
-    pthread_t i = pthread_self();
-    Process::status(i, value);
-}
+    ThreadSlot* s = current;
+    if (s == NULL) return;
 
-void Process::status(long unsigned int i, eThreadStatus value) {
-    BOOST_LOG_TRIVIAL(debug) << "status : " << Process::to_string(value) << "(call thread " << i << ")";
-    std::map<long unsigned int, InfoThread>::iterator it;
-    it = threads.find(i);
-    if (it == threads.end()) {
-        BOOST_LOG_TRIVIAL(debug) << "thread " << i << " not found !?";
-        return;
-    }
-    it->second.set_status(Process::to_string(value));
-    BOOST_LOG_TRIVIAL(debug) << "status update : " << it->second.get_status();
+    int64_t now = now_ns();
+
+    // Seul le thread propriétaire écrit dans son emplacement : la séquence est impaire pendant l'écriture
+    unsigned long seq = s->sequence.load(std::memory_order_relaxed);
+    s->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
 
+    s->status.store(value, std::memory_order_relaxed);
     if (value == eThreadStatus::PENDING) {
-        auto start = std::chrono::system_clock::now();
-        std::time_t time = std::chrono::system_clock::to_time_t(start);
-        it->second.set_time(time);
-        it->second.set_duration(0);
+        s->start_ns.store(now, std::memory_order_relaxed);
+        s->duration_ns.store(0, std::memory_order_relaxed);
+    } else if (value == eThreadStatus::RUNNING) {
+        s->start_ns.store(now, std::memory_order_relaxed);
+    } else if (value == eThreadStatus::AVAILABLE) {
+        s->duration_ns.store(now - s->start_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        s->count.store(s->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
     }
 
-    if (value == eThreadStatus::RUNNING) {
-        auto start = std::chrono::system_clock::now();
-        std::time_t time = std::chrono::system_clock::to_time_t(start);
-        it->second.set_time(time);
-        BOOST_LOG_TRIVIAL(debug) << "time update : " << it->second.get_time();
+    s->sequence.store(seq + 2, std::memory_order_release);
+}
+
+std::vector<Process::ThreadInfos> Process::snapshot() {
+    int count = std::min(threads_count.load(), slots_count);
+
+    std::vector<ThreadInfos> infos;
+    infos.reserve(count);
+    for (int i = 0; i < count; i++) {
+        ThreadSlot* s = &slots[i];
+        ThreadInfos ti;
+        while (true) {
+            unsigned long before = s->sequence.load(std::memory_order_acquire);
+            if (before % 2 == 1) continue;
+
+            ti.pid = s->pid.load(std::memory_order_relaxed);
+            ti.status = (eThreadStatus) s->status.load(std::memory_order_relaxed);
+            ti.count = s->count.load(std::memory_order_relaxed);
+            ti.start_ns = s->start_ns.load(std::memory_order_relaxed);
+            ti.duration_ns = s->duration_ns.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s->sequence.load(std::memory_order_relaxed) == before) break;
+        }
+        infos.push_back(ti);
     }
+    return infos;
+}
 
-    if (value == eThreadStatus::AVAILABLE) {
-        auto end = std::chrono::system_clock::now();
-        std::time_t time = it->second.get_time();
-        auto start = std::chrono::system_clock::from_time_t(time);
-        std::chrono::duration<double> elapsed_seconds = end - start;
-        double duration = elapsed_seconds.count();
-        it->second.set_duration(duration);
-        BOOST_LOG_TRIVIAL(debug) << "duration update : " << it->second.get_duration();
-        it->second.set_count();
-        BOOST_LOG_TRIVIAL(debug) << "count update : " << it->second.get_count();
+json11::Json Process::to_json() {
+    int64_t now = now_ns();
+    long wall_now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+    std::vector<json11::Json> res;
+    for (const ThreadInfos& ti : snapshot()) {
+        json11::Json::object t = json11::Json::object {
+            { "pid", (int) ti.pid },
+            { "status", to_string(ti.status) },
+            { "count", (int) ti.count },
+            // Date du début de la dernière requête, déduite de l'horloge monotone
+            { "time", (int) (wall_now - (now - ti.start_ns) / 1000000000LL) },
+            { "duration", (double) ti.duration_ns / 1e9 }
+        };
+        if (ti.status == eThreadStatus::RUNNING) {
+            t["elapsed"] = (double) (now - ti.start_ns) / 1e9;
+        }
+        res.push_back(t);
     }
 
+    return json11::Json(res);
 }
 
 int Process::get_threads_count() {
-    return threads.size();
+    return std::min(threads_count.load(), slots_count);
 }
 
 long unsigned int Process::get_pid() { return pid; }
 void Process::set_pid(long unsigned int p) { pid = p; }
 long Process::get_time() { return time; }
 void Process::set_time(long processTime) { time = processTime; }
-
-InfoThread::InfoThread(long unsigned int& i) {
-    pid = i;
-    status = Process::to_string(eThreadStatus::PENDING);
-    count = 0;
-    duration = 0;
-    time = 0;
-}
-
-InfoThread::InfoThread(long unsigned int& i, std::string st) {
-    pid = i;
-    status = st;
-    count = 0;
-    duration = 0;
-    time = 0;
-}
-
-long unsigned int InfoThread::get_pid() {
-    return pid;
-}
-
-std::string InfoThread::get_status() {
-    return status;
-}
-
-void InfoThread::set_status(std::string s) {
-    status = s;
-}
-
-int InfoThread::get_count() {
-    return count;
-}
-
-void InfoThread::set_count() {
-    count++;
-}
-
-void InfoThread::set_time(std::time_t t) {
-    time = t;
-}
-
-void InfoThread::set_duration(long double d) {
-    duration = d;
-}
\ No newline at end of file
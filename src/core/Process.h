@@ -38,20 +38,20 @@
 /**
  * \file core/Process.h
  ** \~french
- * \brief Définition des classes InfoThread et Process
+ * \brief Définition de la classe Process
  ** \~english
- * \brief Define classes InfoThread and Process
+ * \brief Define classe Process
  */
 
 #pragma once
 
-#include <map>
+#include <atomic>
 #include <chrono>
+#include <stdint.h>
+#include <vector>
 
 #include <rok4/thirdparty/json11.hpp>
 
-#include "core/Request.h"
-
 enum eThreadStatus {
     UNKNOWN,
     RUNNING,
@@ -66,137 +66,72 @@ const char* const threadstatus_name[] = {
     "AVAILABLE"
 };
 
-class InfoThread {
-    private:
-
-        /**
-         * @brief PID or thread ID
-         * 
-         */
-        long unsigned int pid;
-
-        /**
-         * @brief Thread status : PENDING | RUNNING | AVAIBLE
-         * 
-         */
-        std::string status;
-
-        /**
-         * @brief Number of times the thread changes status
-         * 
-         */
-        int count;
-
-        /**
-         * @brief Time to the last execution
-         * 
-         */
-        std::time_t time;
-
-        /**
-         * @brief Duration to the last execution
-         * 
-         */
-        long double duration;
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Informations sur le processus et ses threads de traitement
+ * \details Chaque thread de traitement dispose d'un emplacement fixe, alloué avant sa création et occupant sa propre ligne de cache. Il y écrit son statut sans verrou ni allocation. Les lectures obtiennent une copie cohérente de chaque emplacement grâce à un numéro de séquence, incrémenté avant et après chaque écriture.
+ * \~english
+ * \brief Process and worker threads informations
+ * \details Each worker thread has a fixed slot, allocated before its creation and using its own cache line. It writes its status there without lock nor allocation. Reads get a consistent copy of each slot thanks to a sequence number, incremented before and after each write.
+ */
+class Process {
 
     public:
-        /**
-         * @brief Construct a new Stat object
-         * 
-         */
-        InfoThread(){};
-        InfoThread(long unsigned int&);
-        InfoThread(long unsigned int&, std::string);
-
-        json11::Json to_json() const {
-            return json11::Json::object {
-                { "pid", (int) pid },
-                { "status", status },
-                { "count", count },
-                { "time", (int) time },
-                { "duration", (double) duration }
-            };
-        }
-
-        /**
-         * @brief Destroy the Stat object
-         * 
-         */
-        ~InfoThread(){};
-
-        /**
-         * @brief 
-         * 
-         * @return std::string
-         */
-        long unsigned int get_pid();
-
-        /**
-         * @brief Get the Status object
-         * 
-         * @return std::string 
-         */
-        std::string get_status();
-
-        /**
-         * @brief Set the Status object
-         * 
-         */
-        void set_status(std::string);
 
         /**
-         * @brief Get the Count object
-         * 
-         * @return int 
+         * \~french \brief Copie cohérente de l'emplacement d'un thread
+         * \~english \brief Consistent copy of a thread's slot
          */
-        int get_count();
-
-        /**
-         * @brief Set the Count object
-         * 
-         */
-        void set_count();
+        struct ThreadInfos {
+            unsigned long pid;
+            eThreadStatus status;
+            unsigned long count;
+            /**
+             * \~french \brief Début de la dernière requête, en nanosecondes sur l'horloge monotone
+             * \~english \brief Last request start, in nanoseconds on the monotonic clock
+             */
+            int64_t start_ns;
+            /**
+             * \~french \brief Durée de la dernière requête terminée, en nanosecondes
+             * \~english \brief Last finished request duration, in nanoseconds
+             */
+            int64_t duration_ns;
+        };
 
-        /**
-         * @brief Set the Time object
-         * 
-         */
-        void set_time(std::time_t);
+    private:
 
-        /**
-         * @brief Get the Time object
-         * 
-         * @return long int
-         */
-        std::time_t get_time() {
-            return time;
-        }
+        struct alignas(64) ThreadSlot {
+            /**
+             * \~french \brief Numéro de séquence, impair pendant une écriture
+             * \~english \brief Sequence number, odd during a write
+             */
+            std::atomic<unsigned long> sequence;
+            std::atomic<unsigned long> pid;
+            std::atomic<int> status;
+            std::atomic<unsigned long> count;
+            std::atomic<int64_t> start_ns;
+            std::atomic<int64_t> duration_ns;
+        };
 
         /**
-         * @brief Get the Duration object
-         * 
-         * @return long double 
+         * \~french \brief Emplacements des threads, alloués avant leur création
+         * \~english \brief Threads slots, allocated before their creation
          */
-        long double get_duration() {
-            return duration;
-        }
+        static ThreadSlot* slots;
+        static int slots_count;
 
         /**
-         * @brief Set the Duration object
-         * 
-         * @param double 
+         * \~french \brief Nombre d'emplacements attribués
+         * \~english \brief Attributed slots count
          */
-        void set_duration(long double);
-
-};
+        static std::atomic<int> threads_count;
 
-class Process {
-    private:
         /**
-         * @brief Thread list information
-         * 
+         * \~french \brief Emplacement du thread courant, NULL s'il n'est pas un thread de traitement
+         * \~english \brief Current thread's slot, NULL if it is not a worker thread
          */
-        static std::map<long unsigned int, InfoThread> threads;
+        static thread_local ThreadSlot* current;
 
         /**
          * @brief Process ID
@@ -231,9 +166,10 @@ class Process {
         static long unsigned int get_pid();
 
         /**
-         * @brief Get the number of threads
-         * 
-         * @return int
+         * \~french
+         * \brief Nombre de threads de traitement enregistrés
+         * \~english
+         * \brief Registered worker threads count
          */
         static int get_threads_count();
 
@@ -245,52 +181,65 @@ class Process {
         static void set_pid(long unsigned int);
 
         /**
-         * @brief Add a new thread to the map
-         * @warning use only in execution thread if id is NULL, 
-         * or else in main thread !
-         * 
+         * \~french
+         * \brief Alloue les emplacements des threads de traitement
+         * \warning À appeler depuis le thread principal, avant la création des threads de traitement et alors qu'aucun ne tourne
+         * \~english
+         * \brief Allocate worker threads slots
+         * \warning To call from the main thread, before worker threads creation and while none is running
          */
-        //static void add();
-        static void add(long unsigned int);
+        static void init_threads(int count);
 
         /**
-         * @brief Update thread information (request, ...)
-         * @warning use only in execution thread if id is NULL, 
-         * or else in main thread !
-         * 
+         * \~french
+         * \brief Attribue un emplacement au thread courant
+         * \details À appeler par le thread de traitement lui-même, à son démarrage. Sans emplacement disponible, le statut du thread n'est pas suivi.
+         * \~english
+         * \brief Attribute a slot to the current thread
+         * \details To call by the worker thread itself, when it starts. Without available slot, thread's status is not tracked.
          */
-        static void update(Request*);
-        static void update(long unsigned int, Request*);
+        static void register_thread();
 
         /**
-         * @brief Update thread status
-         * @warning use only in execution thread if id is NULL, 
-         * or else in main thread !
-         * 
-         * @see Status
+         * \~french
+         * \brief Met à jour le statut du thread courant
+         * \details Sans verrou ni allocation. Le passage à RUNNING date le début de la requête, le passage à AVAILABLE en calcule la durée et incrémente le compteur de requêtes.
+         * \~english
+         * \brief Update current thread's status
+         * \details Without lock nor allocation. Switch to RUNNING dates the request start, switch to AVAILABLE computes its duration and increments the requests counter.
+         * @see eThreadStatus
          */
         static void status(eThreadStatus);
-        static void status(long unsigned int, eThreadStatus);
+
+        /**
+         * \~french
+         * \brief Copie cohérente des emplacements des threads enregistrés
+         * \~english
+         * \brief Consistent copy of registered threads slots
+         */
+        static std::vector<ThreadInfos> snapshot();
 
         /**
          * @brief Show status of all threads in JSON format
          * 
          * @return std::string 
          */
-        static json11::Json to_json() {
-
-            std::vector<InfoThread> res;
-            for(auto const& t: threads) {
-                res.push_back(t.second);
-            }
-
-            return json11::Json(res);
-        };
+        static json11::Json to_json();
 
         static std::string to_string (eThreadStatus st) {
             return std::string ( threadstatus_name[st] );
         }
 
+        /**
+         * \~french
+         * \brief Horloge monotone, en nanosecondes
+         * \~english
+         * \brief Monotonic clock, in nanoseconds
+         */
+        static int64_t now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
         /**
          * \~french
          * \brief Stocke la date du process principal
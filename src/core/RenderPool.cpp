@@ -0,0 +1,125 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/RenderPool.cpp
+ ** \~french
+ * \brief Implémentation de la classe RenderPool
+ ** \~english
+ * \brief Implements classe RenderPool
+ */
+
+#include <boost/log/trivial.hpp>
+
+#include "core/RenderPool.h"
+
+std::mutex RenderPool::mtx;
+std::condition_variable RenderPool::cv;
+std::deque<RenderPool::Task> RenderPool::tasks;
+std::vector<std::thread> RenderPool::threads;
+bool RenderPool::stopping = false;
+int RenderPool::threads_per_request = 1;
+int RenderPool::band_height = 256;
+
+void RenderPool::work() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [] { return stopping || ! tasks.empty(); });
+            if (tasks.empty()) {
+                // Arrêt demandé et plus rien à faire
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void RenderPool::configure(int threads_count, int per_request, int height) {
+    threads_per_request = per_request;
+    band_height = height;
+
+    if (threads_count <= 0) {
+        BOOST_LOG_TRIVIAL(info) << "Rendu parallèle des images désactivé";
+        return;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Rendu parallèle des images : " << threads_count << " threads, " << per_request << " bandes de " << height << " lignes au plus par requête";
+
+    for (int i = 0; i < threads_count; i++) {
+        threads.push_back(std::thread(RenderPool::work));
+    }
+}
+
+void RenderPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    threads.clear();
+}
+
+void RenderPool::submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        tasks.push_back(std::move(task));
+    }
+    cv.notify_one();
+}
+
+json11::Json RenderPool::to_json() {
+    size_t pending;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending = tasks.size();
+    }
+    return json11::Json::object {
+        { "threads", (int) threads.size() },
+        { "threads_per_request", threads_per_request },
+        { "band_height", band_height },
+        { "pending", (int) pending }
+    };
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/RenderPool.h
+ ** \~french
+ * \brief Définition de la classe RenderPool
+ ** \~english
+ * \brief Define classe RenderPool
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <rok4/thirdparty/json11.hpp>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Threads de calcul partagés pour le rendu parallèle des images (WMS GetMap, OGC API Maps)
+ * \details Les images sont découpées en bandes de lignes, calculées par les threads du pool. Le nombre de bandes calculées simultanément pour une même requête est plafonné, pour qu'une grande image ne monopolise pas le pool. Les requêtes de tuiles sont traitées par les threads de traitement et ne passent pas par ce pool.
+ * \~english
+ * \brief Shared computing threads for parallel images rendering (WMS GetMap, OGC API Maps)
+ * \details Images are split into rows bands, computed by pool's threads. Bands count computed at the same time for a request is capped, so that a big image cannot monopolize the pool. Tile requests are processed by request threads and do not use this pool.
+ */
+class RenderPool {
+
+public:
+
+    typedef std::function<void ()> Task;
+
+private:
+
+    static std::mutex mtx;
+    static std::condition_variable cv;
+    static std::deque<Task> tasks;
+    static std::vector<std::thread> threads;
+    static bool stopping;
+
+    /**
+     * \~french \brief Nombre maximal de bandes calculées simultanément pour une requête
+     * \~english \brief Max bands count computed at the same time for a request
+     */
+    static int threads_per_request;
+
+    /**
+     * \~french \brief Hauteur des bandes, en lignes
+     * \~english \brief Bands height, in lines
+     */
+    static int band_height;
+
+    static void work();
+
+public:
+
+    /**
+     * \~french
+     * \brief Démarre les threads de calcul
+     * \param[in] threads_count Nombre de threads, le rendu parallèle est désactivé si 0
+     * \param[in] per_request Nombre maximal de bandes calculées simultanément pour une requête
+     * \param[in] height Hauteur des bandes, en lignes
+     * \~english
+     * \brief Start computing threads
+     * \param[in] threads_count Threads count, parallel rendering is disabled if 0
+     * \param[in] per_request Max bands count computed at the same time for a request
+     * \param[in] height Bands height, in lines
+     */
+    static void configure(int threads_count, int per_request, int height);
+
+    /**
+     * \~french
+     * \brief Arrête les threads de calcul, une fois les tâches en attente traitées
+     * \~english
+     * \brief Stop computing threads, once pending tasks are done
+     */
+    static void stop();
+
+    /**
+     * \~french
+     * \brief Ajoute une tâche à la file
+     * \~english
+     * \brief Add a task to the queue
+     */
+    static void submit(Task task);
+
+    /**
+     * \~french
+     * \brief Teste si une image de cette hauteur doit être calculée en parallèle
+     * \~english
+     * \brief Test if an image with this height have to be computed in parallel
+     */
+    static bool is_enabled_for(int height) {
+        return ! threads.empty() && threads_per_request > 1 && height >= 2 * band_height;
+    }
+
+    static int get_threads_per_request() { return threads_per_request; }
+    static int get_band_height() { return band_height; }
+
+    /**
+     * \~french
+     * \brief Export JSON de l'état du pool
+     * \~english
+     * \brief JSON export of pool's state
+     */
+    static json11::Json to_json();
+};
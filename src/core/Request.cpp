@@ -51,15 +51,17 @@
 #include <climits>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <strings.h>
 #include <vector>
 
-#include <rok4/utils/CurlPool.h>
 #include <rok4/utils/LibcurlStruct.h>
 
+#include "core/UpstreamClient.h"
 #include "core/Utils.h"
 #include "config.h"
 
-Request::Request(FCGX_Request *fcgx) : fcgx_request(fcgx) {
+Request::Request(FCGX_Request *fcgx) : fcgx_request(fcgx), operation(Metrics::OTHER), response_status(0), response_bytes(0), cache_outcome(AccessLog::CACHE_NONE) {
     // Méthode
     method = std::string(FCGX_GetParam("REQUEST_METHOD", fcgx->envp));
 
@@ -88,120 +90,226 @@ Request::Request(FCGX_Request *fcgx) : fcgx_request(fcgx) {
     // Query parameters
     char *query = FCGX_GetParam("QUERY_STRING", fcgx->envp);
     BOOST_LOG_TRIVIAL(debug) << "Query parameters: " << query;
-    Utils::url_decode(query);
+    parse_query_string(query);
 
-    std::map<std::string, std::string> params = Utils::string_to_map(std::string(query), "&", "=");
+    // Secret
+    char* tmp = FCGX_GetParam(SECRET_HEADER_NAME, fcgx->envp);
+    if (tmp != 0) {
+        secret = std::string(tmp);
+    }
 
-    // On stocke les paramètres de requête avec la clé en minuscule
-    std::map<std::string, std::string>::iterator it;
-    for (it = params.begin(); it != params.end(); it++) {
-        std::string key = it->first;
-        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-        query_params.insert(std::pair<std::string, std::string>(key, it->second));
+    // Requête conditionnelle
+    tmp = FCGX_GetParam(IF_NONE_MATCH_HEADER_NAME, fcgx->envp);
+    if (tmp != 0) {
+        if_none_match = std::string(tmp);
     }
 
-    // On stocke les paramètres de requête avec la clé en minuscule
-    char* tmp = FCGX_GetParam(SECRET_HEADER_NAME, fcgx->envp);
+    // Encodages acceptés
+    tmp = FCGX_GetParam(ACCEPT_ENCODING_HEADER_NAME, fcgx->envp);
     if (tmp != 0) {
-        secret = std::string(tmp);
+        accept_encoding = std::string(tmp);
     }
 }
 
-Request::Request(std::string m, std::string u, std::map<std::string, std::string> qp) : fcgx_request(NULL), method(m), query_params(qp), url(u) {}
+Request::Request(std::string m, std::string u, std::map<std::string, std::string> qp) : fcgx_request(NULL), url(u), method(m), operation(Metrics::OTHER), response_status(0), response_bytes(0), cache_outcome(AccessLog::CACHE_NONE) {
+    for (auto const& p : qp) {
+        QueryParam param;
+        param.key = query_buffer.size();
+        param.key_size = p.first.size();
+        query_buffer.append(p.first);
+        param.value = query_buffer.size();
+        param.value_size = p.second.size();
+        query_buffer.append(p.second);
+        query_params.push_back(param);
+    }
+}
 
 Request::~Request() {}
 
-bool Request::has_query_param(std::string paramName) {
-    std::map<std::string, std::string>::iterator it = query_params.find(paramName);
-    if (it == query_params.end()) {
-        return false;
+void Request::parse_query_string(const char* query) {
+
+    if (query == NULL) {
+        return;
+    }
+
+    // Une seule copie de la chaîne, les clés et valeurs y sont ensuite décodées en place. Le découpage se fait avant
+    // le décodage, pour qu'un '&' ou un '=' encodé reste dans la valeur
+    query_buffer.assign(query);
+    char* buffer = &query_buffer[0];
+    size_t length = query_buffer.size();
+
+    size_t read = 0;
+    size_t write = 0;
+    while (read < length) {
+        const char* item = buffer + read;
+        const char* item_end = (const char*) memchr(item, '&', length - read);
+        size_t item_size = (item_end == NULL) ? length - read : item_end - item;
+
+        const char* equal = (const char*) memchr(item, '=', item_size);
+        if (equal != NULL) {
+            QueryParam param;
+            param.key = write;
+            param.key_size = Utils::url_decode(buffer + write, item, equal - item);
+            write += param.key_size;
+
+            param.value = write;
+            param.value_size = Utils::url_decode(buffer + write, equal + 1, item + item_size - equal - 1);
+            write += param.value_size;
+
+            query_params.push_back(param);
+        }
+
+        read += item_size + 1;
     }
-    return true;
+
+    query_buffer.resize(write);
 }
 
-std::string Request::get_query_param(std::string paramName) {
-    std::map<std::string, std::string>::iterator it = query_params.find(paramName);
-    if (it == query_params.end()) {
-        return "";
+const Request::QueryParam* Request::find_query_param(const std::string& paramName) const {
+    for (const QueryParam& p : query_params) {
+        if (p.key_size == paramName.size() && strncasecmp(query_buffer.data() + p.key, paramName.data(), p.key_size) == 0) {
+            return &p;
+        }
     }
-    return it->second;
+    return NULL;
 }
 
-std::string Request::to_string() {
-    return method + " " + path + "?" + Utils::map_to_string(query_params, "&", "=");
+bool Request::has_query_param(const std::string& paramName) const {
+    return find_query_param(paramName) != NULL;
 }
 
-bool Request::is_inspire(bool inspire_default) {
+std::string Request::get_query_param(const std::string& paramName) const {
+    const QueryParam* p = find_query_param(paramName);
+    if (p == NULL) {
+        return "";
+    }
+    return query_buffer.substr(p->value, p->value_size);
+}
 
-    if (inspire_default) {
-        std::string inspire = get_query_param("inspire");
-        return ! (inspire == "false" || inspire == "0");
-    } else {
-        std::string inspire = get_query_param("inspire");
-        return inspire == "true" || inspire == "1";
+std::string Request::get_query_string() const {
+    std::string res;
+    res.reserve(query_buffer.size() + 2 * query_params.size());
+    for (const QueryParam& p : query_params) {
+        if (! res.empty()) res.push_back('&');
+        res.append(query_buffer, p.key, p.key_size);
+        res.push_back('=');
+        res.append(query_buffer, p.value, p.value_size);
     }
+    return res;
+}
 
+void Request::add_response_header(std::string name, std::string value) {
+    response_headers.push_back(std::make_pair(name, value));
 }
 
-RawDataStream* Request::send() {
+bool Request::has_response_header(const std::string& name) const {
+    for (auto const& h : response_headers) {
+        if (strcasecmp(h.first.c_str(), name.c_str()) == 0) return true;
+    }
+    return false;
+}
 
-    if (fcgx_request != NULL) {
-        BOOST_LOG_TRIVIAL(error) << "Input request cannot be sent";
-        return NULL;
+bool Request::match_etag(const std::string& etag) const {
+    if (if_none_match.empty() || etag.empty()) {
+        return false;
     }
 
-    BOOST_LOG_TRIVIAL(info) << "Send request " << method << " " << url << "?" << Utils::map_to_string(query_params, "&", "=");
+    size_t pos = 0;
+    while (pos < if_none_match.size()) {
+        // Chaque élément de la liste est séparé par une virgule, entouré d'éventuels espaces
+        size_t end = if_none_match.find(',', pos);
+        if (end == std::string::npos) end = if_none_match.size();
+
+        size_t start = if_none_match.find_first_not_of(" \t", pos);
+        size_t last = if_none_match.find_last_not_of(" \t", end - 1);
+
+        if (start != std::string::npos && start < end && last != std::string::npos && last >= start) {
+            if (if_none_match.compare(start, 2, "W/") == 0) start += 2;
+            size_t size = last - start + 1;
+
+            if (size == 1 && if_none_match[start] == '*') {
+                return true;
+            }
+            if (size == etag.size() && if_none_match.compare(start, size, etag) == 0) {
+                return true;
+            }
+        }
 
-    CURLcode res;
-    DataStruct chunk;
-    chunk.nbPassage = 0;
-    chunk.data = (char *)malloc(1);
-    chunk.size = 0;
+        pos = end + 1;
+    }
 
-    CURL *curl = CurlPool::get_curl_env();
+    return false;
+}
 
-    std::string full_url = url + "?" + Utils::map_to_string(query_params, "&", "=");
-    curl_easy_setopt(curl, CURLOPT_URL, full_url.c_str());
-    if (get_ssl_no_verify()) {
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+bool Request::accepts_encoding(const std::string& coding) const {
+    if (accept_encoding.empty()) {
+        return false;
     }
-    int timeout = get_timeout();
-    if (timeout != 0) {
-        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, timeout);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+
+    // Poids de l'encodage demandé et du joker, -1 si absents
+    double coding_q = -1;
+    double any_q = -1;
+
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        // Chaque élément de la liste est séparé par une virgule, ses paramètres par des points-virgules
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) end = accept_encoding.size();
+
+        std::string item = accept_encoding.substr(pos, end - pos);
+        std::string name = item;
+        double q = 1;
+
+        size_t semicolon = item.find(';');
+        if (semicolon != std::string::npos) {
+            name = item.substr(0, semicolon);
+            size_t q_pos = item.find("q=", semicolon);
+            if (q_pos != std::string::npos) {
+                q = atof(item.c_str() + q_pos + 2);
+            }
+        }
+        boost::trim(name);
+
+        if (strcasecmp(name.c_str(), coding.c_str()) == 0) {
+            coding_q = q;
+        } else if (name == "*") {
+            any_q = q;
+        }
+
+        pos = end + 1;
     }
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
-    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-    curl_easy_setopt(curl, CURLOPT_HEADER, 0L);
-    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "identity");
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "ROK4 server");
 
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
+    if (coding_q >= 0) {
+        return coding_q > 0;
+    }
+    return any_q > 0;
+}
 
-    res = curl_easy_perform(curl);
+std::string Request::to_string() {
+    return method + " " + path + "?" + get_query_string();
+}
 
-    if (CURLE_OK != res) {
-        BOOST_LOG_TRIVIAL(error) <<  method << " " << url << " failed" ;
-        BOOST_LOG_TRIVIAL(error) << curl_easy_strerror(res);
-        return NULL;
+bool Request::is_inspire(bool inspire_default) {
+
+    if (inspire_default) {
+        std::string inspire = get_query_param("inspire");
+        return ! (inspire == "false" || inspire == "0");
+    } else {
+        std::string inspire = get_query_param("inspire");
+        return inspire == "true" || inspire == "1";
     }
 
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+}
+
+DataStream* Request::send() {
 
-    if (http_code < 200 || http_code > 299) {
-        BOOST_LOG_TRIVIAL(error) <<  method << " " << url << " failed" ;
-        BOOST_LOG_TRIVIAL(error) << "Response HTTP code : " << http_code;
+    if (fcgx_request != NULL) {
+        BOOST_LOG_TRIVIAL(error) << "Input request cannot be sent";
         return NULL;
     }
 
-    char* content_type = 0;
-    curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &content_type);
-
-    RawDataStream* stream = new RawDataStream((uint8_t*) chunk.data, chunk.size, std::string(content_type), "");
+    BOOST_LOG_TRIVIAL(info) << "Send request " << method << " " << url << "?" << get_query_string();
 
-    return stream;
+    // Les paramètres sont ordonnés : l'URL complète est une clé canonique pour le cache des réponses
+    return UpstreamClient::fetch(url + "?" + get_query_string(), get_ssl_no_verify(), get_timeout());
 }
\ No newline at end of file
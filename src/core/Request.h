@@ -41,9 +41,14 @@
 #include <vector>
 #include <regex>
 #include <fcgiapp.h>
+#include <boost/container/small_vector.hpp>
 
 #include <rok4/datastream/DataStream.h>
 
+#include "core/Metrics.h"
+#include "core/AccessLog.h"
+#include "core/Trace.h"
+
 // struct Route;
 
 /**
@@ -74,6 +79,55 @@
 class Request {
     friend class CppUnitRequest;
 
+private:
+
+    /**
+     * \~french \brief Paramètre de requête, clé et valeur sont des portions de query_buffer
+     * \~english \brief Query parameter, key and value are query_buffer parts
+     */
+    struct QueryParam {
+        size_t key;
+        size_t key_size;
+        size_t value;
+        size_t value_size;
+    };
+
+    /**
+     * \~french \brief Nombre de paramètres de requête stockés sans allocation
+     * \~english \brief Query parameters count stored without allocation
+     */
+    static const int INLINE_QUERY_PARAMS = 16;
+
+    /**
+     * \~french \brief Clés et valeurs décodées des paramètres de requête, contiguës
+     * \~english \brief Decoded query parameters' keys and values, contiguous
+     */
+    std::string query_buffer;
+
+    /**
+     * \~french \brief Liste des paramètres de la requête, dans leur ordre d'apparition
+     * \~english \brief Request parameters list, in appearance order
+     */
+    boost::container::small_vector<QueryParam, INLINE_QUERY_PARAMS> query_params;
+
+    /**
+     * \~french
+     * \brief Recherche d'un paramètre, la clé étant comparée sans tenir compte de la casse
+     * \details En cas de doublon, le premier paramètre est retourné
+     * \~english
+     * \brief Look for a parameter, key is compared case-insensitively
+     * \details With duplicates, the first parameter is returned
+     */
+    const QueryParam* find_query_param ( const std::string& paramName ) const;
+
+    /**
+     * \~french
+     * \brief Découpe et décode la chaîne de paramètres de requête, en une passe
+     * \~english
+     * \brief Split and decode query string, in one pass
+     */
+    void parse_query_string ( const char* query );
+
 public:
 
     FCGX_Request* fcgx_request;
@@ -88,7 +142,7 @@ public:
      * \param[in] paramName parameter to test
      * \return true if present
      */
-    bool has_query_param ( std::string paramName );
+    bool has_query_param ( const std::string& paramName ) const;
 
     /**
      * \~french
@@ -100,7 +154,15 @@ public:
      * \param[in] paramName parameter name
      * \return parameter value or "" if not availlable
      */
-    std::string get_query_param ( std::string paramName );
+    std::string get_query_param ( const std::string& paramName ) const;
+
+    /**
+     * \~french
+     * \brief Chaîne des paramètres de la requête, sans encodage
+     * \~english
+     * \brief Request parameters string, without encoding
+     */
+    std::string get_query_string() const;
 
     /**
      * \~french \brief Protocole, hôte, port et chemin
@@ -119,18 +181,108 @@ public:
      */
     std::string path;
 
-    /**
-     * \~french \brief Liste des paramètres de la requête
-     * \~english \brief Request parameters list
-     */
-    std::map<std::string, std::string> query_params;
-
     /**
      * \~french \brief Secret
      * \~english \brief Secret
      */
     std::string secret;
 
+    /**
+     * \~french \brief Valeur de l'en-tête If-None-Match, vide si absent
+     * \~english \brief If-None-Match header value, empty if missing
+     */
+    std::string if_none_match;
+
+    /**
+     * \~french \brief Valeur de l'en-tête Accept-Encoding, vide si absent
+     * \~english \brief Accept-Encoding header value, empty if missing
+     */
+    std::string accept_encoding;
+
+    /**
+     * \~french \brief En-têtes supplémentaires de la réponse
+     * \~english \brief Additionnal response headers
+     */
+    std::vector<std::pair<std::string, std::string> > response_headers;
+
+    /**
+     * \~french \brief Opération demandée, renseignée par le service pour les métriques
+     * \~english \brief Asked operation, filled by the service for metrics
+     */
+    Metrics::eOperation operation;
+
+    /**
+     * \~french \brief Couche concernée (la première pour une carte), vide si aucune
+     * \~english \brief Concerned layer (the first one for a map), empty if none
+     */
+    std::string layer;
+
+    /**
+     * \~french \brief Code de statut HTTP de la réponse envoyée
+     * \~english \brief Sent response HTTP status code
+     */
+    int response_status;
+
+    /**
+     * \~french \brief Nombre d'octets envoyés, en-tête compris
+     * \~english \brief Sent bytes count, header included
+     */
+    size_t response_bytes;
+
+    /**
+     * \~french \brief Issue de la recherche dans le cache des tuiles, pour le journal d'accès
+     * \~english \brief Tiles cache search outcome, for the access log
+     */
+    AccessLog::eCacheOutcome cache_outcome;
+
+    /**
+     * \~french \brief Durées des phases du traitement, depuis la réception de la requête
+     * \~english \brief Processing phases durations, since request reception
+     */
+    Trace trace;
+
+    /**
+     * \~french
+     * \brief Ajoute un en-tête à la réponse
+     * \~english
+     * \brief Add a header to the response
+     */
+    void add_response_header ( std::string name, std::string value );
+
+    /**
+     * \~french
+     * \brief Teste la présence d'un en-tête dans la réponse, sans tenir compte de la casse
+     * \~english
+     * \brief Test if a header is in the response, case insensitive
+     */
+    bool has_response_header ( const std::string& name ) const;
+
+    /**
+     * \~french
+     * \brief Teste si l'ETag fait partie de ceux de l'en-tête If-None-Match
+     * \details La comparaison est faible : un préfixe W/ est ignoré. La valeur '*' correspond à tous les ETags
+     * \param[in] etag ETag de la ressource, avec ses guillemets
+     * \return Vrai si la ressource n'a pas été modifiée
+     * \~english
+     * \brief Test if the ETag is one of the If-None-Match header's
+     * \details Weak comparison : a W/ prefix is ignored. '*' value matches all ETags
+     * \param[in] etag Resource ETag, with its quotes
+     * \return True if resource is not modified
+     */
+    bool match_etag ( const std::string& etag ) const;
+
+    /**
+     * \~french
+     * \brief Teste si l'encodage de contenu est accepté par le client, selon l'en-tête Accept-Encoding
+     * \details Un poids nul (q=0) refuse l'encodage. Le joker '*' s'applique aux encodages non cités
+     * \param[in] coding Encodage de contenu (gzip...)
+     * \~english
+     * \brief Test if content coding is accepted by the client, according to the Accept-Encoding header
+     * \details A null weight (q=0) refuses the coding. '*' wildcard applies to codings not listed
+     * \param[in] coding Content coding (gzip...)
+     */
+    bool accepts_encoding ( const std::string& coding ) const;
+
     /**
      * \~french \brief Liste des paramètres extraits du chemin de la requête
      * \~english \brief Parameters list from request path
@@ -159,11 +311,11 @@ public:
 
     /**
      * \~french \brief Joue la requête
-     * \details La requête ne doit pas être une requête reçue
+     * \details La requête ne doit pas être une requête reçue. Elle est jouée par le client des services externes, la réponse est lue au fur et à mesure de sa réception
      * \~english \brief Send the request
-     * \details Request cannot be an input one
+     * \details Request cannot be an input one. It is played by the external services client, response is read as it is received
      */
-    RawDataStream* send();
+    DataStream* send();
     
     /**
      * \~french
@@ -0,0 +1,98 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/RequestQueue.cpp
+ ** \~french
+ * \brief Implémentation de la classe RequestQueue
+ ** \~english
+ * \brief Implements classe RequestQueue
+ */
+
+#include "core/RequestQueue.h"
+
+RequestQueue::RequestQueue(size_t c) : capacity(c), closed(false) {
+    if (capacity < 1) capacity = 1;
+}
+
+RequestQueue::~RequestQueue() {
+    for (FCGX_Request* r : requests) {
+        FCGX_Finish_r(r);
+        FCGX_Free(r, 1);
+        delete r;
+    }
+}
+
+bool RequestQueue::push(FCGX_Request* r) {
+    std::unique_lock<std::mutex> lock(mtx);
+    not_full.wait(lock, [this] { return closed || requests.size() < capacity; });
+    if (closed) {
+        return false;
+    }
+    requests.push_back(r);
+    lock.unlock();
+    not_empty.notify_one();
+    return true;
+}
+
+FCGX_Request* RequestQueue::pop() {
+    std::unique_lock<std::mutex> lock(mtx);
+    not_empty.wait(lock, [this] { return closed || ! requests.empty(); });
+    if (requests.empty()) {
+        return NULL;
+    }
+    FCGX_Request* r = requests.front();
+    requests.pop_front();
+    lock.unlock();
+    not_full.notify_one();
+    return r;
+}
+
+void RequestQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+size_t RequestQueue::size() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return requests.size();
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/RequestQueue.h
+ ** \~french
+ * \brief Définition de la classe RequestQueue
+ ** \~english
+ * \brief Define classe RequestQueue
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <fcgiapp.h>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief File bornée des requêtes FastCGI acceptées
+ * \details Les threads d'acceptation y déposent les requêtes dont l'en-tête a été lu, les threads de traitement les y récupèrent. Lorsque la file est pleine, l'acceptation est suspendue et les connexions restent dans le backlog du socket.
+ * \~english
+ * \brief Bounded queue of accepted FastCGI requests
+ * \details Acceptor threads push requests whose parameters have been read, worker threads pop them. When the queue is full, accepting is paused and connections wait in the socket backlog.
+ */
+class RequestQueue {
+
+private:
+    /**
+     * \~french \brief Requêtes en attente de traitement
+     * \~english \brief Requests waiting to be processed
+     */
+    std::deque<FCGX_Request*> requests;
+
+    /**
+     * \~french \brief Nombre maximal de requêtes en attente
+     * \~english \brief Max waiting requests count
+     */
+    size_t capacity;
+
+    /**
+     * \~french \brief La file n'accepte plus de nouvelles requêtes
+     * \~english \brief Queue does not accept new requests anymore
+     */
+    bool closed;
+
+    std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+public:
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] c nombre maximal de requêtes en attente
+     * \~english
+     * \brief Constructor
+     * \param[in] c max waiting requests count
+     */
+    RequestQueue(size_t c);
+
+    /**
+     * \~french
+     * \brief Destructeur, les requêtes restantes sont fermées
+     * \~english
+     * \brief Destructor, remaining requests are closed
+     */
+    ~RequestQueue();
+
+    /**
+     * \~french
+     * \brief Ajoute une requête, en attendant qu'une place se libère
+     * \return false si la file est fermée, la requête n'est alors pas ajoutée
+     * \~english
+     * \brief Add a request, waiting for a free slot
+     * \return false if queue is closed, request is not added
+     */
+    bool push(FCGX_Request* r);
+
+    /**
+     * \~french
+     * \brief Récupère la prochaine requête, en attendant qu'il y en ait une
+     * \return NULL si la file est fermée et vide
+     * \~english
+     * \brief Get the next request, waiting for one
+     * \return NULL if queue is closed and empty
+     */
+    FCGX_Request* pop();
+
+    /**
+     * \~french
+     * \brief Ferme la file : les requêtes déjà présentes restent à traiter, les threads en attente sont réveillés
+     * \~english
+     * \brief Close the queue : already queued requests are still processed, waiting threads are woken up
+     */
+    void close();
+
+    /**
+     * \~french \brief Retourne le nombre de requêtes en attente
+     * \~english \brief Return waiting requests count
+     */
+    size_t size();
+};
@@ -66,7 +66,12 @@
 #include <fcgiapp.h>
 
 #include "core/Rok4Server.h"
+#include "core/AccessLog.h"
 #include "core/Process.h"
+#include "core/RenderPool.h"
+#include "core/TileCache.h"
+#include "core/Trace.h"
+#include "core/UpstreamClient.h"
 #include "config.h"
 
 #include "services/Router.h"
@@ -78,37 +83,70 @@ void hangleSIGALARM(int id) {
     signal(SIGALRM, hangleSIGALARM);
 }
 
-void* Rok4Server::thread_loop(void* arg) {
+void* Rok4Server::accept_loop(void* arg) {
     Rok4Server* server = (Rok4Server*)(arg);
-    FCGX_Request fcgxRequest;
-    if (FCGX_InitRequest(&fcgxRequest, server->sock, FCGI_FAIL_ACCEPT_ON_INTR) != 0) {
-        BOOST_LOG_TRIVIAL(fatal) << "Le listener FCGI ne peut etre initialise";
-    }
 
     while (server->is_running()) {
-        std::string content;
+        FCGX_Request* fcgxRequest = new FCGX_Request;
+        if (FCGX_InitRequest(fcgxRequest, server->sock, FCGI_FAIL_ACCEPT_ON_INTR) != 0) {
+            BOOST_LOG_TRIVIAL(fatal) << "Le listener FCGI ne peut etre initialise";
+            delete fcgxRequest;
+            break;
+        }
 
         int rc;
-        if ((rc = FCGX_Accept_r(&fcgxRequest)) < 0) {
+        if ((rc = FCGX_Accept_r(fcgxRequest)) < 0) {
             if (rc == -4) {  // Cas du redémarrage
-                BOOST_LOG_TRIVIAL(debug) << "Redémarrage : FCGX_InitRequest renvoie le code d'erreur " << rc;
+                BOOST_LOG_TRIVIAL(debug) << "Redémarrage : FCGX_Accept_r renvoie le code d'erreur " << rc;
             } else {
-                BOOST_LOG_TRIVIAL(error) << "FCGX_InitRequest renvoie le code d'erreur " << rc;
-                std::cerr << "FCGX_InitRequest renvoie le code d'erreur " << rc << std::endl;
+                BOOST_LOG_TRIVIAL(error) << "FCGX_Accept_r renvoie le code d'erreur " << rc;
+                std::cerr << "FCGX_Accept_r renvoie le code d'erreur " << rc << std::endl;
             }
+            FCGX_Free(fcgxRequest, 1);
+            delete fcgxRequest;
+            break;
+        }
 
+        if (! server->queue->push(fcgxRequest)) {
+            // La file est fermée, la connexion est refermée sans réponse
+            FCGX_Finish_r(fcgxRequest);
+            delete fcgxRequest;
             break;
         }
+    }
+
+    BOOST_LOG_TRIVIAL(debug) << "Extinction du thread d'acceptation";
+    return 0;
+}
+
+void* Rok4Server::thread_loop(void* arg) {
+    Rok4Server* server = (Rok4Server*)(arg);
+
+    Process::register_thread();
+
+    FCGX_Request* fcgxRequest;
+    // La file n'est vide et fermée qu'à l'arrêt du serveur, une fois les requêtes acceptées toutes traitées
+    while ((fcgxRequest = server->queue->pop()) != NULL) {
 
         BOOST_LOG_TRIVIAL(debug) << "Thread " << pthread_self() << " traite une requete";
         Process::status(eThreadStatus::RUNNING);
 
-        Request* request = new Request(&fcgxRequest);
-        Router::process_request(request, server->get_services_configuration());
+        // La configuration est conservée jusqu'à la fin de la requête, même si elle est rechargée entre temps
+        std::shared_ptr<ServicesConfiguration> services = server->get_services_configuration();
+
+        // De même, les couches vues restent celles du début de la requête, même si elles sont modifiées entre temps
+        services->pin_layers();
+
+        Request* request = new Request(fcgxRequest);
+        Router::process_request(request, services.get());
         delete request;
 
-        FCGX_Finish_r(&fcgxRequest);
-        FCGX_Free(&fcgxRequest, 1);
+        services->unpin_layers();
+        services.reset();
+
+        FCGX_Finish_r(fcgxRequest);
+        FCGX_Free(fcgxRequest, 1);
+        delete fcgxRequest;
 
         BOOST_LOG_TRIVIAL(debug) << "Thread " << pthread_self() << " en a fini avec la requete";
         Process::status(eThreadStatus::AVAILABLE);
@@ -120,7 +158,8 @@ void* Rok4Server::thread_loop(void* arg) {
 
 Rok4Server::Rok4Server(ServerConfiguration* svr, ServicesConfiguration* svc) {
     sock = 0;
-    services_configuration = svc;
+    released_configuration = NULL;
+    services_configuration = share_services_configuration(svc);
     server_configuration = svr;
     
     if (svr->cache_validity > 0) {
@@ -129,15 +168,28 @@ Rok4Server::Rok4Server(ServerConfiguration* svr, ServicesConfiguration* svc) {
     if (svr->cache_size > 0) {
         IndexCache::setCacheSize(svr->cache_size);
     }
+    TileCache::configure((size_t) svr->tile_cache_size * 1024 * 1024, svr->tile_cache_shards);
+    RenderPool::configure(svr->map_threads_count, svr->map_threads_per_request, svr->map_band_height);
+    UpstreamClient::configure(svr->external_timeout, svr->external_max_host_connections, svr->external_hedge_delay, svr->external_cache_ttl, svr->external_cache_size);
+    if (! AccessLog::configure(svr->access_log_output, svr->access_log_file, svr->access_log_buffer_size, svr->access_log_flush_interval)) {
+        BOOST_LOG_TRIVIAL(error) << "Journal d'accès désactivé";
+    }
+    Trace::configure(svr->server_timing, svr->slow_request_threshold);
 
     threads = std::vector<pthread_t>(server_configuration->get_threads_count());
+    acceptors = std::vector<pthread_t>(server_configuration->get_acceptors_count());
+    queue = NULL;
 
     running = false;
 }
 
 Rok4Server::~Rok4Server() {
+    RenderPool::stop();
+    UpstreamClient::stop();
+    AccessLog::stop();
+    if (queue != NULL) delete queue;
     delete server_configuration;
-    delete services_configuration;
+    delete_services_configuration(std::atomic_exchange(&services_configuration, std::shared_ptr<ServicesConfiguration>()));
 }
 
 void Rok4Server::initialize_fcgi() {
@@ -146,18 +198,29 @@ void Rok4Server::initialize_fcgi() {
     sock = FCGX_OpenSocket(server_configuration->socket.c_str(), server_configuration->backlog);
 }
 
-void Rok4Server::run(sig_atomic_t signal_pending) {
+void Rok4Server::run() {
+    if (queue != NULL) delete queue;
+    queue = new RequestQueue(server_configuration->get_queue_size());
+
     running = true;
 
+    // Les emplacements de suivi existent avant que les threads ne s'y enregistrent
+    Process::init_threads(threads.size());
+
     for (int i = 0; i < threads.size(); i++) {
         pthread_create(&(threads[i]), NULL, Rok4Server::thread_loop, (void*)this);
-	    Process::add(threads[i]);
     }
 
-    if (signal_pending != 0) {
-        raise(signal_pending);
+    for (int i = 0; i < acceptors.size(); i++) {
+        pthread_create(&(acceptors[i]), NULL, Rok4Server::accept_loop, (void*)this);
     }
 
+    // Les threads d'acceptation s'arrêtent en premier, les threads de traitement terminent ensuite les requêtes déjà acceptées
+    for (int i = 0; i < acceptors.size(); i++)
+        pthread_join(acceptors[i], NULL);
+
+    queue->close();
+
     for (int i = 0; i < threads.size(); i++)
         pthread_join(threads[i], NULL);
 }
@@ -165,18 +228,49 @@ void Rok4Server::run(sig_atomic_t signal_pending) {
 void Rok4Server::terminate() {
     running = false;
 
-    // Terminate FCGI Thread
-    for (int i = 0; i < threads.size(); i++) {
-        pthread_kill(threads[i], SIGQUIT);
+    // Interruption des threads bloqués dans FCGX_Accept_r. Ceux en attente d'une place dans la file
+    // en obtiendront une au fur et à mesure du traitement, la file n'est fermée qu'une fois qu'ils sont tous arrêtés
+    for (int i = 0; i < acceptors.size(); i++) {
+        pthread_kill(acceptors[i], SIGQUIT);
     }
 }
 
 /******************* GETTERS / SETTERS *****************/
 
-ServicesConfiguration* Rok4Server::get_services_configuration() { return services_configuration; }
+std::shared_ptr<ServicesConfiguration> Rok4Server::get_services_configuration() { return std::atomic_load(&services_configuration); }
+
+std::shared_ptr<ServicesConfiguration> Rok4Server::share_services_configuration(ServicesConfiguration* svc) {
+    return std::shared_ptr<ServicesConfiguration>(svc, [this](ServicesConfiguration* s) {
+        std::lock_guard<std::mutex> lock(release_mtx);
+        released_configuration = s;
+        release_cv.notify_all();
+    });
+}
+
+void Rok4Server::delete_services_configuration(std::shared_ptr<ServicesConfiguration> old) {
+    if (! old) {
+        return;
+    }
+
+    ServicesConfiguration* svc = old.get();
+
+    // Plus aucune requête ne peut obtenir l'ancienne configuration, on attend que celles qui l'utilisent aient fini
+    old.reset();
+    std::unique_lock<std::mutex> lock(release_mtx);
+    release_cv.wait(lock, [this, svc] { return released_configuration == svc; });
+    released_configuration = NULL;
+    lock.unlock();
+
+    delete svc;
+}
+
+void Rok4Server::swap_services_configuration(ServicesConfiguration* svc) {
+    delete_services_configuration(std::atomic_exchange(&services_configuration, share_services_configuration(svc)));
+}
 ServerConfiguration* Rok4Server::get_server_configuration() { return server_configuration; }
 
 std::vector<pthread_t>& Rok4Server::get_threads() {return threads;}
+std::vector<pthread_t>& Rok4Server::get_acceptors() {return acceptors;}
 
 int Rok4Server::get_fcgi_socket() { return sock; }
 void Rok4Server::set_fcgi_socket(int sockFCGI) { sock = sockFCGI; }
@@ -54,6 +54,9 @@ class Server;
 #include <pthread.h>
 #include <map>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
 
 #include "configurations/Server.h"
 #include "configurations/Services.h"
@@ -62,6 +65,7 @@ class Server;
 #include <rok4/utils/IndexCache.h>
 
 #include "core/Request.h"
+#include "core/RequestQueue.h"
 
 #include "config.h"
 
@@ -80,11 +84,23 @@ class Rok4Server {
 
 private:
     /**
-     * \~french \brief Liste des processus léger
-     * \~english \brief Threads liste
+     * \~french \brief Liste des processus léger de traitement des requêtes
+     * \~english \brief Request processing threads liste
      */
     std::vector<pthread_t> threads;
 
+    /**
+     * \~french \brief Liste des processus léger d'acceptation des connexions FastCGI
+     * \~english \brief FastCGI connections accepting threads liste
+     */
+    std::vector<pthread_t> acceptors;
+
+    /**
+     * \~french \brief File des requêtes acceptées, en attente de traitement
+     * \~english \brief Accepted requests queue, waiting for processing
+     */
+    RequestQueue* queue;
+
     /**
      * \~french \brief Défini si le serveur est en cours d'éxécution
      * \~english \brief Define whether the server is running
@@ -98,10 +114,38 @@ private:
     int sock;
 
     /**
-     * \~french \brief Configurations des services
-     * \~english \brief Services configuration
+     * \~french
+     * \brief Configurations des services
+     * \details Accédée uniquement de manière atomique (std::atomic_load / std::atomic_exchange), pour pouvoir être remplacée à chaud
+     * \~english
+     * \brief Services configuration
+     * \details Only accessed atomically (std::atomic_load / std::atomic_exchange), to be replaced while running
+     */
+    std::shared_ptr<ServicesConfiguration> services_configuration;
+
+    /**
+     * \~french
+     * \brief Dernière configuration des services libérée par tous ses utilisateurs, à supprimer
+     * \details Le dernier pointeur partagé ne la supprime pas, il la dépose ici et réveille le thread qui l'a remplacée
+     * \~english
+     * \brief Last services configuration released by all its users, to delete
+     * \details Last shared pointer does not delete it, it drops it here and wakes up the thread which replaced it
+     */
+    ServicesConfiguration* released_configuration;
+    std::mutex release_mtx;
+    std::condition_variable release_cv;
+
+    /**
+     * \~french \brief Pointeur partagé vers une configuration, signalant sa libération
+     * \~english \brief Shared pointer to a configuration, notifying its release
+     */
+    std::shared_ptr<ServicesConfiguration> share_services_configuration ( ServicesConfiguration* svc ) ;
+
+    /**
+     * \~french \brief Attend qu'une configuration retirée soit libérée par toutes les requêtes, puis la supprime
+     * \~english \brief Wait for a withdrawn configuration to be released by all requests, then delete it
      */
-    ServicesConfiguration* services_configuration;
+    void delete_services_configuration ( std::shared_ptr<ServicesConfiguration> old ) ;
 
     /**
      * \~french \brief Configuration du serveur
@@ -111,22 +155,48 @@ private:
 
     /**
      * \~french
-     * \brief Boucle principale exécutée par chaque thread à l'écoute des requêtes des utilisateurs.
+     * \brief Boucle exécutée par chaque thread d'acceptation
+     * \details Les connexions FastCGI sont acceptées et leurs paramètres lus, puis la requête est déposée dans la file. Aucun traitement n'est fait ici, pour qu'une lecture lente sur le stockage ne bloque pas l'acceptation.
      * \param[in] arg pointeur vers l'instance de Rok4Server
-     * \return true si présent
      * \~english
-     * \brief Main event loop executed by each thread, listening to user request
+     * \brief Loop executed by each acceptor thread
+     * \details FastCGI connections are accepted and their parameters read, then the request is pushed into the queue. No processing is done here, so that a slow storage read does not block accepting.
+     * \param[in] arg pointer to the Rok4Server instance
+     */
+    static void* accept_loop ( void* arg );
+
+    /**
+     * \~french
+     * \brief Boucle principale exécutée par chaque thread de traitement, consommant la file des requêtes
+     * \param[in] arg pointeur vers l'instance de Rok4Server
+     * \~english
+     * \brief Main loop executed by each processing thread, consuming the requests queue
      * \param[in] arg pointer to the Rok4Server instance
-     * \return true if present
      */
     static void* thread_loop ( void* arg );
 
 public:
     /**
-     * \~french Retourne la configuration des services
-     * \~english Return the services configurations
+     * \~french
+     * \brief Retourne la configuration des services
+     * \details La configuration reste valide tant que le pointeur retourné est conservé, même si elle est remplacée entre temps
+     * \~english
+     * \brief Return the services configurations
+     * \details Configuration stays valid as long as returned pointer is kept, even if it is replaced in the meantime
+     */
+    std::shared_ptr<ServicesConfiguration> get_services_configuration() ;
+
+    /**
+     * \~french
+     * \brief Remplace la configuration des services
+     * \details La nouvelle configuration est publiée immédiatement. L'appel rend la main une fois l'ancienne configuration libérée par toutes les requêtes qui l'utilisaient encore, et supprimée.
+     * \param[in] svc nouvelle configuration des services, dont le serveur devient propriétaire
+     * \~english
+     * \brief Replace the services configuration
+     * \details New configuration is published immediately. Call returns once the old configuration has been released by all the requests still using it, and deleted.
+     * \param[in] svc new services configuration, owned by the server
      */
-    ServicesConfiguration* get_services_configuration() ;
+    void swap_services_configuration ( ServicesConfiguration* svc ) ;
     /**
      * \~french Retourne la configuration du serveur
      * \~english Return the server configuration
@@ -139,13 +209,19 @@ public:
      */
     std::vector<pthread_t>& get_threads() ;
 
+    /**
+     * \~french Retourne la liste des threads d'acceptation
+     * \~english Return the acceptor threads list
+     */
+    std::vector<pthread_t>& get_acceptors() ;
+
     /**
      * \~french
      * \brief Lancement des threads du serveur
      * \~english
      * \brief Start server's thread
      */
-    void run(sig_atomic_t signal_pending = 0);
+    void run();
     /**
      * \~french
      * \brief Initialise le socket FastCGI
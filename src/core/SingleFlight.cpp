@@ -0,0 +1,134 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/SingleFlight.cpp
+ ** \~french
+ * \brief Implémentation de la classe SingleFlight
+ ** \~english
+ * \brief Implements classe SingleFlight
+ */
+
+#include <boost/log/trivial.hpp>
+
+#include "core/SingleFlight.h"
+
+std::mutex SingleFlight::mtx;
+std::unordered_map<std::string, std::shared_ptr<SingleFlight::Call> > SingleFlight::calls;
+std::atomic<unsigned long> SingleFlight::coalesced(0);
+
+std::shared_ptr<const TileCache::Entry> SingleFlight::run(const std::string& key, Computation compute, std::string* error, bool* leader) {
+
+    std::shared_ptr<Call> call;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+
+        auto it = calls.find(key);
+        if (it != calls.end()) {
+            // Un calcul identique est en cours, on attend son résultat
+            call = it->second;
+            coalesced++;
+            call->cv.wait(lock, [&call] { return call->done; });
+
+            *leader = false;
+
+            if (call->message) {
+                // Chaque appelant envoie et supprime son propre message
+                throw new MessageDataStream(*call->message);
+            }
+            if (call->exception) {
+                std::rethrow_exception(call->exception);
+            }
+
+            *error = call->error;
+            return call->entry;
+        }
+
+        call = std::make_shared<Call>();
+        call->done = false;
+        calls.emplace(key, call);
+    }
+
+    *leader = true;
+
+    std::shared_ptr<const TileCache::Entry> entry;
+    try {
+        entry = compute(error);
+    } catch (MessageDataStream* m) {
+        // Les appelants en attente ne doivent pas rester bloqués, ils échouent de la même manière
+        fail(key, call, std::exception_ptr(), std::make_shared<const MessageDataStream>(*m));
+        throw;
+    } catch (...) {
+        fail(key, call, std::current_exception(), std::shared_ptr<const MessageDataStream>());
+        throw;
+    }
+
+    finish(key, call, entry, *error);
+    return entry;
+}
+
+void SingleFlight::finish(const std::string& key, std::shared_ptr<Call> call, std::shared_ptr<const TileCache::Entry> entry, std::string error) {
+    std::lock_guard<std::mutex> lock(mtx);
+    call->entry = entry;
+    call->error = error;
+    call->done = true;
+    calls.erase(key);
+    call->cv.notify_all();
+}
+
+void SingleFlight::fail(const std::string& key, std::shared_ptr<Call> call, std::exception_ptr exception, std::shared_ptr<const MessageDataStream> message) {
+    std::lock_guard<std::mutex> lock(mtx);
+    call->exception = exception;
+    call->message = message;
+    call->done = true;
+    calls.erase(key);
+    call->cv.notify_all();
+}
+
+json11::Json SingleFlight::to_json() {
+    size_t pending;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending = calls.size();
+    }
+
+    return json11::Json::object {
+        { "pending", (double) pending },
+        { "coalesced", (double) coalesced.load() }
+    };
+}
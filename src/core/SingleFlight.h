@@ -0,0 +1,164 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/SingleFlight.h
+ ** \~french
+ * \brief Définition de la classe SingleFlight
+ ** \~english
+ * \brief Define classe SingleFlight
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <rok4/thirdparty/json11.hpp>
+
+#include "core/DataStreams.h"
+#include "core/TileCache.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Regroupement des calculs identiques simultanés
+ * \details Pour une clé donnée (requête normalisée), le premier appelant calcule la réponse encodée. Les appelants suivants, arrivés pendant ce calcul, l'attendent et partagent le même tampon immuable.
+ *
+ * Si le calcul lève une exception, elle est levée à nouveau chez chaque appelant en attente (un message d'erreur étant copié pour chacun), pour qu'un échec ne soit pas confondu avec une réponse vide.
+ * \~english
+ * \brief Coalescing of identical concurrent computations
+ * \details For a given key (normalized request), the first caller computes the encoded response. Following callers, arrived during this computation, wait for it and share the same immutable buffer.
+ *
+ * If computation throws an exception, it is thrown again to each waiting caller (an error message being copied for each one), so that a failure is not mistaken for an empty response.
+ */
+class SingleFlight {
+
+public:
+
+    /**
+     * \~french
+     * \brief Calcul d'une réponse encodée
+     * \details Retourne une réponse nulle en cas d'erreur, le message étant alors renseigné
+     * \~english
+     * \brief Encoded response computation
+     * \details Return a null response if error, message is then filled
+     */
+    typedef std::function<std::shared_ptr<const TileCache::Entry> (std::string* error)> Computation;
+
+private:
+
+    struct Call {
+        std::condition_variable cv;
+        bool done;
+        std::shared_ptr<const TileCache::Entry> entry;
+        std::string error;
+
+        /**
+         * \~french \brief Exception levée par le calcul, nulle si aucune
+         * \~english \brief Exception thrown by computation, null if none
+         */
+        std::exception_ptr exception;
+
+        /**
+         * \~french \brief Copie du message d'erreur levé par le calcul, le message original appartenant à l'appelant qui a calculé
+         * \~english \brief Copy of error message thrown by computation, original message belonging to the computing caller
+         */
+        std::shared_ptr<const MessageDataStream> message;
+    };
+
+    static std::mutex mtx;
+
+    /**
+     * \~french \brief Calculs en cours, par clé
+     * \~english \brief Pending computations, by key
+     */
+    static std::unordered_map<std::string, std::shared_ptr<Call> > calls;
+
+    /**
+     * \~french \brief Nombre d'appels ayant réutilisé un calcul en cours
+     * \~english \brief Calls count that reused a pending computation
+     */
+    static std::atomic<unsigned long> coalesced;
+
+    static void finish(const std::string& key, std::shared_ptr<Call> call, std::shared_ptr<const TileCache::Entry> entry, std::string error);
+
+    /**
+     * \~french \brief Termine un calcul en échec
+     * \~english \brief End a failed computation
+     */
+    static void fail(const std::string& key, std::shared_ptr<Call> call, std::exception_ptr exception, std::shared_ptr<const MessageDataStream> message);
+
+public:
+
+    /**
+     * \~french
+     * \brief Calcule la réponse, ou attend le calcul en cours pour la même clé
+     * \param[in] key Clé de la requête normalisée
+     * \param[in] compute Calcul de la réponse
+     * \param[out] error Message d'erreur si la réponse est nulle
+     * \param[out] leader Vrai si le calcul a été fait par cet appel
+     * \return Réponse encodée, nulle en cas d'erreur
+     * \throw Exception levée par le calcul, y compris lorsqu'il a été fait par un autre appel
+     * \~english
+     * \brief Compute the response, or wait for the pending computation with the same key
+     * \param[in] key Normalized request key
+     * \param[in] compute Response computation
+     * \param[out] error Error message if response is null
+     * \param[out] leader True if computation was made by this call
+     * \return Encoded response, null if error
+     * \throw Exception thrown by computation, even if made by another call
+     */
+    static std::shared_ptr<const TileCache::Entry> run(const std::string& key, Computation compute, std::string* error, bool* leader);
+
+    static unsigned long get_coalesced() { return coalesced.load(); }
+
+    /**
+     * \~french
+     * \brief Export JSON des compteurs
+     * \~english
+     * \brief JSON export of counters
+     */
+    static json11::Json to_json();
+};
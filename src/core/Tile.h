@@ -47,23 +47,31 @@
 #include <rok4/datastream/TiffPackBitsEncoder.h>
 #include <rok4/datastream/TiffRawEncoder.h>
 
+#include <chrono>
 #include <iomanip>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "configurations/Layer.h"
+#include "core/DataStreams.h"
+#include "core/Metrics.h"
+#include "core/Request.h"
+#include "core/SingleFlight.h"
+#include "core/TileCache.h"
+#include "core/WarpedImage.h"
 
 namespace Tile {
     
 /**
  * \~french
- * \brief Retourne la tuile demandée
+ * \brief Calcule la tuile demandée
  * \return Flux de donnée
  * \~english
- * \brief Give the asked tile
+ * \brief Compute the asked tile
  * \return Data stream
  */
-static DataStream* get_tile(ServicesConfiguration* services, Layer* layer, TileMatrixSet* tms, TileMatrix* tm, int column, int row, std::string format, Style* style) {
+static DataStream* compute_tile(ServicesConfiguration* services, Layer* layer, TileMatrixSet* tms, TileMatrix* tm, int column, int row, std::string format, Style* style) {
     // Traitement de la requête
 
     if (tms->get_id() == layer->get_pyramid()->get_tms()->get_id()) {
@@ -76,10 +84,16 @@ static DataStream* get_tile(ServicesConfiguration* services, Layer* layer, TileM
         }
 
         if (layer->is_raster() && layer->get_pyramid()->get_channels() == 1 && format == "image/png" && style->get_palette() && !style->get_palette()->is_empty()) {
-            return new DataStreamFromDataSource(new PaletteDataSource(d, style->get_palette()));
-        } else {
-            return new DataStreamFromDataSource(d);
+            d = new PaletteDataSource(d, style->get_palette());
         }
+
+        // La tuile est lue une seule fois dans le stockage et envoyée sans copie intermédiaire
+        DataSourceDataStream* stream = new DataSourceDataStream(d);
+        if (! stream->is_ok()) {
+            delete stream;
+            return NULL;
+        }
+        return stream;
     } else {
         // TMS d'interrogation à la demande, forcément du raster
 
@@ -92,7 +106,16 @@ static DataStream* get_tile(ServicesConfiguration* services, Layer* layer, TileM
         bool crs_equals = services->are_crs_equals(layer->get_pyramid()->get_tms()->get_crs()->get_proj_code(), crs->get_proj_code());
 
         // On se donne maxium 3 tuiles sur 3 dans la pyramide source pour calculer cette tuile
-        Image* image = layer->get_pyramid()->getbbox(3, 3, bbox, width, height, crs, crs_equals, layer->get_resampling(), 0);
+        Image* image = NULL;
+
+        // Reprojection par grille de contrôle, la reprojection exacte reste utilisée si elle n'est pas applicable
+        if (! crs_equals && services->get_tile_reprojection_tolerance() > 0) {
+            image = WarpedImage::create(layer->get_pyramid(), 3, 3, bbox, width, height, crs, layer->get_resampling(), 0, services->get_tile_reprojection_tolerance());
+        }
+
+        if (image == NULL) {
+            image = layer->get_pyramid()->getbbox(3, 3, bbox, width, height, crs, crs_equals, layer->get_resampling(), 0);
+        }
 
         if (image == NULL) {
             BOOST_LOG_TRIVIAL(warning) << "Cannot process the tile in a non native TMS";
@@ -153,4 +176,158 @@ static DataStream* get_tile(ServicesConfiguration* services, Layer* layer, TileM
     BOOST_LOG_TRIVIAL(error) << "On ne devrait pas passer par là";
     return NULL;
 }
+
+/**
+ * \~french
+ * \brief ETag d'une tuile du TMS natif, calculé sans lecture de la tuile
+ * \details L'ETag identifie la tuile dans le stockage (dalle et indices dans le niveau de la pyramide) et le rendu demandé (style et format, pour l'application d'une palette). Une tuile du TMS natif n'est modifiée qu'avec sa dalle, les requêtes conditionnelles sont ainsi traitées avant toute lecture.
+ * \return ETag, vide si le niveau n'existe pas
+ * \~english
+ * \brief Native TMS tile's ETag, computed without reading the tile
+ * \details ETag identifies the tile in the storage (slab and indices in the pyramid's level) and the asked rendering (style and format, to apply a palette). A native TMS tile is modified only with its slab, conditional requests are thus handled before any read.
+ * \return ETag, empty if level does not exist
+ */
+static std::string get_native_etag(Layer* layer, TileMatrix* tm, int column, int row, std::string format, Style* style) {
+    Level* level = layer->get_pyramid()->get_level(tm->get_id());
+    if (level == NULL) {
+        return "";
+    }
+
+    std::ostringstream identity;
+    identity << level->get_path(column, row) << '\n' << level->get_id() << '\n' << column << '\n' << row << '\n' << format << '\n' << (style == NULL ? "" : style->get_identifier());
+    return TileCache::get_etag(identity.str());
+}
+
+/**
+ * \~french
+ * \brief Réponse pour une tuile encodée
+ * \details L'ETag de la tuile et les en-têtes de cache de la couche sont ajoutés à la réponse. Si la requête est conditionnelle et que l'ETag correspond, la réponse est une 304 sans contenu.
+ * \~english
+ * \brief Response for an encoded tile
+ * \details Tile's ETag and layer's cache headers are added to the response. If request is conditional and ETag matches, response is a 304 without content.
+ */
+static DataStream* get_response(Request* req, Layer* layer, std::shared_ptr<const TileCache::Entry> entry) {
+    req->add_response_header("ETag", entry->etag);
+    layer->get_tile_cache_policy().add_headers(req);
+
+    if (req->match_etag(entry->etag)) {
+        return new NotModifiedDataStream();
+    }
+
+    return new TileCacheDataStream(entry);
+}
+
+/**
+ * \~french
+ * \brief Retourne la tuile demandée encodée, depuis le cache des tuiles si elle y est présente
+ * \details Une tuile calculée est entièrement lue puis ajoutée au cache. Les demandes simultanées d'une même tuile absente du cache ne donnent lieu qu'à un seul calcul.
+ * \return Tuile encodée, vide si elle n'existe pas
+ * \~english
+ * \brief Give the asked encoded tile, from the tiles cache if present
+ * \details A computed tile is entirely read then added to cache. Concurrent requests of the same tile missing from cache lead to only one computation.
+ * \return Encoded tile, empty if it does not exist
+ */
+static std::shared_ptr<const TileCache::Entry> get_entry(Request* req, ServicesConfiguration* services, Layer* layer, TileMatrixSet* tms, TileMatrix* tm, int column, int row, std::string format, Style* style) {
+
+    std::string key = TileCache::get_key(layer->get_id(), tms->get_id(), tm->get_id(), column, row, (style == NULL ? "" : style->get_identifier()), format);
+
+    std::shared_ptr<const TileCache::Entry> entry;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_CACHE);
+        entry = TileCache::get(key);
+    }
+    if (entry) {
+        req->cache_outcome = AccessLog::CACHE_HIT;
+        return entry;
+    }
+
+    unsigned long generation = TileCache::get_generation();
+
+    // La couche figée par la requête a pu être remplacée avant la lecture de la génération, la tuile n'est alors pas mise en cache
+    bool current = services->are_pinned_layers_current();
+
+    // Seules les requêtes voyant la même version des couches partagent un calcul
+    std::ostringstream flight_key;
+    flight_key << "tile\n" << services << '\n' << services->get_pinned_layers_version() << '\n' << key;
+
+    std::string error;
+    bool leader;
+    std::chrono::steady_clock::time_point waiting = std::chrono::steady_clock::now();
+    entry = SingleFlight::run(flight_key.str(), [&](std::string* error) -> std::shared_ptr<const TileCache::Entry> {
+        Trace::Timer timer(&req->trace, Trace::PHASE_RENDER);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DataStream* d = compute_tile(services, layer, tms, tm, column, row, format, style);
+        if (d == NULL) {
+            return std::shared_ptr<const TileCache::Entry>();
+        }
+
+        // Dans le TMS natif, la tuile est lue telle quelle : la durée est celle de la lecture dans le stockage, l'ETag n'est pas une empreinte du contenu
+        if (tms->get_id() == layer->get_pyramid()->get_tms()->get_id()) {
+            std::shared_ptr<const TileCache::Entry> computed(TileCache::read_entry(d, layer->get_id(), get_native_etag(layer, tm, column, row, format, style)));
+            Metrics::record_storage_read(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            return computed;
+        }
+        return std::shared_ptr<const TileCache::Entry>(TileCache::read_entry(d, layer->get_id()));
+    }, &error, &leader);
+
+    if (! leader) {
+        req->trace.add(Trace::PHASE_WAIT, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waiting).count());
+    }
+
+    if (TileCache::is_enabled()) {
+        req->cache_outcome = (leader ? AccessLog::CACHE_MISS : AccessLog::CACHE_SHARED);
+    }
+
+    if (entry && leader && current) {
+        TileCache::add(key, entry, generation);
+    }
+
+    return entry;
+}
+
+/**
+ * \~french
+ * \brief Retourne la tuile demandée, depuis le cache des tuiles si elle y est présente
+ * \details Les requêtes conditionnelles (If-None-Match) sont traitées à partir de l'ETag, sans envoi de la tuile. Dans le TMS natif, l'ETag est connu avant la lecture de la tuile : une requête conditionnelle satisfaite ne donne lieu à aucune lecture dans le stockage. Lorsque le cache des tuiles est désactivé, une tuile du TMS natif est transmise directement depuis le stockage, sans copie intermédiaire. Une tuile calculée dans un autre TMS a pour ETag l'empreinte de son contenu.
+ * \return Flux de donnée
+ * \~english
+ * \brief Give the asked tile, from the tiles cache if present
+ * \details Conditional requests (If-None-Match) are answered from the ETag, without sending the tile. In the native TMS, ETag is known before reading the tile : a satisfied conditional request leads to no storage read. When tiles cache is disabled, a native TMS tile is sent directly from the storage, without intermediate copy. A tile computed in another TMS has its content's hash as ETag.
+ * \return Data stream
+ */
+static DataStream* get_tile(Request* req, ServicesConfiguration* services, Layer* layer, TileMatrixSet* tms, TileMatrix* tm, int column, int row, std::string format, Style* style) {
+
+    if (tms->get_id() == layer->get_pyramid()->get_tms()->get_id()) {
+        std::string etag = get_native_etag(layer, tm, column, row, format, style);
+
+        if (req->match_etag(etag)) {
+            req->add_response_header("ETag", etag);
+            layer->get_tile_cache_policy().add_headers(req);
+            return new NotModifiedDataStream();
+        }
+
+        if (! TileCache::is_enabled()) {
+            DataStream* d;
+            {
+                Trace::Timer timer(&req->trace, Trace::PHASE_RENDER);
+                d = compute_tile(services, layer, tms, tm, column, row, format, style);
+            }
+            if (d == NULL) {
+                return NULL;
+            }
+            req->add_response_header("ETag", etag);
+            layer->get_tile_cache_policy().add_headers(req);
+            return d;
+        }
+    }
+
+    std::shared_ptr<const TileCache::Entry> entry = get_entry(req, services, layer, tms, tm, column, row, format, style);
+
+    if (! entry) {
+        // Lecture dans le stockage ou reprojection en échec : seules les tuiles hors limites reçoivent une 404 pouvant être mise en cache
+        return NULL;
+    }
+
+    return get_response(req, layer, entry);
+}
 };  // namespace Tile
@@ -0,0 +1,249 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/TileCache.cpp
+ ** \~french
+ * \brief Implémentation de la classe TileCache
+ ** \~english
+ * \brief Implements classe TileCache
+ */
+
+#include <cstdio>
+#include <functional>
+#include <boost/log/trivial.hpp>
+
+#include "core/TileCache.h"
+
+std::vector<std::unique_ptr<TileCache::Shard> > TileCache::shards;
+size_t TileCache::shard_max_bytes = 0;
+std::atomic<unsigned long> TileCache::generation(0);
+std::atomic<unsigned long> TileCache::hits(0);
+std::atomic<unsigned long> TileCache::misses(0);
+std::atomic<unsigned long> TileCache::evictions(0);
+
+void TileCache::configure(size_t max_bytes, int shards_count) {
+    shards.clear();
+
+    if (max_bytes == 0 || shards_count <= 0) {
+        BOOST_LOG_TRIVIAL(info) << "Cache des tuiles désactivé";
+        return;
+    }
+
+    shard_max_bytes = max_bytes / shards_count;
+    for (int i = 0; i < shards_count; i++) {
+        Shard* s = new Shard();
+        s->bytes = 0;
+        shards.push_back(std::unique_ptr<Shard>(s));
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Cache des tuiles de " << max_bytes << " octets, en " << shards_count << " sections";
+}
+
+std::string TileCache::get_key(std::string layer, std::string tms, std::string tm, int column, int row, std::string style, std::string format) {
+    std::string key;
+    key.reserve(layer.size() + tms.size() + tm.size() + style.size() + format.size() + 32);
+    key.append(layer).push_back('\n');
+    key.append(tms).push_back('\n');
+    key.append(tm).push_back('\n');
+    key.append(std::to_string(column)).push_back('\n');
+    key.append(std::to_string(row)).push_back('\n');
+    key.append(style).push_back('\n');
+    key.append(format);
+    return key;
+}
+
+TileCache::Shard* TileCache::get_shard(const std::string& key) {
+    return shards[std::hash<std::string>()(key) % shards.size()].get();
+}
+
+std::shared_ptr<const TileCache::Entry> TileCache::get(const std::string& key) {
+    if (shards.empty()) {
+        return std::shared_ptr<const Entry>();
+    }
+
+    Shard* s = get_shard(key);
+    std::lock_guard<std::mutex> lock(s->mtx);
+
+    auto it = s->index.find(key);
+    if (it == s->index.end()) {
+        misses++;
+        return std::shared_ptr<const Entry>();
+    }
+
+    // La tuile devient la plus récemment utilisée
+    s->lru.splice(s->lru.begin(), s->lru, it->second);
+    hits++;
+    return it->second->second;
+}
+
+void TileCache::add(const std::string& key, std::shared_ptr<const Entry> entry, unsigned long gen) {
+    if (shards.empty()) {
+        return;
+    }
+
+    size_t size = entry_size(key, *entry);
+    // On ne garde pas une tuile qui occuperait une trop grande part de sa section
+    if (size > shard_max_bytes / 8) {
+        return;
+    }
+
+    Shard* s = get_shard(key);
+    std::lock_guard<std::mutex> lock(s->mtx);
+
+    // Une invalidation a eu lieu pendant le calcul de la tuile
+    if (gen != generation.load()) {
+        return;
+    }
+
+    if (s->index.find(key) != s->index.end()) {
+        return;
+    }
+
+    s->lru.push_front(std::make_pair(key, entry));
+    s->index.emplace(key, s->lru.begin());
+    s->bytes += size;
+
+    while (s->bytes > shard_max_bytes && ! s->lru.empty()) {
+        auto& last = s->lru.back();
+        s->bytes -= entry_size(last.first, *(last.second));
+        s->index.erase(last.first);
+        s->lru.pop_back();
+        evictions++;
+    }
+}
+
+/**
+ * \~french \brief Empreinte FNV-1a 64 bits, poursuivie à partir de hash
+ * \~english \brief 64 bits FNV-1a hash, continued from hash
+ */
+static uint64_t fnv_hash(const std::string& s, uint64_t hash = 14695981039346656037ULL) {
+    for (size_t i = 0; i < s.size(); i++) {
+        hash = (hash ^ (uint8_t) s[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string format_etag(uint64_t hash) {
+    char etag[20];
+    snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long) hash);
+    return etag;
+}
+
+std::string TileCache::get_etag(const std::string& s) {
+    return format_etag(fnv_hash(s));
+}
+
+std::shared_ptr<TileCache::Entry> TileCache::read_entry(DataStream* d, std::string layer, std::string etag) {
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->layer = layer;
+    entry->type = d->get_type();
+    entry->encoding = d->get_encoding();
+    if (d->get_length() != 0) {
+        entry->data.reserve(d->get_length());
+    }
+
+    uint8_t buffer[1 << 16];
+    while (true) {
+        size_t read_size = d->read(buffer, sizeof(buffer));
+        if (read_size == 0) break;
+        entry->data.append((char*) buffer, read_size);
+    }
+    delete d;
+
+    if (! etag.empty()) {
+        entry->etag = etag;
+    } else {
+        // Empreinte du type et du contenu
+        entry->etag = format_etag(fnv_hash(entry->data, fnv_hash(entry->type)));
+    }
+
+    return entry;
+}
+
+void TileCache::invalidate_layer(std::string layer) {
+    if (shards.empty()) {
+        return;
+    }
+
+    BOOST_LOG_TRIVIAL(debug) << "Invalidation du cache des tuiles pour la couche " << layer;
+
+    for (auto& s : shards) {
+        std::lock_guard<std::mutex> lock(s->mtx);
+        generation++;
+        for (auto it = s->lru.begin(); it != s->lru.end(); ) {
+            if (it->second->layer == layer) {
+                s->bytes -= entry_size(it->first, *(it->second));
+                s->index.erase(it->first);
+                it = s->lru.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+}
+
+void TileCache::clean() {
+    for (auto& s : shards) {
+        std::lock_guard<std::mutex> lock(s->mtx);
+        generation++;
+        s->index.clear();
+        s->lru.clear();
+        s->bytes = 0;
+    }
+}
+
+json11::Json TileCache::to_json() {
+    size_t bytes = 0;
+    size_t count = 0;
+    for (auto& s : shards) {
+        std::lock_guard<std::mutex> lock(s->mtx);
+        bytes += s->bytes;
+        count += s->index.size();
+    }
+
+    return json11::Json::object {
+        { "enabled", is_enabled() },
+        { "size", (double) bytes },
+        { "max_size", (double) (shard_max_bytes * shards.size()) },
+        { "tiles", (double) count },
+        { "hits", (double) hits.load() },
+        { "misses", (double) misses.load() },
+        { "evictions", (double) evictions.load() }
+    };
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/TileCache.h
+ ** \~french
+ * \brief Définition des classes TileCache et TileCacheDataStream
+ ** \~english
+ * \brief Define classes TileCache and TileCacheDataStream
+ */
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <string.h>
+
+#include <rok4/thirdparty/json11.hpp>
+
+#include "core/DataStreams.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache mémoire des tuiles encodées
+ * \details Les tuiles sont stockées telles qu'envoyées au client. Le cache est découpé en sections (chacune avec son verrou et sa liste LRU) pour limiter la contention entre les threads de traitement, et borné en octets. Il est configuré une seule fois, au démarrage du serveur, et désactivé si la taille est nulle.
+ * \~english
+ * \brief In memory cache of encoded tiles
+ * \details Tiles are stored as sent to the client. Cache is split into shards (each one with its own lock and LRU list) to limit contention between worker threads, and bounded in bytes. It is configured only once, at server start, and disabled if size is null.
+ */
+class TileCache {
+
+public:
+
+    /**
+     * \~french \brief Tuile encodée
+     * \~english \brief Encoded tile
+     */
+    struct Entry {
+        std::string layer;
+        std::string data;
+        std::string type;
+        std::string encoding;
+        /**
+         * \~french \brief ETag fort, empreinte du contenu et de son type
+         * \~english \brief Strong ETag, content and type hash
+         */
+        std::string etag;
+    };
+
+private:
+
+    struct Shard {
+        std::mutex mtx;
+        std::list<std::pair<std::string, std::shared_ptr<const Entry> > > lru;
+        std::unordered_map<std::string, std::list<std::pair<std::string, std::shared_ptr<const Entry> > >::iterator> index;
+        size_t bytes;
+    };
+
+    /**
+     * \~french \brief Sections du cache, vide si le cache est désactivé
+     * \~english \brief Cache shards, empty if cache is disabled
+     */
+    static std::vector<std::unique_ptr<Shard> > shards;
+
+    /**
+     * \~french \brief Taille maximale d'une section, en octets
+     * \~english \brief Shard max size, in bytes
+     */
+    static size_t shard_max_bytes;
+
+    /**
+     * \~french \brief Génération, incrémentée à chaque invalidation
+     * \details Une tuile calculée avant une invalidation n'est pas ajoutée au cache
+     * \~english \brief Generation, incremented for each invalidation
+     * \details A tile computed before an invalidation is not added to cache
+     */
+    static std::atomic<unsigned long> generation;
+
+    static std::atomic<unsigned long> hits;
+    static std::atomic<unsigned long> misses;
+    static std::atomic<unsigned long> evictions;
+
+    static Shard* get_shard(const std::string& key);
+
+    static size_t entry_size(const std::string& key, const Entry& e) {
+        return key.size() + e.layer.size() + e.data.size() + e.type.size() + e.encoding.size() + e.etag.size() + sizeof(Entry);
+    }
+
+public:
+
+    /**
+     * \~french
+     * \brief Configuration du cache
+     * \param[in] max_bytes Taille maximale du cache en octets, 0 pour le désactiver
+     * \param[in] shards_count Nombre de sections
+     * \~english
+     * \brief Cache configuration
+     * \param[in] max_bytes Cache max size in bytes, 0 to disable it
+     * \param[in] shards_count Shards count
+     */
+    static void configure(size_t max_bytes, int shards_count);
+
+    static bool is_enabled() {
+        return ! shards.empty();
+    }
+
+    /**
+     * \~french
+     * \brief Clé d'une tuile
+     * \details La couche est en tête de clé, suivie d'un séparateur absent des identifiants
+     * \~english
+     * \brief Tile key
+     * \details Layer is at the key's head, followed by a separator missing from identifiers
+     */
+    static std::string get_key(std::string layer, std::string tms, std::string tm, int column, int row, std::string style, std::string format);
+
+    /**
+     * \~french
+     * \brief Recherche d'une tuile
+     * \return Tuile, nulle si absente
+     * \~english
+     * \brief Look for a tile
+     * \return Tile, null if missing
+     */
+    static std::shared_ptr<const Entry> get(const std::string& key);
+
+    /**
+     * \~french
+     * \brief Ajout d'une tuile
+     * \param[in] key Clé de la tuile
+     * \param[in] entry Tuile encodée
+     * \param[in] gen Génération lue avant le calcul de la tuile
+     * \~english
+     * \brief Add a tile
+     * \param[in] key Tile key
+     * \param[in] entry Encoded tile
+     * \param[in] gen Generation read before tile computing
+     */
+    static void add(const std::string& key, std::shared_ptr<const Entry> entry, unsigned long gen);
+
+    /**
+     * \~french
+     * \brief Lecture complète d'un flux en une tuile encodée
+     * \details Le flux est supprimé. Sans ETag fourni, celui-ci est l'empreinte du contenu lu.
+     * \param[in] d Flux à lire
+     * \param[in] layer Identifiant de la couche
+     * \param[in] etag ETag de la tuile, s'il est connu avant la lecture
+     * \~english
+     * \brief Read a whole stream into an encoded tile
+     * \details Stream is deleted. Without provided ETag, it is the hash of the read content.
+     * \param[in] d Stream to read
+     * \param[in] layer Layer's identifier
+     * \param[in] etag Tile's ETag, if known before reading
+     */
+    static std::shared_ptr<Entry> read_entry(DataStream* d, std::string layer, std::string etag = "");
+
+    /**
+     * \~french
+     * \brief ETag calculé par empreinte FNV-1a 64 bits d'une chaîne
+     * \~english
+     * \brief ETag computed with a 64 bits FNV-1a hash of a string
+     */
+    static std::string get_etag(const std::string& s);
+
+    static unsigned long get_generation() {
+        return generation.load();
+    }
+
+    /**
+     * \~french
+     * \brief Supprime les tuiles d'une couche
+     * \~english
+     * \brief Remove tiles of a layer
+     */
+    static void invalidate_layer(std::string layer);
+
+    /**
+     * \~french
+     * \brief Vide le cache
+     * \~english
+     * \brief Empty the cache
+     */
+    static void clean();
+
+    static unsigned long get_hits() { return hits.load(); }
+    static unsigned long get_misses() { return misses.load(); }
+    static unsigned long get_evictions() { return evictions.load(); }
+
+    /**
+     * \~french
+     * \brief Export JSON des compteurs et de l'occupation
+     * \~english
+     * \brief JSON export of counters and occupancy
+     */
+    static json11::Json to_json();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Flux de données lisant une tuile du cache, sans copie préalable
+ * \details La tuile est partagée avec le cache : elle reste valide même si elle en est évincée pendant l'envoi
+ * \~english
+ * \brief Data stream reading a tile from cache, without prior copy
+ * \details Tile is shared with the cache : it remains valid even if evicted during sending
+ */
+class TileCacheDataStream : public ContiguousDataStream {
+private:
+    std::shared_ptr<const TileCache::Entry> entry;
+    size_t pos;
+
+public:
+    TileCacheDataStream ( std::shared_ptr<const TileCache::Entry> e ) : entry ( e ), pos ( 0 ) {}
+
+    size_t read ( uint8_t *buffer, size_t size ) {
+        if ( size > entry->data.size() - pos ) size = entry->data.size() - pos;
+        memcpy ( buffer, entry->data.data() + pos, size );
+        pos += size;
+        return size;
+    }
+    bool eof() {
+        return ( pos == entry->data.size() );
+    }
+    std::string get_type() {
+        return entry->type;
+    }
+    std::string get_encoding() {
+        return entry->encoding;
+    }
+    std::string get_etag() {
+        return entry->etag;
+    }
+    int get_http_status() {
+        return 200;
+    }
+    unsigned int get_length(){
+        return entry->data.size();
+    }
+    const uint8_t* get_data ( size_t& size ) {
+        size = entry->data.size();
+        return ( const uint8_t* ) entry->data.data();
+    }
+};
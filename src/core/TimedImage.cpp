@@ -0,0 +1,67 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+/**
+ * \file core/TimedImage.cpp
+ ** \~french
+ * \brief Implémentation des classes TimedImage et TimedDataStream
+ ** \~english
+ * \brief Implements classes TimedImage and TimedDataStream
+ */
+
+#include "core/TimedImage.h"
+
+TimedImage::TimedImage(Image* image, Trace* t, Trace::ePhase p) :
+    Image(image->get_width(), image->get_height(), image->get_channels(), image->get_bbox()), source(image), trace(t), phase(p), duration(0)
+{ }
+
+TimedImage::~TimedImage() {
+    delete source;
+    // Une image jamais lue (chaîne construite pour valider la requête) n'est pas rapportée
+    if (trace != NULL && duration > 0) {
+        trace->add(phase, duration);
+    }
+}
+
+TimedDataStream::~TimedDataStream() {
+    delete source;
+    if (trace != NULL && duration > 0) {
+        trace->add(phase, duration);
+    }
+}
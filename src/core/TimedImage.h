@@ -0,0 +1,157 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+/**
+ * \file core/TimedImage.h
+ ** \~french
+ * \brief Définition des classes TimedImage et TimedDataStream
+ ** \~english
+ * \brief Define classes TimedImage and TimedDataStream
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include <rok4/datastream/DataStream.h>
+#include <rok4/image/Image.h>
+
+#include "core/Trace.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Image mesurant la durée de lecture des lignes de l'image source
+ * \details La durée propre des appels (durée totale moins celle des images et flux mesurés imbriqués) est cumulée, les lignes pouvant être lues par plusieurs threads, puis ajoutée à la phase de la trace à la destruction de l'image. L'image source est détruite avec elle.
+ * \~english
+ * \brief Image timing lines reading of the source image
+ * \details Calls own duration (total duration minus nested timed images and streams one) is cumulated, lines being possibly read by several threads, then added to trace's phase when image is destroyed. Source image is deleted with it.
+ */
+class TimedImage : public Image {
+
+private:
+
+    Image* source;
+    Trace* trace;
+    Trace::ePhase phase;
+
+    /**
+     * \~french \brief Durée propre cumulée, en nanosecondes
+     * \~english \brief Cumulated own duration, in nanoseconds
+     */
+    std::atomic<int64_t> duration;
+
+    template<typename T>
+    int _getline(T* buffer, int line) {
+        Trace::Section section;
+        int size = source->get_line(buffer, line);
+        duration += section.end();
+        return size;
+    }
+
+public:
+
+    /**
+     * \~french
+     * \brief Crée une image mesurée
+     * \param[in] image Image source, prise en charge
+     * \param[in] t Trace de la requête, doit exister jusqu'à la destruction de l'image
+     * \param[in] p Phase à laquelle attribuer la durée
+     * \~english
+     * \brief Create a timed image
+     * \param[in] image Source image, taken over
+     * \param[in] t Request trace, has to exist until image destruction
+     * \param[in] p Phase to attribute duration to
+     */
+    TimedImage(Image* image, Trace* t, Trace::ePhase p);
+
+    int get_line(uint8_t* buffer, int line) { return _getline(buffer, line); }
+    int get_line(uint16_t* buffer, int line) { return _getline(buffer, line); }
+    int get_line(float* buffer, int line) { return _getline(buffer, line); }
+
+    virtual ~TimedImage();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Flux mesurant la durée de lecture du flux source
+ * \details Utilisé pour l'encodage : la durée propre des lectures exclut celle des images mesurées qu'il lit. Elle est ajoutée à la phase de la trace à la destruction du flux, le flux source est détruit avec lui.
+ * \~english
+ * \brief Stream timing source stream reading
+ * \details Used for encoding : reading own duration excludes the one of timed images it reads. It is added to trace's phase when stream is destroyed, source stream is deleted with it.
+ */
+class TimedDataStream : public DataStream {
+
+private:
+
+    DataStream* source;
+    Trace* trace;
+    Trace::ePhase phase;
+    int64_t duration;
+
+public:
+
+    TimedDataStream(DataStream* stream, Trace* t, Trace::ePhase p) : source(stream), trace(t), phase(p), duration(0) { }
+
+    size_t read(uint8_t* buffer, size_t size) {
+        Trace::Section section;
+        size_t read_size = source->read(buffer, size);
+        duration += section.end();
+        return read_size;
+    }
+    bool eof() {
+        return source->eof();
+    }
+    std::string get_type() {
+        return source->get_type();
+    }
+    std::string get_encoding() {
+        return source->get_encoding();
+    }
+    int get_http_status() {
+        return source->get_http_status();
+    }
+    unsigned int get_length() {
+        return source->get_length();
+    }
+
+    ~TimedDataStream();
+};
@@ -0,0 +1,99 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/Trace.cpp
+ ** \~french
+ * \brief Implémentation de la classe Trace
+ ** \~english
+ * \brief Implements classe Trace
+ */
+
+#include <stdio.h>
+
+#include "core/Trace.h"
+
+const char* const Trace::phases_names[Trace::PHASES_COUNT] = { "parse", "lookup", "cache", "build", "render", "style", "merge", "encode", "wait", "send" };
+
+thread_local int64_t Trace::nested = 0;
+
+bool Trace::header_enabled = false;
+int64_t Trace::slow_threshold_ns = 0;
+
+Trace::Trace() : start(std::chrono::steady_clock::now()), measured(0) {
+    for (int p = 0; p < PHASES_COUNT; p++) {
+        durations[p] = 0;
+    }
+}
+
+int64_t Trace::get_elapsed() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Trace::append_server_timing(std::string& out) const {
+    char value[64];
+    for (int p = 0; p < PHASES_COUNT; p++) {
+        if (measured & (1u << p)) {
+            snprintf(value, sizeof(value), "%s;dur=%.3f, ", phases_names[p], durations[p] / 1e6);
+            out.append(value);
+        }
+    }
+    snprintf(value, sizeof(value), "total;dur=%.3f", get_elapsed() / 1e6);
+    out.append(value);
+}
+
+std::string Trace::to_string(int64_t total_ns) const {
+    std::string out;
+    char value[64];
+    int64_t other = total_ns;
+    for (int p = 0; p < PHASES_COUNT; p++) {
+        if (measured & (1u << p)) {
+            snprintf(value, sizeof(value), "%s=%.3fms ", phases_names[p], durations[p] / 1e6);
+            out.append(value);
+            other -= durations[p];
+        }
+    }
+    snprintf(value, sizeof(value), "other=%.3fms", (other < 0 ? 0 : other) / 1e6);
+    out.append(value);
+    return out;
+}
+
+void Trace::configure(bool header, int slow_threshold) {
+    header_enabled = header;
+    slow_threshold_ns = (int64_t) slow_threshold * 1000000;
+}
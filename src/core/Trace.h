@@ -0,0 +1,246 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/Trace.h
+ ** \~french
+ * \brief Définition de la classe Trace
+ ** \~english
+ * \brief Define classe Trace
+ */
+
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <string>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Durées des phases du traitement d'une requête
+ * \details Une trace est portée par la requête et les phases sont mesurées par des chronomètres créés sur la pile, sans allocation. Les durées peuvent être rapportées dans l'en-tête de réponse Server-Timing et les requêtes plus longues qu'un seuil sont journalisées avec le détail des phases.
+ *
+ * Les lectures, décodages, rééchantillonnages, styles et fusions d'une image sont faits à la demande, ligne par ligne, lors de son encodage. Ils sont distingués par des décorateurs mesurant les appels de leur image ou flux (voir TimedImage et TimedDataStream). Chaque mesure est exclusive : la durée des sections imbriquées dans le même thread en est déduite, une phase n'est ainsi jamais comptée deux fois. Avec le rendu parallèle, les durées des bandes calculées par les threads du pool sont cumulées et peuvent dépasser la durée écoulée.
+ * \~english
+ * \brief Durations of a request processing phases
+ * \details A trace is held by the request and phases are measured with timers created on the stack, without allocation. Durations can be reported in the Server-Timing response header and requests longer than a threshold are logged with phases details.
+ *
+ * Image reading, decoding, resampling, styling and merging are done on demand, line by line, while encoding. They are told apart by decorators timing calls to their image or stream (see TimedImage and TimedDataStream). Each measure is exclusive : duration of sections nested in the same thread is deducted, a phase is thus never counted twice. With parallel rendering, durations of bands computed by pool threads are cumulated and can exceed the elapsed duration.
+ */
+class Trace {
+    friend class CppUnitTrace;
+
+public:
+
+    /**
+     * \~french \brief Phases mesurées
+     * \~english \brief Measured phases
+     */
+    enum ePhase {
+        PHASE_PARSE,
+        PHASE_LOOKUP,
+        PHASE_CACHE,
+        PHASE_BUILD,
+        PHASE_RENDER,
+        PHASE_STYLE,
+        PHASE_MERGE,
+        PHASE_ENCODE,
+        PHASE_WAIT,
+        PHASE_SEND,
+        PHASES_COUNT
+    };
+
+    /**
+     * \~french
+     * \brief Section mesurée, dont la durée propre exclut celle des sections imbriquées dans le même thread
+     * \~english
+     * \brief Measured section, whose own duration excludes the one of sections nested in the same thread
+     */
+    class Section {
+    private:
+        int64_t outer;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        Section() : outer(nested), start(std::chrono::steady_clock::now()) {
+            nested = 0;
+        }
+
+        /**
+         * \~french \brief Termine la section
+         * \return Durée propre de la section, en nanosecondes
+         * \~english \brief End the section
+         * \return Section own duration, in nanoseconds
+         */
+        int64_t end() {
+            int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            int64_t own = duration - nested;
+            nested = outer + duration;
+            return own;
+        }
+    };
+
+    /**
+     * \~french
+     * \brief Chronomètre d'une phase, sa durée propre est ajoutée à la trace à sa destruction
+     * \~english
+     * \brief Phase timer, its own duration is added to the trace when destroyed
+     */
+    class Timer {
+    private:
+        Trace* trace;
+        ePhase phase;
+        Section section;
+
+    public:
+        Timer(Trace* t, ePhase p) : trace(t), phase(p) { }
+
+        ~Timer() {
+            int64_t duration = section.end();
+            if (trace != NULL) {
+                trace->add(phase, duration);
+            }
+        }
+    };
+
+private:
+
+    /**
+     * \~french \brief Durée cumulée des sections terminées, imbriquées dans la section en cours du thread
+     * \~english \brief Cumulated duration of ended sections, nested in thread's current section
+     */
+    static thread_local int64_t nested;
+
+    static const char* const phases_names[PHASES_COUNT];
+
+    /**
+     * \~french \brief Émission de l'en-tête Server-Timing
+     * \~english \brief Server-Timing header emission
+     */
+    static bool header_enabled;
+
+    /**
+     * \~french \brief Durée au-delà de laquelle une requête est journalisée, en nanosecondes (désactivé si 0)
+     * \~english \brief Duration beyond which a request is logged, in nanoseconds (disabled if 0)
+     */
+    static int64_t slow_threshold_ns;
+
+    /**
+     * \~french \brief Début de la requête
+     * \~english \brief Request start
+     */
+    std::chrono::steady_clock::time_point start;
+
+    /**
+     * \~french \brief Durées cumulées des phases, en nanosecondes
+     * \~english \brief Phases cumulated durations, in nanoseconds
+     */
+    int64_t durations[PHASES_COUNT];
+
+    /**
+     * \~french \brief Phases mesurées (un bit par phase)
+     * \~english \brief Measured phases (one bit per phase)
+     */
+    unsigned int measured;
+
+public:
+
+    /**
+     * \~french \brief Crée une trace, la requête débute
+     * \~english \brief Create a trace, request starts
+     */
+    Trace();
+
+    /**
+     * \~french \brief Ajoute une durée à une phase
+     * \~english \brief Add a duration to a phase
+     */
+    void add(ePhase phase, int64_t duration_ns) {
+        durations[phase] += duration_ns;
+        measured |= (1u << phase);
+    }
+
+    /**
+     * \~french \brief Durée écoulée depuis le début de la requête, en nanosecondes
+     * \~english \brief Elapsed duration since request start, in nanoseconds
+     */
+    int64_t get_elapsed() const;
+
+    /**
+     * \~french
+     * \brief Ajoute la valeur de l'en-tête Server-Timing
+     * \details Seules les phases mesurées sont données, suivies de la durée totale écoulée, en millisecondes
+     * \~english
+     * \brief Append the Server-Timing header value
+     * \details Only measured phases are given, followed by the total elapsed duration, in milliseconds
+     */
+    void append_server_timing(std::string& out) const;
+
+    /**
+     * \~french
+     * \brief Détail des phases pour le journal des requêtes lentes
+     * \details La durée non attribuée à une phase est donnée comme "other"
+     * \~english
+     * \brief Phases details for slow requests log
+     * \details Duration not attributed to a phase is given as "other"
+     */
+    std::string to_string(int64_t total_ns) const;
+
+    /**
+     * \~french
+     * \brief Configure les traces
+     * \param[in] header Émission de l'en-tête Server-Timing
+     * \param[in] slow_threshold Durée au-delà de laquelle une requête est journalisée, en millisecondes (désactivé si 0)
+     * \~english
+     * \brief Configure traces
+     * \param[in] header Server-Timing header emission
+     * \param[in] slow_threshold Duration beyond which a request is logged, in milliseconds (disabled if 0)
+     */
+    static void configure(bool header, int slow_threshold);
+
+    static bool is_header_enabled() { return header_enabled; }
+
+    /**
+     * \~french \brief La durée dépasse-t-elle le seuil des requêtes lentes ?
+     * \~english \brief Is duration beyond slow requests threshold ?
+     */
+    static bool is_slow(int64_t duration_ns) {
+        return slow_threshold_ns > 0 && duration_ns >= slow_threshold_ns;
+    }
+};
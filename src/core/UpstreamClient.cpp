@@ -0,0 +1,514 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/UpstreamClient.cpp
+ ** \~french
+ * \brief Implémentation des classes UpstreamClient et UpstreamDataStream
+ ** \~english
+ * \brief Implements classes UpstreamClient and UpstreamDataStream
+ */
+
+#include <chrono>
+#include <cstring>
+
+#include <boost/log/trivial.hpp>
+
+#include "core/UpstreamClient.h"
+
+const size_t UpstreamClient::MAX_QUEUED_BYTES;
+const size_t UpstreamClient::MAX_CACHED_BYTES;
+
+CURLM* UpstreamClient::multi = NULL;
+std::thread UpstreamClient::loop_thread;
+
+std::mutex UpstreamClient::mtx;
+bool UpstreamClient::stopping = false;
+std::vector<std::shared_ptr<UpstreamClient::Transfer> > UpstreamClient::to_add;
+std::vector<std::shared_ptr<UpstreamClient::Transfer> > UpstreamClient::to_resume;
+std::vector<std::shared_ptr<UpstreamClient::Transfer> > UpstreamClient::to_cancel;
+std::map<CURL*, std::shared_ptr<UpstreamClient::Transfer> > UpstreamClient::running;
+
+int UpstreamClient::timeout = 10;
+long UpstreamClient::hedge_delay = 0;
+int UpstreamClient::cache_ttl = 0;
+size_t UpstreamClient::cache_size = 0;
+
+std::mutex UpstreamClient::cache_mtx;
+std::list<std::pair<std::string, UpstreamClient::CacheEntry> > UpstreamClient::cache_lru;
+std::unordered_map<std::string, std::list<std::pair<std::string, UpstreamClient::CacheEntry> >::iterator> UpstreamClient::cache_index;
+
+std::atomic<unsigned long> UpstreamClient::requests(0);
+std::atomic<unsigned long> UpstreamClient::hedged(0);
+std::atomic<unsigned long> UpstreamClient::cache_hits(0);
+std::atomic<unsigned long> UpstreamClient::failures(0);
+
+void UpstreamClient::configure(int timeout_s, int max_host_connections, int hedge_delay_ms, int cache_ttl_s, int cache_entries) {
+    timeout = timeout_s;
+    hedge_delay = hedge_delay_ms;
+    cache_ttl = cache_ttl_s;
+    cache_size = cache_entries;
+
+    // La boucle peut être relancée après un arrêt
+    stopping = false;
+    multi = curl_multi_init();
+    if (max_host_connections > 0) {
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) max_host_connections);
+    }
+
+    loop_thread = std::thread(UpstreamClient::loop);
+}
+
+void UpstreamClient::stop() {
+    if (multi == NULL) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    curl_multi_wakeup(multi);
+    loop_thread.join();
+
+    curl_multi_cleanup(multi);
+    multi = NULL;
+}
+
+void UpstreamClient::answer(Transfer* t) {
+    // Appelé par le thread de la boucle, verrou du groupe posé
+    curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &(t->http_code));
+    char* content_type = NULL;
+    curl_easy_getinfo(t->curl, CURLINFO_CONTENT_TYPE, &content_type);
+    if (content_type != NULL) {
+        t->content_type = std::string(content_type);
+    }
+    t->answered = true;
+    t->group->cv.notify_all();
+}
+
+size_t UpstreamClient::on_data(char* ptr, size_t size, size_t nmemb, void* userdata) {
+    Transfer* t = (Transfer*) userdata;
+    size_t n = size * nmemb;
+
+    std::lock_guard<std::mutex> lock(t->group->mtx);
+
+    if (t->cancelled) {
+        // Le transfert s'arrête en erreur
+        return 0;
+    }
+
+    if (! t->answered) {
+        answer(t);
+    }
+
+    if (t->queued >= MAX_QUEUED_BYTES) {
+        // Le lecteur ne suit pas : les mêmes données seront de nouveau fournies à la reprise
+        t->paused = true;
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
+    t->chunks.emplace_back(ptr, n);
+    t->queued += n;
+    t->group->cv.notify_all();
+
+    return n;
+}
+
+void UpstreamClient::loop() {
+
+    while (true) {
+        std::vector<std::shared_ptr<Transfer> > adds, resumes, cancels;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (stopping) break;
+            adds.swap(to_add);
+            resumes.swap(to_resume);
+            cancels.swap(to_cancel);
+        }
+
+        for (std::shared_ptr<Transfer>& t : adds) {
+            running.emplace(t->curl, t);
+            curl_multi_add_handle(multi, t->curl);
+        }
+        for (std::shared_ptr<Transfer>& t : resumes) {
+            auto it = running.find(t->curl);
+            if (it != running.end() && it->second == t) {
+                curl_easy_pause(t->curl, CURLPAUSE_CONT);
+            }
+        }
+        for (std::shared_ptr<Transfer>& t : cancels) {
+            auto it = running.find(t->curl);
+            if (it == running.end() || it->second != t) continue;
+            curl_multi_remove_handle(multi, t->curl);
+            running.erase(it);
+            {
+                std::lock_guard<std::mutex> lock(t->group->mtx);
+                t->done = true;
+                t->result = CURLE_ABORTED_BY_CALLBACK;
+            }
+            t->group->cv.notify_all();
+            curl_easy_cleanup(t->curl);
+        }
+
+        int still_running;
+        curl_multi_perform(multi, &still_running);
+
+        CURLMsg* msg;
+        int queued_msgs;
+        while ((msg = curl_multi_info_read(multi, &queued_msgs)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            auto it = running.find(msg->easy_handle);
+            if (it == running.end()) continue;
+            std::shared_ptr<Transfer> t = it->second;
+            running.erase(it);
+
+            CURLcode result = msg->data.result;
+            curl_multi_remove_handle(multi, t->curl);
+            {
+                std::lock_guard<std::mutex> lock(t->group->mtx);
+                if (result == CURLE_OK && ! t->answered) {
+                    // Réponse sans contenu
+                    answer(t.get());
+                }
+                t->done = true;
+                t->result = result;
+            }
+            t->group->cv.notify_all();
+            curl_easy_cleanup(t->curl);
+        }
+
+        // Transferts sans réponse dans le délai
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (auto it = running.begin(); it != running.end(); ) {
+            std::shared_ptr<Transfer> t = it->second;
+            if (now < t->deadline) {
+                it++;
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(t->group->mtx);
+                if (t->answered) {
+                    it++;
+                    continue;
+                }
+                t->done = true;
+                t->result = CURLE_OPERATION_TIMEDOUT;
+            }
+            curl_multi_remove_handle(multi, t->curl);
+            it = running.erase(it);
+            t->group->cv.notify_all();
+            curl_easy_cleanup(t->curl);
+        }
+
+        curl_multi_poll(multi, NULL, 0, 1000, NULL);
+    }
+
+    // Arrêt : les transferts en cours sont abandonnés
+    for (auto& r : running) {
+        std::shared_ptr<Transfer> t = r.second;
+        curl_multi_remove_handle(multi, t->curl);
+        {
+            std::lock_guard<std::mutex> lock(t->group->mtx);
+            t->done = true;
+            t->result = CURLE_ABORTED_BY_CALLBACK;
+        }
+        t->group->cv.notify_all();
+        curl_easy_cleanup(t->curl);
+    }
+    running.clear();
+}
+
+std::shared_ptr<UpstreamClient::Transfer> UpstreamClient::start(std::shared_ptr<Group> group, const std::string& url, bool ssl_no_verify, int timeout_s) {
+    std::shared_ptr<Transfer> t = std::make_shared<Transfer>();
+    t->group = group;
+    t->answered = false;
+    t->done = false;
+    t->cancelled = false;
+    t->paused = false;
+    t->result = CURLE_OK;
+    t->http_code = 0;
+    t->queued = 0;
+    t->deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout_s);
+
+    t->curl = curl_easy_init();
+    curl_easy_setopt(t->curl, CURLOPT_URL, url.c_str());
+    if (ssl_no_verify) {
+        curl_easy_setopt(t->curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    }
+    curl_easy_setopt(t->curl, CURLOPT_CONNECTTIMEOUT, (long) timeout_s);
+    // Le délai complet ne s'applique que jusqu'à la réponse (voir la boucle). Le contenu peut ensuite être suspendu
+    // tant que le client ne suit pas : seul un transfert sans données reçues pendant le délai est interrompu
+    curl_easy_setopt(t->curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(t->curl, CURLOPT_LOW_SPEED_TIME, (long) timeout_s);
+    curl_easy_setopt(t->curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(t->curl, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(t->curl, CURLOPT_HEADER, 0L);
+    curl_easy_setopt(t->curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(t->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(t->curl, CURLOPT_ACCEPT_ENCODING, "identity");
+    curl_easy_setopt(t->curl, CURLOPT_USERAGENT, "ROK4 server");
+    curl_easy_setopt(t->curl, CURLOPT_WRITEFUNCTION, UpstreamClient::on_data);
+    curl_easy_setopt(t->curl, CURLOPT_WRITEDATA, (void*) t.get());
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        to_add.push_back(t);
+    }
+    curl_multi_wakeup(multi);
+
+    return t;
+}
+
+void UpstreamClient::resume(std::shared_ptr<Transfer> t) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        to_resume.push_back(t);
+    }
+    curl_multi_wakeup(multi);
+}
+
+void UpstreamClient::cancel(std::shared_ptr<Transfer> t) {
+    {
+        std::lock_guard<std::mutex> lock(t->group->mtx);
+        if (t->done) return;
+        t->cancelled = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        to_cancel.push_back(t);
+    }
+    curl_multi_wakeup(multi);
+}
+
+std::shared_ptr<const TileCache::Entry> UpstreamClient::get_cached(const std::string& key) {
+    std::lock_guard<std::mutex> lock(cache_mtx);
+
+    auto it = cache_index.find(key);
+    if (it == cache_index.end()) {
+        return std::shared_ptr<const TileCache::Entry>();
+    }
+    if (it->second->second.expiration < std::time(NULL)) {
+        cache_lru.erase(it->second);
+        cache_index.erase(it);
+        return std::shared_ptr<const TileCache::Entry>();
+    }
+
+    cache_lru.splice(cache_lru.begin(), cache_lru, it->second);
+    return it->second->second.entry;
+}
+
+void UpstreamClient::add_cached(const std::string& key, const std::string& type, std::string& data) {
+    TileCache::Entry* e = new TileCache::Entry();
+    e->type = type;
+    e->data.swap(data);
+
+    CacheEntry ce;
+    ce.entry = std::shared_ptr<const TileCache::Entry>(e);
+    ce.expiration = std::time(NULL) + cache_ttl;
+
+    std::lock_guard<std::mutex> lock(cache_mtx);
+
+    auto it = cache_index.find(key);
+    if (it != cache_index.end()) {
+        cache_lru.erase(it->second);
+        cache_index.erase(it);
+    }
+
+    cache_lru.emplace_front(key, ce);
+    cache_index.emplace(key, cache_lru.begin());
+
+    while (cache_lru.size() > cache_size) {
+        cache_index.erase(cache_lru.back().first);
+        cache_lru.pop_back();
+    }
+}
+
+DataStream* UpstreamClient::fetch(const std::string& url, bool ssl_no_verify, int timeout_s) {
+
+    if (multi == NULL) {
+        BOOST_LOG_TRIVIAL(error) << "Client des services externes non démarré";
+        return NULL;
+    }
+
+    if (is_cache_enabled()) {
+        std::shared_ptr<const TileCache::Entry> entry = get_cached(url);
+        if (entry) {
+            cache_hits++;
+            return new TileCacheDataStream(entry);
+        }
+    }
+
+    if (timeout_s <= 0) timeout_s = timeout;
+
+    requests++;
+
+    std::shared_ptr<Group> group = std::make_shared<Group>();
+    std::vector<std::shared_ptr<Transfer> > attempts;
+    attempts.push_back(start(group, url, ssl_no_verify, timeout_s));
+
+    std::chrono::steady_clock::time_point hedge_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(hedge_delay);
+    std::shared_ptr<Transfer> winner;
+
+    {
+        std::unique_lock<std::mutex> lock(group->mtx);
+        while (true) {
+            // La première tentative ayant reçu une réponse est retenue
+            bool all_done = true;
+            for (std::shared_ptr<Transfer>& t : attempts) {
+                if (t->answered) {
+                    winner = t;
+                    break;
+                }
+                all_done = all_done && t->done;
+            }
+            if (winner) break;
+
+            bool can_hedge = (hedge_delay > 0 && attempts.size() < 2);
+            if (all_done && ! can_hedge) break;
+
+            if (can_hedge && (all_done || std::chrono::steady_clock::now() >= hedge_time)) {
+                // Pas de réponse dans le délai, ou échec : on relance la requête
+                lock.unlock();
+                BOOST_LOG_TRIVIAL(debug) << "Relance de la requête " << url;
+                hedged++;
+                attempts.push_back(start(group, url, ssl_no_verify, timeout_s));
+                lock.lock();
+                continue;
+            }
+
+            if (can_hedge) {
+                group->cv.wait_until(lock, hedge_time);
+            } else {
+                group->cv.wait(lock);
+            }
+        }
+    }
+
+    for (std::shared_ptr<Transfer>& t : attempts) {
+        if (t != winner) cancel(t);
+    }
+
+    if (! winner) {
+        failures++;
+        BOOST_LOG_TRIVIAL(error) << "GET " << url << " failed";
+        BOOST_LOG_TRIVIAL(error) << curl_easy_strerror(attempts.back()->result);
+        return NULL;
+    }
+
+    if (winner->http_code < 200 || winner->http_code > 299) {
+        failures++;
+        cancel(winner);
+        BOOST_LOG_TRIVIAL(error) << "GET " << url << " failed";
+        BOOST_LOG_TRIVIAL(error) << "Response HTTP code : " << winner->http_code;
+        return NULL;
+    }
+
+    return new UpstreamDataStream(winner, url);
+}
+
+json11::Json UpstreamClient::to_json() {
+    size_t cached;
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx);
+        cached = cache_lru.size();
+    }
+    return json11::Json::object {
+        { "requests", (double) requests.load() },
+        { "hedged", (double) hedged.load() },
+        { "failures", (double) failures.load() },
+        { "cache_hits", (double) cache_hits.load() },
+        { "cache_entries", (int) cached }
+    };
+}
+
+size_t UpstreamDataStream::read(uint8_t* buffer, size_t size) {
+    std::unique_lock<std::mutex> lock(transfer->group->mtx);
+    transfer->group->cv.wait(lock, [this] { return ! transfer->chunks.empty() || transfer->done; });
+
+    size_t n = 0;
+    while (n < size && ! transfer->chunks.empty()) {
+        std::string& chunk = transfer->chunks.front();
+        size_t s = std::min(size - n, chunk.size() - offset);
+        memcpy(buffer + n, chunk.data() + offset, s);
+        n += s;
+        offset += s;
+        if (offset == chunk.size()) {
+            transfer->queued -= chunk.size();
+            transfer->chunks.pop_front();
+            offset = 0;
+        }
+    }
+
+    bool resume = (transfer->paused && transfer->queued < UpstreamClient::MAX_QUEUED_BYTES / 2);
+    if (resume) transfer->paused = false;
+    bool finished = (transfer->chunks.empty() && transfer->done);
+    CURLcode result = transfer->result;
+    lock.unlock();
+
+    if (resume) {
+        UpstreamClient::resume(transfer);
+    }
+
+    if (cacheable) {
+        if (body.size() + n <= UpstreamClient::MAX_CACHED_BYTES) {
+            body.append((const char*) buffer, n);
+        } else {
+            cacheable = false;
+        }
+    }
+
+    if (finished) {
+        if (result != CURLE_OK) {
+            BOOST_LOG_TRIVIAL(error) << "Réponse incomplète du service externe : " << curl_easy_strerror(result);
+        } else if (cacheable) {
+            UpstreamClient::add_cached(key, transfer->content_type, body);
+        }
+        cacheable = false;
+    }
+
+    return n;
+}
+
+bool UpstreamDataStream::eof() {
+    std::lock_guard<std::mutex> lock(transfer->group->mtx);
+    return transfer->chunks.empty() && transfer->done;
+}
+
+UpstreamDataStream::~UpstreamDataStream() {
+    UpstreamClient::cancel(transfer);
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/UpstreamClient.h
+ ** \~french
+ * \brief Définition des classes UpstreamClient et UpstreamDataStream
+ ** \~english
+ * \brief Define classes UpstreamClient and UpstreamDataStream
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <curl/curl.h>
+#include <rok4/datastream/DataStream.h>
+#include <rok4/thirdparty/json11.hpp>
+
+#include "core/TileCache.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Client des services externes (GetFeatureInfo de type EXTERNALWMS)
+ * \details Les requêtes sont jouées par une boucle d'évènements curl multi, dans un thread dédié : les threads de traitement n'attendent que la réponse, dans la limite d'un délai. Une fois la réponse reçue, le transfert n'est interrompu que s'il ne reçoit plus de données pendant ce délai, le temps passé suspendu en attendant le client n'étant pas compté. Les connexions sont conservées et réutilisées, avec un nombre maximal par hôte. Une requête sans réponse après un délai configurable, ou en échec, est relancée une fois, la première réponse étant retenue. Les petites réponses sont gardées en cache pendant une durée configurable, la clé étant l'URL complète. Le contenu est transmis au fur et à mesure de sa réception.
+ * \~english
+ * \brief External services client (EXTERNALWMS GetFeatureInfo)
+ * \details Requests are played by a curl multi event loop, in a dedicated thread : processing threads only wait for the response, within a timeout. Once response is received, transfer is aborted only if it gets no more data during this timeout, time spent paused waiting for the client being not counted. Connections are kept and reused, with a maximum count per host. A request without response after a configurable delay, or failed, is sent again once, first response being used. Small responses are cached for a configurable duration, key being the full URL. Content is transmitted as it is received.
+ */
+class UpstreamClient {
+    friend class CppUnitUpstreamClient;
+
+public:
+
+    /**
+     * \~french \brief Tentatives d'une même requête, partageant verrou et condition
+     * \~english \brief Attempts of the same request, sharing lock and condition
+     */
+    struct Group {
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    /**
+     * \~french \brief Transfert en cours, l'état étant protégé par le verrou du groupe
+     * \~english \brief Pending transfer, state being protected by group's lock
+     */
+    struct Transfer {
+        std::shared_ptr<Group> group;
+        CURL* curl;
+
+        bool answered;
+        bool done;
+        bool cancelled;
+        bool paused;
+        CURLcode result;
+        long http_code;
+        std::string content_type;
+
+        std::deque<std::string> chunks;
+        size_t queued;
+
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /**
+     * \~french \brief Taille maximale des données reçues en attente d'envoi, au delà le transfert est suspendu
+     * \~english \brief Max size of received data waiting to be sent, beyond transfer is paused
+     */
+    static const size_t MAX_QUEUED_BYTES = 1024 * 1024;
+
+    /**
+     * \~french \brief Taille maximale d'une réponse mise en cache
+     * \~english \brief Max size of a cached response
+     */
+    static const size_t MAX_CACHED_BYTES = 256 * 1024;
+
+private:
+
+    static CURLM* multi;
+    static std::thread loop_thread;
+
+    static std::mutex mtx;
+    static bool stopping;
+    static std::vector<std::shared_ptr<Transfer> > to_add;
+    static std::vector<std::shared_ptr<Transfer> > to_resume;
+    static std::vector<std::shared_ptr<Transfer> > to_cancel;
+
+    /**
+     * \~french \brief Transferts gérés par la boucle, manipulés uniquement par son thread
+     * \~english \brief Transfers handled by the loop, only used by its thread
+     */
+    static std::map<CURL*, std::shared_ptr<Transfer> > running;
+
+    static int timeout;
+    static long hedge_delay;
+    static int cache_ttl;
+    static size_t cache_size;
+
+    struct CacheEntry {
+        std::shared_ptr<const TileCache::Entry> entry;
+        std::time_t expiration;
+    };
+    static std::mutex cache_mtx;
+    static std::list<std::pair<std::string, CacheEntry> > cache_lru;
+    static std::unordered_map<std::string, std::list<std::pair<std::string, CacheEntry> >::iterator> cache_index;
+
+    static std::atomic<unsigned long> requests;
+    static std::atomic<unsigned long> hedged;
+    static std::atomic<unsigned long> cache_hits;
+    static std::atomic<unsigned long> failures;
+
+    static void loop();
+    static size_t on_data(char* ptr, size_t size, size_t nmemb, void* userdata);
+    static void answer(Transfer* t);
+    static std::shared_ptr<Transfer> start(std::shared_ptr<Group> group, const std::string& url, bool ssl_no_verify, int timeout);
+    static std::shared_ptr<const TileCache::Entry> get_cached(const std::string& key);
+
+public:
+
+    /**
+     * \~french
+     * \brief Démarre la boucle d'évènements
+     * \param[in] timeout_s Délai par défaut des requêtes, en secondes
+     * \param[in] max_host_connections Nombre maximal de connexions par hôte (0 pour aucune limite)
+     * \param[in] hedge_delay_ms Délai avant de relancer une requête sans réponse, en millisecondes (pas de relance si 0)
+     * \param[in] cache_ttl_s Durée de validité des réponses en cache, en secondes (pas de cache si 0)
+     * \param[in] cache_entries Nombre maximal de réponses en cache
+     * \~english
+     * \brief Start the event loop
+     * \param[in] timeout_s Requests default timeout, in seconds
+     * \param[in] max_host_connections Max connections count per host (0 for no limit)
+     * \param[in] hedge_delay_ms Delay before sending again a request without response, in milliseconds (no retry if 0)
+     * \param[in] cache_ttl_s Cached responses validity duration, in seconds (no cache if 0)
+     * \param[in] cache_entries Max cached responses count
+     */
+    static void configure(int timeout_s, int max_host_connections, int hedge_delay_ms, int cache_ttl_s, int cache_entries);
+
+    /**
+     * \~french
+     * \brief Arrête la boucle d'évènements, les transferts en cours sont abandonnés
+     * \~english
+     * \brief Stop the event loop, pending transfers are dropped
+     */
+    static void stop();
+
+    /**
+     * \~french
+     * \brief Joue une requête GET
+     * \param[in] url URL complète, clé du cache
+     * \param[in] ssl_no_verify Pas de vérification du certificat
+     * \param[in] timeout_s Délai de la requête, en secondes (délai par défaut si 0)
+     * \return Réponse, NULL en cas d'échec ou de code HTTP en erreur
+     * \~english
+     * \brief Play a GET request
+     * \param[in] url Full URL, cache key
+     * \param[in] ssl_no_verify No certificate check
+     * \param[in] timeout_s Request timeout, in seconds (default timeout if 0)
+     * \return Response, NULL if failure or error HTTP code
+     */
+    static DataStream* fetch(const std::string& url, bool ssl_no_verify, int timeout_s);
+
+    /**
+     * \~french
+     * \brief Relance un transfert suspendu, les données en attente ayant été lues
+     * \~english
+     * \brief Resume a paused transfer, pending data being read
+     */
+    static void resume(std::shared_ptr<Transfer> t);
+
+    /**
+     * \~french
+     * \brief Abandonne un transfert
+     * \~english
+     * \brief Drop a transfer
+     */
+    static void cancel(std::shared_ptr<Transfer> t);
+
+    /**
+     * \~french
+     * \brief Met en cache une réponse complète
+     * \~english
+     * \brief Cache a complete response
+     */
+    static void add_cached(const std::string& key, const std::string& type, std::string& data);
+
+    static bool is_cache_enabled() { return cache_ttl > 0 && cache_size > 0; }
+
+    /**
+     * \~french
+     * \brief Export JSON des compteurs
+     * \~english
+     * \brief JSON export of counters
+     */
+    static json11::Json to_json();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Réponse d'un service externe, lue au fur et à mesure de sa réception
+ * \details La réponse complète est mise en cache à la fin de la lecture si elle est assez petite
+ * \~english
+ * \brief External service response, read as it is received
+ * \details Complete response is cached at the end of reading if small enough
+ */
+class UpstreamDataStream : public DataStream {
+    friend class CppUnitUpstreamClient;
+
+private:
+    std::shared_ptr<UpstreamClient::Transfer> transfer;
+    std::string key;
+    std::string body;
+    bool cacheable;
+    size_t offset;
+
+public:
+    UpstreamDataStream ( std::shared_ptr<UpstreamClient::Transfer> t, std::string k ) :
+        transfer ( t ), key ( k ), cacheable ( UpstreamClient::is_cache_enabled() ), offset ( 0 ) {}
+
+    size_t read ( uint8_t *buffer, size_t size );
+    bool eof();
+    std::string get_type() {
+        return transfer->content_type;
+    }
+    std::string get_encoding() {
+        return "";
+    }
+    int get_http_status() {
+        return 200;
+    }
+    unsigned int get_length() {
+        return 0;
+    }
+
+    ~UpstreamDataStream();
+};
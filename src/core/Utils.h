@@ -131,23 +131,22 @@ namespace Utils {
     }
 
     static std::map<std::string, std::string> string_to_map(std::string s, std::string item_separator, std::string kv_separator) {
-        size_t pos_item = 0;
+        size_t start = 0;
         std::map<std::string, std::string> res;
 
-        std::string item;
         while (true) {
-            pos_item = s.find(item_separator);
-            item = s.substr(0, pos_item);
-            s.erase(0, pos_item + item_separator.length());
+            size_t pos_item = s.find(item_separator, start);
+            size_t end = (pos_item == std::string::npos) ? s.size() : pos_item;
 
-            size_t pos_kv = item.find(kv_separator);
-            if (pos_kv != std::string::npos) {
-                res.insert(std::pair<std::string, std::string>(item.substr(0, pos_kv), item.substr(pos_kv + kv_separator.length(), std::string::npos)));
+            size_t pos_kv = s.find(kv_separator, start);
+            if (pos_kv != std::string::npos && pos_kv < end) {
+                res.insert(std::pair<std::string, std::string>(s.substr(start, pos_kv - start), s.substr(pos_kv + kv_separator.length(), end - pos_kv - kv_separator.length())));
             }
 
             if (pos_item == std::string::npos) {
                 break;
             }
+            start = pos_item + item_separator.length();
         }
 
         return res;
@@ -210,20 +209,29 @@ namespace Utils {
 
     /**
      * \~french
-     * \brief Décodage de l'URL correspondant à la requête
-     * \param[in,out] src URL
+     * \brief Décodage d'une portion d'URL (clé ou valeur d'un paramètre de requête)
+     * \details Le décodage peut se faire en place (dst = src), la taille décodée n'étant jamais supérieure à la taille d'origine
+     * \param[out] dst Destination du décodage
+     * \param[in] src Portion d'URL à décoder
+     * \param[in] size Taille de la portion à décoder
+     * \return Taille décodée
      * \~english
-     * \brief URL decoding
-     * \param[in,out] src URL
+     * \brief URL part decoding (query parameter's key or value)
+     * \details Decoding can be done in place (dst = src), decoded size is never greater than the original one
+     * \param[out] dst Decoding destination
+     * \param[in] src URL part to decode
+     * \param[in] size Size of the part to decode
+     * \return Decoded size
      */
-    static void url_decode(char* src) {
+    static size_t url_decode(char* dst, const char* src, size_t size) {
         unsigned char high, low;
-        char* dst = src;
+        const char* end = src + size;
+        char* start = dst;
 
-        while ((*src) != '\0') {
+        while (src < end) {
             if (*src == '+') {
                 *dst = ' ';
-            } else if (*src == '%') {
+            } else if (*src == '%' && end - src > 2) {
                 *dst = '%';
 
                 high = Utils::hexadecimal_to_int(*(src + 1));
@@ -247,7 +255,7 @@ namespace Utils {
             src++;
         }
 
-        *dst = '\0';
+        return dst - start;
     }
 };
 
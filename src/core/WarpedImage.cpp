@@ -0,0 +1,249 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/WarpedImage.cpp
+ ** \~french
+ * \brief Implémentation de la classe WarpedImage
+ ** \~english
+ * \brief Implements classe WarpedImage
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <boost/log/trivial.hpp>
+
+#include "core/WarpedImage.h"
+
+/**
+ * \~french \brief Marge autour de l'emprise source, en pixels, couvrant le voisinage bilinéaire et la tolérance
+ * \~english \brief Margin around source bbox, in pixels, covering bilinear neighbourhood and tolerance
+ */
+static const double SOURCE_MARGIN = 2.5;
+
+/**
+ * \~french \brief Rapport maximal entre les tailles des images source et demandée, au delà la reprojection exacte est utilisée
+ * \~english \brief Max ratio between source and asked images sizes, exact reprojection being used beyond
+ */
+static const double MAX_SOURCE_RATIO = 4.;
+
+WarpedImage* WarpedImage::create(
+    Pyramid* pyramid, int max_tile_x, int max_tile_y, BoundingBox<double> bbox, int width, int height, CRS* crs,
+    Interpolation::KernelType interpolation, int dpi, double tolerance
+) {
+    CRS* data_crs = pyramid->get_tms()->get_crs();
+
+    ApproxTransformer* transformer = new ApproxTransformer(crs, data_crs, bbox, width, height);
+    if (! transformer->is_ok()) {
+        delete transformer;
+        return NULL;
+    }
+
+    // Résolution source : taille locale d'un pixel demandé au centre de l'image, dans le CRS de la pyramide
+    double ci = (width - 1) / 2., cj = (height - 1) / 2.;
+    double x0, y0, x1, y1, x2, y2;
+    if (! transformer->transform_point(ci, cj, x0, y0) || ! transformer->transform_point(ci + 1, cj, x1, y1) || ! transformer->transform_point(ci, cj + 1, x2, y2)) {
+        delete transformer;
+        return NULL;
+    }
+    double res = std::min(std::hypot(x1 - x0, y1 - y0), std::hypot(x2 - x0, y2 - y0));
+    if (! std::isfinite(res) || res <= 0) {
+        delete transformer;
+        return NULL;
+    }
+
+    if (! transformer->build(tolerance * res)) {
+        BOOST_LOG_TRIVIAL(debug) << "Grille de contrôle impossible à construire, reprojection exacte";
+        delete transformer;
+        return NULL;
+    }
+
+    BoundingBox<double> source_bbox = transformer->get_envelope();
+    source_bbox.xmin -= SOURCE_MARGIN * res;
+    source_bbox.ymax += SOURCE_MARGIN * res;
+    int source_width = (int) std::ceil((source_bbox.xmax + SOURCE_MARGIN * res - source_bbox.xmin) / res);
+    int source_height = (int) std::ceil((source_bbox.ymax - source_bbox.ymin + SOURCE_MARGIN * res) / res);
+
+    // Déformation trop forte (pôles, antiméridien...) : l'image source serait démesurée
+    if (source_width <= 0 || source_height <= 0 || (double) source_width * source_height > MAX_SOURCE_RATIO * width * height) {
+        BOOST_LOG_TRIVIAL(debug) << "Emprise source trop grande pour la grille de contrôle, reprojection exacte";
+        delete transformer;
+        return NULL;
+    }
+
+    source_bbox.xmax = source_bbox.xmin + source_width * res;
+    source_bbox.ymin = source_bbox.ymax - source_height * res;
+    source_bbox.crs = data_crs->get_request_code();
+
+    Image* source = pyramid->getbbox(max_tile_x, max_tile_y, source_bbox, source_width, source_height, data_crs, true, interpolation, dpi);
+    if (source == NULL) {
+        delete transformer;
+        return NULL;
+    }
+
+    WarpedImage* image = new WarpedImage(
+        width, height, bbox, source, source_bbox, res, transformer,
+        interpolation == Interpolation::NEAREST_NEIGHBOUR, pyramid->get_nodata_value()
+    );
+    image->set_crs(crs);
+
+    return image;
+}
+
+WarpedImage::WarpedImage(int width, int height, BoundingBox<double> bbox, Image* source, BoundingBox<double> source_bbox, double source_res, ApproxTransformer* transformer, bool nearest, int* nodata) :
+    Image(width, height, source->get_channels(), bbox), source(source), source_bbox(source_bbox), source_res(source_res), transformer(transformer), nearest(nearest)
+{
+    int channels = source->get_channels();
+    this->nodata.resize(channels);
+    for (int c = 0; c < channels; c++) {
+        this->nodata[c] = nodata[c];
+    }
+
+    // Pour chaque ligne, première ligne source dont elle ou une ligne suivante peut avoir besoin
+    std::vector<double> min_y, max_y;
+    transformer->get_lines_bounds(min_y, max_y);
+    first_source_lines.resize(height);
+    for (int j = height - 1; j >= 0; j--) {
+        int first = (int) std::floor((source_bbox.ymax - max_y[j]) / source_res - 0.5) - 1;
+        first_source_lines[j] = (j == height - 1) ? first : std::min(first, first_source_lines[j + 1]);
+    }
+
+    xs.resize(width);
+    ys.resize(width);
+    warped.resize(width * channels);
+}
+
+WarpedImage::~WarpedImage() {
+    delete source;
+    delete transformer;
+}
+
+const float* WarpedImage::get_source_line(int line) {
+    std::map<int, std::vector<float> >::iterator it = source_lines.find(line);
+    if (it != source_lines.end()) {
+        return it->second.data();
+    }
+
+    std::vector<float>& buffer = source_lines[line];
+    buffer.resize(source->get_width() * source->get_channels());
+    source->get_line(buffer.data(), line);
+    return buffer.data();
+}
+
+bool WarpedImage::is_nodata(const float* pixel) {
+    for (unsigned int c = 0; c < nodata.size(); c++) {
+        if (pixel[c] != nodata[c]) return false;
+    }
+    return true;
+}
+
+void WarpedImage::warp_line(int line) {
+    int channels = get_channels();
+    int source_width = source->get_width();
+    int source_height = source->get_height();
+
+    // Les lignes source précédant celles encore utiles sont libérées
+    source_lines.erase(source_lines.begin(), source_lines.lower_bound(first_source_lines[line]));
+
+    transformer->transform_line(line, xs.data(), ys.data());
+
+    for (int i = 0; i < get_width(); i++) {
+        float* out = warped.data() + i * channels;
+
+        double fc = (xs[i] - source_bbox.xmin) / source_res - 0.5;
+        double fr = (source_bbox.ymax - ys[i]) / source_res - 0.5;
+
+        if (! nearest) {
+            int c0 = (int) std::floor(fc);
+            int r0 = (int) std::floor(fr);
+
+            if (c0 >= 0 && r0 >= 0 && c0 + 1 < source_width && r0 + 1 < source_height) {
+                const float* top = get_source_line(r0) + c0 * channels;
+                const float* bottom = get_source_line(r0 + 1) + c0 * channels;
+
+                // Au bord du nodata, on se replie sur le plus proche voisin pour ne pas mélanger nodata et données
+                if (! is_nodata(top) && ! is_nodata(top + channels) && ! is_nodata(bottom) && ! is_nodata(bottom + channels)) {
+                    float dc = fc - c0;
+                    float dr = fr - r0;
+                    for (int c = 0; c < channels; c++) {
+                        out[c] = (1 - dr) * ((1 - dc) * top[c] + dc * top[channels + c]) + dr * ((1 - dc) * bottom[c] + dc * bottom[channels + c]);
+                    }
+                    continue;
+                }
+            }
+        }
+
+        int c = (int) std::floor(fc + 0.5);
+        int r = (int) std::floor(fr + 0.5);
+
+        if (c >= 0 && r >= 0 && c < source_width && r < source_height) {
+            memcpy(out, get_source_line(r) + c * channels, channels * sizeof(float));
+        } else {
+            memcpy(out, nodata.data(), channels * sizeof(float));
+        }
+    }
+}
+
+template <typename T>
+static void convert_line(T* dst, const float* src, int size) {
+    for (int i = 0; i < size; i++) {
+        dst[i] = (T) (src[i] + 0.5);
+    }
+}
+
+static void convert_line(float* dst, const float* src, int size) {
+    memcpy(dst, src, size * sizeof(float));
+}
+
+template <typename T>
+int WarpedImage::_getline(T* buffer, int line) {
+    if (line < 0 || line >= get_height()) {
+        return 0;
+    }
+
+    warp_line(line);
+    convert_line(buffer, warped.data(), get_width() * get_channels());
+
+    return get_width() * get_channels();
+}
+
+int WarpedImage::get_line(uint8_t* buffer, int line) { return _getline(buffer, line); }
+int WarpedImage::get_line(uint16_t* buffer, int line) { return _getline(buffer, line); }
+int WarpedImage::get_line(float* buffer, int line) { return _getline(buffer, line); }
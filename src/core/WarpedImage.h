@@ -0,0 +1,178 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file core/WarpedImage.h
+ ** \~french
+ * \brief Définition de la classe WarpedImage
+ ** \~english
+ * \brief Define classe WarpedImage
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <rok4/image/Image.h>
+#include <rok4/utils/Pyramid.h>
+#include <rok4/enums/Interpolation.h>
+
+#include "core/ApproxTransformer.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Image reprojetée à l'aide d'une grille de contrôle
+ * \details Les données sont lues dans le CRS de la pyramide, sur l'emprise couverte par l'image demandée et à une résolution équivalente, avec l'interpolation de la couche. Chaque pixel est ensuite rééchantillonné (bilinéaire, ou au plus proche voisin pour une couche ainsi configurée ou au bord du nodata) à la position fournie par un ApproxTransformer : seuls les noeuds de la grille de contrôle sont reprojetés exactement.
+ *
+ * Les lignes source sont gardées en mémoire tant qu'une ligne suivante de l'image peut en avoir besoin.
+ * \~english
+ * \brief Image reprojected with a control grid
+ * \details Data is read in the pyramid's CRS, on the bbox covered by the asked image and with an equivalent resolution, using layer's interpolation. Each pixel is then resampled (bilinear, or nearest neighbour for a layer configured so or at nodata edge) at the position provided by an ApproxTransformer : only control grid nodes are exactly reprojected.
+ *
+ * Source lines are kept in memory as long as a following image line can need them.
+ */
+class WarpedImage : public Image {
+
+private:
+
+    /**
+     * \~french \brief Image source, dans le CRS de la pyramide
+     * \~english \brief Source image, in pyramid's CRS
+     */
+    Image* source;
+
+    /**
+     * \~french \brief Emprise de l'image source, dans le CRS de la pyramide
+     * \~english \brief Source image bbox, in pyramid's CRS
+     */
+    BoundingBox<double> source_bbox;
+
+    /**
+     * \~french \brief Résolution de l'image source, identique dans les deux directions
+     * \~english \brief Source image resolution, same in both directions
+     */
+    double source_res;
+
+    ApproxTransformer* transformer;
+
+    bool nearest;
+
+    std::vector<float> nodata;
+
+    /**
+     * \~french \brief Première ligne source utile à partir de chaque ligne de l'image
+     * \~english \brief First useful source line from each image's line
+     */
+    std::vector<int> first_source_lines;
+
+    /**
+     * \~french \brief Lignes source en mémoire
+     * \~english \brief Source lines in memory
+     */
+    std::map<int, std::vector<float> > source_lines;
+
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::vector<float> warped;
+
+    /**
+     * \~french \brief Ligne source, lue si besoin
+     * \~english \brief Source line, read if needed
+     */
+    const float* get_source_line(int line);
+
+    bool is_nodata(const float* pixel);
+
+    /**
+     * \~french \brief Calcule une ligne de l'image, en flottant
+     * \~english \brief Compute an image's line, as floats
+     */
+    void warp_line(int line);
+
+    template<typename T>
+    int _getline(T* buffer, int line);
+
+    WarpedImage(int width, int height, BoundingBox<double> bbox, Image* source, BoundingBox<double> source_bbox, double source_res, ApproxTransformer* transformer, bool nearest, int* nodata);
+
+public:
+
+    /**
+     * \~french
+     * \brief Crée l'image reprojetée d'une pyramide
+     * \param[in] pyramid Pyramide source
+     * \param[in] max_tile_x Nombre maximal de tuiles lues en largeur
+     * \param[in] max_tile_y Nombre maximal de tuiles lues en hauteur
+     * \param[in] bbox Emprise demandée, dans le CRS demandé
+     * \param[in] width Largeur demandée
+     * \param[in] height Hauteur demandée
+     * \param[in] crs CRS demandé, différent de celui de la pyramide
+     * \param[in] interpolation Interpolation de la couche
+     * \param[in] dpi Résolution d'affichage
+     * \param[in] tolerance Écart maximal toléré entre les positions exacte et interpolée, en pixels
+     * \return Image, NULL si la grille de contrôle ne peut pas être utilisée (la reprojection exacte doit alors être utilisée)
+     * \~english
+     * \brief Create the reprojected image of a pyramid
+     * \param[in] pyramid Source pyramid
+     * \param[in] max_tile_x Max read tiles count in width
+     * \param[in] max_tile_y Max read tiles count in height
+     * \param[in] bbox Asked bbox, in asked CRS
+     * \param[in] width Asked width
+     * \param[in] height Asked height
+     * \param[in] crs Asked CRS, different from the pyramid's one
+     * \param[in] interpolation Layer's interpolation
+     * \param[in] dpi Display resolution
+     * \param[in] tolerance Max tolerated gap between exact and interpolated positions, in pixels
+     * \return Image, NULL if control grid cannot be used (exact reprojection have to be used then)
+     */
+    static WarpedImage* create(
+        Pyramid* pyramid, int max_tile_x, int max_tile_y, BoundingBox<double> bbox, int width, int height, CRS* crs,
+        Interpolation::KernelType interpolation, int dpi, double tolerance
+    );
+
+    int get_line(uint8_t* buffer, int line);
+    int get_line(uint16_t* buffer, int line);
+    int get_line(float* buffer, int line);
+
+    /**
+     * \~french \brief Destructeur : l'image source est supprimée
+     * \~english \brief Destructor : source image is deleted
+     */
+    virtual ~WarpedImage();
+};
@@ -0,0 +1,160 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+/**
+ * \file core/XmlWriter.cpp
+ ** \~french
+ * \brief Implémentation de la classe XmlWriter
+ ** \~english
+ * \brief Implements classe XmlWriter
+ */
+
+#include <limits>
+#include <sstream>
+
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "core/XmlWriter.h"
+
+XmlWriter::XmlWriter(size_t capacity) : pending(false) {
+    buffer.reserve(capacity);
+}
+
+void XmlWriter::close_pending() {
+    if (pending) {
+        buffer.push_back('>');
+        pending = false;
+    }
+}
+
+void XmlWriter::append_escaped(const std::string& s) {
+    // Comme boost, un texte fait uniquement d'espaces voit son premier espace encodé
+    if (! s.empty() && s.find_first_not_of(' ') == std::string::npos) {
+        buffer.append("&#32;");
+        buffer.append(s.size() - 1, ' ');
+        return;
+    }
+
+    for (char c : s) {
+        switch (c) {
+            case '<': buffer.append("&lt;"); break;
+            case '>': buffer.append("&gt;"); break;
+            case '&': buffer.append("&amp;"); break;
+            case '"': buffer.append("&quot;"); break;
+            case '\'': buffer.append("&apos;"); break;
+            default: buffer.push_back(c); break;
+        }
+    }
+}
+
+void XmlWriter::declaration() {
+    buffer.append("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
+}
+
+void XmlWriter::start_element(const std::string& name) {
+    close_pending();
+    buffer.push_back('<');
+    buffer.append(name);
+    opened.push_back(name);
+    pending = true;
+}
+
+void XmlWriter::attribute(const std::string& name, const std::string& value) {
+    buffer.push_back(' ');
+    buffer.append(name);
+    buffer.append("=\"");
+    append_escaped(value);
+    buffer.push_back('"');
+}
+
+void XmlWriter::attribute(const std::string& name, int value) {
+    attribute(name, std::to_string(value));
+}
+
+void XmlWriter::text(const std::string& value) {
+    if (value.empty()) {
+        return;
+    }
+    close_pending();
+    append_escaped(value);
+}
+
+void XmlWriter::end_element() {
+    if (pending) {
+        // Ni texte ni enfant : élément vide
+        buffer.append("/>");
+        pending = false;
+    } else {
+        buffer.append("</");
+        buffer.append(opened.back());
+        buffer.push_back('>');
+    }
+    opened.pop_back();
+}
+
+void XmlWriter::element(const std::string& name, const std::string& value) {
+    start_element(name);
+    text(value);
+    end_element();
+}
+
+void XmlWriter::element(const std::string& name, int value) {
+    element(name, std::to_string(value));
+}
+
+void XmlWriter::element(const std::string& name, double value) {
+    std::ostringstream os;
+    os.precision(std::numeric_limits<double>::max_digits10);
+    os << value;
+    element(name, os.str());
+}
+
+void XmlWriter::raw(const std::string& content) {
+    if (content.empty()) {
+        return;
+    }
+    close_pending();
+    buffer.append(content);
+}
+
+void XmlWriter::subtree(const boost::property_tree::ptree& tree) {
+    std::ostringstream os;
+    boost::property_tree::xml_parser::write_xml_element(os, std::string(), tree, -1, boost::property_tree::xml_writer_settings<std::string>());
+    raw(os.str());
+}
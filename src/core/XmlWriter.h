@@ -0,0 +1,154 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+/**
+ * \file core/XmlWriter.h
+ ** \~french
+ * \brief Définition de la classe XmlWriter
+ ** \~english
+ * \brief Define classe XmlWriter
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Écriture séquentielle d'un document XML dans un tampon
+ * \details Les éléments sont écrits au fil de l'eau, sans arbre intermédiaire. La sortie est identique à celle de boost::property_tree::write_xml sans indentation : un élément sans texte ni enfant est fermé par "/>", les attributs et le texte sont échappés de la même manière. Le texte d'un élément doit être écrit avant ses enfants.
+ * \~english
+ * \brief Sequential XML document writing into a buffer
+ * \details Elements are written on the fly, without intermediate tree. Output is identical to the boost::property_tree::write_xml one without indentation : an element without text nor child is closed with "/>", attributes and text are escaped the same way. Element's text have to be written before its children.
+ */
+class XmlWriter {
+
+private:
+
+    std::string buffer;
+
+    /**
+     * \~french \brief Noms des éléments ouverts
+     * \~english \brief Opened elements names
+     */
+    std::vector<std::string> opened;
+
+    /**
+     * \~french \brief La balise ouvrante du dernier élément n'est pas encore fermée, des attributs peuvent y être ajoutés
+     * \~english \brief Last element opening tag is not closed yet, attributes can be added
+     */
+    bool pending;
+
+    void close_pending();
+
+    void append_escaped(const std::string& s);
+
+public:
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] capacity Taille réservée pour le tampon
+     * \~english
+     * \brief Constructor
+     * \param[in] capacity Reserved buffer size
+     */
+    XmlWriter(size_t capacity = 4096);
+
+    /**
+     * \~french \brief Écrit la déclaration XML, avant l'élément racine
+     * \~english \brief Write the XML declaration, before root element
+     */
+    void declaration();
+
+    void start_element(const std::string& name);
+
+    /**
+     * \~french
+     * \brief Ajoute un attribut au dernier élément ouvert
+     * \details Doit être appelé juste après #start_element
+     * \~english
+     * \brief Add an attribute to the last opened element
+     * \details Has to be called just after #start_element
+     */
+    void attribute(const std::string& name, const std::string& value);
+    void attribute(const std::string& name, int value);
+
+    /**
+     * \~french \brief Écrit le texte du dernier élément ouvert, rien si vide
+     * \~english \brief Write the last opened element's text, nothing if empty
+     */
+    void text(const std::string& value);
+
+    void end_element();
+
+    /**
+     * \~french
+     * \brief Écrit un élément feuille
+     * \details Les nombres flottants sont écrits avec la précision utilisée par boost::property_tree
+     * \~english
+     * \brief Write a leaf element
+     * \details Floating numbers are written with the precision used by boost::property_tree
+     */
+    void element(const std::string& name, const std::string& value);
+    void element(const std::string& name, int value);
+    void element(const std::string& name, double value);
+
+    /**
+     * \~french \brief Écrit un contenu déjà sérialisé (fragment en cache)
+     * \~english \brief Write an already serialized content (cached fragment)
+     */
+    void raw(const std::string& content);
+
+    /**
+     * \~french
+     * \brief Écrit les enfants d'un arbre
+     * \details Pour les éléments fournis par la librairie, qui ne savent s'écrire que dans un arbre
+     * \~english
+     * \brief Write a tree's children
+     * \details For elements provided by the library, which can only write themselves into a tree
+     */
+    void subtree(const boost::property_tree::ptree& tree);
+
+    const std::string& get_content() { return buffer; }
+};
@@ -47,7 +47,7 @@
  *  - le chemin vers le fichier de configuration du serveur
  *
  * Signaux écoutés :
- *  - \b SIGHUP réinitialise la configuration du serveur
+ *  - \b SIGHUP recharge la configuration des services et des couches, sans interrompre le traitement des requêtes
  *  - \b SIGQUIT & \b SIGUSR1 éteint le serveur
  * \brief Exécutable du serveur ROK4
  * \~english
@@ -59,7 +59,7 @@
  *  - path to the server configuration file
  *
  * Listened Signal :
- *  - \b SIGHUP reinitialise the server configuration
+ *  - \b SIGHUP reload services and layers configuration, without interrupting requests processing
  *  - \b SIGQUIT & \b SIGUSR1 shut the server down
  * \brief ROK4 Server executable
  */
@@ -72,6 +72,8 @@
 #include <chrono>
 #include <curl/curl.h>
 #include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <openssl/evp.h>
 #include <openssl/err.h>
 #include <rok4/utils/CurlPool.h>
@@ -87,25 +89,22 @@ namespace logging = boost::log;
 namespace keywords = boost::log::keywords;
 namespace sinks = boost::log::sinks;
 
+#include "core/Books.h"
 #include "core/Rok4Server.h"
 #include "core/Process.h"
+#include "core/TileCache.h"
 #include "config.h"
 
 Rok4Server* rok4server_instance;
-Rok4Server* rok4server_instance_tmp;
-bool reload;
 static bool logger_initialized = false;
 
 std::string server_configuration_path;
 
-// Minimum time between two signal to be defered.
-// Earlier signal would be ignored.
-// in microseconds
-static const double signal_defering_min_time = 1000000LL;
-
-volatile sig_atomic_t signal_pending = 0;
 volatile sig_atomic_t defer_signal;
-volatile timeval signal_timestamp;
+
+// Rechargement demandé (posté par le gestionnaire du signal SIGHUP, attendu par le thread de rechargement)
+sem_t reload_semaphore;
+volatile sig_atomic_t shutting_down = 0;
 
 /**
  * \~french
@@ -117,6 +116,74 @@ void usage() {
     std::cerr << "Usage : rok4 [-f server_configuration_path]" <<std::endl;
 }
 
+/**
+ * \~french
+ * \brief Chargement de la configuration des services et des couches
+ * \param[in] server_configuration configuration du serveur, donnant les chemins vers ces configurations
+ * \return configuration des services, NULL en cas d'erreur
+ * \~english
+ * \brief Load services and layers configuration
+ * \param[in] server_configuration server configuration, providing paths to these configurations
+ * \return services configuration, NULL if error
+ */
+ServicesConfiguration* load_services_configuration(ServerConfiguration* server_configuration) {
+
+    // Construction des parametres de service
+    ServicesConfiguration* services_configuration = new ServicesConfiguration ( server_configuration->get_services_configuration_file() );
+    if ( ! services_configuration->is_ok() ) {
+        BOOST_LOG_TRIVIAL(fatal) << "Cannot load services configuration " << std::endl;
+        BOOST_LOG_TRIVIAL(fatal) << services_configuration->get_error_message() << std::endl;
+        delete services_configuration;
+        return NULL;
+    }
+
+    // Chargement des layers
+
+    BOOST_LOG_TRIVIAL(info) << "LAYERS LOADING" ;
+    
+    std::string list_path = server_configuration->get_layers_list();
+
+    if (list_path != "") {
+        // Lecture de la liste des couches
+
+        ContextType::eContextType storage_type;
+        std::string tray_name, fo_name;
+        ContextType::split_path(list_path, storage_type, fo_name, tray_name);
+
+        Context* context = StoragePool::get_context(storage_type, tray_name);
+        if (context == NULL) {
+            BOOST_LOG_TRIVIAL(fatal) << "Cannot add " + ContextType::to_string(storage_type) + " storage context to read layers list" << std::endl;
+            delete services_configuration;
+            return NULL;
+        }
+
+        int size = -1;
+        uint8_t* data = context->read_full(size, fo_name);
+
+        if (size < 0) {
+            BOOST_LOG_TRIVIAL(fatal) << "Cannot read layers list " + list_path << std::endl;
+            if (data != NULL) delete[] data;
+            delete services_configuration;
+            return NULL;
+        }
+        
+        std::istringstream list_content(std::string((char*) data, size));
+        delete[] data; 
+        std::string layer_desc;    
+        std::vector<std::string> descriptors;
+        while (std::getline(list_content, layer_desc)) {
+            descriptors.push_back(layer_desc);
+        }
+
+        // Les couches sont construites par plusieurs threads. En chargement différé, leurs pyramides sont chargées en arrière-plan
+        services_configuration->load_layers(descriptors, server_configuration->get_layers_loading_threads(), server_configuration->is_layers_lazy_loading());
+    }
+
+    BOOST_LOG_TRIVIAL(info) << services_configuration->get_layers_count() << " layer(s) registered" ;
+
+    return services_configuration;
+}
+
 /**
 * \brief Initialisation du serveur ROK4
 * \return : pointeur sur le serveur ROK4, NULL en cas d'erreur (forcement fatale)
@@ -162,98 +229,92 @@ Rok4Server* load_configuration() {
         logger_initialized = true;
     }
 
-    // Construction des parametres de service
-    ServicesConfiguration* services_configuration = new ServicesConfiguration ( server_configuration->get_services_configuration_file() );
-    if ( ! services_configuration->is_ok() ) {
-        BOOST_LOG_TRIVIAL(fatal) << "Cannot load services configuration " << std::endl;
-        BOOST_LOG_TRIVIAL(fatal) << services_configuration->get_error_message() << std::endl;
+    ServicesConfiguration* services_configuration = load_services_configuration(server_configuration);
+    if ( services_configuration == NULL ) {
         sleep ( 1 );    // Pour laisser le temps au logger pour se vider
         return NULL;
     }
 
-    // Chargement des layers
-
-    BOOST_LOG_TRIVIAL(info) << "LAYERS LOADING" ;
-    
-    std::string list_path = server_configuration->get_layers_list();
-
-    if (list_path != "") {
-        // Lecture de la liste des couches
-
-        ContextType::eContextType storage_type;
-        std::string tray_name, fo_name;
-        ContextType::split_path(list_path, storage_type, fo_name, tray_name);
-
-        Context* context = StoragePool::get_context(storage_type, tray_name);
-        if (context == NULL) {
-            BOOST_LOG_TRIVIAL(fatal) << "Cannot add " + ContextType::to_string(storage_type) + " storage context to read layers list" << std::endl;
-            return NULL;
-        }
-
-        int size = -1;
-        uint8_t* data = context->read_full(size, fo_name);
-
-        if (size < 0) {
-            BOOST_LOG_TRIVIAL(fatal) << "Cannot read layers list " + list_path << std::endl;
-            if (data != NULL) delete[] data;
-            return NULL;
-        }
-        
-        std::istringstream list_content(std::string((char*) data, size));
-        delete[] data; 
-        std::string layer_desc;    
-        while (std::getline(list_content, layer_desc)) {
-            Layer* layer = new Layer(layer_desc, services_configuration);
-            if ( layer->is_ok() ) {
-                services_configuration->add_layer ( layer );
-            } else {
-                BOOST_LOG_TRIVIAL(error) << "Cannot load layer " << layer_desc << ": " << layer->get_error_message();
-                delete layer;
-            }
-        }
-    }
-
-    BOOST_LOG_TRIVIAL(info) << services_configuration->get_layers_count() << " layer(s) loaded" ;
-
     // Instanciation du serveur
     return new Rok4Server ( server_configuration, services_configuration );
 }
 
 /**
  * \~french
- * \brief Force le rechargement de la configuration
+ * \brief Demande le rechargement de la configuration
+ * \details Le rechargement est effectué par le thread dédié, le gestionnaire de signal ne fait que le réveiller
  * \~english
- * \brief Force configuration reload
+ * \brief Ask for configuration reload
+ * \details Reload is done by the dedicated thread, signal handler only wakes it up
  */
 void reload_configuration ( int signum ) {
-    if ( defer_signal ) {
-        timeval now;
-        gettimeofday ( &now, NULL );
-        double delta = ( now.tv_sec - signal_timestamp.tv_sec ) *1000000LL + ( now.tv_usec - signal_timestamp.tv_usec );
-        if ( delta > signal_defering_min_time ) {
-            signal_pending = signum;
+    if ( ! shutting_down ) {
+        sem_post ( &reload_semaphore );
+    }
+}
+
+/**
+ * \~french
+ * \brief Boucle du thread de rechargement de la configuration
+ * \details Une nouvelle configuration des services et des couches est construite pendant que les requêtes continuent d'être traitées avec l'ancienne.
+ * Elle est ensuite publiée de manière atomique : les requêtes en cours gardent l'ancienne configuration jusqu'à leur fin.
+ * Les anciens TMS et styles ne sont supprimés qu'une fois l'ancienne configuration libérée par tous ses lecteurs.
+ * Les paramètres propres au serveur (threads, port, journalisation) ne sont pas rechargés.
+ * \~english
+ * \brief Configuration reload thread loop
+ * \details A new services and layers configuration is built while requests are still processed with the old one.
+ * It is then atomically published : in-flight requests keep the old configuration until they finish.
+ * Old TMS and styles are deleted only once the old configuration has been released by all its readers.
+ * Server specific parameters (threads, port, logging) are not reloaded.
+ */
+void* reload_loop ( void* arg ) {
+    while ( true ) {
+        while ( sem_wait ( &reload_semaphore ) != 0 && errno == EINTR ) {}
+
+        if ( shutting_down ) {
+            break;
         }
-    } else {
-        defer_signal++;
-        signal_pending = 0;
-        timeval begin;
-        gettimeofday ( &begin, NULL );
-        signal_timestamp.tv_sec = begin.tv_sec;
-        signal_timestamp.tv_usec = begin.tv_usec;
-        reload = true;
+
+        // Plusieurs demandes reçues pendant le rechargement précédent n'en font qu'une
+        while ( sem_trywait ( &reload_semaphore ) == 0 ) {}
+
         std::cout<<  "Rechargement du serveur rok4" << "["<< getpid() <<"]" <<std::endl;
+        BOOST_LOG_TRIVIAL(info) << "Configuration reload" ;
+
+        ServerConfiguration* server_configuration = new ServerConfiguration( server_configuration_path );
+        if ( ! server_configuration->is_ok() ) {
+            BOOST_LOG_TRIVIAL(error) << "Cannot reload server configuration: " << server_configuration->get_error_message();
+            delete server_configuration;
+            continue;
+        }
 
         // On veut que le chargement de configuration construise de nouvelles instances des styles et TMS, qui ont potentiellement changé
-        TmsBook::send_to_trash();
-        StyleBook::send_to_trash();
+        Books::send_to_trash();
 
-        rok4server_instance_tmp = load_configuration();
-        if ( ! rok4server_instance_tmp ){
+        ServicesConfiguration* services_configuration = load_services_configuration(server_configuration);
+        delete server_configuration;
+
+        if ( services_configuration == NULL ) {
+            // Les TMS et styles à la poubelle sont toujours utilisés par la configuration courante, on ne les supprime pas
             std::cout<<  "Erreur lors du rechargement du serveur rok4" << "["<< getpid() <<"]" <<std::endl;
-            return;
+            BOOST_LOG_TRIVIAL(error) << "Configuration reload failed, current configuration is kept" ;
+            continue;
         }
-        rok4server_instance->terminate();
+
+        // Publication, puis attente de la fin des requêtes utilisant l'ancienne configuration
+        rok4server_instance->swap_services_configuration ( services_configuration );
+
+        // Lors du rechargement on a mis à la poubelle tous les anciens TMS et styles
+        // Plus aucune requête ne les utilise, on peut maintenant les supprimer
+        Books::empty_trash();
+
+        // Les tuiles en cache ont pu être calculées avec d'anciennes couches, styles ou TMS
+        TileCache::clean();
+
+        BOOST_LOG_TRIVIAL(info) << "Configuration reloaded" ;
     }
+
+    return 0;
 }
 /**
  * \~french
@@ -266,7 +327,8 @@ void shutdown_server ( int signum ) {
         // Do nothing because rok4 is going to shutdown...
     } else {
         defer_signal++;
-        reload = false;
+        shutting_down = 1;
+        sem_post ( &reload_semaphore );
         rok4server_instance->terminate();
     }
 }
@@ -300,10 +362,8 @@ std::string get_locale_path() {
  */
 int main ( int argc, char** argv ) {
 
-    bool first_start = true;
-    int sock = 0;
-    reload = true;
     defer_signal = 1;
+    sem_init ( &reload_semaphore, 0, 0 );
     /* install Signal Handler for Conf Reloadind and Server Shutdown*/
     struct sigaction sa;
     sigemptyset ( &sa.sa_mask );
@@ -351,61 +411,44 @@ int main ( int argc, char** argv ) {
     }
 
     // Demarrage du serveur
-    while ( reload ) {
+    int pid = getpid();
+    std::cout<<  "Server start " << "["<< pid <<"]" <<std::endl;
 
-        reload = false;
-        int pid = getpid();
-        std::cout<<  "Server start " << "["<< pid <<"]" <<std::endl;
+    rok4server_instance = load_configuration();
+    if ( !rok4server_instance ) {
+        return 1;
+    }
+    rok4server_instance->initialize_fcgi();
 
-        if ( first_start ) {
-            rok4server_instance = load_configuration();
-            if ( !rok4server_instance ) {
-                return 1;
-            }
-            rok4server_instance->initialize_fcgi();
-            first_start = false;
-        } else {
-            std::cout<<  "Configuration update " << "["<< pid <<"]" <<std::endl;
-            if ( rok4server_instance_tmp ) {
-                std::cout<<  "Servers switch " << "["<< pid <<"]" <<std::endl;
-                rok4server_instance = rok4server_instance_tmp;
-                rok4server_instance_tmp = 0;
-            }
-            rok4server_instance->set_fcgi_socket ( sock );
-        }
+    auto start = std::chrono::system_clock::now();
+    std::time_t time = std::chrono::system_clock::to_time_t(start);
+    Process::set_pid(pid);
+    Process::set_time(time);
 
-        auto start = std::chrono::system_clock::now();
-        std::time_t time = std::chrono::system_clock::to_time_t(start);
-        Process::set_pid(pid);
-        Process::set_time(time);
+    // Les rechargements sont traités par un thread dédié, sans arrêter le serveur
+    pthread_t reload_thread;
+    pthread_create ( &reload_thread, NULL, reload_loop, NULL );
 
-        // Remove Event Lock
-        defer_signal--;
-        
-        rok4server_instance->run(signal_pending);
-
-
-        if ( reload ) {
-            // Rechargement du serveur
-            BOOST_LOG_TRIVIAL(info) << "Configuration reload" ;
-            sock = rok4server_instance->get_fcgi_socket();
-            // Lors du rechargement on a mis à la poubelle tous les anciens TMS et styles
-            // On peut maintenant les supprimer
-            TmsBook::empty_trash();
-            StyleBook::empty_trash();
-        } else {
-            // Extinction du serveur
-            BOOST_LOG_TRIVIAL(info) << "Server shutdown" ;
-            // On va vouloir supprimer tous les styles et TMS, on les envoie donc à la poubelle
-            TmsBook::send_to_trash();
-            StyleBook::send_to_trash();
-        }
+    // Remove Event Lock
+    defer_signal--;
 
-        delete rok4server_instance;
-    }
+    rok4server_instance->run();
+
+    // Extinction du serveur
+    BOOST_LOG_TRIVIAL(info) << "Server shutdown" ;
+
+    // Un éventuel rechargement en cours est terminé avant de tout supprimer
+    shutting_down = 1;
+    sem_post ( &reload_semaphore );
+    pthread_join ( reload_thread, NULL );
+
+    // On va vouloir supprimer tous les styles et TMS, on les envoie donc à la poubelle
+    Books::send_to_trash();
+
+    delete rok4server_instance;
+    sem_destroy ( &reload_semaphore );
 
-    TmsBook::empty_trash();
-    StyleBook::empty_trash();
+    Books::empty_trash();
     CrsBook::clean_crss();
     StoragePool::clean_storages();
     IndexCache::clean_indexes();
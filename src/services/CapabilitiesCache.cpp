@@ -0,0 +1,151 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file services/CapabilitiesCache.cpp
+ ** \~french
+ * \brief Implémentation de la classe CapabilitiesCache
+ ** \~english
+ * \brief Implements classe CapabilitiesCache
+ */
+
+#include <boost/log/trivial.hpp>
+
+#include "services/CapabilitiesCache.h"
+#include "configurations/Services.h"
+
+bool CapabilitiesCache::get_document(std::shared_ptr<const EncodedDocument>& doc, bool& is_stale) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (! document) {
+        return false;
+    }
+    doc = document;
+    is_stale = stale;
+    return true;
+}
+
+CapabilitiesCache::Build CapabilitiesCache::begin_build(ServicesConfiguration* services, unsigned long gen) {
+    Build build;
+    build.generation = gen;
+    build.current = services->are_pinned_layers_current();
+    build.complete = services->are_layers_loaded();
+    return build;
+}
+
+CapabilitiesCache::Build CapabilitiesCache::begin_build(ServicesConfiguration* services) {
+    unsigned long gen;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        gen = generation;
+    }
+    return begin_build(services, gen);
+}
+
+void CapabilitiesCache::set_document(std::shared_ptr<const EncodedDocument> doc, const Build& build) {
+    if (! build.is_document_cacheable()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    document = doc;
+    stale = (build.generation != generation);
+}
+
+bool CapabilitiesCache::get_fragment(const std::string& id, std::string& fragment) {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::map<std::string, std::string>::iterator it = fragments.find(id);
+    if (it == fragments.end()) {
+        return false;
+    }
+    fragment = it->second;
+    return true;
+}
+
+void CapabilitiesCache::set_fragment(const std::string& id, const std::string& fragment, const Build& build) {
+    if (! build.current) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if (build.generation == generation) {
+        fragments[id] = fragment;
+    }
+}
+
+void CapabilitiesCache::invalidate_layer(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    generation++;
+    fragments.erase(id);
+    stale = true;
+}
+
+void CapabilitiesCache::clear() {
+    std::lock_guard<std::mutex> lock(mtx);
+    generation++;
+    fragments.clear();
+    document.reset();
+    stale = false;
+}
+
+void CapabilitiesCache::refresh(std::function<void()> build) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (refreshing) {
+        return;
+    }
+
+    // Le thread de la reconstruction précédente est terminé, ou sur le point de l'être
+    if (refresher.joinable()) {
+        refresher.join();
+    }
+
+    refreshing = true;
+    refresher = std::thread([this, build]() {
+        BOOST_LOG_TRIVIAL(debug) << "Reconstruction en arrière-plan d'un document de capacités";
+        try {
+            build();
+        } catch (...) {
+            BOOST_LOG_TRIVIAL(error) << "Echec de la reconstruction en arrière-plan d'un document de capacités";
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        refreshing = false;
+    });
+}
+
+CapabilitiesCache::~CapabilitiesCache() {
+    if (refresher.joinable()) {
+        refresher.join();
+    }
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file services/CapabilitiesCache.h
+ ** \~french
+ * \brief Définition de la classe CapabilitiesCache
+ ** \~english
+ * \brief Define classe CapabilitiesCache
+ */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "core/EncodedDocument.h"
+
+class ServicesConfiguration;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache d'un document de capacités et des fragments de ses couches
+ * \details Le document est écrit en y insérant les fragments sérialisés de chaque couche. La modification d'une couche n'invalide que son fragment et rend le document obsolète : celui-ci reste servi pendant que sa reconstruction, qui ne resérialise que les fragments manquants, est faite en arrière-plan.
+ *
+ * Un numéro de génération, incrémenté à chaque invalidation, permet d'ignorer les fragments et documents calculés avant une invalidation survenue pendant leur calcul.
+ * \~english
+ * \brief Cache of a capabilities document and of its layers fragments
+ * \details Document is written by inserting each layer's serialized fragments. A layer modification only invalidates its fragment and makes the document stale : it is still served while it is rebuilt in background, only missing fragments being serialized again.
+ *
+ * A generation number, incremented by each invalidation, allows to ignore fragments and documents computed before an invalidation occurring during their computation.
+ */
+class CapabilitiesCache {
+
+private:
+
+    std::mutex mtx;
+
+    /**
+     * \~french \brief Dernier document assemblé, avec sa variante compressée, nul si aucun
+     * \~english \brief Last assembled document, with its compressed variant, null if none
+     */
+    std::shared_ptr<const EncodedDocument> document;
+
+    /**
+     * \~french \brief Le document ne tient pas compte de modifications de couche
+     * \~english \brief Document does not take into account layer modifications
+     */
+    bool stale;
+
+    /**
+     * \~french \brief Fragments sérialisés, par identifiant de couche
+     * \~english \brief Serialized fragments, by layer identifier
+     */
+    std::map<std::string, std::string> fragments;
+
+    unsigned long generation;
+
+    /**
+     * \~french \brief Thread de reconstruction en arrière-plan
+     * \~english \brief Background rebuilding thread
+     */
+    std::thread refresher;
+    bool refreshing;
+
+public:
+
+    /**
+     * \~french
+     * \brief Construction d'un document, avec ce qui peut en être mis en cache
+     * \details La génération est lue avant de vérifier que les couches figées par la requête sont toujours les couches courantes : l'administration publie une couche avant d'invalider les caches, une couche remplacée avant la lecture de la génération est donc toujours détectée.
+     * \~english
+     * \brief Document building, with what can be cached
+     * \details Generation is read before checking that layers pinned by the request are still the current ones : administration publishes a layer before invalidating caches, a layer replaced before generation reading is then always detected.
+     */
+    struct Build {
+        /**
+         * \~french \brief Génération lue au début de la construction
+         * \~english \brief Generation read when building starts
+         */
+        unsigned long generation;
+        /**
+         * \~french \brief Les couches figées sont les couches courantes : fragments et document peuvent être mis en cache
+         * \~english \brief Pinned layers are the current ones : fragments and document can be cached
+         */
+        bool current;
+        /**
+         * \~french \brief Toutes les couches sont chargées : le document est complet
+         * \~english \brief All layers are loaded : document is complete
+         */
+        bool complete;
+
+        /**
+         * \~french \brief Le document peut être mis en cache
+         * \~english \brief Document can be cached
+         */
+        bool is_document_cacheable() const { return current && complete; };
+    };
+
+    CapabilitiesCache() : stale(false), generation(0), refreshing(false) { };
+
+    /**
+     * \~french
+     * \brief Commence la construction d'un document à partir d'une génération déjà lue
+     * \details Pour les caches de documents gérant leur propre génération
+     * \~english
+     * \brief Start building a document from an already read generation
+     * \details For documents caches managing their own generation
+     */
+    static Build begin_build(ServicesConfiguration* services, unsigned long gen);
+
+    /**
+     * \~french
+     * \brief Commence la construction d'un document, à appeler avant de lire les couches
+     * \~english
+     * \brief Start building a document, to call before reading layers
+     */
+    Build begin_build(ServicesConfiguration* services);
+
+    /**
+     * \~french
+     * \brief Retourne le document courant
+     * \param[out] doc Document
+     * \param[out] is_stale Le document est obsolète et doit être reconstruit
+     * \return Faux si aucun document n'est en cache
+     * \~english
+     * \brief Return current document
+     * \param[out] doc Document
+     * \param[out] is_stale Document is stale and have to be rebuilt
+     * \return False if no document is cached
+     */
+    bool get_document(std::shared_ptr<const EncodedDocument>& doc, bool& is_stale);
+
+    /**
+     * \~french
+     * \brief Mémorise le document assemblé, s'il peut être mis en cache
+     * \details Il est marqué obsolète si une invalidation est survenue depuis le début de la construction
+     * \~english
+     * \brief Store the assembled document, if it can be cached
+     * \details It is marked as stale if an invalidation occured since building start
+     */
+    void set_document(std::shared_ptr<const EncodedDocument> doc, const Build& build);
+
+    bool get_fragment(const std::string& id, std::string& fragment);
+
+    /**
+     * \~french
+     * \brief Mémorise le fragment d'une couche, si les couches figées sont courantes et qu'aucune invalidation n'est survenue depuis le début de la construction
+     * \~english
+     * \brief Store a layer's fragment, if pinned layers are current and no invalidation occured since building start
+     */
+    void set_fragment(const std::string& id, const std::string& fragment, const Build& build);
+
+    /**
+     * \~french
+     * \brief Invalide le fragment d'une couche ajoutée, modifiée ou supprimée, le document devient obsolète
+     * \~english
+     * \brief Invalidate fragment of an added, modified or removed layer, document becomes stale
+     */
+    void invalidate_layer(const std::string& id);
+
+    /**
+     * \~french
+     * \brief Vide entièrement le cache
+     * \~english
+     * \brief Empty the whole cache
+     */
+    void clear();
+
+    /**
+     * \~french
+     * \brief Lance la reconstruction en arrière-plan, si aucune n'est en cours
+     * \~english
+     * \brief Start background rebuilding, if none is running
+     */
+    void refresh(std::function<void()> build);
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details Attend la fin de la reconstruction en cours
+     * \~english
+     * \brief Destructor
+     * \details Wait for the current rebuilding
+     */
+    ~CapabilitiesCache();
+};
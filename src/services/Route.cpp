@@ -0,0 +1,157 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file services/Route.cpp
+ ** \~french
+ * \brief Implémentation de la classe Route
+ ** \~english
+ * \brief Implements classe Route
+ */
+
+#include <cstring>
+#include <boost/log/trivial.hpp>
+
+#include "services/Route.h"
+#include "core/Request.h"
+
+Route::Route(std::string m, std::string pattern, int op) : method(m), optional_trailing_slash(false), operation(op) {
+
+    if (pattern.size() >= 2 && pattern.compare(pattern.size() - 2, 2, "/?") == 0) {
+        optional_trailing_slash = true;
+        pattern.erase(pattern.size() - 2);
+    }
+
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        // Chaque segment commence par un '/'
+        size_t end = pattern.find('/', pos + 1);
+        if (end == std::string::npos) end = pattern.size();
+        std::string s = pattern.substr(pos + 1, end - pos - 1);
+
+        Segment seg;
+        if (s.size() > 2 && s.front() == '{' && s.back() == '}') {
+            size_t dot = s.find("}.{");
+            seg.type = (dot == std::string::npos) ? PARAMETER : PARAMETER_WITH_EXTENSION;
+        } else {
+            seg.type = LITERAL;
+            seg.literal = s;
+        }
+        segments.push_back(seg);
+
+        pos = end;
+    }
+}
+
+bool Route::match(Request* req, size_t offset) const {
+
+    if (req->method != method) {
+        return false;
+    }
+
+    const char* path = req->path.c_str();
+    size_t length = req->path.size();
+
+    // Positions et tailles des paramètres, les chaînes ne sont construites qu'en cas de succès
+    size_t starts[MAX_PARAMETERS];
+    size_t sizes[MAX_PARAMETERS];
+    int count = 0;
+
+    size_t pos = offset;
+    for (const Segment& seg : segments) {
+        if (pos >= length || path[pos] != '/') {
+            return false;
+        }
+        pos++;
+
+        const char* slash = (const char*) memchr(path + pos, '/', length - pos);
+        size_t end = (slash == NULL) ? length : slash - path;
+        size_t size = end - pos;
+
+        if (size == 0) {
+            return false;
+        }
+
+        switch (seg.type) {
+            case LITERAL:
+                if (size != seg.literal.size() || memcmp(path + pos, seg.literal.data(), size) != 0) {
+                    return false;
+                }
+                break;
+            case PARAMETER:
+                if (count >= MAX_PARAMETERS) return false;
+                starts[count] = pos;
+                sizes[count] = size;
+                count++;
+                break;
+            case PARAMETER_WITH_EXTENSION: {
+                if (count + 1 >= MAX_PARAMETERS) return false;
+                // Séparation sur le dernier point du segment, la partie avant ne pouvant être vide
+                size_t dot = end;
+                while (dot > pos + 1 && path[dot - 1] != '.') dot--;
+                if (dot <= pos + 1) {
+                    return false;
+                }
+                starts[count] = pos;
+                sizes[count] = dot - 1 - pos;
+                count++;
+                starts[count] = dot;
+                sizes[count] = end - dot;
+                count++;
+                break;
+            }
+        }
+
+        pos = end;
+    }
+
+    if (optional_trailing_slash && pos + 1 == length && path[pos] == '/') {
+        pos++;
+    }
+
+    if (pos != length) {
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        req->path_params.push_back(req->path.substr(starts[i], sizes[i]));
+        BOOST_LOG_TRIVIAL(debug) << "Path param : " << req->path_params.back();
+    }
+
+    return true;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file services/Route.h
+ ** \~french
+ * \brief Définition de la classe Route
+ ** \~english
+ * \brief Define classe Route
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class Request;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Route d'un service, compilée une seule fois à la construction du service
+ * \details Le motif est découpé en segments, comparés un à un au chemin de la requête, sans expression régulière. Syntaxe du motif (relatif à la racine du service) :
+ *  - `/collections` : segment littéral
+ *  - `/{collection}` : paramètre de chemin (un segment non vide)
+ *  - `/{row}.{extension}` : deux paramètres de chemin, séparés par le dernier point du segment
+ *  - `/?` en fin de motif : barre oblique finale facultative
+ *
+ * Les paramètres ne sont extraits dans la requête qu'une fois la route reconnue.
+ * \~english
+ * \brief Service route, compiled only once when the service is built
+ * \details Pattern is split into segments, compared one by one to the request path, without regular expression. Pattern syntax (relative to the service root) :
+ *  - `/collections` : literal segment
+ *  - `/{collection}` : path parameter (one non empty segment)
+ *  - `/{row}.{extension}` : two path parameters, split by the last dot of the segment
+ *  - `/?` at the pattern's end : optional trailing slash
+ *
+ * Parameters are extracted into the request only once the route is matched.
+ */
+class Route {
+
+private:
+
+    enum eSegmentType {
+        LITERAL,
+        PARAMETER,
+        PARAMETER_WITH_EXTENSION
+    };
+
+    struct Segment {
+        eSegmentType type;
+        std::string literal;
+    };
+
+    /**
+     * \~french \brief Nombre maximal de paramètres de chemin
+     * \~english \brief Max path parameters count
+     */
+    static const int MAX_PARAMETERS = 16;
+
+    std::string method;
+    std::vector<Segment> segments;
+    bool optional_trailing_slash;
+
+    /**
+     * \~french \brief Identifiant de l'opération, propre au service
+     * \~english \brief Operation identifier, specific to the service
+     */
+    int operation;
+
+public:
+    /**
+     * \~french
+     * \brief Compilation d'une route
+     * \param[in] m méthode HTTP
+     * \param[in] pattern motif du chemin, relatif à la racine du service
+     * \param[in] op identifiant de l'opération
+     * \~english
+     * \brief Route compilation
+     * \param[in] m HTTP method
+     * \param[in] pattern path pattern, relative to the service root
+     * \param[in] op operation identifier
+     */
+    Route(std::string m, std::string pattern, int op);
+
+    /**
+     * \~french
+     * \brief Teste la requête vis à vis de la route
+     * \details Si la requête correspond, les paramètres du chemin y sont ajoutés
+     * \param[in] req Requête à tester
+     * \param[in] offset Position du début du chemin relatif à la racine du service
+     * \~english
+     * \brief Test if request match the route
+     * \details If request matches, path params are added
+     * \param[in] req Request to test
+     * \param[in] offset Start position of the path relative to the service root
+     */
+    bool match(Request* req, size_t offset) const;
+
+    int get_operation() const { return operation; };
+};
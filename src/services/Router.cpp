@@ -46,9 +46,10 @@
 #include <iostream>
 #include <stdio.h>
 #include <string.h>
-#include <sstream>
 #include <boost/log/trivial.hpp>
 #include <stdexcept>
+#include <memory>
+#include <chrono>
 
 #include "services/Router.h"
 #include "services/health/Service.h"
@@ -57,6 +58,9 @@
 #include "services/admin/Service.h"
 #include "services/ogcapi/Service.h"
 #include "services/wms/Service.h"
+#include "core/Metrics.h"
+#include "core/AccessLog.h"
+#include "core/Trace.h"
 
 std::string get_message_from_http_status ( int http_status ) {
     switch ( http_status ) {
@@ -64,6 +68,8 @@ std::string get_message_from_http_status ( int http_status ) {
         return "OK" ;
     case 204 :
         return "No Content" ;
+    case 304 :
+        return "Not Modified" ;
     case 400 :
         return "Bad Request" ;
     case 404 :
@@ -85,17 +91,18 @@ std::string get_message_from_http_status ( int http_status ) {
  * \~french
  * \brief Méthode commune pour générer l'en-tête HTTP en fonction du status code HTTP
  * \param[in] http_status Code de status HTTP
- * \return élément status de l'en-tête HTTP
+ * \param[in,out] header en-tête auquel ajouter l'élément status
  * \~english
  * \brief Common function to generate HTTP headers using the HTTP status code
  * \param[in] http_status HTTP status code
- * \return HTTP header status element
+ * \param[in,out] header header to append the status element to
  */
-std::string get_status_header ( int http_status ) {
-    // Creation de l'en-tete
-    std::stringstream out;
-    out << http_status;
-    return "Status: "+out.str() +" "+get_message_from_http_status ( http_status ) +"\r\n" ;
+void append_status_header ( int http_status, std::string& header ) {
+    header.append ( "Status: " );
+    header.append ( std::to_string ( http_status ) );
+    header.push_back ( ' ' );
+    header.append ( get_message_from_http_status ( http_status ) );
+    header.append ( "\r\n" );
 }
 
 /**
@@ -163,127 +170,203 @@ void print_fcgi_error ( int error ) {
         BOOST_LOG_TRIVIAL(error) <<   "Erreur inconnue" ;
 }
 
+/**
+ * \~french \brief Taille du tampon de copie des flux, alloué une fois par thread
+ * \~english \brief Stream copy buffer size, allocated once per thread
+ */
+static const size_t STREAM_BUFFER_SIZE = 1 << 18;
+
+/**
+ * \~french \brief Taille maximale d'un contenu en mémoire envoyé avec l'en-tête, en une seule écriture
+ * \~english \brief Max size of an in memory content sent with the header, with a single write
+ */
+static const size_t INLINE_BODY_MAX_SIZE = 1 << 16;
+
+/**
+ * \~french \brief Tampons réutilisés d'une réponse à l'autre par chaque thread de traitement
+ * \~english \brief Buffers reused from one response to another by each worker thread
+ */
+static thread_local std::string header_buffer;
+static thread_local std::unique_ptr<uint8_t[]> stream_buffer;
+
+/**
+ * \~french
+ * \brief Écriture complète d'un tampon dans le flux de sortie de la requête
+ * \return -1 en cas de problème, 0 sinon
+ * \~english
+ * \brief Write a whole buffer in the request output stream
+ * \return -1 if error, else 0
+ */
+int write_all ( const uint8_t* data, size_t size, Request* request ) {
+    size_t wr = 0;
+    while ( wr < size ) {
+        // On ne donne que ce qu'il reste à écrire
+        int w = FCGX_PutStr ( ( const char* ) ( data + wr ), size - wr, request->fcgx_request->out );
+        if ( w < 0 ) {
+            BOOST_LOG_TRIVIAL(error) <<   "Echec d'ecriture dans le flux de sortie de la requete FCGI " << request->fcgx_request->requestId ;
+            print_fcgi_error ( FCGX_GetError ( request->fcgx_request->out ) );
+            return -1;
+        }
+        wr += w;
+        request->response_bytes += w;
+    }
+    return 0;
+}
+
 /**
  * \~french
  * \brief Copie d'un flux d'entree dans le flux de sortie de l'objet request de type FCGX_Request
+ * \details Les flux dont le contenu est en mémoire sont envoyés sans copie intermédiaire, avec l'en-tête quand ils sont petits. Les autres sont copiés par morceaux via un tampon propre au thread.
  * \return -1 en cas de problème, 0 sinon
  * \~english
  * \brief Copy a data stream in the FCGX_Request output stream
+ * \details Streams with content in memory are sent without intermediate copy, with header when small. Others are copied in chunks using a thread's own buffer.
  * \return -1 if error, else 0
  */
 int sendresponse ( DataStream* stream, Request* request ) {
 
-
     // Creation de l'en-tete
-    std::string statusHeader= get_status_header ( stream->get_http_status() );
-    FCGX_PutStr ( statusHeader.data(),statusHeader.size(),request->fcgx_request->out );
+    std::string& header = header_buffer;
+    header.clear();
+    request->response_status = stream->get_http_status();
+    append_status_header ( stream->get_http_status(), header );
+
+    std::string type = stream->get_type();
+    std::string encoding = stream->get_encoding();
+    unsigned int length = stream->get_length();
 
-    if (stream->get_type() != "") {
-        FCGX_PutStr ( "Content-Type: ",14,request->fcgx_request->out );
-        FCGX_PutStr ( stream->get_type().c_str(), strlen ( stream->get_type().c_str() ),request->fcgx_request->out );
+    if (type != "") {
+        header.append ( "Content-Type: " );
+        header.append ( type );
+        header.append ( "\r\n" );
     }
-    if (stream->get_encoding() != "" ){
-        FCGX_PutStr ( "\r\nContent-Encoding: ",20,request->fcgx_request->out );
-        FCGX_PutStr ( stream->get_encoding().c_str(), strlen ( stream->get_encoding().c_str() ),request->fcgx_request->out );
+    if (encoding != "" ){
+        header.append ( "Content-Encoding: " );
+        header.append ( encoding );
+        header.append ( "\r\n" );
     }
-    if ( stream->get_length() != 0 ) {
-        std::stringstream ss;
-        ss << stream->get_length();
-        std::string lengthStr = ss.str();
-        FCGX_PutStr ( "\r\nContent-Length: ",18,request->fcgx_request->out );
-        FCGX_PutStr ( lengthStr.c_str(), strlen ( lengthStr.c_str() ),request->fcgx_request->out );
+    if ( length != 0 ) {
+        header.append ( "Content-Length: " );
+        header.append ( std::to_string ( length ) );
+        header.append ( "\r\n" );
     }
 
-    if (stream->get_type() != "") {
-        std::string filename = get_default_filename ( stream->get_type(), request );
+    if (type != "") {
+        std::string filename = get_default_filename ( type, request );
         BOOST_LOG_TRIVIAL(debug) <<  filename ;
 
-        FCGX_PutStr ( "\r\nContent-Disposition: ", 23, request->fcgx_request->out );
+        header.append ( "Content-Disposition: " );
         if (request->has_query_param("filename")) {
-            FCGX_PutStr ( "attachment; ", 12, request->fcgx_request->out );
+            header.append ( "attachment; " );
         }
-        FCGX_PutStr ( "filename=\"", 10, request->fcgx_request->out );
-        FCGX_PutStr ( filename.data(),filename.size(), request->fcgx_request->out );
-        FCGX_PutStr ( "\"",1,request->fcgx_request->out );
+        header.append ( "filename=\"" );
+        header.append ( filename );
+        header.append ( "\"\r\n" );
     }
-    
-    if (stream->get_type() != "" || stream->get_length() != 0) {
-        FCGX_PutStr ( "\r\n\r\n",4,request->fcgx_request->out );
-    } else {
-        FCGX_PutStr ( "\r\n",2,request->fcgx_request->out );
+
+    // En-têtes propres à la requête (ETag, cache...)
+    for ( auto const& h : request->response_headers ) {
+        header.append ( h.first );
+        header.append ( ": " );
+        header.append ( h.second );
+        header.append ( "\r\n" );
     }
 
-    // Copie dans le flux de sortie
-    uint8_t *buffer = new uint8_t[2 << 20];
-    size_t size_to_read = 2 << 20;
-    int pos = 0;
-
-    // Ecriture progressive du flux d'entree dans le flux de sortie
-    while ( true ) {
-        // Recuperation d'une portion du flux d'entree
-
-        size_t read_size = stream->read ( buffer, size_to_read );
-        if ( read_size==0 )
-            break;
-        int wr = 0;
-        // Ecriture iterative de la portion du flux d'entree dans le flux de sortie
-        while ( wr < read_size ) {
-            // Taille ecrite dans le flux de sortie
-            int w = FCGX_PutStr ( ( char* ) ( buffer + wr ), read_size,request->fcgx_request->out );
-            if ( w < 0 ) {
-                BOOST_LOG_TRIVIAL(error) <<   "Echec d'ecriture dans le flux de sortie de la requete FCGI " << request->fcgx_request->requestId ;
-                print_fcgi_error ( FCGX_GetError ( request->fcgx_request->out ) );
-                delete stream;
-                delete[] buffer;
-                return -1;
-            }
-            wr += w;
+    if ( Trace::is_header_enabled() ) {
+        header.append ( "Server-Timing: " );
+        request->trace.append_server_timing ( header );
+        header.append ( "\r\n" );
+    }
+
+    header.append ( "\r\n" );
+
+    // Les flux qui ne sont pas en mémoire sont calculés au fil de leur envoi
+    Trace::Timer timer ( &request->trace, Trace::PHASE_SEND );
+
+    int status = 0;
+
+    ContiguousDataStream* contiguous = dynamic_cast<ContiguousDataStream*> ( stream );
+    if ( contiguous != NULL ) {
+        // Contenu déjà en mémoire : pas de tampon intermédiaire
+        size_t size;
+        const uint8_t* data = contiguous->get_data ( size );
+
+        if ( size <= INLINE_BODY_MAX_SIZE ) {
+            header.append ( ( const char* ) data, size );
+            status = write_all ( ( const uint8_t* ) header.data(), header.size(), request );
+        } else {
+            status = write_all ( ( const uint8_t* ) header.data(), header.size(), request );
+            if ( status == 0 ) status = write_all ( data, size, request );
+        }
+    } else {
+        status = write_all ( ( const uint8_t* ) header.data(), header.size(), request );
+
+        if ( ! stream_buffer ) {
+            stream_buffer.reset ( new uint8_t[STREAM_BUFFER_SIZE] );
         }
-        if ( wr != read_size ) {
-            BOOST_LOG_TRIVIAL(debug) <<   "Nombre incorrect d'octets ecrits dans le flux de sortie" ;
-            delete stream;
-            stream = 0;
-            delete[] buffer;
-            buffer = 0;
-            break;
+
+        // Ecriture progressive du flux d'entree dans le flux de sortie
+        while ( status == 0 ) {
+            // Recuperation d'une portion du flux d'entree
+            size_t read_size = stream->read ( stream_buffer.get(), STREAM_BUFFER_SIZE );
+            if ( read_size == 0 )
+                break;
+            status = write_all ( stream_buffer.get(), read_size, request );
         }
-        pos += read_size;
     }
-    if ( stream ) {
-        delete stream;
-    }
-    if ( buffer ) {
-        delete[] buffer;
+
+    delete stream;
+
+    if ( status != 0 ) {
+        return -1;
     }
+
     BOOST_LOG_TRIVIAL(debug) <<   "End of Response" ;
     return 0;
 }
 
+/**
+ * \~french
+ * \brief Service pour les métriques
+ * \~english
+ * \brief Service for metrics
+ */
+Metrics::eService get_metrics_service ( Service* service, ServicesConfiguration* services ) {
+    if ( service == NULL ) return Metrics::SERVICE_NONE;
+    if ( service == services->get_health_service() ) return Metrics::SERVICE_HEALTH;
+    if ( service == services->get_admin_service() ) return Metrics::SERVICE_ADMIN;
+    if ( service == services->get_wms_service() ) return Metrics::SERVICE_WMS;
+    if ( service == services->get_wmts_service() ) return Metrics::SERVICE_WMTS;
+    if ( service == services->get_tms_service() ) return Metrics::SERVICE_TMS;
+    if ( service == services->get_ogcapi_service() ) return Metrics::SERVICE_OGCAPI;
+    return Metrics::SERVICE_NONE;
+}
+
 void Router::process_request(Request* req, ServicesConfiguration* services) {
 
+    // Lecture de la requête, depuis sa réception
+    req->trace.add(Trace::PHASE_PARSE, req->trace.get_elapsed());
+    Metrics::eService metrics_service = Metrics::SERVICE_NONE;
+
     bool enabled = services->is_enabled();
 
     try {
 
-        BOOST_LOG_TRIVIAL(info) << "Request: " << req->to_string();
+        BOOST_LOG_TRIVIAL(debug) << "Request: " << req->to_string();
 
-        if (services->get_health_service()->match_request(req)) {
-            sendresponse(services->get_health_service()->process_request(req, services), req);
-        }
-        else if (services->get_admin_service()->match_request(req)) {
-            sendresponse(services->get_admin_service()->process_request(req, services), req);
-        }
-        else if (enabled && services->get_tms_service()->match_request(req)) {
-            sendresponse(services->get_tms_service()->process_request(req, services), req);
-        }
-        else if (enabled && services->get_wmts_service()->match_request(req)) {
-            sendresponse(services->get_wmts_service()->process_request(req, services), req);
-        }
-        else if (enabled && services->get_ogcapi_service()->match_request(req)) {
-            sendresponse(services->get_ogcapi_service()->process_request(req, services), req);
-        }
-        else if (enabled && services->get_wms_service()->match_request(req)) {
-            sendresponse(services->get_wms_service()->process_request(req, services), req);
+        Service* service = services->get_service(req->path);
+        metrics_service = get_metrics_service(service, services);
+
+        // Les services de santé et d'administration restent accessibles lorsque les services sont désactivés
+        if (service != NULL && (enabled || service == services->get_health_service() || service == services->get_admin_service())) {
+            DataStream* d = service->process_request(req, services);
+
+            // Les réponses sans politique de cache propre (capacités, métadonnées) suivent la politique globale
+            if (d->get_http_status() == 200 && service != services->get_admin_service() && service != services->get_health_service() && ! req->has_response_header("Cache-Control")) {
+                services->get_default_cache_policy().add_headers(req);
+            }
+
+            sendresponse(d, req);
         }
         else {
             throw new MessageDataStream("{\"error\": \"Bad Request\", \"error_description\": \"Unknown request path\"}", "application/json", 400);
@@ -300,4 +383,12 @@ void Router::process_request(Request* req, ServicesConfiguration* services) {
         BOOST_LOG_TRIVIAL(error) << req->method << " " << req->path;
         sendresponse(new MessageDataStream("{\"error\": \"Internal issue\", \"error_description\": \"Routing error\"}", "application/json", 500), req);
     }
+
+    int64_t duration_ns = req->trace.get_elapsed();
+    Metrics::record(metrics_service, req->operation, req->response_status, req->response_bytes, duration_ns, req->layer);
+    AccessLog::log(req, duration_ns);
+
+    if (Trace::is_slow(duration_ns)) {
+        BOOST_LOG_TRIVIAL(warning) << "Requête lente (" << duration_ns / 1000000 << " ms) : " << req->method << " " << req->path << " [" << req->trace.to_string(duration_ns) << "]";
+    }
 }
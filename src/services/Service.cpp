@@ -46,25 +46,18 @@
 #include "services/Service.h"
 #include "core/Request.h"
 
-bool Service::match_route(std::string path, std::vector<std::string> methods, Request* req) {
-
-    if (std::find(methods.begin(), methods.end(), req->method) == methods.end()) {
-        return false;
-    }
-
-    std::smatch m;
-    if (std::regex_match(req->path, m, std::regex(root_path + path))) {
-
-        for(int i = 1; i < m.size(); i++) {
-            req->path_params.push_back(m[i]);
-            BOOST_LOG_TRIVIAL(debug) << "Path param : " << m[i];
+void Service::add_route(std::string method, std::string pattern, int operation) {
+    routes.push_back(Route(method, pattern, operation));
+}
+
+int Service::match_route(Request* req) {
+    for (const Route& r : routes) {
+        if (r.match(req, root_path.size())) {
+            return r.get_operation();
         }
-
-        return true;
-    } else {
-        return false;
     }
-};
+    return -1;
+}
 
 Service::Service (json11::Json& doc, std::string default_title, std::string default_abstract, std::string default_endpoint_uri, std::string default_root_path) {
 
@@ -128,6 +121,10 @@ Service::Service (json11::Json& doc, std::string default_title, std::string defa
 
     if (doc["root_path"].is_string()) {
         root_path = doc["root_path"].string_value();
+        // Les routes commencent par un '/' : la racine n'en a pas à la fin ("/" devient la racine vide)
+        while (! root_path.empty() && root_path.back() == '/') {
+            root_path.pop_back();
+        }
     } else if (! doc["root_path"].is_null()) {
         error_message = "root_path have to be a string";
         return;
@@ -141,9 +138,3 @@ Service::Service (json11::Json& doc, std::string default_title, std::string defa
         }
     }
 };
-
-bool Service::match_request(Request* req) {
-    return enabled && req->path.rfind(root_path, 0) == 0;
-};
-
-
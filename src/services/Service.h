@@ -45,7 +45,6 @@
 
 #pragma once
 
-#include <regex>
 #include <mutex>
 
 #include <utils/Configuration.h>
@@ -53,6 +52,7 @@
 #include <rok4/datastream/DataStream.h>
 
 #include "configurations/Metadata.h"
+#include "services/Route.h"
 
 class ServicesConfiguration;
 class Request;
@@ -74,27 +74,39 @@ protected:
     Metadata* metadata;
     bool enabled;
 
+    /**
+     * \~french \brief Routes du service, compilées à la construction
+     * \~english \brief Service's routes, compiled at construction
+     */
+    std::vector<Route> routes;
+
     /**
      * \~french
-     * \brief Teste la requête vis à vis de la route
-     * \details La méthode est comparée. Si la requête correspond à la route, les paramètres du chemin sont extraits
-     * \param[in] route Route de validation de la requête
-     * \param[in] req Requête à valider
+     * \brief Ajoute une route au service
+     * \param[in] method Méthode HTTP
+     * \param[in] pattern Motif du chemin, relatif à la racine du service (voir Route)
+     * \param[in] operation Identifiant de l'opération, retourné lorsque la route est reconnue
      * \~english
-     * \brief Test if request match the route
-     * \details Method is tested. If request matches the route, path params are extracted
-     * \param[in] route Route to test request
-     * \param[in] req Request to test
+     * \brief Add a route to the service
+     * \param[in] method HTTP method
+     * \param[in] pattern Path pattern, relative to the service root (see Route)
+     * \param[in] operation Operation identifier, returned when route is matched
      */
-    bool match_route(std::string path, std::vector<std::string> methods, Request* req);
+    void add_route(std::string method, std::string pattern, int operation);
 
     /**
-     * \~french \brief Exclusion mutuelle
-     * \details Pour éviter les modifications concurrentes du cache
-     * \~english \brief Mutual exclusion
-     * \details To avoid concurrent cache updates
+     * \~french
+     * \brief Recherche la route correspondant à la requête
+     * \details Si une route correspond, les paramètres du chemin sont extraits
+     * \param[in] req Requête à tester
+     * \return Identifiant de l'opération, -1 si aucune route ne correspond
+     * \~english
+     * \brief Look for the route matching the request
+     * \details If a route matches, path params are extracted
+     * \param[in] req Request to test
+     * \return Operation identifier, -1 if no route matches
      */
-    std::mutex cache_mtx;
+    int match_route(Request* req);
 
 public:
     /**
@@ -108,8 +120,8 @@ public:
     virtual DataStream* process_request(Request* req, ServicesConfiguration* services) = 0;
 
     std::string get_endpoint_uri() {return endpoint_uri;};
+    std::string get_root_path() {return root_path;};
     bool is_enabled() {return enabled;};
-    bool match_request(Request* req);
 
     /**
      * \~french
@@ -71,36 +71,40 @@ AdminService::AdminService (json11::Json& doc) : Service(doc, "ADMIN service", "
     }
 
     keywords.push_back(Keyword ( "administration" ));
+
+    add_route("POST", "/layers/{layer}", ADDLAYER);
+    add_route("PUT", "/layers/{layer}", UPDATELAYER);
+    add_route("DELETE", "/layers/{layer}", DELETELAYER);
+    add_route("PUT", "/on", TURNON);
+    add_route("PUT", "/off", TURNOFF);
 }
 
 DataStream* AdminService::process_request(Request* req, ServicesConfiguration* services) {
     BOOST_LOG_TRIVIAL(debug) << "ADMIN service";
+    req->operation = Metrics::ADMIN;
 
     // Contrôle du secret
     if (secret != "" && req->secret != secret) {
         throw AdminException::get_error_message("Not authorized request", "Operation forbidden", 403);
     }
 
-    if ( match_route( "/layers/([^/]+)", {"POST"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "ADDLAYER request";
-        return add_layer(req, services);
-    }
-    else if ( match_route( "/layers/([^/]+)", {"PUT"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "UPDATELAYER request";
-        return update_layer(req, services);
-    }
-    else if ( match_route( "/layers/([^/]+)", {"DELETE"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "DELETELAYER request";
-        return delete_layer(req, services);
-    }
-    else if ( match_route( "/on", {"PUT"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "TURNON request";
-        return turn_on(req, services);
-    }
-    else if ( match_route( "/off", {"PUT"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "TURNOFF request";
-        return turn_off(req, services);
-    } else {
-        throw AdminException::get_error_message("Unknown admin request path", "Operation not supported", 400);
+    switch (match_route(req)) {
+        case ADDLAYER:
+            BOOST_LOG_TRIVIAL(debug) << "ADDLAYER request";
+            return add_layer(req, services);
+        case UPDATELAYER:
+            BOOST_LOG_TRIVIAL(debug) << "UPDATELAYER request";
+            return update_layer(req, services);
+        case DELETELAYER:
+            BOOST_LOG_TRIVIAL(debug) << "DELETELAYER request";
+            return delete_layer(req, services);
+        case TURNON:
+            BOOST_LOG_TRIVIAL(debug) << "TURNON request";
+            return turn_on(req, services);
+        case TURNOFF:
+            BOOST_LOG_TRIVIAL(debug) << "TURNOFF request";
+            return turn_off(req, services);
+        default:
+            throw AdminException::get_error_message("Unknown admin request path", "Operation not supported", 400);
     }
 };
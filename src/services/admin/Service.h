@@ -58,6 +58,14 @@ class AdminService : public Service {
 
 private:
 
+    enum eOperation {
+        ADDLAYER,
+        UPDATELAYER,
+        DELETELAYER,
+        TURNON,
+        TURNOFF
+    };
+
     DataStream* turn_on ( Request* req, ServicesConfiguration* services );
     DataStream* turn_off ( Request* req, ServicesConfiguration* services );
     DataStream* add_layer ( Request* req, ServicesConfiguration* services );
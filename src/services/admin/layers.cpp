@@ -47,6 +47,7 @@
 #include "services/admin/Exception.h"
 
 #include "core/Rok4Server.h"
+#include "core/TileCache.h"
 
 DataStream* AdminService::add_layer ( Request* req, ServicesConfiguration* services ) {
 
@@ -63,8 +64,9 @@ DataStream* AdminService::add_layer ( Request* req, ServicesConfiguration* servi
         throw AdminException::get_error_message(msg, "Configuration issue", 400);
     }
 
-    services->add_layer ( layer );
-    services->clean_cache();
+    // Une autre requête a pu ajouter la couche entre temps, elle est alors supprimée
+    if ( ! services->add_layer ( layer ) ) throw AdminException::get_error_message("Layer already exists.", "Configuration conflict", 409);
+    services->invalidate_layer ( str_layer );
 
     return new EmptyResponseDataStream ();
 }
@@ -88,9 +90,10 @@ DataStream* AdminService::update_layer ( Request* req, ServicesConfiguration* se
         throw AdminException::get_error_message(msg, "Configuration issue", 400);
     }
 
-    services->delete_layer ( layer->get_id() );
-    services->add_layer ( new_layer );
-    services->clean_cache();
+    // Remplacement en une seule version : les requêtes voient l'ancienne couche ou la nouvelle, jamais aucune
+    if ( ! services->replace_layer ( new_layer ) ) throw AdminException::get_error_message("Layer " + str_layer + " does not exists.", "Not found", 404);
+    services->invalidate_layer ( str_layer );
+    TileCache::invalidate_layer ( str_layer );
 
     return new EmptyResponseDataStream ();
 
@@ -108,8 +111,9 @@ DataStream* AdminService::delete_layer ( Request* req, ServicesConfiguration* se
 
     if ( layer == NULL ) throw AdminException::get_error_message("Layer " + str_layer + " does not exists.", "Not found", 404);
 
-    services->delete_layer ( layer->get_id() );
-    services->clean_cache();
+    if ( ! services->delete_layer ( layer->get_id() ) ) throw AdminException::get_error_message("Layer " + str_layer + " does not exists.", "Not found", 404);
+    services->invalidate_layer ( str_layer );
+    TileCache::invalidate_layer ( str_layer );
 
     return new EmptyResponseDataStream ();
 }
\ No newline at end of file
@@ -66,27 +66,38 @@ HealthService::HealthService (json11::Json& doc) : Service(doc, "HEALTH service"
 
     keywords.push_back(Keyword ( "health" ));
     keywords.push_back(Keyword ( "check" ));
+
+    add_route("GET", "", GETHEALTH);
+    add_route("GET", "/ready", GETREADY);
+    add_route("GET", "/info", GETINFOS);
+    add_route("GET", "/threads", GETTHREADS);
+    add_route("GET", "/depends", GETDEPENDENCIES);
+    add_route("GET", "/metrics", GETMETRICS);
 }
 
 DataStream* HealthService::process_request(Request* req, ServicesConfiguration* services) {
     BOOST_LOG_TRIVIAL(debug) << "HEALTH service";
 
-    if ( match_route( "", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETHEALTH request";
-        return get_health(req, services);
-    }
-    else if ( match_route( "/info", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETINFOS request";
-        return get_infos(req, services);
-    }
-    else if ( match_route( "/threads", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETTHREADS request";
-        return get_threads(req, services);
-    }
-    else if ( match_route( "/depends", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETDEPENDENCIES request";
-        return get_dependencies(req, services);
-    } else {
-        throw HealthException::get_error_message("Unknown health request path", 400);
+    switch (match_route(req)) {
+        case GETHEALTH:
+            BOOST_LOG_TRIVIAL(debug) << "GETHEALTH request";
+            return get_health(req, services);
+        case GETREADY:
+            BOOST_LOG_TRIVIAL(debug) << "GETREADY request";
+            return get_ready(req, services);
+        case GETINFOS:
+            BOOST_LOG_TRIVIAL(debug) << "GETINFOS request";
+            return get_infos(req, services);
+        case GETTHREADS:
+            BOOST_LOG_TRIVIAL(debug) << "GETTHREADS request";
+            return get_threads(req, services);
+        case GETDEPENDENCIES:
+            BOOST_LOG_TRIVIAL(debug) << "GETDEPENDENCIES request";
+            return get_dependencies(req, services);
+        case GETMETRICS:
+            BOOST_LOG_TRIVIAL(debug) << "GETMETRICS request";
+            return get_metrics(req, services);
+        default:
+            throw HealthException::get_error_message("Unknown health request path", 400);
     }
 };
@@ -58,10 +58,29 @@ class HealthService : public Service {
 
 private:
 
+    enum eOperation {
+        GETHEALTH,
+        GETREADY,
+        GETINFOS,
+        GETTHREADS,
+        GETDEPENDENCIES,
+        GETMETRICS
+    };
+
     DataStream* get_dependencies ( Request* req, ServicesConfiguration* services );
     DataStream* get_threads ( Request* req, ServicesConfiguration* services );
     DataStream* get_infos ( Request* req, ServicesConfiguration* services );
     DataStream* get_health ( Request* req, ServicesConfiguration* services );
+    DataStream* get_ready ( Request* req, ServicesConfiguration* services );
+    /**
+     * \~french
+     * \brief Métriques des requêtes au format d'exposition Prometheus
+     * \details Le paramètre \b top fixe le nombre de couches détaillées
+     * \~english
+     * \brief Requests metrics in Prometheus exposition format
+     * \details Parameter \b top sets the detailed layers count
+     */
+    DataStream* get_metrics ( Request* req, ServicesConfiguration* services );
 
 public:
     DataStream* process_request(Request* req, ServicesConfiguration* services );
@@ -50,8 +50,16 @@
 #include "services/health/Service.h"
 #include "services/health/Exception.h"
 
+#include "core/Books.h"
 #include "core/Rok4Server.h"
 #include "core/Process.h"
+#include "core/LayerLoader.h"
+#include "core/AccessLog.h"
+#include "core/Metrics.h"
+#include "core/RenderPool.h"
+#include "core/SingleFlight.h"
+#include "core/TileCache.h"
+#include "core/UpstreamClient.h"
 
 DataStream* HealthService::get_health ( Request* req, ServicesConfiguration* services ) {
 
@@ -65,27 +73,47 @@ DataStream* HealthService::get_health ( Request* req, ServicesConfiguration* ser
     return new MessageDataStream ( res.dump(), "application/json", 200 );
 }
 
+DataStream* HealthService::get_ready ( Request* req, ServicesConfiguration* services ) {
+
+    bool ready = services->are_layers_loaded();
+
+    json11::Json::object res = json11::Json::object {
+        { "status", ready ? "READY" : "LOADING" }
+    };
+
+    if (services->get_layer_loader() != NULL) {
+        res["layers_loading"] = services->get_layer_loader()->to_json();
+    }
+
+    // Les sondes de disponibilité ne doivent envoyer du trafic qu'une fois toutes les couches chargées
+    return new MessageDataStream ( json11::Json{ res }.dump(), "application/json", ready ? 200 : 503 );
+}
+
 DataStream* HealthService::get_infos ( Request* req, ServicesConfiguration* services ) {
 
     std::vector<std::string> layers;
     for(auto const& l: services->get_layers()) {
-        layers.push_back(l.first);
+        if (l.second->is_loaded()) {
+            layers.push_back(l.first);
+        }
     }
 
     std::vector<std::string> tms;
-    for(auto const& t: TmsBook::get_book()) {
-        tms.push_back(t.first);
+    for(TileMatrixSet* t: Books::get_tmss()) {
+        tms.push_back(t->get_id());
     }
 
-    std::vector<std::string> styles;
-    for(auto const& s: StyleBook::get_book()) {
-        styles.push_back(s.first);
-    }
+    std::vector<std::string> styles = Books::get_styles_ids();
 
     json11::Json res = json11::Json::object {
         { "layers", layers },
         { "tms", tms },
-        { "styles", styles }
+        { "styles", styles },
+        { "tile_cache", TileCache::to_json() },
+        { "single_flight", SingleFlight::to_json() },
+        { "map_rendering", RenderPool::to_json() },
+        { "external_requests", UpstreamClient::to_json() },
+        { "access_log", AccessLog::to_json() }
     };
 
     return new MessageDataStream ( res.dump(), "application/json", 200 );
@@ -101,6 +129,20 @@ DataStream* HealthService::get_threads ( Request* req, ServicesConfiguration* se
     return new MessageDataStream ( res.dump(), "application/json", 200 );
 }
 
+DataStream* HealthService::get_metrics ( Request* req, ServicesConfiguration* services ) {
+
+    int top = METRICS_DEFAULT_TOP_LAYERS;
+    std::string str_top = req->get_query_param("top");
+    if (str_top != "") {
+        char c;
+        if (sscanf(str_top.c_str(), "%d%c", &top, &c) != 1 || top < 0) {
+            throw HealthException::get_error_message("Top query parameter have to be a positive integer", 400);
+        }
+    }
+
+    return new MessageDataStream ( Metrics::to_prometheus(top), "text/plain; version=0.0.4", 200 );
+}
+
 DataStream* HealthService::get_dependencies ( Request* req, ServicesConfiguration* services ) {
 
     int file_count, s3_count, ceph_count, swift_count;
@@ -58,7 +58,7 @@ std::map<std::string, std::string> OgcApiService::ogcapi_format_to_mime_type = {
     {"bil", "image/x-bil;bits=32"},
     {"asc", "text/asc"}};
 
-OgcApiService::OgcApiService(json11::Json& doc) : Service(doc, "OGC API service", "OGC API service", "http://localhost/ogcapi", "/ogcapi") {
+OgcApiService::OgcApiService(json11::Json& doc) : Service(doc, "OGC API service", "OGC API service", "http://localhost/ogcapi", "/ogcapi"), documents_generation(0) {
     if (!is_ok()) {
         // Le constructeur du service générique a détecté une erreur, on ajoute simplement le service concerné dans le message
         error_message = "OGCAPI service: " + error_message;
@@ -96,84 +96,125 @@ OgcApiService::OgcApiService(json11::Json& doc) : Service(doc, "OGC API service"
     } else {
         default_size = 256;
     }
-}
 
-DataStream* OgcApiService::process_request(Request* req, ServicesConfiguration* services) {
-    BOOST_LOG_TRIVIAL(debug) << "OGC API service";
-
-    if (match_route("", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET LANDING PAGE request";
-        return get_landing_page(req, services);
-    } else if (match_route("/conformance", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET CONFORMANCE request";
-        return get_conformance(req, services);
-    }
+    add_route("GET", "", GETLANDINGPAGE);
+    add_route("GET", "/conformance", GETCONFORMANCE);
     // API
-    else if (match_route("/api/all-collections", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET API COLLECTION request";
-        return get_api_collections(req, services);
-    } else if (match_route("/api/vectorTiles-collections", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET API VECTOR COLLECTIONS request";
-        return get_api_vector_collections(req, services);
-    } else if (match_route("/api/tileMatrixSets", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET API TILE MATRIX SETS request";
-        return get_api_tilematrixsets(req, services);
-    } else if (match_route("/api/styles", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET API STYLES request";
-        return get_api_styles(req, services);
-    }
+    add_route("GET", "/api/all-collections", GETAPICOLLECTIONS);
+    add_route("GET", "/api/vectorTiles-collections", GETAPIVECTORCOLLECTIONS);
+    add_route("GET", "/api/tileMatrixSets", GETAPITILEMATRIXSETS);
+    add_route("GET", "/api/styles", GETAPISTYLES);
     // TMS
-    else if (match_route("/tileMatrixSets", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET TILE MATRIX SETS request";
-        return get_tilematrixsets(req, services);
-    } else if (match_route("/tileMatrixSets/([^/]+)", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET TILE MATRIX SET request";
-        return get_tilematrixset(req, services);
-    }
+    add_route("GET", "/tileMatrixSets", GETTILEMATRIXSETS);
+    add_route("GET", "/tileMatrixSets/{tms}", GETTILEMATRIXSET);
     // Collections
-    else if (match_route("/collections", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET COLLECTIONS request";
-        return get_collections(req, services);
-    } else if (match_route("/collections/([^/]+)", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET COLLECTION request";
-        return get_collection(req, services);
-    }
+    add_route("GET", "/collections", GETCOLLECTIONS);
+    add_route("GET", "/collections/{collection}", GETCOLLECTION);
 
-    // TILES
-    // Données vecteur
-    else if (tiles && match_route("/collections/([^/]+)/tiles", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET TILESETS vector request";
-        return get_tilesets(req, services, false);
-    } else if (tiles && match_route("/collections/([^/]+)/tiles/([^/]+)", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET TILESET vector request";
-        return get_tileset(req, services, false);
-    } else if (tiles && match_route("/collections/([^/]+)/tiles/([^/]+)/([^/]+)/([^/]+)/([^/]+)", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET TILE vector request";
-        return get_tile(req, services, false);
-    }
-    // Données raster
-    else if (tiles && match_route("/collections/([^/]+)/map/tiles", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET TILE SETS map request";
-        return get_tilesets(req, services, true);
-    } else if (tiles && match_route("/collections/([^/]+)/map/tiles/([^/]+)", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET TILE SET map request";
-        return get_tileset(req, services, true);
-    } else if (tiles && match_route("/collections/([^/]+)/styles/([^/]+)/map/tiles/([^/]+)/([^/]+)/([^/]+)/([^/]+)", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET TILE map request";
-        return get_tile(req, services, true);
+    if (tiles) {
+        // Données vecteur
+        add_route("GET", "/collections/{collection}/tiles", GETVECTORTILESETS);
+        add_route("GET", "/collections/{collection}/tiles/{tms}", GETVECTORTILESET);
+        add_route("GET", "/collections/{collection}/tiles/{tms}/{level}/{row}/{col}", GETVECTORTILE);
+        // Données raster
+        add_route("GET", "/collections/{collection}/map/tiles", GETMAPTILESETS);
+        add_route("GET", "/collections/{collection}/map/tiles/{tms}", GETMAPTILESET);
+        add_route("GET", "/collections/{collection}/styles/{style}/map/tiles/{tms}/{level}/{row}/{col}", GETMAPTILE);
     }
 
-    // MAPS
-    // Données raster
-    else if (maps && match_route("/collections/([^/]+)/map", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET MAP request";
-        return get_map(req, services);
-    } else if (maps && match_route("/collections/([^/]+)/styles/([^/]+)/map", {"GET"}, req)) {
-        BOOST_LOG_TRIVIAL(debug) << "GET MAP request";
-        return get_map(req, services);
+    if (maps) {
+        add_route("GET", "/collections/{collection}/map", GETMAP);
+        add_route("GET", "/collections/{collection}/styles/{style}/map", GETMAP);
     }
+}
+
+DataStream* OgcApiService::process_request(Request* req, ServicesConfiguration* services) {
+    BOOST_LOG_TRIVIAL(debug) << "OGC API service";
+
+    switch (match_route(req)) {
+        case GETLANDINGPAGE:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET LANDING PAGE request";
+            return get_landing_page(req, services);
+        case GETCONFORMANCE:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET CONFORMANCE request";
+            return get_conformance(req, services);
+
+        // API
+        case GETAPICOLLECTIONS:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET API COLLECTION request";
+            return get_api_collections(req, services);
+        case GETAPIVECTORCOLLECTIONS:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET API VECTOR COLLECTIONS request";
+            return get_api_vector_collections(req, services);
+        case GETAPITILEMATRIXSETS:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET API TILE MATRIX SETS request";
+            return get_api_tilematrixsets(req, services);
+        case GETAPISTYLES:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET API STYLES request";
+            return get_api_styles(req, services);
+
+        // TMS
+        case GETTILEMATRIXSETS:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET TILE MATRIX SETS request";
+            return get_tilematrixsets(req, services);
+        case GETTILEMATRIXSET:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET TILE MATRIX SET request";
+            return get_tilematrixset(req, services);
+
+        // Collections
+        case GETCOLLECTIONS:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET COLLECTIONS request";
+            return get_collections(req, services);
+        case GETCOLLECTION:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET COLLECTION request";
+            return get_collection(req, services);
+
+        // TILES
+        // Données vecteur
+        case GETVECTORTILESETS:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET TILESETS vector request";
+            return get_tilesets(req, services, false);
+        case GETVECTORTILESET:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET TILESET vector request";
+            return get_tileset(req, services, false);
+        case GETVECTORTILE:
+            req->operation = Metrics::TILE;
+            BOOST_LOG_TRIVIAL(debug) << "GET TILE vector request";
+            return get_tile(req, services, false);
+        // Données raster
+        case GETMAPTILESETS:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET TILE SETS map request";
+            return get_tilesets(req, services, true);
+        case GETMAPTILESET:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GET TILE SET map request";
+            return get_tileset(req, services, true);
+        case GETMAPTILE:
+            req->operation = Metrics::TILE;
+            BOOST_LOG_TRIVIAL(debug) << "GET TILE map request";
+            return get_tile(req, services, true);
+
+        // MAPS
+        // Données raster
+        case GETMAP:
+            req->operation = Metrics::MAP;
+            BOOST_LOG_TRIVIAL(debug) << "GET MAP request";
+            return get_map(req, services);
 
-    else {
-        throw OgcApiException::get_error_message("ResourceNotFound", "Unknown OGC API request path", 404);
+        default:
+            throw OgcApiException::get_error_message("ResourceNotFound", "Unknown OGC API request path", 404);
     }
 };
@@ -48,6 +48,14 @@ class OgcApiService;
 #pragma once
 
 #include "services/Service.h"
+#include "services/CapabilitiesCache.h"
+#include "core/EncodedDocument.h"
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <rok4/utils/BoundingBox.h>
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -63,6 +71,26 @@ private:
     static std::vector<std::string> tiles_conformances;
     static std::map<std::string, std::string> ogcapi_format_to_mime_type;
 
+    enum eOperation {
+        GETLANDINGPAGE,
+        GETCONFORMANCE,
+        GETAPICOLLECTIONS,
+        GETAPIVECTORCOLLECTIONS,
+        GETAPITILEMATRIXSETS,
+        GETAPISTYLES,
+        GETTILEMATRIXSETS,
+        GETTILEMATRIXSET,
+        GETCOLLECTIONS,
+        GETCOLLECTION,
+        GETVECTORTILESETS,
+        GETVECTORTILESET,
+        GETVECTORTILE,
+        GETMAPTILESETS,
+        GETMAPTILESET,
+        GETMAPTILE,
+        GETMAP
+    };
+
     DataStream* get_landing_page ( Request* req, ServicesConfiguration* services );
     DataStream* get_conformance ( Request* req, ServicesConfiguration* services );
 
@@ -73,10 +101,24 @@ private:
 
     DataStream* get_tilematrixsets ( Request* req, ServicesConfiguration* services );
     DataStream* get_tilematrixset ( Request* req, ServicesConfiguration* services );
+    DataStream* get_collections ( Request* req, ServicesConfiguration* services );
     /**
-     * \todo Gérer la pagination
+     * \~french
+     * \brief Construit la liste des collections, filtrée par une bbox si fournie, en réutilisant les fragments des couches en cache
+     * \details Les couches intersectant la bbox sont recherchées dans l'index spatial. La variante compressée est calculée si le document est mis en cache.
+     * \param[in] bbox Emprise de filtrage, NULL pour toutes les couches
+     * \param[in] str_bbox Emprise telle que demandée, pour les liens
+     * \param[in] limit Nombre maximal de collections retournées, 0 pour toutes
+     * \param[in] offset Nombre de collections sautées
+     * \~english
+     * \brief Build collections list, filtered by a bbox if provided, reusing cached layers fragments
+     * \details Layers intersecting the bbox are searched in the spatial index. Compressed variant is computed if document is cached.
+     * \param[in] bbox Filtering extent, NULL for all layers
+     * \param[in] str_bbox Extent as requested, for links
+     * \param[in] limit Max returned collections count, 0 for all
+     * \param[in] offset Skipped collections count
      */
-    DataStream* get_collections ( Request* req, ServicesConfiguration* services );
+    std::shared_ptr<const EncodedDocument> build_collections ( ServicesConfiguration* services, BoundingBox<double>* bbox, std::string str_bbox, int limit, int offset );
     DataStream* get_collection ( Request* req, ServicesConfiguration* services );
     
     DataStream* get_tilesets ( Request* req, ServicesConfiguration* services, bool is_map_request );
@@ -90,7 +132,40 @@ private:
 
     int default_size;
 
-    std::string cache_getcapabilities;
+    CapabilitiesCache cache_getcapabilities;
+
+    /**
+     * \~french \brief Documents JSON sans fragment de couche (page d'accueil, conformité, énumérations de l'API), avec leur variante compressée
+     * \~english \brief JSON documents without layer fragment (landing page, conformance, API enumerations), with their compressed variant
+     */
+    std::map<std::string, std::shared_ptr<const EncodedDocument> > documents;
+    std::mutex documents_mtx;
+    unsigned long documents_generation;
+
+    /**
+     * \~french \brief Dernières listes de collections filtrées ou paginées, indexées par leurs paramètres (protégées par #documents_mtx)
+     * \~english \brief Last filtered or paged collections lists, indexed by their parameters (protected by #documents_mtx)
+     */
+    std::list<std::pair<std::string, std::shared_ptr<const EncodedDocument> > > queries_lru;
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::shared_ptr<const EncodedDocument> > >::iterator> queries_index;
+
+    /**
+     * \~french
+     * \brief Retourne le document en cache, ou le construit
+     * \param[in] services Configuration des services, dont les couches figées par la requête
+     * \param[in] key Identifiant du document
+     * \param[in] cacheable Le document peut être mis en cache (pas de couche en cours de chargement)
+     * \param[in] build Construction du document
+     * \~english
+     * \brief Return the cached document, or build it
+     * \param[in] services Services configuration, with layers frozen by the request
+     * \param[in] key Document identifier
+     * \param[in] cacheable Document can be cached (no layer being loaded)
+     * \param[in] build Document building
+     */
+    DataStream* get_document ( Request* req, ServicesConfiguration* services, std::string key, bool cacheable, std::function<std::string()> build );
+
+    void clear_documents();
 
 public:
     DataStream* process_request(Request* req, ServicesConfiguration* services );
@@ -110,9 +185,20 @@ public:
      * \brief Remove cached responses
      */
     void clean_cache() {
-        cache_mtx.lock();
         cache_getcapabilities.clear();
-        cache_mtx.unlock();
+        clear_documents();
+    };
+
+    /**
+     * \~french
+     * \brief Invalide les fragments de capacités d'une couche ajoutée, modifiée ou supprimée
+     * \~english
+     * \brief Invalidate capabilities fragments of an added, modified or removed layer
+     */
+    void invalidate_layer(std::string id) {
+        cache_getcapabilities.invalidate_layer(id);
+        // Les énumérations des collections de l'API dépendent des couches
+        clear_documents();
     };
 
     /**
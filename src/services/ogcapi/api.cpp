@@ -47,6 +47,7 @@
 
 #include "services/ogcapi/Exception.h"
 #include "services/ogcapi/Service.h"
+#include "core/Books.h"
 #include "core/Rok4Server.h"
 
 
@@ -57,20 +58,23 @@ DataStream* OgcApiService::get_api_collections ( Request* req, ServicesConfigura
         throw OgcApiException::get_error_message("InvalidParameter", "Format unknown", 400);
     }
 
-    std::vector<std::string> collections;
+    // Tant que toutes les couches ne sont pas chargées, l'énumération est incomplète et n'est pas mise en cache
+    return get_document(req, services, "api_collections", services->are_layers_loaded(), [services]() {
+        std::vector<std::string> collections;
 
-    for(auto const& l: services->get_layers()) {
-        if (l.second->is_ogcapi_enabled()) {
-            collections.push_back(l.first);
+        for(auto const& l: services->get_layers()) {
+            if (l.second->is_loaded() && l.second->is_ogcapi_enabled()) {
+                collections.push_back(l.first);
+            }
         }
-    }
 
-    json11::Json::object res = json11::Json::object {
-        { "type", "enum" },
-        { "enum", collections }
-    };
+        json11::Json::object res = json11::Json::object {
+            { "type", "enum" },
+            { "enum", collections }
+        };
 
-    return new MessageDataStream ( json11::Json{ res }.dump(), "application/json", 200 );
+        return json11::Json{ res }.dump();
+    });
 }
 
 DataStream* OgcApiService::get_api_vector_collections ( Request* req, ServicesConfiguration* services ) {
@@ -80,20 +84,22 @@ DataStream* OgcApiService::get_api_vector_collections ( Request* req, ServicesCo
         throw OgcApiException::get_error_message("InvalidParameter", "Format unknown", 400);
     }
 
-    std::vector<std::string> collections;
+    return get_document(req, services, "api_vector_collections", services->are_layers_loaded(), [services]() {
+        std::vector<std::string> collections;
 
-    for(auto const& l: services->get_layers()) {
-        if (l.second->is_ogcapi_enabled() && ! l.second->is_raster()) {
-            collections.push_back(l.first);
+        for(auto const& l: services->get_layers()) {
+            if (l.second->is_loaded() && l.second->is_ogcapi_enabled() && ! l.second->is_raster()) {
+                collections.push_back(l.first);
+            }
         }
-    }
 
-    json11::Json::object res = json11::Json::object {
-        { "type", "enum" },
-        { "enum", collections }
-    };
+        json11::Json::object res = json11::Json::object {
+            { "type", "enum" },
+            { "enum", collections }
+        };
 
-    return new MessageDataStream ( json11::Json{ res }.dump(), "application/json", 200 );
+        return json11::Json{ res }.dump();
+    });
 }
 
 DataStream* OgcApiService::get_api_tilematrixsets ( Request* req, ServicesConfiguration* services ) {
@@ -103,17 +109,19 @@ DataStream* OgcApiService::get_api_tilematrixsets ( Request* req, ServicesConfig
         throw OgcApiException::get_error_message("InvalidParameter", "Format unknown", 400);
     }
 
-    std::vector<std::string> tms;
-    for(auto const& t: TmsBook::get_book()) {
-        tms.push_back(t.first);
-    }
+    return get_document(req, services, "api_tilematrixsets", true, []() {
+        std::vector<std::string> tms;
+        for(TileMatrixSet* t: Books::get_tmss()) {
+            tms.push_back(t->get_id());
+        }
 
-    json11::Json::object res = json11::Json::object {
-        { "type", "enum" },
-        { "enum", tms }
-    };
+        json11::Json::object res = json11::Json::object {
+            { "type", "enum" },
+            { "enum", tms }
+        };
 
-    return new MessageDataStream ( json11::Json{ res }.dump(), "application/json", 200 );
+        return json11::Json{ res }.dump();
+    });
 }
 
 DataStream* OgcApiService::get_api_styles ( Request* req, ServicesConfiguration* services ) {
@@ -123,17 +131,16 @@ DataStream* OgcApiService::get_api_styles ( Request* req, ServicesConfiguration*
         throw OgcApiException::get_error_message("InvalidParameter", "Format unknown", 400);
     }
 
-    std::vector<std::string> styles;
-    for(auto const& s: StyleBook::get_book()) {
-        styles.push_back(s.first);
-    }
+    return get_document(req, services, "api_styles", true, []() {
+        std::vector<std::string> styles = Books::get_styles_ids();
 
-    json11::Json::object res = json11::Json::object {
-        { "type", "enum" },
-        { "enum", styles }
-    };
+        json11::Json::object res = json11::Json::object {
+            { "type", "enum" },
+            { "enum", styles }
+        };
 
-    return new MessageDataStream ( json11::Json{ res }.dump(), "application/json", 200 );
+        return json11::Json{ res }.dump();
+    });
 }
 
 DataStream* OgcApiService::get_tilematrixsets ( Request* req, ServicesConfiguration* services ) {
@@ -147,17 +154,17 @@ DataStream* OgcApiService::get_tilematrixsets ( Request* req, ServicesConfigurat
 
     std::vector<json11::Json::object> tmss;
     
-    for(auto const& t: TmsBook::get_book()) {
+    for(TileMatrixSet* t: Books::get_tmss()) {
         tmss.push_back(json11::Json::object {
-            { "id", t.second->get_id()},
-            { "title", t.second->get_title()},
-            { "crs", t.second->get_crs()->get_url()},
+            { "id", t->get_id()},
+            { "title", t->get_title()},
+            { "crs", t->get_crs()->get_url()},
             { "links", json11::Json::array {
                 json11::Json::object {
-                    { "href", endpoint_uri + "/tileMatrixSets/" + t.second->get_id() + "?f=json"},
+                    { "href", endpoint_uri + "/tileMatrixSets/" + t->get_id() + "?f=json"},
                     { "rel", "describedby"},
                     { "type", "application/json"},
-                    { "title", t.second->get_id() + " definition as application/json"}
+                    { "title", t->get_id() + " definition as application/json"}
                 }
             }}
         });
@@ -183,7 +190,7 @@ DataStream* OgcApiService::get_tilematrixset ( Request* req, ServicesConfigurati
         throw OgcApiException::get_error_message("ResourceNotFound", "Tile matrix set unknown", 404);
     }
 
-    TileMatrixSet* tms = TmsBook::get_tms(str_tms);
+    TileMatrixSet* tms = Books::get_tms(str_tms);
     if ( tms == NULL) {
         throw OgcApiException::get_error_message("ResourceNotFound", "Tile matrix set "+str_tms+" unknown", 404);
     }
@@ -84,42 +84,77 @@ std::vector<std::string> OgcApiService::tiles_conformances ={
     "http://www.opengis.net/spec/ogcapi-tiles-1/1.0/conf/tiff"
 };
 
-DataStream* OgcApiService::get_landing_page ( Request* req, ServicesConfiguration* services ) {
-    std::string f = req->get_query_param("f");
-    if (f != "" && f != "application/json" && f != "json") {
-        throw OgcApiException::get_error_message("InvalidParameter", "Format unknown", 400);
+DataStream* OgcApiService::get_document ( Request* req, ServicesConfiguration* services, std::string key, bool cacheable, std::function<std::string()> build ) {
+
+    CapabilitiesCache::Build b;
+    {
+        std::lock_guard<std::mutex> lock(documents_mtx);
+        std::map<std::string, std::shared_ptr<const EncodedDocument> >::iterator it = documents.find(key);
+        if (it != documents.end()) {
+            return EncodedDocument::get_stream ( it->second, req );
+        }
+        b = CapabilitiesCache::begin_build(services, documents_generation);
     }
 
-    std::vector<json11::Json> links;
+    std::shared_ptr<const EncodedDocument> document = std::make_shared<EncodedDocument>(build(), "application/json", cacheable);
 
-    links.push_back(json11::Json::object {
-        { "href", endpoint_uri},
-        { "rel", "self"},
-        { "type", "application/json"},
-        { "title", "this document"}
-    });
+    if (cacheable && b.current) {
+        std::lock_guard<std::mutex> lock(documents_mtx);
+        // Un document calculé pendant une invalidation n'est pas conservé
+        if (b.generation == documents_generation) {
+            documents[key] = document;
+        }
+    }
 
-    links.push_back(json11::Json::object {
-        { "href", endpoint_uri + "/collections?f=json"},
-        { "rel", "data"},
-        { "type", "application/json"},
-        { "title", "Information about the collections"}
-    });
+    return EncodedDocument::get_stream ( document, req );
+}
 
-    links.push_back(json11::Json::object {
-        { "href", endpoint_uri + "/conformance?f=json"},
-        { "rel", "data"},
-        { "type", "application/json"},
-        { "title", "OGC API conformance classes implemented by this service"}
-    });
+void OgcApiService::clear_documents() {
+    std::lock_guard<std::mutex> lock(documents_mtx);
+    documents.clear();
+    queries_lru.clear();
+    queries_index.clear();
+    documents_generation++;
+}
 
-    json11::Json::object res = json11::Json::object {
-        { "title", title },
-        { "description", abstract },
-        { "links", links }
-    };
+DataStream* OgcApiService::get_landing_page ( Request* req, ServicesConfiguration* services ) {
+    std::string f = req->get_query_param("f");
+    if (f != "" && f != "application/json" && f != "json") {
+        throw OgcApiException::get_error_message("InvalidParameter", "Format unknown", 400);
+    }
 
-    return new MessageDataStream ( json11::Json{ res }.dump(), "application/json", 200 );
+    return get_document(req, services, "landing_page", true, [this]() {
+        std::vector<json11::Json> links;
+
+        links.push_back(json11::Json::object {
+            { "href", endpoint_uri},
+            { "rel", "self"},
+            { "type", "application/json"},
+            { "title", "this document"}
+        });
+
+        links.push_back(json11::Json::object {
+            { "href", endpoint_uri + "/collections?f=json"},
+            { "rel", "data"},
+            { "type", "application/json"},
+            { "title", "Information about the collections"}
+        });
+
+        links.push_back(json11::Json::object {
+            { "href", endpoint_uri + "/conformance?f=json"},
+            { "rel", "data"},
+            { "type", "application/json"},
+            { "title", "OGC API conformance classes implemented by this service"}
+        });
+
+        json11::Json::object res = json11::Json::object {
+            { "title", title },
+            { "description", abstract },
+            { "links", links }
+        };
+
+        return json11::Json{ res }.dump();
+    });
 }
 
 DataStream* OgcApiService::get_conformance ( Request* req, ServicesConfiguration* services ) {
@@ -128,19 +163,21 @@ DataStream* OgcApiService::get_conformance ( Request* req, ServicesConfiguration
         throw OgcApiException::get_error_message("InvalidParameter", "Format unknown", 400);
     }
 
-    std::vector<std::string> conformances = common_conformances;
+    return get_document(req, services, "conformance", true, [this]() {
+        std::vector<std::string> conformances = common_conformances;
 
-    if (maps) {
-        conformances.insert(conformances.end(), maps_conformances.begin(), maps_conformances.end());
-    }
+        if (maps) {
+            conformances.insert(conformances.end(), maps_conformances.begin(), maps_conformances.end());
+        }
 
-    if (tiles) {
-        conformances.insert(conformances.end(), tiles_conformances.begin(), tiles_conformances.end());
-    }
+        if (tiles) {
+            conformances.insert(conformances.end(), tiles_conformances.begin(), tiles_conformances.end());
+        }
 
-    json11::Json::object res = json11::Json::object {
-        { "conformsTo", conformances }
-    };
+        json11::Json::object res = json11::Json::object {
+            { "conformsTo", conformances }
+        };
 
-    return new MessageDataStream ( json11::Json{ res }.dump(), "application/json", 200 );
+        return json11::Json{ res }.dump();
+    });
 }
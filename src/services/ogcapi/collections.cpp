@@ -44,11 +44,14 @@
  */
 
 #include <iostream>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 
 #include "services/ogcapi/Exception.h"
 #include "services/ogcapi/Service.h"
 #include "core/Rok4Server.h"
+#include "core/JsonWriter.h"
+#include "config.h"
 
 
 DataStream* OgcApiService::get_collections ( Request* req, ServicesConfiguration* services ) {
@@ -87,55 +90,171 @@ DataStream* OgcApiService::get_collections ( Request* req, ServicesConfiguration
         bbox.ymax=bb[3];
     }
 
-    if ( ! cache_getcapabilities.empty() && ! bbox_provided) {
-        return new MessageDataStream ( cache_getcapabilities, "application/json", 200 );
+    // pagination
+    int limit = 0;
+    std::string str_limit = req->get_query_param("limit");
+    if (str_limit != "") {
+        char c;
+        if (sscanf(str_limit.c_str(), "%d%c", &limit, &c) != 1 || limit < 1 || limit > COLLECTIONS_MAX_LIMIT)
+            throw OgcApiException::get_error_message("InvalidParameter", "Limit invalid", 400);
     }
 
-    std::vector<json11::Json> links;
-    if (bbox_provided) {
-        links.push_back(json11::Json::object {
-            { "href", endpoint_uri + "/collections?f=json&bbox=" + str_bbox},
-            { "rel", "self"},
-            { "type", "application/json"},
-            { "title", "this document"}
-        });
+    int offset = 0;
+    std::string str_offset = req->get_query_param("offset");
+    if (str_offset != "") {
+        char c;
+        if (sscanf(str_offset.c_str(), "%d%c", &offset, &c) != 1 || offset < 0)
+            throw OgcApiException::get_error_message("InvalidParameter", "Offset invalid", 400);
+    }
+
+    if (bbox_provided || limit != 0 || offset != 0) {
+        // Les requêtes filtrées ou paginées récentes sont conservées, tant que les couches ne changent pas
+        std::string key = str_bbox + "|" + std::to_string(limit) + "|" + std::to_string(offset);
+        CapabilitiesCache::Build build;
+        {
+            std::lock_guard<std::mutex> lock(documents_mtx);
+            std::unordered_map<std::string, std::list<std::pair<std::string, std::shared_ptr<const EncodedDocument> > >::iterator>::iterator it = queries_index.find(key);
+            if (it != queries_index.end()) {
+                queries_lru.splice(queries_lru.begin(), queries_lru, it->second);
+                return EncodedDocument::get_stream ( it->second->second, req );
+            }
+            build = CapabilitiesCache::begin_build(services, documents_generation);
+        }
+
+        std::shared_ptr<const EncodedDocument> document = build_collections(services, bbox_provided ? &bbox : NULL, str_bbox, limit, offset);
+
+        if (build.is_document_cacheable()) {
+            std::lock_guard<std::mutex> lock(documents_mtx);
+            // Une réponse calculée pendant une invalidation n'est pas conservée
+            if (build.generation == documents_generation && queries_index.find(key) == queries_index.end()) {
+                queries_lru.push_front(std::make_pair(key, document));
+                queries_index.emplace(key, queries_lru.begin());
+                while (queries_lru.size() > COLLECTIONS_QUERIES_CACHE_SIZE) {
+                    queries_index.erase(queries_lru.back().first);
+                    queries_lru.pop_back();
+                }
+            }
+        }
+
+        return EncodedDocument::get_stream ( document, req );
+    }
+
+    std::shared_ptr<const EncodedDocument> document;
+    bool stale;
+    if ( cache_getcapabilities.get_document(document, stale) ) {
+        if (stale) {
+            // Le document obsolète est servi pendant sa reconstruction
+            cache_getcapabilities.refresh([this, services]() {
+                build_collections(services, NULL, "", 0, 0);
+                services->unpin_layers();
+            });
+        }
+        return EncodedDocument::get_stream ( document, req );
+    }
+
+    return EncodedDocument::get_stream ( build_collections(services, NULL, "", 0, 0), req );
+}
+
+std::shared_ptr<const EncodedDocument> OgcApiService::build_collections ( ServicesConfiguration* services, BoundingBox<double>* bbox, std::string str_bbox, int limit, int offset ) {
+
+    // Tant que toutes les couches ne sont pas chargées, la réponse est incomplète et n'est pas mise en cache
+    CapabilitiesCache::Build build = cache_getcapabilities.begin_build(services);
+
+    // Couches sélectionnées, dans l'ordre de leur identifiant
+    std::vector<std::pair<std::string, Layer*> > candidates;
+    if (bbox == NULL) {
+        candidates.assign(services->get_layers().begin(), services->get_layers().end());
     } else {
-        links.push_back(json11::Json::object {
-            { "href", endpoint_uri + "/collections?f=json"},
-            { "rel", "self"},
-            { "type", "application/json"},
-            { "title", "this document"}
-        });
+        services->get_spatial_index()->query(*bbox, candidates);
     }
 
-    if (metadata) {
-        links.push_back(metadata->to_json_ogcapi("Service metadata", "describedby"));
+    std::vector<std::pair<std::string, Layer*> > selected;
+    selected.reserve(candidates.size());
+    for (const std::pair<std::string, Layer*>& c : candidates) {
+        if (! c.second->is_loaded() || ! c.second->is_ogcapi_enabled()) continue;
+        // L'index compare les emprises bornes incluses, le test exact est fait ici
+        if (bbox != NULL && ! c.second->get_geographical_bbox().intersects(*bbox)) continue;
+        selected.push_back(c);
     }
 
-    std::vector<json11::Json> collections;
+    int matched = selected.size();
+    int first = std::min(offset, matched);
+    int last = (limit == 0) ? matched : std::min(matched, first + limit);
 
-    std::map<std::string, Layer*>::iterator layers_iterator ( services->get_layers().begin() ), layers_end ( services->get_layers().end() );
-    for ( ; layers_iterator != layers_end; ++layers_iterator ) {
-        if (layers_iterator->second->is_ogcapi_enabled() && (! bbox_provided || layers_iterator->second->get_geographical_bbox().intersects(bbox))) {
-            collections.push_back(layers_iterator->second->to_json_ogcapi(this));
+    // Fragments des couches de la page, sérialisés seulement s'ils ne sont pas en cache
+    std::vector<std::string> fragments;
+    size_t fragments_size = 0;
+    for (int i = first; i < last; i++) {
+        std::string fragment;
+        if (! cache_getcapabilities.get_fragment(selected.at(i).first, fragment)) {
+            JsonWriter fragment_writer;
+            selected.at(i).second->to_json_ogcapi(fragment_writer, this);
+            fragment = fragment_writer.get_content();
+            cache_getcapabilities.set_fragment(selected.at(i).first, fragment, build);
         }
+        fragments_size += fragment.size() + 2;
+        fragments.push_back(fragment);
+    }
+
+    std::string base_href = endpoint_uri + "/collections?f=json";
+    if (bbox != NULL) {
+        base_href += "&bbox=" + str_bbox;
+    }
+
+    // Clés dans l'ordre alphabétique
+    JsonWriter writer(fragments_size + 1024);
+    writer.start_object();
+
+    writer.key("collections");
+    writer.start_array();
+    for (const std::string& fragment : fragments) {
+        writer.raw(fragment);
     }
+    writer.end_array();
 
-    json11::Json::object res = json11::Json::object {
-        { "links", links },
-        { "numberMatched", (int) collections.size() },
-        { "numberReturned", (int) collections.size() }
-    };
+    writer.key("links");
+    writer.start_array();
+    writer.start_object();
+    std::string self_href = base_href;
+    if (limit != 0) self_href += "&limit=" + std::to_string(limit);
+    if (offset != 0) self_href += "&offset=" + std::to_string(offset);
+    writer.key("href"); writer.value(self_href);
+    writer.key("rel"); writer.value("self");
+    writer.key("title"); writer.value("this document");
+    writer.key("type"); writer.value("application/json");
+    writer.end_object();
+    if (limit != 0 && first > 0) {
+        writer.start_object();
+        writer.key("href"); writer.value(base_href + "&limit=" + std::to_string(limit) + "&offset=" + std::to_string(std::max(0, first - limit)));
+        writer.key("rel"); writer.value("prev");
+        writer.key("title"); writer.value("previous page");
+        writer.key("type"); writer.value("application/json");
+        writer.end_object();
+    }
+    if (limit != 0 && last < matched) {
+        writer.start_object();
+        writer.key("href"); writer.value(base_href + "&limit=" + std::to_string(limit) + "&offset=" + std::to_string(last));
+        writer.key("rel"); writer.value("next");
+        writer.key("title"); writer.value("next page");
+        writer.key("type"); writer.value("application/json");
+        writer.end_object();
+    }
+    if (metadata) {
+        metadata->to_json_ogcapi(writer, "Service metadata", "describedby");
+    }
+    writer.end_array();
+
+    writer.key("numberMatched"); writer.value(matched);
+    writer.key("numberReturned"); writer.value((int) fragments.size());
 
-    res["collections"] = collections;
+    writer.end_object();
 
-    if (! bbox_provided) {
-        cache_mtx.lock();
-        cache_getcapabilities = json11::Json{ res }.dump();
-        cache_mtx.unlock();
-        return new MessageDataStream ( cache_getcapabilities, "application/json", 200 );
+    // Seule la liste complète est mise en cache par le cache des capacités, avec sa variante compressée
+    std::shared_ptr<const EncodedDocument> document = std::make_shared<EncodedDocument>(writer.get_content(), "application/json", build.complete);
+    if (bbox == NULL && limit == 0 && offset == 0) {
+        cache_getcapabilities.set_document(document, build);
     }
-    return new MessageDataStream ( json11::Json{ res }.dump(), "application/json", 200 ); 
+    return document;
 }
 
 
@@ -153,10 +272,16 @@ DataStream* OgcApiService::get_collection ( Request* req, ServicesConfiguration*
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer unknown", 404);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_ogcapi_enabled() ) {
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer "+str_layer+" unknown", 404);
     }
 
-    return new MessageDataStream ( json11::Json{ layer->to_json_ogcapi(this) }.dump(), "application/json", 200 );
+    JsonWriter writer;
+    layer->to_json_ogcapi(writer, this);
+    return new MessageDataStream ( writer.get_content(), "application/json", 200 );
 }
@@ -61,10 +61,15 @@ DataStream* OgcApiService::get_map ( Request* req, ServicesConfiguration* servic
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer unknown", 404);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_ogcapi_enabled() ) {
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer "+str_layer+" unknown", 404);
     }
+    req->layer = layer->get_id();
 
     if (! layer->is_raster()) {
         throw OgcApiException::get_error_message("InvalidParameter", "Vector data " + str_layer + " cannot be requested with OGC API Maps", 400);
@@ -293,12 +298,13 @@ DataStream* OgcApiService::get_map ( Request* req, ServicesConfiguration* servic
     // Traitement de la requête
     std::string error;
     DataStream* d = Map::get_map(
-        services, services->map_reprojection, services->map_max_tile_x, services->map_max_tile_y, 
+        req, services, services->map_reprojection, services->map_max_tile_x, services->map_max_tile_y, 
         layers, width, height, crs, bbox, styles, format, format_options, dpi,
         &error
     );
     if (d == NULL) {
         throw OgcApiException::get_error_message("InvalidParameter", error, 400);
     }
+    Map::add_cache_headers(req, layers);
     return d;
 }
\ No newline at end of file
@@ -59,6 +59,7 @@
 #include "services/ogcapi/Exception.h"
 #include "services/ogcapi/Service.h"
 #include "core/Rok4Server.h"
+#include "core/JsonWriter.h"
 #include "core/Tile.h"
 
 
@@ -76,7 +77,11 @@ DataStream* OgcApiService::get_tilesets ( Request* req, ServicesConfiguration* s
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer unknown", 404);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_ogcapi_enabled() ) {
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer "+str_layer+" unknown", 404);
     }
@@ -96,7 +101,9 @@ DataStream* OgcApiService::get_tilesets ( Request* req, ServicesConfiguration* s
         }
     }
 
-    return new MessageDataStream ( json11::Json{ layer->to_json_tilesets(this) }.dump(), "application/json", 200 );
+    JsonWriter writer;
+    layer->to_json_tilesets(writer, this);
+    return new MessageDataStream ( writer.get_content(), "application/json", 200 );
 }
 
 
@@ -114,7 +121,11 @@ DataStream* OgcApiService::get_tileset ( Request* req, ServicesConfiguration* se
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer unknown", 404);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_ogcapi_enabled() ) {
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer "+str_layer+" unknown", 404);
     }
@@ -151,7 +162,9 @@ DataStream* OgcApiService::get_tileset ( Request* req, ServicesConfiguration* se
         throw OgcApiException::get_error_message("InvalidParameter", "Tile matrix set " + str_tms + " unknown", 400);
     }
 
-    return new MessageDataStream ( json11::Json{ layer->to_json_tileset(this, tmsi) }.dump(), "application/json", 200 );
+    JsonWriter writer;
+    layer->to_json_tileset(writer, this, tmsi);
+    return new MessageDataStream ( writer.get_content(), "application/json", 200 );
 }
 
 DataStream* OgcApiService::get_tile ( Request* req, ServicesConfiguration* services, bool is_map_request ) {
@@ -163,10 +176,15 @@ DataStream* OgcApiService::get_tile ( Request* req, ServicesConfiguration* servi
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer unknown", 404);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_ogcapi_enabled() ) {
         throw OgcApiException::get_error_message("ResourceNotFound", "Layer "+str_layer+" unknown", 404);
     }
+    req->layer = layer->get_id();
 
     bool is_raster_data = layer->is_raster();
 
@@ -277,15 +295,17 @@ DataStream* OgcApiService::get_tile ( Request* req, ServicesConfiguration* servi
     TileMatrixLimits* tml = layer->get_tilematrix_limits(tmsi->tms, tm);
     if (tml == NULL) {
         // On est hors niveau -> erreur
+        layer->get_tile_cache_policy().add_not_found_headers(req);
         throw OgcApiException::get_error_message("ResourceNotFound", "Level out of limits", 404);
     }
-    if (!tml->contain_tile(column, row)) {
-        // On est hors tuiles -> erreur
+    if (!tml->contain_tile(column, row) || ! layer->contain_tile(tmsi->tms, tm, column, row)) {
+        // On est hors tuiles ou la dalle est absente -> erreur
+        layer->get_tile_cache_policy().add_not_found_headers(req);
         throw OgcApiException::get_error_message("ResourceNotFound", "Tile's indices out of limits", 404);
     }
 
     // Traitement de la requête
-    DataStream* d = Tile::get_tile(services, layer, tmsi->tms, tm, column, row, format, style);
+    DataStream* d = Tile::get_tile(req, services, layer, tmsi->tms, tm, column, row, format, style);
     if (d == NULL) {
         throw OgcApiException::get_error_message("ResourceNotFound", "Not data found", 404);
     }
@@ -61,31 +61,39 @@ TmsService::TmsService (json11::Json& doc) : Service(doc, "TMS service", "TMS se
         // Le service a déjà été mis comme n'étant pas actif
         return;
     }
+
+    add_route("GET", "/{version}/?", GETCAPABILITIES);
+    add_route("GET", "/{version}/{layer}/?", GETTILES);
+    add_route("GET", "/{version}/{layer}/metadata.json", GETMETADATA);
+    add_route("GET", "/{version}/{layer}/gdal.xml", GETGDAL);
+    add_route("GET", "/{version}/{layer}/{z}/{x}/{y}.{extension}", GETTILE);
 }
 
 DataStream* TmsService::process_request(Request* req, ServicesConfiguration* services) {
     BOOST_LOG_TRIVIAL(debug) << "TMS service";
 
-    if ( match_route( "/([^/]+)/?", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETCAPABILITIES request";
-        return get_capabilities(req, services);
-    }
-    else if ( match_route( "/([^/]+)/([^/]+)/?", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETTILES request";
-        return get_tiles(req, services);
-    }
-    else if ( match_route( "/([^/]+)/([^/]+)/metadata\\.json", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETMETADATA request";
-        return get_metadata(req, services);
-    }
-    else if ( match_route( "/([^/]+)/([^/]+)/gdal\\.xml", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETGDAL request";
-        return get_gdal(req, services);
-    }
-    else if ( match_route( "/([^/]+)/([^/]+)/([^/]+)/([^/]+)/([^/]+)\\.(.*)", {"GET"}, req ) ) {
-        BOOST_LOG_TRIVIAL(debug) << "GETTILE request";
-        return get_tile(req, services);
-    } else {
-        throw TmsException::get_error_message("Unknown tms request path", 400);
+    switch (match_route(req)) {
+        case GETCAPABILITIES:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GETCAPABILITIES request";
+            return get_capabilities(req, services);
+        case GETTILES:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GETTILES request";
+            return get_tiles(req, services);
+        case GETMETADATA:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GETMETADATA request";
+            return get_metadata(req, services);
+        case GETGDAL:
+            req->operation = Metrics::CAPABILITIES;
+            BOOST_LOG_TRIVIAL(debug) << "GETGDAL request";
+            return get_gdal(req, services);
+        case GETTILE:
+            req->operation = Metrics::TILE;
+            BOOST_LOG_TRIVIAL(debug) << "GETTILE request";
+            return get_tile(req, services);
+        default:
+            throw TmsException::get_error_message("Unknown tms request path", 400);
     }
 };
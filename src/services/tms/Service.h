@@ -47,6 +47,7 @@ class TmsService;
 
 #pragma once
 #include "services/Service.h"
+#include "services/CapabilitiesCache.h"
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -56,13 +57,31 @@ class TmsService;
 class TmsService : public Service {  
 
 private:
+
+    enum eOperation {
+        GETCAPABILITIES,
+        GETTILES,
+        GETMETADATA,
+        GETGDAL,
+        GETTILE
+    };
+
     DataStream* get_capabilities ( Request* req, ServicesConfiguration* services );
+    /**
+     * \~french
+     * \brief Construit le document de capacités, en réutilisant les fragments des couches en cache
+     * \details La variante compressée est calculée si le document est mis en cache
+     * \~english
+     * \brief Build capabilities document, reusing cached layers fragments
+     * \details Compressed variant is computed if document is cached
+     */
+    std::shared_ptr<const EncodedDocument> build_capabilities ( ServicesConfiguration* services );
     DataStream* get_tiles ( Request* req, ServicesConfiguration* services );
     DataStream* get_metadata ( Request* req, ServicesConfiguration* services );
     DataStream* get_gdal ( Request* req, ServicesConfiguration* services );
     DataStream* get_tile ( Request* req, ServicesConfiguration* services );
 
-    std::string cache_getcapabilities;
+    CapabilitiesCache cache_getcapabilities;
 
 public:
     DataStream* process_request(Request* req, ServicesConfiguration* services );
@@ -74,9 +93,17 @@ public:
      * \brief Remove cached responses
      */
     void clean_cache() {
-        cache_mtx.lock();
         cache_getcapabilities.clear();
-        cache_mtx.unlock();
+    };
+
+    /**
+     * \~french
+     * \brief Invalide les fragments de capacités d'une couche ajoutée, modifiée ou supprimée
+     * \~english
+     * \brief Invalidate capabilities fragments of an added, modified or removed layer
+     */
+    void invalidate_layer(std::string id) {
+        cache_getcapabilities.invalidate_layer(id);
     };
 
     /**
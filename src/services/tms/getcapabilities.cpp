@@ -45,18 +45,12 @@
 
 #include <iostream>
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
-
-using boost::property_tree::ptree;
-using boost::property_tree::write_xml;
-using boost::property_tree::xml_writer_settings;
-
 #include <rok4/thirdparty/json11.hpp>
 
 #include "services/tms/Exception.h"
 #include "services/tms/Service.h"
 #include "core/Rok4Server.h"
+#include "core/XmlWriter.h"
 
 DataStream* TmsService::get_capabilities ( Request* req, ServicesConfiguration* services ) {
 
@@ -64,41 +58,70 @@ DataStream* TmsService::get_capabilities ( Request* req, ServicesConfiguration*
         throw TmsException::get_error_message("Invalid version (only 1.0.0 available)", 400);
     }
 
-    if (! cache_getcapabilities.empty()) {
-        return new MessageDataStream ( cache_getcapabilities, "text/xml", 200 );
+    std::shared_ptr<const EncodedDocument> document;
+    bool stale;
+    if ( cache_getcapabilities.get_document(document, stale) ) {
+        if (stale) {
+            // Le document obsolète est servi pendant sa reconstruction
+            cache_getcapabilities.refresh([this, services]() {
+                build_capabilities(services);
+                services->unpin_layers();
+            });
+        }
+        return EncodedDocument::get_stream ( document, req );
+    }
+
+    return EncodedDocument::get_stream ( build_capabilities(services), req );
+}
+
+std::shared_ptr<const EncodedDocument> TmsService::build_capabilities ( ServicesConfiguration* services ) {
+
+    // Tant que toutes les couches ne sont pas chargées, la réponse est incomplète et n'est pas mise en cache
+    CapabilitiesCache::Build build = cache_getcapabilities.begin_build(services);
+
+    // Fragments des couches, sérialisés seulement s'ils ne sont pas en cache
+    std::string layers_content;
+    std::map<std::string, Layer*>::const_iterator layers_iterator ( services->get_layers().begin() ), layers_end ( services->get_layers().end() );
+    for ( ; layers_iterator != layers_end; ++layers_iterator ) {
+        if (! layers_iterator->second->is_loaded()) continue;
+        std::string fragment;
+        if (! cache_getcapabilities.get_fragment(layers_iterator->first, fragment)) {
+            XmlWriter fragment_writer(256);
+            layers_iterator->second->add_node_tms(fragment_writer, this);
+            fragment = fragment_writer.get_content();
+            cache_getcapabilities.set_fragment(layers_iterator->first, fragment, build);
+        }
+        layers_content.append(fragment);
     }
 
-    ptree tree;
+    XmlWriter writer(layers_content.size() + 4096);
+    writer.declaration();
 
-    ptree& root = tree.add("TileMapService", "");
-    root.add("<xmlattr>.version", "1.0.0");
-    root.add("<xmlattr>.services", endpoint_uri );
-    root.add("Title", title );
-    root.add("Abstract", abstract );
+    writer.start_element("TileMapService");
+    writer.attribute("version", "1.0.0");
+    writer.attribute("services", endpoint_uri );
+    writer.element("Title", title );
+    writer.element("Abstract", abstract );
 
     for ( unsigned int i=0; i < keywords.size(); i++ ) {
-        root.add("KeywordList", keywords.at(i).get_content() );
+        writer.element("KeywordList", keywords.at(i).get_content() );
     }
 
-    services->contact->add_node_tms(root, services->service_provider);
+    services->contact->add_node_tms(writer, services->service_provider);
 
     if (metadata) {
-        metadata->add_node_tms(root);
+        metadata->add_node_tms(writer);
     }
 
-    ptree& contents_node = root.add("TileMaps", "");
+    writer.start_element("TileMaps");
+    writer.raw(layers_content);
+    writer.end_element();
 
-    std::map<std::string, Layer*>::iterator layers_iterator ( services->get_layers().begin() ), layers_end ( services->get_layers().end() );
-    for ( ; layers_iterator != layers_end; ++layers_iterator ) {
-        layers_iterator->second->add_node_tms(contents_node, this);
-    }
+    writer.end_element();
 
-    std::stringstream ss;
-    write_xml(ss, tree);
-    cache_mtx.lock();
-    cache_getcapabilities = ss.str();
-    cache_mtx.unlock();
-    return new MessageDataStream ( ss.str(), "text/xml", 200 );
+    std::shared_ptr<const EncodedDocument> document = std::make_shared<EncodedDocument>(writer.get_content(), "text/xml", build.complete);
+    cache_getcapabilities.set_document(document, build);
+    return document;
 }
 
 DataStream* TmsService::get_tiles ( Request* req, ServicesConfiguration* services ) {
@@ -114,7 +137,11 @@ DataStream* TmsService::get_tiles ( Request* req, ServicesConfiguration* service
         throw TmsException::get_error_message("Layer unknown", 400);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_tms_enabled() ) {
         throw TmsException::get_error_message("Layer " +str_layer+" unknown", 400);
     }
@@ -135,7 +162,11 @@ DataStream* TmsService::get_metadata ( Request* req, ServicesConfiguration* serv
         throw TmsException::get_error_message("Layer unknown", 400);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_tms_enabled() ) {
         throw TmsException::get_error_message("Layer " +str_layer+" unknown", 400);
     }
@@ -156,7 +187,11 @@ DataStream* TmsService::get_gdal ( Request* req, ServicesConfiguration* services
         throw TmsException::get_error_message("Layer unknown", 400);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_tms_enabled() ) {
         throw TmsException::get_error_message("Layer " +str_layer+" unknown", 400);
     }
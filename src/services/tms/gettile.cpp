@@ -65,10 +65,15 @@ DataStream* TmsService::get_tile ( Request* req, ServicesConfiguration* services
         throw TmsException::get_error_message("Layer unknown", 400);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if ( layer == NULL || ! layer->is_tms_enabled() ) {
         throw TmsException::get_error_message("Layer " + str_layer + " unknown", 400);
     }
+    req->layer = layer->get_id();
 
     // Le niveau
     TileMatrixSet* tms = layer->get_pyramid()->get_tms();
@@ -102,11 +107,13 @@ DataStream* TmsService::get_tile ( Request* req, ServicesConfiguration* services
     TileMatrixLimits* tml = layer->get_tilematrix_limits(tms, tm);
     if (tml == NULL) {
         // On est hors niveau -> erreur
+        layer->get_tile_cache_policy().add_not_found_headers(req);
         throw TmsException::get_error_message("No data found", 404);
     }
 
-    if (! tml->contain_tile(column, row)) {
-        // On est hors tuiles -> erreur
+    if (! tml->contain_tile(column, row) || ! layer->contain_tile(tms, tm, column, row)) {
+        // On est hors tuiles ou la dalle est absente -> erreur
+        layer->get_tile_cache_policy().add_not_found_headers(req);
         throw TmsException::get_error_message("No data found", 404);
     }
 
@@ -133,7 +140,7 @@ DataStream* TmsService::get_tile ( Request* req, ServicesConfiguration* services
     std::string format = Rok4Format::to_mime_type ( ( layer->get_pyramid()->get_format() ) );
 
     // Traitement de la requête
-    DataStream* d = Tile::get_tile(services, layer, tms, tm, column, row, format, style);
+    DataStream* d = Tile::get_tile(req, services, layer, tms, tm, column, row, format, style);
     if (d == NULL) {
         throw TmsException::get_error_message("No data found", 404);
     }
@@ -128,12 +128,15 @@ DataStream* WmsService::process_request(Request* req, ServicesConfiguration* ser
     std::transform(param_request.begin(), param_request.end(), param_request.begin(), ::tolower);
     
     if (param_request == "getcapabilities") {
+        req->operation = Metrics::CAPABILITIES;
         BOOST_LOG_TRIVIAL(debug) << "GETCAPABILITIES request";
         return get_capabilities(req, services);
     } else if (param_request == "getfeatureinfo") {
+        req->operation = Metrics::FEATUREINFO;
         BOOST_LOG_TRIVIAL(debug) << "GETFEATUREINFO request";
         return get_feature_info(req, services);
     } else if (param_request == "getmap") {
+        req->operation = Metrics::MAP;
         BOOST_LOG_TRIVIAL(debug) << "GETMAP request";
         return get_map(req, services);
     } else {
@@ -48,6 +48,7 @@ class WmsService;
 #pragma once
 
 #include "services/Service.h"
+#include "services/CapabilitiesCache.h"
 #include "configurations/Services.h"
 
 /**
@@ -59,6 +60,15 @@ class WmsService : public Service {
 
 private:
     DataStream* get_capabilities ( Request* req, ServicesConfiguration* services );
+    /**
+     * \~french
+     * \brief Construit le document de capacités, en réutilisant les fragments des couches en cache
+     * \details La variante compressée est calculée si le document est mis en cache
+     * \~english
+     * \brief Build capabilities document, reusing cached layers fragments
+     * \details Compressed variant is computed if document is cached
+     */
+    std::shared_ptr<const EncodedDocument> build_capabilities ( ServicesConfiguration* services, bool inspire );
     DataStream* get_feature_info ( Request* req, ServicesConfiguration* services );
     DataStream* get_map ( Request* req, ServicesConfiguration* services );
 
@@ -67,8 +77,8 @@ private:
     std::string root_layer_title;
     std::string root_layer_abstract;
 
-    std::string cache_getcapabilities;
-    std::string cache_getcapabilities_inspire;
+    CapabilitiesCache cache_getcapabilities;
+    CapabilitiesCache cache_getcapabilities_inspire;
 
 public:
     DataStream* process_request(Request* req, ServicesConfiguration* services );
@@ -80,10 +90,19 @@ public:
      * \brief Remove cached responses
      */
     void clean_cache() {
-        cache_mtx.lock();
         cache_getcapabilities.clear();
         cache_getcapabilities_inspire.clear();
-        cache_mtx.unlock();
+    };
+
+    /**
+     * \~french
+     * \brief Invalide les fragments de capacités d'une couche ajoutée, modifiée ou supprimée
+     * \~english
+     * \brief Invalidate capabilities fragments of an added, modified or removed layer
+     */
+    void invalidate_layer(std::string id) {
+        cache_getcapabilities.invalidate_layer(id);
+        cache_getcapabilities_inspire.invalidate_layer(id);
     };
 
     /**
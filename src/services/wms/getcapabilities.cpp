@@ -46,136 +46,199 @@
 #include <iostream>
 
 #include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
 
 using boost::property_tree::ptree;
-using boost::property_tree::write_xml;
-using boost::property_tree::xml_writer_settings;
 
 #include "services/wms/Exception.h"
 #include "services/wms/Service.h"
 #include "core/Rok4Server.h"
+#include "core/XmlWriter.h"
 
 DataStream* WmsService::get_capabilities ( Request* req, ServicesConfiguration* services ) {
 
-    bool default_inspire = services->default_inspire;
-
-    if ( req->is_inspire(default_inspire) && ! cache_getcapabilities_inspire.empty()) {
-        return new MessageDataStream ( cache_getcapabilities_inspire, "text/xml", 200 );
+    bool inspire = req->is_inspire(services->default_inspire);
+    CapabilitiesCache& cache = inspire ? cache_getcapabilities_inspire : cache_getcapabilities;
+
+    std::shared_ptr<const EncodedDocument> document;
+    bool stale;
+    if ( cache.get_document(document, stale) ) {
+        if (stale) {
+            // Le document obsolète est servi pendant sa reconstruction
+            cache.refresh([this, services, inspire]() {
+                build_capabilities(services, inspire);
+                services->unpin_layers();
+            });
+        }
+        return EncodedDocument::get_stream ( document, req );
     }
-    else if (! req->is_inspire(default_inspire) && ! cache_getcapabilities.empty()) {
-        return new MessageDataStream ( cache_getcapabilities, "text/xml", 200 );
+
+    return EncodedDocument::get_stream ( build_capabilities(services, inspire), req );
+}
+
+/**
+ * \~french \brief Écrit l'URL d'une opération, l'élément DCPType
+ * \~english \brief Write an operation URL, the DCPType element
+ */
+static void write_dcptype(XmlWriter& writer, std::string url) {
+    writer.start_element("DCPType");
+    writer.start_element("HTTP");
+    writer.start_element("Get");
+    writer.start_element("OnlineResource");
+    writer.attribute("xlink:href", url);
+    writer.attribute("xmlns:xlink", "http://www.w3.org/1999/xlink");
+    writer.attribute("xlink:type", "simple");
+    writer.end_element();
+    writer.end_element();
+    writer.end_element();
+    writer.end_element();
+}
+
+std::shared_ptr<const EncodedDocument> WmsService::build_capabilities ( ServicesConfiguration* services, bool inspire ) {
+
+    CapabilitiesCache& cache = inspire ? cache_getcapabilities_inspire : cache_getcapabilities;
+    // Tant que toutes les couches ne sont pas chargées, la réponse est incomplète et n'est pas mise en cache
+    CapabilitiesCache::Build build = cache.begin_build(services);
+
+    // Fragments des couches, sérialisés seulement s'ils ne sont pas en cache
+    std::string layers_content;
+    std::map<std::string, Layer*>::const_iterator layers_iterator ( services->get_layers().begin() ), layers_end ( services->get_layers().end() );
+    for ( ; layers_iterator != layers_end; ++layers_iterator ) {
+        if (! layers_iterator->second->is_loaded()) continue;
+        std::string fragment;
+        if (! cache.get_fragment(layers_iterator->first, fragment)) {
+            XmlWriter fragment_writer;
+            layers_iterator->second->add_node_wms(fragment_writer, this, inspire);
+            fragment = fragment_writer.get_content();
+            cache.set_fragment(layers_iterator->first, fragment, build);
+        }
+        layers_content.append(fragment);
     }
 
-    ptree tree;
+    XmlWriter writer(layers_content.size() + 16384);
+    writer.declaration();
 
-    ptree& root = tree.add("WMS_Capabilities", "");
-    root.add("<xmlattr>.version", "1.3.0");
-    root.add("<xmlattr>.xmlns","http://www.opengis.net/wms" );
-    root.add("<xmlattr>.xmlns:xlink","http://www.w3.org/1999/xlink" );
-    root.add("<xmlattr>.xmlns:xsi","http://www.w3.org/2001/XMLSchema-instance" );
+    writer.start_element("WMS_Capabilities");
+    writer.attribute("version", "1.3.0");
+    writer.attribute("xmlns","http://www.opengis.net/wms" );
+    writer.attribute("xmlns:xlink","http://www.w3.org/1999/xlink" );
+    writer.attribute("xmlns:xsi","http://www.w3.org/2001/XMLSchema-instance" );
     
-    if ( req->is_inspire(default_inspire) ) {
-        root.add("<xmlattr>.xmlns:inspire_common","http://inspire.ec.europa.eu/schemas/common/1.0" );
-        root.add("<xmlattr>.xmlns:inspire_vs","http://inspire.ec.europa.eu/schemas/inspire_vs_ows11/1.0" );
-        root.add("<xmlattr>.xsi:schemaLocation","http://www.opengis.net/wms http://schemas.opengis.net/wms/1.3.0/capabilities_1_3_0.xsd http://inspire.ec.europa.eu/schemas/inspire_vs/1.0 http://inspire.ec.europa.eu/schemas/inspire_vs/1.0/inspire_vs.xsd http://inspire.ec.europa.eu/schemas/common/1.0 http://inspire.ec.europa.eu/schemas/common/1.0/common.xsd" );
+    if ( inspire ) {
+        writer.attribute("xmlns:inspire_common","http://inspire.ec.europa.eu/schemas/common/1.0" );
+        writer.attribute("xmlns:inspire_vs","http://inspire.ec.europa.eu/schemas/inspire_vs_ows11/1.0" );
+        writer.attribute("xsi:schemaLocation","http://www.opengis.net/wms http://schemas.opengis.net/wms/1.3.0/capabilities_1_3_0.xsd http://inspire.ec.europa.eu/schemas/inspire_vs/1.0 http://inspire.ec.europa.eu/schemas/inspire_vs/1.0/inspire_vs.xsd http://inspire.ec.europa.eu/schemas/common/1.0 http://inspire.ec.europa.eu/schemas/common/1.0/common.xsd" );
     } else {
-        root.add("<xmlattr>.xsi:schemaLocation","http://www.opengis.net/wms http://schemas.opengis.net/wms/1.3.0/capabilities_1_3_0.xsd" );
+        writer.attribute("xsi:schemaLocation","http://www.opengis.net/wms http://schemas.opengis.net/wms/1.3.0/capabilities_1_3_0.xsd" );
     }
 
-    ptree& service_node = root.add("Service", "");
-    service_node.add("Name", name);
-    service_node.add("Title", title);
-    service_node.add("Abstract", abstract);
+    writer.start_element("Service");
+    writer.element("Name", name);
+    writer.element("Title", title);
+    writer.element("Abstract", abstract);
     if ( keywords.size() != 0 ) {
-        ptree& keywords_node = service_node.add("KeywordList", "");
+        writer.start_element("KeywordList");
+        ptree keywords_tree;
         for ( unsigned int i=0; i < keywords.size(); i++ ) {
-            keywords.at(i).add_node(keywords_node, "Keyword");
+            keywords.at(i).add_node(keywords_tree, "Keyword");
         }
+        writer.subtree(keywords_tree);
+        writer.end_element();
     }
 
-    service_node.add("OnlineResource.<xmlattr>.xmlns:xlink", "http://www.w3.org/1999/xlink");
-    service_node.add("OnlineResource.<xmlattr>.xlink:href", services->provider_site);
+    writer.start_element("OnlineResource");
+    writer.attribute("xmlns:xlink", "http://www.w3.org/1999/xlink");
+    writer.attribute("xlink:href", services->provider_site);
+    writer.end_element();
 
-    services->contact->add_node_wms(service_node, services->service_provider);
+    services->contact->add_node_wms(writer, services->service_provider);
 
-    service_node.add("Fees", services->fee);
-    service_node.add("AccessConstraints", services->access_constraint);
-    service_node.add("LayerLimit", services->map_max_layers_count);
-    service_node.add("MaxWidth", services->map_max_width);
-    service_node.add("MaxHeight", services->map_max_height);
+    writer.element("Fees", services->fee);
+    writer.element("AccessConstraints", services->access_constraint);
+    writer.element("LayerLimit", services->map_max_layers_count);
+    writer.element("MaxWidth", services->map_max_width);
+    writer.element("MaxHeight", services->map_max_height);
+    writer.end_element();
 
-    ptree& capability_node = root.add("Capability", "");
+    writer.start_element("Capability");
 
     std::string additionnal_params = "?SERVICE=WMS&";
-    if (req->is_inspire(default_inspire)) {
+    if (inspire) {
         additionnal_params = "?INSPIRE=1&SERVICE=WMS&";
     }
 
-    ptree& op_getcapabilities = capability_node.add("Request.GetCapabilities", "");
-    op_getcapabilities.add("Format", "text/xml");
-    op_getcapabilities.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xlink:href", endpoint_uri + additionnal_params);
-    op_getcapabilities.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xmlns:xlink", "http://www.w3.org/1999/xlink");
-    op_getcapabilities.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xlink:type", "simple");
+    writer.start_element("Request");
 
-    ptree& op_getmap = capability_node.add("Request.GetMap", "");
+    writer.start_element("GetCapabilities");
+    writer.element("Format", "text/xml");
+    write_dcptype(writer, endpoint_uri + additionnal_params);
+    writer.end_element();
+
+    writer.start_element("GetMap");
     for ( unsigned int i = 0; i < services->map_formats.size(); i++ ) {
-        op_getmap.add("Format", services->map_formats.at(i));
+        writer.element("Format", services->map_formats.at(i));
     }
-    op_getmap.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xlink:href", endpoint_uri + additionnal_params);
-    op_getmap.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xmlns:xlink", "http://www.w3.org/1999/xlink");
-    op_getmap.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xlink:type", "simple");
+    write_dcptype(writer, endpoint_uri + additionnal_params);
+    writer.end_element();
 
-    ptree& op_getfeatureinfo = capability_node.add("Request.GetFeatureInfo", "");
+    writer.start_element("GetFeatureInfo");
     for ( unsigned int i = 0; i < services->info_formats.size(); i++ ) {
-        op_getfeatureinfo.add("Format", services->info_formats.at(i));
+        writer.element("Format", services->info_formats.at(i));
     }
-    op_getfeatureinfo.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xlink:href", endpoint_uri + additionnal_params);
-    op_getfeatureinfo.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xmlns:xlink", "http://www.w3.org/1999/xlink");
-    op_getfeatureinfo.add("DCPType.HTTP.Get.OnlineResource.<xmlattr>.xlink:type", "simple");
+    write_dcptype(writer, endpoint_uri + additionnal_params);
+    writer.end_element();
+
+    writer.end_element();
 
-    capability_node.add("Exception.Format", "XML");
+    writer.start_element("Exception");
+    writer.element("Format", "XML");
+    writer.end_element();
 
-    if (req->is_inspire(default_inspire)) {
-        ptree& inspire_extension = capability_node.add("inspire_vs:ExtendedCapabilities", "");
+    if (inspire) {
+        writer.start_element("inspire_vs:ExtendedCapabilities");
 
         if (metadata) {
-            inspire_extension.add("inspire_common:MetadataUrl.inspire_common:URL", metadata->get_href());
-            inspire_extension.add("inspire_common:MetadataUrl.inspire_common:MediaType", metadata->get_type());
+            writer.start_element("inspire_common:MetadataUrl");
+            writer.element("inspire_common:URL", metadata->get_href());
+            writer.element("inspire_common:MediaType", metadata->get_type());
+            writer.end_element();
         }
         
-        inspire_extension.add("inspire_common:SupportedLanguages.inspire_common:DefaultLanguage.inspire_common:Language", "fre");
-        inspire_extension.add("inspire_common:ResponseLanguage.inspire_common:Language", "fre");
+        writer.start_element("inspire_common:SupportedLanguages");
+        writer.start_element("inspire_common:DefaultLanguage");
+        writer.element("inspire_common:Language", "fre");
+        writer.end_element();
+        writer.end_element();
+        writer.start_element("inspire_common:ResponseLanguage");
+        writer.element("inspire_common:Language", "fre");
+        writer.end_element();
+
+        writer.end_element();
     }
 
-    ptree& contents_node = capability_node.add("Layer", "");
+    writer.start_element("Layer");
 
-    contents_node.add("Title", root_layer_title);
-    contents_node.add("Abstract", root_layer_abstract);
+    writer.element("Title", root_layer_title);
+    writer.element("Abstract", root_layer_abstract);
 
     for ( unsigned int i = 0; i < services->map_crss.size(); i++ ) {
-        contents_node.add("CRS", services->map_crss.at(i)->get_request_code());
+        writer.element("CRS", services->map_crss.at(i)->get_request_code());
     }
 
+    ptree bboxes_tree;
     BoundingBox<double> gbbox ( -180.0,-90.0,180.0,90.0 );
-    gbbox.add_node(contents_node, true, true);
+    gbbox.add_node(bboxes_tree, true, true);
     gbbox.crs = "CRS:84";
-    gbbox.add_node(contents_node, false, false);
+    gbbox.add_node(bboxes_tree, false, false);
+    writer.subtree(bboxes_tree);
 
-    std::map<std::string, Layer*>::iterator layers_iterator ( services->get_layers().begin() ), layers_end ( services->get_layers().end() );
-    for ( ; layers_iterator != layers_end; ++layers_iterator ) {
-        layers_iterator->second->add_node_wms(contents_node, this, req->is_inspire(default_inspire));
-    }
+    writer.raw(layers_content);
 
-    std::stringstream ss;
-    write_xml(ss, tree);
-    cache_mtx.lock();
-    if (req->is_inspire(default_inspire)) {
-        cache_getcapabilities_inspire = ss.str();
-    } else {
-        cache_getcapabilities = ss.str();
-    }
-    cache_mtx.unlock();
-    return new MessageDataStream ( ss.str(), "text/xml", 200 );
+    writer.end_element();
+    writer.end_element();
+    writer.end_element();
+
+    std::shared_ptr<const EncodedDocument> document = std::make_shared<EncodedDocument>(writer.get_content(), "text/xml", build.complete);
+    cache.set_document(document, build);
+    return document;
 
 }
@@ -73,7 +73,11 @@ DataStream* WmsService::get_feature_info ( Request* req, ServicesConfiguration*
             throw WmsException::get_error_message("Layer unknown", "LayerNotDefined", 400);
         }
 
-        Layer* layer = services->get_layer(vector_layers.at(i));
+        Layer* layer;
+        {
+            Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+            layer = services->get_layer(vector_layers.at(i));
+        }
         if (layer == NULL || ! layer->is_wms_enabled()) {
             throw WmsException::get_error_message("Layer " + vector_layers.at(i) + " unknown", "LayerNotDefined", 400);
         }
@@ -101,10 +105,15 @@ DataStream* WmsService::get_feature_info ( Request* req, ServicesConfiguration*
             throw WmsException::get_error_message("Layer unknown", "LayerNotDefined", 400);
         }
 
-        Layer* layer = services->get_layer(vector_query_layers.at(i));
+        Layer* layer;
+        {
+            Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+            layer = services->get_layer(vector_query_layers.at(i));
+        }
         if (layer == NULL || ! layer->is_wms_enabled()) {
             throw WmsException::get_error_message("Layer " + vector_query_layers.at(i) + " unknown", "LayerNotDefined", 400);
         }
+        if (i == 0) req->layer = layer->get_id();
 
         if (! layer->is_gfi_enabled()) {
             throw WmsException::get_error_message("Layer " + vector_query_layers.at(i) + " not queryable", "LayerNotQueryable", 400);
@@ -73,10 +73,15 @@ DataStream* WmsService::get_map ( Request* req, ServicesConfiguration* services
             throw WmsException::get_error_message("Layer unknown", "LayerNotDefined", 400);
         }
 
-        Layer* layer = services->get_layer(vector_layers.at(i));
+        Layer* layer;
+        {
+            Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+            layer = services->get_layer(vector_layers.at(i));
+        }
         if (layer == NULL || ! layer->is_wms_enabled()) {
             throw WmsException::get_error_message("Layer " + vector_layers.at(i) + " unknown", "LayerNotDefined", 400);
         }
+        if (i == 0) req->layer = layer->get_id();
         if (! layer->is_raster()) {
             throw WmsException::get_error_message("Vector data " + vector_layers.at(i) + " cannot be requested with WMS GetMap", "InvalidParameterValue", 400);
         }
@@ -242,13 +247,14 @@ DataStream* WmsService::get_map ( Request* req, ServicesConfiguration* services
     // Traitement de la requête
     std::string error;
     DataStream* d = Map::get_map(
-        services, services->map_reprojection, services->map_max_tile_x, services->map_max_tile_y, 
+        req, services, services->map_reprojection, services->map_max_tile_x, services->map_max_tile_y, 
         layers, width, height, crs, bbox, styles, format, format_options, dpi,
         &error
     );
     if (d == NULL) {
         throw WmsException::get_error_message(error, "InvalidParameterValue", 400);
     }
+    Map::add_cache_headers(req, layers);
     return d;
 
 }
\ No newline at end of file
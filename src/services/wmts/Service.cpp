@@ -92,12 +92,15 @@ DataStream* WmtsService::process_request(Request* req, ServicesConfiguration* se
     std::transform(param_request.begin(), param_request.end(), param_request.begin(), ::tolower);
     
     if (param_request == "getcapabilities") {
+        req->operation = Metrics::CAPABILITIES;
         BOOST_LOG_TRIVIAL(debug) << "GETCAPABILITIES request";
         return get_capabilities(req, services);
     } else if (param_request == "getfeatureinfo") {
+        req->operation = Metrics::FEATUREINFO;
         BOOST_LOG_TRIVIAL(debug) << "GETFEATUREINFO request";
         return get_feature_info(req, services);
     } else if (param_request == "gettile") {
+        req->operation = Metrics::TILE;
         BOOST_LOG_TRIVIAL(debug) << "GETTILE request";
         return get_tile(req, services);
     } else {
@@ -48,6 +48,7 @@ class WmtsService;
 #pragma once
 
 #include "services/Service.h"
+#include "services/CapabilitiesCache.h"
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -58,11 +59,20 @@ class WmtsService : public Service {
 
 private:
     DataStream* get_capabilities ( Request* req, ServicesConfiguration* services );
+    /**
+     * \~french
+     * \brief Construit le document de capacités, en réutilisant les fragments des couches en cache
+     * \details La variante compressée est calculée si le document est mis en cache
+     * \~english
+     * \brief Build capabilities document, reusing cached layers fragments
+     * \details Compressed variant is computed if document is cached
+     */
+    std::shared_ptr<const EncodedDocument> build_capabilities ( ServicesConfiguration* services, bool inspire );
     DataStream* get_feature_info ( Request* req, ServicesConfiguration* services );
     DataStream* get_tile ( Request* req, ServicesConfiguration* services );
 
-    std::string cache_getcapabilities;
-    std::string cache_getcapabilities_inspire;
+    CapabilitiesCache cache_getcapabilities;
+    CapabilitiesCache cache_getcapabilities_inspire;
 
 public:
     DataStream* process_request(Request* req, ServicesConfiguration* services );
@@ -74,10 +84,19 @@ public:
      * \brief Remove cached responses
      */
     void clean_cache() {
-        cache_mtx.lock();
         cache_getcapabilities.clear();
         cache_getcapabilities_inspire.clear();
-        cache_mtx.unlock();
+    };
+
+    /**
+     * \~french
+     * \brief Invalide les fragments de capacités d'une couche ajoutée, modifiée ou supprimée
+     * \~english
+     * \brief Invalidate capabilities fragments of an added, modified or removed layer
+     */
+    void invalidate_layer(std::string id) {
+        cache_getcapabilities.invalidate_layer(id);
+        cache_getcapabilities_inspire.invalidate_layer(id);
     };
 
     /**
@@ -46,137 +46,198 @@
 #include <iostream>
 
 #include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
 
 using boost::property_tree::ptree;
-using boost::property_tree::write_xml;
-using boost::property_tree::xml_writer_settings;
 
 #include "services/wmts/Exception.h"
 #include "services/wmts/Service.h"
 #include "core/Rok4Server.h"
+#include "core/XmlWriter.h"
 
 DataStream* WmtsService::get_capabilities ( Request* req, ServicesConfiguration* services ) {
 
-    bool default_inspire = services->default_inspire;
-
-    if ( req->is_inspire(default_inspire) && ! cache_getcapabilities_inspire.empty()) {
-        return new MessageDataStream ( cache_getcapabilities_inspire, "text/xml", 200 );
-    }
-    else if (! req->is_inspire(default_inspire) && ! cache_getcapabilities.empty()) {
-        return new MessageDataStream ( cache_getcapabilities, "text/xml", 200 );
+    bool inspire = req->is_inspire(services->default_inspire);
+    CapabilitiesCache& cache = inspire ? cache_getcapabilities_inspire : cache_getcapabilities;
+
+    std::shared_ptr<const EncodedDocument> document;
+    bool stale;
+    if ( cache.get_document(document, stale) ) {
+        if (stale) {
+            // Le document obsolète est servi pendant sa reconstruction
+            cache.refresh([this, services, inspire]() {
+                build_capabilities(services, inspire);
+                services->unpin_layers();
+            });
+        }
+        return EncodedDocument::get_stream ( document, req );
     }
 
+    return EncodedDocument::get_stream ( build_capabilities(services, inspire), req );
+}
+
+/**
+ * \~french \brief Écrit une opération et son URL
+ * \~english \brief Write an operation and its URL
+ */
+static void write_operation(XmlWriter& writer, std::string name, std::string url) {
+    writer.start_element("ows:Operation");
+    writer.attribute("name", name);
+    writer.start_element("ows:DCP");
+    writer.start_element("ows:HTTP");
+    writer.start_element("ows:Get");
+    writer.attribute("xlink:href", url);
+    writer.start_element("ows:Constraint");
+    writer.attribute("name", "GetEncoding");
+    writer.start_element("ows:AllowedValues");
+    writer.element("ows:Value", "KVP");
+    writer.end_element();
+    writer.end_element();
+    writer.end_element();
+    writer.end_element();
+    writer.end_element();
+    writer.end_element();
+}
+
+std::shared_ptr<const EncodedDocument> WmtsService::build_capabilities ( ServicesConfiguration* services, bool inspire ) {
+
+    CapabilitiesCache& cache = inspire ? cache_getcapabilities_inspire : cache_getcapabilities;
+    // Tant que toutes les couches ne sont pas chargées, la réponse est incomplète et n'est pas mise en cache
+    CapabilitiesCache::Build build = cache.begin_build(services);
+
     // On va mémoriser les TMS utilisés, avec les niveaux du haut et du bas
     // La clé est un triplet : nom du TMS, niveau du haut, niveau du bas
     std::map< std::string, TileMatrixSetInfos*> used_tms_list;
 
-    ptree tree;
+    // Fragments des couches, sérialisés seulement s'ils ne sont pas en cache. Les TMS utilisés sont toujours collectés
+    std::string layers_content;
+    std::map<std::string, Layer*>::const_iterator layers_iterator ( services->get_layers().begin() ), layers_end ( services->get_layers().end() );
+    for ( ; layers_iterator != layers_end; ++layers_iterator ) {
+        if (! layers_iterator->second->is_loaded()) continue;
+        std::string fragment;
+        if (cache.get_fragment(layers_iterator->first, fragment)) {
+            layers_iterator->second->add_used_tms_wmts(inspire, &used_tms_list);
+        } else {
+            XmlWriter fragment_writer;
+            layers_iterator->second->add_node_wmts(fragment_writer, this, inspire, &used_tms_list);
+            fragment = fragment_writer.get_content();
+            cache.set_fragment(layers_iterator->first, fragment, build);
+        }
+        layers_content.append(fragment);
+    }
+
+    XmlWriter writer(layers_content.size() + 65536);
+    writer.declaration();
 
-    ptree& root = tree.add("Capabilities", "");
-    root.add("<xmlattr>.version", "1.0.0");
-    root.add("<xmlattr>.xmlns","http://www.opengis.net/wmts/1.0" );
-    root.add("<xmlattr>.xmlns:ows","http://www.opengis.net/ows/1.1" );
-    root.add("<xmlattr>.xmlns:xlink","http://www.w3.org/1999/xlink" );
-    root.add("<xmlattr>.xmlns:xsi","http://www.w3.org/2001/XMLSchema-instance" );
-    root.add("<xmlattr>.xmlns:gml","http://www.opengis.net/gml" );
+    writer.start_element("Capabilities");
+    writer.attribute("version", "1.0.0");
+    writer.attribute("xmlns","http://www.opengis.net/wmts/1.0" );
+    writer.attribute("xmlns:ows","http://www.opengis.net/ows/1.1" );
+    writer.attribute("xmlns:xlink","http://www.w3.org/1999/xlink" );
+    writer.attribute("xmlns:xsi","http://www.w3.org/2001/XMLSchema-instance" );
+    writer.attribute("xmlns:gml","http://www.opengis.net/gml" );
     
-    if ( req->is_inspire(default_inspire) ) {
-        root.add("<xmlattr>.xmlns:inspire_common","http://inspire.ec.europa.eu/schemas/common/1.0" );
-        root.add("<xmlattr>.xmlns:inspire_vs","http://inspire.ec.europa.eu/schemas/inspire_vs_ows11/1.0" );
-        root.add("<xmlattr>.xsi:schemaLocation","http://www.opengis.net/wmts/1.0 http://schemas.opengis.net/wmts/1.0/wmtsGetCapabilities_response.xsd http://inspire.ec.europa.eu/schemas/inspire_vs_ows11/1.0 http://inspire.ec.europa.eu/schemas/inspire_vs_ows11/1.0/inspire_vs_ows_11.xsd" );
+    if ( inspire ) {
+        writer.attribute("xmlns:inspire_common","http://inspire.ec.europa.eu/schemas/common/1.0" );
+        writer.attribute("xmlns:inspire_vs","http://inspire.ec.europa.eu/schemas/inspire_vs_ows11/1.0" );
+        writer.attribute("xsi:schemaLocation","http://www.opengis.net/wmts/1.0 http://schemas.opengis.net/wmts/1.0/wmtsGetCapabilities_response.xsd http://inspire.ec.europa.eu/schemas/inspire_vs_ows11/1.0 http://inspire.ec.europa.eu/schemas/inspire_vs_ows11/1.0/inspire_vs_ows_11.xsd" );
     } else {
-        root.add("<xmlattr>.xsi:schemaLocation","http://www.opengis.net/wmts/1.0 http://schemas.opengis.net/wmts/1.0/wmtsGetCapabilities_response.xsd" );
+        writer.attribute("xsi:schemaLocation","http://www.opengis.net/wmts/1.0 http://schemas.opengis.net/wmts/1.0/wmtsGetCapabilities_response.xsd" );
     }
 
-    ptree& identification_node = root.add("ows:ServiceIdentification", "");
-    identification_node.add("ows:Title", title);
-    identification_node.add("ows:Abstract", abstract);
+    writer.start_element("ows:ServiceIdentification");
+    writer.element("ows:Title", title);
+    writer.element("ows:Abstract", abstract);
     if ( keywords.size() != 0 ) {
-        ptree& keywords_node = identification_node.add("ows:Keywords", "");
+        writer.start_element("ows:Keywords");
+        ptree keywords_tree;
         for ( unsigned int i=0; i < keywords.size(); i++ ) {
-            keywords.at(i).add_node(keywords_node, "ows:Keyword");
+            keywords.at(i).add_node(keywords_tree, "ows:Keyword");
         }
+        writer.subtree(keywords_tree);
+        writer.end_element();
     }
 
-    identification_node.add("ows:ServiceType", "OGC WMTS");
-    identification_node.add("ows:ServiceTypeVersion", "1.0.0");
-    identification_node.add("ows:Fees", services->fee);
-    identification_node.add("ows:AccessConstraints", services->access_constraint);
+    writer.element("ows:ServiceType", "OGC WMTS");
+    writer.element("ows:ServiceTypeVersion", "1.0.0");
+    writer.element("ows:Fees", services->fee);
+    writer.element("ows:AccessConstraints", services->access_constraint);
+    writer.end_element();
 
-    ptree& provider_node = root.add("ows:ServiceProvider", "");
-    provider_node.add("ows:ProviderName", services->service_provider);
-    provider_node.add("ows:ProviderSite.<xmlattr>.xlink:href", services->provider_site);
+    writer.start_element("ows:ServiceProvider");
+    writer.element("ows:ProviderName", services->service_provider);
+    writer.start_element("ows:ProviderSite");
+    writer.attribute("xlink:href", services->provider_site);
+    writer.end_element();
 
-    services->contact->add_node_wmts(provider_node);
+    services->contact->add_node_wmts(writer);
+    writer.end_element();
 
     std::string additionnal_params = "?SERVICE=WMTS&";
-    if (req->is_inspire(default_inspire)) {
+    if (inspire) {
         additionnal_params = "?INSPIRE=1&SERVICE=WMTS&";
     }
 
-    ptree& op_getcapabilities = root.add("ows:OperationsMetadata.ows:Operation", "");
-    op_getcapabilities.add("<xmlattr>.name", "GetCapabilities");
-    op_getcapabilities.add("ows:DCP.ows:HTTP.ows:Get.<xmlattr>.xlink:href", endpoint_uri + additionnal_params);
-    op_getcapabilities.add("ows:DCP.ows:HTTP.ows:Get.ows:Constraint.<xmlattr>.name", "GetEncoding");
-    op_getcapabilities.add("ows:DCP.ows:HTTP.ows:Get.ows:Constraint.ows:AllowedValues.ows:Value", "KVP");
+    writer.start_element("ows:OperationsMetadata");
+    write_operation(writer, "GetCapabilities", endpoint_uri + additionnal_params);
+    write_operation(writer, "GetTile", endpoint_uri + additionnal_params);
+    write_operation(writer, "GetFeatureInfo", endpoint_uri + additionnal_params);
 
-    ptree& op_gettile = root.add("ows:OperationsMetadata.ows:Operation", "");
-    op_gettile.add("<xmlattr>.name", "GetTile");
-    op_gettile.add("ows:DCP.ows:HTTP.ows:Get.<xmlattr>.xlink:href", endpoint_uri + additionnal_params);
-    op_gettile.add("ows:DCP.ows:HTTP.ows:Get.ows:Constraint.<xmlattr>.name", "GetEncoding");
-    op_gettile.add("ows:DCP.ows:HTTP.ows:Get.ows:Constraint.ows:AllowedValues.ows:Value", "KVP");
-
-    ptree& op_getfeatureinfo = root.add("ows:OperationsMetadata.ows:Operation", "");
-    op_getfeatureinfo.add("<xmlattr>.name", "GetFeatureInfo");
-    op_getfeatureinfo.add("ows:DCP.ows:HTTP.ows:Get.<xmlattr>.xlink:href", endpoint_uri + additionnal_params);
-    op_getfeatureinfo.add("ows:DCP.ows:HTTP.ows:Get.ows:Constraint.<xmlattr>.name", "GetEncoding");
-    op_getfeatureinfo.add("ows:DCP.ows:HTTP.ows:Get.ows:Constraint.ows:AllowedValues.ows:Value", "KVP");
-
-    if (req->is_inspire(default_inspire)) {
-        ptree& inspire_extension = root.add("ows:OperationsMetadata.inspire_vs:ExtendedCapabilities", "");
+    if (inspire) {
+        writer.start_element("inspire_vs:ExtendedCapabilities");
 
         if (metadata) {
-            inspire_extension.add("inspire_common:MetadataUrl.inspire_common:URL", metadata->get_href());
-            inspire_extension.add("inspire_common:MetadataUrl.inspire_common:MediaType", metadata->get_type());
+            writer.start_element("inspire_common:MetadataUrl");
+            writer.element("inspire_common:URL", metadata->get_href());
+            writer.element("inspire_common:MediaType", metadata->get_type());
+            writer.end_element();
         }
         
-        inspire_extension.add("inspire_common:SupportedLanguages.inspire_common:DefaultLanguage.inspire_common:Language", "fre");
-        inspire_extension.add("inspire_common:ResponseLanguage.inspire_common:Language", "fre");
+        writer.start_element("inspire_common:SupportedLanguages");
+        writer.start_element("inspire_common:DefaultLanguage");
+        writer.element("inspire_common:Language", "fre");
+        writer.end_element();
+        writer.end_element();
+        writer.start_element("inspire_common:ResponseLanguage");
+        writer.element("inspire_common:Language", "fre");
+        writer.end_element();
+
+        writer.end_element();
     }
+    writer.end_element();
 
-    ptree& contents_node = root.add("Contents", "");
+    writer.start_element("Contents");
 
-    std::map<std::string, Layer*>::iterator layers_iterator ( services->get_layers().begin() ), layers_end ( services->get_layers().end() );
-    for ( ; layers_iterator != layers_end; ++layers_iterator ) {
-        layers_iterator->second->add_node_wmts(contents_node, this, req->is_inspire(default_inspire), &used_tms_list);
-    }
+    // Les fragments des couches, avant les TMS
+    writer.raw(layers_content);
 
     std::map<std::string, TileMatrixSetInfos*>::iterator tms_iterator ( used_tms_list.begin() ), tms_end ( used_tms_list.end() );
     for ( ; tms_iterator!=tms_end; ++tms_iterator ) {
 
-        ptree& tms_node = contents_node.add("TileMatrixSet", "");
+        writer.start_element("TileMatrixSet");
 
-        tms_node.add( "ows:Identifier", tms_iterator->first );
+        writer.element( "ows:Identifier", tms_iterator->first );
 
         TileMatrixSet* tms = tms_iterator->second->tms;
 
         if ( ! ( tms->get_title().empty() ) ) {
-            tms_node.add ( "ows:Title", tms->get_title() );
+            writer.element ( "ows:Title", tms->get_title() );
         }
 
         if ( ! ( tms->get_abstract().empty() ) ) {
-            tms_node.add ( "ows:Abstract", tms->get_abstract() );
+            writer.element ( "ows:Abstract", tms->get_abstract() );
         }
 
         if ( tms->get_keywords()->size() != 0 ) {
-            ptree& tms_keywords_node = tms_node.add("ows:Keywords", "");
+            writer.start_element("ows:Keywords");
+            ptree tms_keywords_tree;
             for ( unsigned int j = 0; j < tms->get_keywords()->size(); j++ ) {
-                tms->get_keywords()->at ( j ).add_node(tms_keywords_node, "ows:Keyword");
+                tms->get_keywords()->at ( j ).add_node(tms_keywords_tree, "ows:Keyword");
             }
+            writer.subtree(tms_keywords_tree);
+            writer.end_element();
         }
 
-        tms_node.add ( "ows:SupportedCRS",tms->get_crs()->get_request_code() );
+        writer.element ( "ows:SupportedCRS",tms->get_crs()->get_request_code() );
         
         // TileMatrix
         bool keep = false;
@@ -192,39 +253,39 @@ DataStream* WmtsService::get_capabilities ( Request* req, ServicesConfiguration*
                 keep = true;
             }
 
-            ptree& tm_node = tms_node.add("TileMatrix", "");
+            writer.start_element("TileMatrix");
 
-            tm_node.add( "ows:Identifier",tm->get_id() );
-            tm_node.add( "ScaleDenominator",Utils::double_to_string ( ( long double ) ( tm->get_res() * tms->get_crs()->get_meters_per_unit() ) /0.00028 ) );
+            writer.element( "ows:Identifier",tm->get_id() );
+            writer.element( "ScaleDenominator",Utils::double_to_string ( ( long double ) ( tm->get_res() * tms->get_crs()->get_meters_per_unit() ) /0.00028 ) );
             if (tms->get_crs()->get_authority() == "EPSG" && tms->get_crs()->is_geographic()) {
-                tm_node.add ( "TopLeftCorner", Utils::double_to_string ( tm->get_y0() ) + " " + Utils::double_to_string ( tm->get_x0() ) );
+                writer.element ( "TopLeftCorner", Utils::double_to_string ( tm->get_y0() ) + " " + Utils::double_to_string ( tm->get_x0() ) );
             } else {
-                tm_node.add ( "TopLeftCorner", Utils::double_to_string ( tm->get_x0() ) + " " + Utils::double_to_string ( tm->get_y0() ) );
+                writer.element ( "TopLeftCorner", Utils::double_to_string ( tm->get_x0() ) + " " + Utils::double_to_string ( tm->get_y0() ) );
             }
-            tm_node.add( "TileWidth",Utils::int_to_string ( tm->get_tile_width() ) );
-            tm_node.add("TileHeight",Utils::int_to_string ( tm->get_tile_height() ) );
-            tm_node.add( "MatrixWidth",Utils::int_to_string ( tm->get_matrix_width() ) );
-            tm_node.add( "MatrixHeight",Utils::int_to_string ( tm->get_matrix_height() ) );
+            writer.element( "TileWidth",Utils::int_to_string ( tm->get_tile_width() ) );
+            writer.element("TileHeight",Utils::int_to_string ( tm->get_tile_height() ) );
+            writer.element( "MatrixWidth",Utils::int_to_string ( tm->get_matrix_width() ) );
+            writer.element( "MatrixHeight",Utils::int_to_string ( tm->get_matrix_height() ) );
+
+            writer.end_element();
 
             if (tm->get_id() == tms_iterator->second->bottom_level) {
                 break;
             }
         }
 
+        writer.end_element();
+
         if (tms_iterator->second->top_level == "") {
             // On est sur un TMS d'origine, TileMatrixSetInfos créé pour cette occasion, on doit le nettoyer
             delete tms_iterator->second;
         }
     }
 
-    std::stringstream ss;
-    write_xml(ss, tree);
-    cache_mtx.lock();
-    if (req->is_inspire(default_inspire)) {
-        cache_getcapabilities_inspire = ss.str();
-    } else {
-        cache_getcapabilities = ss.str();
-    }
-    cache_mtx.unlock();
-    return new MessageDataStream ( ss.str(), "text/xml", 200 );
+    writer.end_element();
+    writer.end_element();
+
+    std::shared_ptr<const EncodedDocument> document = std::make_shared<EncodedDocument>(writer.get_content(), "text/xml", build.complete);
+    cache.set_document(document, build);
+    return document;
 }
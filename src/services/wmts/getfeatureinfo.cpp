@@ -48,6 +48,7 @@
 #include "services/wmts/Exception.h"
 #include "services/wmts/Service.h"
 #include "core/Rok4Server.h"
+#include "core/PointSampler.h"
 
 DataStream* WmtsService::get_feature_info ( Request* req, ServicesConfiguration* services ) {
 
@@ -60,10 +61,15 @@ DataStream* WmtsService::get_feature_info ( Request* req, ServicesConfiguration*
         throw WmtsException::get_error_message("Layer unknown", "InvalidParameterValue", 400);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if (layer == NULL || ! layer->is_wmts_enabled()) {
         throw WmtsException::get_error_message("Layer " + str_layer + " unknown", "InvalidParameterValue", 400);
     }
+    req->layer = layer->get_id();
     if (! layer->is_gfi_enabled()) {
         throw WmtsException::get_error_message("Layer " + str_layer + " not queryable", "InvalidParameterValue", 400);
     }
@@ -230,6 +236,21 @@ DataStream* WmtsService::get_feature_info ( Request* req, ServicesConfiguration*
 
         return Utils::format_get_feature_info(gfi_data, info_format);
 
+    } else if (gfi_type.compare("PYRAMID") == 0) {
+        BOOST_LOG_TRIVIAL(debug) << "GFI sur pyramide dans un TMS non natif";
+
+        // On lit la valeur du pixel source sous le clic, sans calculer la tuile demandée
+        std::vector<std::string> gfi_data;
+        std::string error;
+        if (! PointSampler::get_values(
+            services, services->tile_reprojection, layer, tmsi->tms->get_crs(), tm->tile_indices_to_bbox(column, row),
+            tm->get_tile_width(), tm->get_tile_height(), i, j, layer->is_gfi_bilinear(), &gfi_data, &error
+        )) {
+            throw WmtsException::get_error_message(error, "InvalidParameterValue", 400);
+        }
+
+        return Utils::format_get_feature_info(gfi_data, info_format);
+
     } else if (gfi_type.compare("EXTERNALWMS") == 0) {
         BOOST_LOG_TRIVIAL(debug) << "GFI sur WMS externe, en TMS natif ou non";
 
@@ -259,7 +280,7 @@ DataStream* WmtsService::get_feature_info ( Request* req, ServicesConfiguration*
 
         Request* gfi_request = new Request("GET", layer->get_gfi_url(), query_params);
 
-        RawDataStream* response = gfi_request->send();
+        DataStream* response = gfi_request->send();
         delete gfi_request;
 
         if (response == NULL) {
@@ -72,10 +72,15 @@ DataStream* WmtsService::get_tile(Request* req, ServicesConfiguration* services
         throw WmtsException::get_error_message("Layer unknown", "InvalidParameterValue", 400);
     }
 
-    Layer* layer = services->get_layer(str_layer);
+    Layer* layer;
+    {
+        Trace::Timer timer(&req->trace, Trace::PHASE_LOOKUP);
+        layer = services->get_layer(str_layer);
+    }
     if (layer == NULL || !layer->is_wmts_enabled()) {
         throw WmtsException::get_error_message("Layer " + str_layer + " unknown", "InvalidParameterValue", 400);
     }
+    req->layer = layer->get_id();
 
     // Le tile matrix set
     std::string str_tms = req->get_query_param("tilematrixset");
@@ -123,10 +128,12 @@ DataStream* WmtsService::get_tile(Request* req, ServicesConfiguration* services
     TileMatrixLimits* tml = layer->get_tilematrix_limits(tmsi->tms, tm);
     if (tml == NULL) {
         // On est hors niveau -> erreur
+        layer->get_tile_cache_policy().add_not_found_headers(req);
         throw WmtsException::get_error_message("No data found", "Not Found", 404);
     }
-    if (!tml->contain_tile(column, row)) {
-        // On est hors tuiles -> erreur
+    if (!tml->contain_tile(column, row) || ! layer->contain_tile(tmsi->tms, tm, column, row)) {
+        // On est hors tuiles ou la dalle est absente -> erreur
+        layer->get_tile_cache_policy().add_not_found_headers(req);
         throw WmtsException::get_error_message("No data found", "Not Found", 404);
     }
 
@@ -161,7 +168,7 @@ DataStream* WmtsService::get_tile(Request* req, ServicesConfiguration* services
     }
 
     // Traitement de la requête
-    DataStream* d = Tile::get_tile(services, layer, tmsi->tms, tm, column, row, format, style);
+    DataStream* d = Tile::get_tile(req, services, layer, tmsi->tms, tm, column, row, format, style);
     if (d == NULL) {
         throw WmtsException::get_error_message("No data found", "Not Found", 404);
     }
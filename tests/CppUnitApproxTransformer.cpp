@@ -0,0 +1,167 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <rok4/utils/CRS.h>
+
+#include "core/ApproxTransformer.h"
+
+class CppUnitApproxTransformer : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitApproxTransformer );
+
+    CPPUNIT_TEST ( identity );
+    CPPUNIT_TEST ( tolerance );
+    CPPUNIT_TEST ( exact );
+    CPPUNIT_TEST ( bounds );
+    CPPUNIT_TEST ( invalid );
+
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    CRS* crs84;
+    CRS* pm;
+
+    // Écart maximal entre les positions interpolées et exactes de tous les pixels
+    double max_error ( ApproxTransformer& t, int width, int height ) {
+        std::vector<double> x ( width ), y ( width );
+        double error = 0;
+        for ( int j = 0; j < height; j++ ) {
+            t.transform_line ( j, x.data(), y.data() );
+            for ( int i = 0; i < width; i++ ) {
+                double ex, ey;
+                CPPUNIT_ASSERT ( t.transform_point ( i, j, ex, ey ) );
+                error = std::max ( error, std::max ( std::fabs ( ex - x.at ( i ) ), std::fabs ( ey - y.at ( i ) ) ) );
+            }
+        }
+        return error;
+    }
+
+public:
+
+    void setUp() {
+        crs84 = new CRS ( "EPSG:4326" );
+        pm = new CRS ( "EPSG:3857" );
+    }
+
+    void tearDown() {
+        delete crs84;
+        delete pm;
+    }
+
+    void identity() {
+        BoundingBox<double> bbox ( 0, 0, 2000, 1000 );
+        ApproxTransformer t ( pm, pm, bbox, 200, 100 );
+        CPPUNIT_ASSERT ( t.is_ok() );
+        CPPUNIT_ASSERT ( t.build ( 0.001 ) );
+
+        // Centres des pixels, dans l'ordre est/nord
+        std::vector<double> x ( 200 ), y ( 200 );
+        t.transform_line ( 10, x.data(), y.data() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 5, x.at ( 0 ), 1e-6 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 1995, x.at ( 199 ), 1e-6 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 895, y.at ( 0 ), 1e-6 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 895, y.at ( 199 ), 1e-6 );
+
+        CPPUNIT_ASSERT ( max_error ( t, 200, 100 ) < 1e-6 );
+    }
+
+    void tolerance() {
+        BoundingBox<double> bbox ( 2, 48, 4, 50 );
+        ApproxTransformer t ( crs84, pm, bbox, 300, 200 );
+        CPPUNIT_ASSERT ( t.is_ok() );
+
+        // La tolérance n'est vérifiée qu'au centre et aux milieux des côtés des cellules : une marge est conservée
+        double tol = 0.5;
+        CPPUNIT_ASSERT ( t.build ( tol ) );
+        CPPUNIT_ASSERT ( max_error ( t, 300, 200 ) <= 2 * tol );
+
+        double ex, ey;
+        CPPUNIT_ASSERT ( t.transform_point ( 0, 0, ex, ey ) );
+        CPPUNIT_ASSERT ( ex > 200000 && ex < 250000 );
+        CPPUNIT_ASSERT ( ey > 6400000 && ey < 6500000 );
+    }
+
+    void exact() {
+        BoundingBox<double> bbox ( 2, 48, 4, 50 );
+        ApproxTransformer t ( crs84, pm, bbox, 70, 70 );
+        CPPUNIT_ASSERT ( t.build ( 0 ) );
+
+        // Sans tolérance, toutes les cellules sont subdivisées jusqu'aux pixels
+        CPPUNIT_ASSERT ( max_error ( t, 70, 70 ) < 1e-6 );
+    }
+
+    void bounds() {
+        BoundingBox<double> bbox ( 2, 48, 4, 50 );
+        ApproxTransformer t ( crs84, pm, bbox, 100, 100 );
+        CPPUNIT_ASSERT ( t.build ( 0.5 ) );
+
+        BoundingBox<double> envelope = t.get_envelope();
+        std::vector<double> min_y, max_y;
+        t.get_lines_bounds ( min_y, max_y );
+        CPPUNIT_ASSERT_EQUAL ( (size_t) 100, min_y.size() );
+
+        std::vector<double> x ( 100 ), y ( 100 );
+        for ( int j = 0; j < 100; j++ ) {
+            t.transform_line ( j, x.data(), y.data() );
+            for ( int i = 0; i < 100; i++ ) {
+                CPPUNIT_ASSERT ( x.at ( i ) >= envelope.xmin - 1e-6 && x.at ( i ) <= envelope.xmax + 1e-6 );
+                CPPUNIT_ASSERT ( y.at ( i ) >= min_y.at ( j ) - 1e-6 && y.at ( i ) <= max_y.at ( j ) + 1e-6 );
+            }
+        }
+
+        // Les lignes du haut de l'image sont au nord
+        CPPUNIT_ASSERT ( min_y.at ( 0 ) >= max_y.at ( 99 ) );
+    }
+
+    void invalid() {
+        BoundingBox<double> bbox ( 2, 48, 4, 50 );
+        ApproxTransformer t ( crs84, pm, bbox, 0, 100 );
+        CPPUNIT_ASSERT ( ! t.is_ok() );
+        CPPUNIT_ASSERT ( ! t.build ( 0.5 ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitApproxTransformer );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitApproxTransformer, "CppUnitApproxTransformer" );
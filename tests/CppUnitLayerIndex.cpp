@@ -0,0 +1,156 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "configurations/LayerIndex.h"
+
+class CppUnitLayerIndex : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitLayerIndex );
+
+    CPPUNIT_TEST ( empty );
+    CPPUNIT_TEST ( bounds_included );
+    CPPUNIT_TEST ( grid );
+
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    LayerIndex* index;
+
+    // Les couches sont ajoutées directement, dans l'ordre de leur identifiant, comme le fait le constructeur
+    void add ( std::string id, double xmin, double ymin, double xmax, double ymax ) {
+        LayerIndex::Entry e;
+        e.box.xmin = xmin;
+        e.box.ymin = ymin;
+        e.box.xmax = xmax;
+        e.box.ymax = ymax;
+        e.id = id;
+        e.layer = NULL;
+        index->entries.push_back ( e );
+    }
+
+    std::vector<std::string> query ( double xmin, double ymin, double xmax, double ymax ) {
+        std::vector<std::pair<std::string, Layer*> > layers;
+        index->query ( BoundingBox<double> ( xmin, ymin, xmax, ymax ), layers );
+        std::vector<std::string> ids;
+        for ( size_t i = 0; i < layers.size(); i++ ) {
+            ids.push_back ( layers.at ( i ).first );
+        }
+        return ids;
+    }
+
+public:
+
+    void setUp() {
+        index = new LayerIndex ( std::map<std::string, Layer*>() );
+    }
+
+    void tearDown() {
+        delete index;
+    }
+
+    void empty() {
+        CPPUNIT_ASSERT ( index->is_complete() );
+        CPPUNIT_ASSERT_EQUAL ( (size_t) 0, index->get_entries_count() );
+        CPPUNIT_ASSERT ( query ( -180, -90, 180, 90 ).empty() );
+    }
+
+    void bounds_included() {
+        add ( "a", 0, 0, 1, 1 );
+        add ( "b", 2, 0, 3, 1 );
+        index->build();
+
+        std::vector<std::string> ids = query ( 1, 1, 2, 2 );
+        CPPUNIT_ASSERT_EQUAL ( (size_t) 2, ids.size() );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "a" ), ids.at ( 0 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "b" ), ids.at ( 1 ) );
+
+        ids = query ( 1.5, 0, 1.8, 1 );
+        CPPUNIT_ASSERT ( ids.empty() );
+
+        ids = query ( 2.5, 0.5, 2.6, 0.6 );
+        CPPUNIT_ASSERT_EQUAL ( (size_t) 1, ids.size() );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "b" ), ids.at ( 0 ) );
+    }
+
+    void grid() {
+        // Assez de couches pour un arbre sur trois niveaux, comparé à une recherche exhaustive
+        std::vector<std::vector<double> > boxes;
+        for ( int i = 0; i < 40; i++ ) {
+            for ( int j = 0; j < 25; j++ ) {
+                char id[16];
+                snprintf ( id, sizeof ( id ), "layer_%04d", i * 25 + j );
+                double xmin = -180 + i * 9;
+                double ymin = -90 + j * 7;
+                add ( id, xmin, ymin, xmin + 4 + ( i % 3 ), ymin + 3 + ( j % 5 ) );
+                boxes.push_back ( std::vector<double> { xmin, ymin, xmin + 4 + ( i % 3 ), ymin + 3 + ( j % 5 ) } );
+            }
+        }
+        index->build();
+        CPPUNIT_ASSERT_EQUAL ( (size_t) 1000, index->get_entries_count() );
+
+        double searches[4][4] = {
+            { -180, -90, 180, 90 },
+            { 0, 0, 10, 10 },
+            { -47.5, 12.25, -20, 40 },
+            { 175, 85, 180, 90 }
+        };
+        for ( int s = 0; s < 4; s++ ) {
+            std::vector<std::string> expected;
+            for ( size_t k = 0; k < boxes.size(); k++ ) {
+                if ( boxes.at ( k ).at ( 0 ) <= searches[s][2] && searches[s][0] <= boxes.at ( k ).at ( 2 ) &&
+                     boxes.at ( k ).at ( 1 ) <= searches[s][3] && searches[s][1] <= boxes.at ( k ).at ( 3 ) ) {
+                    expected.push_back ( index->entries.at ( k ).id );
+                }
+            }
+
+            std::vector<std::string> ids = query ( searches[s][0], searches[s][1], searches[s][2], searches[s][3] );
+            CPPUNIT_ASSERT ( ids == expected );
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitLayerIndex );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitLayerIndex, "CppUnitLayerIndex" );
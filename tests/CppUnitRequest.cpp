@@ -0,0 +1,155 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <map>
+#include <string>
+
+#include "core/Request.h"
+
+class CppUnitRequest : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitRequest );
+
+    CPPUNIT_TEST ( query_string );
+    CPPUNIT_TEST ( query_decoding );
+    CPPUNIT_TEST ( query_constructor );
+    CPPUNIT_TEST ( accepts_encoding );
+    CPPUNIT_TEST ( match_etag );
+
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    Request* req;
+
+public:
+
+    void setUp() {
+        req = new Request ( "GET", "", std::map<std::string, std::string>() );
+    }
+
+    void tearDown() {
+        delete req;
+    }
+
+    void query_string() {
+        req->parse_query_string ( "SERVICE=WMS&request=GetMap&LAYERS=ortho&empty=&novalue&SERVICE=WMTS" );
+
+        // Clés comparées sans tenir compte de la casse, premier paramètre retenu en cas de doublon
+        CPPUNIT_ASSERT ( req->has_query_param ( "service" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "WMS" ), req->get_query_param ( "Service" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "GetMap" ), req->get_query_param ( "REQUEST" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "ortho" ), req->get_query_param ( "layers" ) );
+
+        // Valeur vide et élément sans '=' ignoré
+        CPPUNIT_ASSERT ( req->has_query_param ( "empty" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "" ), req->get_query_param ( "empty" ) );
+        CPPUNIT_ASSERT ( ! req->has_query_param ( "novalue" ) );
+        CPPUNIT_ASSERT ( ! req->has_query_param ( "missing" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "" ), req->get_query_param ( "missing" ) );
+
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "SERVICE=WMS&request=GetMap&LAYERS=ortho&empty=&SERVICE=WMTS" ), req->get_query_string() );
+    }
+
+    void query_decoding() {
+        req->parse_query_string ( "layers=a%26b&filter=x%3D1&style=a+b&crs=EPSG%3a4326&bad=%G1&end=%4" );
+
+        // Découpage avant décodage : '&' et '=' encodés restent dans la valeur
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "a&b" ), req->get_query_param ( "layers" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "x=1" ), req->get_query_param ( "filter" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "a b" ), req->get_query_param ( "style" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "EPSG:4326" ), req->get_query_param ( "crs" ) );
+
+        // Séquences invalides ou tronquées laissées telles quelles
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "%G1" ), req->get_query_param ( "bad" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "%4" ), req->get_query_param ( "end" ) );
+
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "layers=a&b&filter=x=1&style=a b&crs=EPSG:4326&bad=%G1&end=%4" ), req->get_query_string() );
+    }
+
+    void query_constructor() {
+        std::map<std::string, std::string> qp;
+        qp["SERVICE"] = "WMS";
+        qp["layers"] = "a&b";
+        Request r ( "GET", "http://localhost/wms", qp );
+
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "WMS" ), r.get_query_param ( "service" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "a&b" ), r.get_query_param ( "LAYERS" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "SERVICE=WMS&layers=a&b" ), r.get_query_string() );
+    }
+
+    void accepts_encoding() {
+        CPPUNIT_ASSERT ( ! req->accepts_encoding ( "gzip" ) );
+
+        req->accept_encoding = "gzip, deflate, br";
+        CPPUNIT_ASSERT ( req->accepts_encoding ( "gzip" ) );
+        CPPUNIT_ASSERT ( req->accepts_encoding ( "GZIP" ) );
+        CPPUNIT_ASSERT ( req->accepts_encoding ( "br" ) );
+        CPPUNIT_ASSERT ( ! req->accepts_encoding ( "zstd" ) );
+
+        req->accept_encoding = "deflate;q=0.5, gzip;q=0";
+        CPPUNIT_ASSERT ( ! req->accepts_encoding ( "gzip" ) );
+        CPPUNIT_ASSERT ( req->accepts_encoding ( "deflate" ) );
+
+        // Le joker ne s'applique qu'aux encodages non cités
+        req->accept_encoding = "*;q=0.1, gzip;q=0";
+        CPPUNIT_ASSERT ( ! req->accepts_encoding ( "gzip" ) );
+        CPPUNIT_ASSERT ( req->accepts_encoding ( "br" ) );
+
+        req->accept_encoding = "identity, *;q=0";
+        CPPUNIT_ASSERT ( ! req->accepts_encoding ( "gzip" ) );
+    }
+
+    void match_etag() {
+        CPPUNIT_ASSERT ( ! req->match_etag ( "\"abc\"" ) );
+
+        req->if_none_match = "\"xyz\", W/\"abc\"";
+        CPPUNIT_ASSERT ( req->match_etag ( "\"abc\"" ) );
+        CPPUNIT_ASSERT ( req->match_etag ( "\"xyz\"" ) );
+        CPPUNIT_ASSERT ( ! req->match_etag ( "\"ab\"" ) );
+        CPPUNIT_ASSERT ( ! req->match_etag ( "" ) );
+
+        req->if_none_match = "*";
+        CPPUNIT_ASSERT ( req->match_etag ( "\"abc\"" ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRequest );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitRequest, "CppUnitRequest" );
@@ -0,0 +1,154 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <map>
+#include <string>
+
+#include "core/Request.h"
+#include "services/Route.h"
+
+class CppUnitRoute : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitRoute );
+
+    CPPUNIT_TEST ( literal );
+    CPPUNIT_TEST ( trailing_slash );
+    CPPUNIT_TEST ( parameters );
+    CPPUNIT_TEST ( extension );
+    CPPUNIT_TEST ( offset );
+
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    bool match ( const Route& route, std::string method, std::string path, size_t offset, std::vector<std::string>& params ) {
+        Request req ( method, "", std::map<std::string, std::string>() );
+        req.path = path;
+        bool result = route.match ( &req, offset );
+        params = req.path_params;
+        return result;
+    }
+
+public:
+
+    void literal() {
+        Route route ( "GET", "/collections", 1 );
+        std::vector<std::string> params;
+
+        CPPUNIT_ASSERT_EQUAL ( 1, route.get_operation() );
+        CPPUNIT_ASSERT ( match ( route, "GET", "/collections", 0, params ) );
+        CPPUNIT_ASSERT ( params.empty() );
+
+        CPPUNIT_ASSERT ( ! match ( route, "POST", "/collections", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/collection", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/collectionss", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/collections/", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/collections/ortho", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "", 0, params ) );
+    }
+
+    void trailing_slash() {
+        Route route ( "GET", "/collections/?", 1 );
+        std::vector<std::string> params;
+
+        CPPUNIT_ASSERT ( match ( route, "GET", "/collections", 0, params ) );
+        CPPUNIT_ASSERT ( match ( route, "GET", "/collections/", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/collections//", 0, params ) );
+
+        Route root ( "GET", "/?", 2 );
+        CPPUNIT_ASSERT ( match ( root, "GET", "", 0, params ) );
+        CPPUNIT_ASSERT ( match ( root, "GET", "/", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( root, "GET", "/collections", 0, params ) );
+    }
+
+    void parameters() {
+        Route route ( "GET", "/collections/{collection}/styles/{style}", 1 );
+        std::vector<std::string> params;
+
+        CPPUNIT_ASSERT ( match ( route, "GET", "/collections/ortho/styles/normal", 0, params ) );
+        CPPUNIT_ASSERT_EQUAL ( (size_t) 2, params.size() );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "ortho" ), params.at ( 0 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "normal" ), params.at ( 1 ) );
+
+        // Un paramètre ne peut être vide, et aucun paramètre n'est ajouté si la route ne correspond pas
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/collections//styles/normal", 0, params ) );
+        CPPUNIT_ASSERT ( params.empty() );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/collections/ortho/styles/normal/extra", 0, params ) );
+        CPPUNIT_ASSERT ( params.empty() );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/collections/ortho/style/normal", 0, params ) );
+        CPPUNIT_ASSERT ( params.empty() );
+    }
+
+    void extension() {
+        Route route ( "GET", "/tiles/{level}/{row}/{col}.{extension}", 1 );
+        std::vector<std::string> params;
+
+        CPPUNIT_ASSERT ( match ( route, "GET", "/tiles/12/1500/2040.png", 0, params ) );
+        CPPUNIT_ASSERT_EQUAL ( (size_t) 4, params.size() );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "12" ), params.at ( 0 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "1500" ), params.at ( 1 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "2040" ), params.at ( 2 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "png" ), params.at ( 3 ) );
+
+        // Séparation sur le dernier point
+        CPPUNIT_ASSERT ( match ( route, "GET", "/tiles/12/1500/2040.tar.gz", 0, params ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "2040.tar" ), params.at ( 2 ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "gz" ), params.at ( 3 ) );
+
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/tiles/12/1500/2040", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/tiles/12/1500/.png", 0, params ) );
+    }
+
+    void offset() {
+        Route route ( "GET", "/collections/{collection}", 1 );
+        std::vector<std::string> params;
+
+        // Le chemin est comparé à partir de la fin de la racine du service
+        CPPUNIT_ASSERT ( match ( route, "GET", "/ogcapi/collections/ortho", 7, params ) );
+        CPPUNIT_ASSERT_EQUAL ( (size_t) 1, params.size() );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "ortho" ), params.at ( 0 ) );
+
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/ogcapi/collections/ortho", 0, params ) );
+        CPPUNIT_ASSERT ( ! match ( route, "GET", "/ogcapicollections/ortho", 7, params ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRoute );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitRoute, "CppUnitRoute" );
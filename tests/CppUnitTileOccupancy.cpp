@@ -0,0 +1,115 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdint.h>
+#include <string>
+
+#include "configurations/TileOccupancy.h"
+
+class CppUnitTileOccupancy : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitTileOccupancy );
+
+    CPPUNIT_TEST ( decode_object_slab );
+    CPPUNIT_TEST ( decode_file_slab );
+    CPPUNIT_TEST ( decode_invalid_slab );
+
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    std::string level;
+    uint32_t column;
+    uint32_t row;
+
+    bool decode ( std::string name ) {
+        return TileOccupancy::decode_slab ( name, level, column, row );
+    }
+
+public:
+
+    void decode_object_slab() {
+        CPPUNIT_ASSERT ( decode ( "DATA_12_345_678" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "12" ), level );
+        CPPUNIT_ASSERT_EQUAL ( (uint32_t) 345, column );
+        CPPUNIT_ASSERT_EQUAL ( (uint32_t) 678, row );
+
+        // Préfixe du contenant et niveau contenant un '_'
+        CPPUNIT_ASSERT ( decode ( "pyramids/ORTHO/DATA_level_1_0_7" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "level_1" ), level );
+        CPPUNIT_ASSERT_EQUAL ( (uint32_t) 0, column );
+        CPPUNIT_ASSERT_EQUAL ( (uint32_t) 7, row );
+    }
+
+    void decode_file_slab() {
+        // Les chiffres en base 36 de la colonne et de la ligne alternent : colonne 0 3 4, ligne 0 A B
+        CPPUNIT_ASSERT ( decode ( "/pyramids/ORTHO/DATA/12/00/3A/4B.tif" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "12" ), level );
+        CPPUNIT_ASSERT_EQUAL ( (uint32_t) ( 3 * 36 + 4 ), column );
+        CPPUNIT_ASSERT_EQUAL ( (uint32_t) ( 10 * 36 + 11 ), row );
+
+        CPPUNIT_ASSERT ( decode ( "/pyramids/ORTHO/DATA/0/01" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "0" ), level );
+        CPPUNIT_ASSERT_EQUAL ( (uint32_t) 0, column );
+        CPPUNIT_ASSERT_EQUAL ( (uint32_t) 1, row );
+    }
+
+    void decode_invalid_slab() {
+        // Dalles de masque
+        CPPUNIT_ASSERT ( ! decode ( "MASK_12_345_678" ) );
+        CPPUNIT_ASSERT ( ! decode ( "/pyramids/ORTHO/MASK/12/00/3A/4B.tif" ) );
+
+        // Indices manquants ou invalides
+        CPPUNIT_ASSERT ( ! decode ( "DATA_12_345" ) );
+        CPPUNIT_ASSERT ( ! decode ( "DATA__345_678" ) );
+        CPPUNIT_ASSERT ( ! decode ( "DATA_12_3a5_678" ) );
+        CPPUNIT_ASSERT ( ! decode ( "DATA_12_345_" ) );
+        CPPUNIT_ASSERT ( ! decode ( "DATA_12_1234567890_1" ) );
+
+        // Nombre de chiffres impair, caractère hors base 36 ou chemin absent
+        CPPUNIT_ASSERT ( ! decode ( "/pyramids/ORTHO/DATA/12/00/3A/4.tif" ) );
+        CPPUNIT_ASSERT ( ! decode ( "/pyramids/ORTHO/DATA/12/00/3a/4B.tif" ) );
+        CPPUNIT_ASSERT ( ! decode ( "/pyramids/ORTHO/DATA/12" ) );
+        CPPUNIT_ASSERT ( ! decode ( "/pyramids/ORTHO/DATA/12/.tif" ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitTileOccupancy );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitTileOccupancy, "CppUnitTileOccupancy" );
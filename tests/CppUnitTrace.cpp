@@ -0,0 +1,158 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "core/TimedImage.h"
+#include "core/Trace.h"
+
+/**
+ * \~french \brief Flux dont chaque lecture dure le délai donné
+ * \~english \brief Stream whose each read lasts the given delay
+ */
+class SlowDataStream : public DataStream {
+private:
+    int delay_ms;
+    int reads;
+public:
+    SlowDataStream ( int d, int r ) : delay_ms ( d ), reads ( r ) {}
+    size_t read ( uint8_t *buffer, size_t size ) {
+        if ( reads == 0 ) return 0;
+        reads--;
+        std::this_thread::sleep_for ( std::chrono::milliseconds ( delay_ms ) );
+        memset ( buffer, 0, size );
+        return size;
+    }
+    bool eof() { return reads == 0; }
+    std::string get_type() { return "application/octet-stream"; }
+    std::string get_encoding() { return ""; }
+    int get_http_status() { return 200; }
+    unsigned int get_length() { return 0; }
+};
+
+class CppUnitTrace : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitTrace );
+
+    CPPUNIT_TEST ( nested_timers );
+    CPPUNIT_TEST ( timed_stream );
+    CPPUNIT_TEST ( server_timing );
+
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    static double ms ( const Trace& trace, Trace::ePhase phase ) {
+        return trace.durations[phase] / 1e6;
+    }
+
+    static bool is_measured ( const Trace& trace, Trace::ePhase phase ) {
+        return ( trace.measured & ( 1u << phase ) ) != 0;
+    }
+
+public:
+
+    void nested_timers() {
+        Trace trace;
+        {
+            Trace::Timer outer ( &trace, Trace::PHASE_SEND );
+            std::this_thread::sleep_for ( std::chrono::milliseconds ( 20 ) );
+            {
+                Trace::Timer inner ( &trace, Trace::PHASE_ENCODE );
+                std::this_thread::sleep_for ( std::chrono::milliseconds ( 60 ) );
+            }
+        }
+
+        // La durée de la phase imbriquée est déduite de la phase englobante
+        CPPUNIT_ASSERT ( ms ( trace, Trace::PHASE_ENCODE ) >= 60 );
+        CPPUNIT_ASSERT ( ms ( trace, Trace::PHASE_SEND ) >= 20 );
+        CPPUNIT_ASSERT ( ms ( trace, Trace::PHASE_SEND ) < 60 );
+
+        // Une section terminée n'est plus déduite des sections suivantes
+        {
+            Trace::Timer next ( &trace, Trace::PHASE_PARSE );
+            std::this_thread::sleep_for ( std::chrono::milliseconds ( 10 ) );
+        }
+        CPPUNIT_ASSERT ( ms ( trace, Trace::PHASE_PARSE ) >= 10 );
+    }
+
+    void timed_stream() {
+        Trace trace;
+        {
+            TimedDataStream stream ( new SlowDataStream ( 20, 2 ), &trace, Trace::PHASE_ENCODE );
+            CPPUNIT_ASSERT_EQUAL ( std::string ( "application/octet-stream" ), stream.get_type() );
+
+            Trace::Timer timer ( &trace, Trace::PHASE_RENDER );
+            uint8_t buffer[16];
+            while ( stream.read ( buffer, sizeof ( buffer ) ) > 0 ) {
+                std::this_thread::sleep_for ( std::chrono::milliseconds ( 5 ) );
+            }
+
+            // La durée n'est rapportée qu'à la destruction du flux
+            CPPUNIT_ASSERT ( ! is_measured ( trace, Trace::PHASE_ENCODE ) );
+        }
+
+        CPPUNIT_ASSERT ( ms ( trace, Trace::PHASE_ENCODE ) >= 40 );
+        CPPUNIT_ASSERT ( ms ( trace, Trace::PHASE_RENDER ) >= 10 );
+        CPPUNIT_ASSERT ( ms ( trace, Trace::PHASE_RENDER ) < 40 );
+
+        // Un flux jamais lu n'est pas rapporté
+        Trace unread;
+        delete new TimedDataStream ( new SlowDataStream ( 20, 2 ), &unread, Trace::PHASE_ENCODE );
+        CPPUNIT_ASSERT ( ! is_measured ( unread, Trace::PHASE_ENCODE ) );
+    }
+
+    void server_timing() {
+        Trace trace;
+        trace.add ( Trace::PHASE_LOOKUP, 1500000 );
+        trace.add ( Trace::PHASE_STYLE, 2000000 );
+
+        std::string header;
+        trace.append_server_timing ( header );
+        // Seules les phases mesurées sont données, dans l'ordre des phases
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 0, header.find ( "lookup;dur=1.500, style;dur=2.000, total;dur=" ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitTrace );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitTrace, "CppUnitTrace" );
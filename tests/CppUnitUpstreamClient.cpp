@@ -0,0 +1,365 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/UpstreamClient.h"
+
+/**
+ * \~french
+ * \brief Serveur HTTP local minimal, une requête par connexion
+ * \details La réponse est écrite par une fonction recevant la socket, le chemin demandé et le rang de la requête sur ce chemin
+ * \~english
+ * \brief Minimal local HTTP server, one request per connection
+ * \details Response is written by a function getting the socket, the asked path and the request's rank on this path
+ */
+class HttpStub {
+
+public:
+
+    typedef std::function<void ( HttpStub* stub, int fd, const std::string& path, int hit )> Handler;
+
+    HttpStub ( Handler h ) : handler ( h ), stopping ( false ) {
+        fd = socket ( AF_INET, SOCK_STREAM, 0 );
+        int on = 1;
+        setsockopt ( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof ( on ) );
+
+        struct sockaddr_in addr;
+        memset ( &addr, 0, sizeof ( addr ) );
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+        addr.sin_port = 0;
+        bind ( fd, ( struct sockaddr* ) &addr, sizeof ( addr ) );
+        listen ( fd, 16 );
+
+        socklen_t len = sizeof ( addr );
+        getsockname ( fd, ( struct sockaddr* ) &addr, &len );
+        port = ntohs ( addr.sin_port );
+
+        acceptor = std::thread ( &HttpStub::accept_loop, this );
+    }
+
+    ~HttpStub() {
+        stopping = true;
+        acceptor.join();
+        for ( std::thread& t : connections ) t.join();
+        close ( fd );
+    }
+
+    std::string url ( std::string path ) {
+        return "http://127.0.0.1:" + std::to_string ( port ) + path;
+    }
+
+    int get_hits ( std::string path ) {
+        std::lock_guard<std::mutex> lock ( mtx );
+        return hits[path];
+    }
+
+    bool is_stopping() {
+        return stopping;
+    }
+
+    /**
+     * \~french \brief Envoi complet d'une réponse, false si le client a fermé la connexion
+     * \~english \brief Send a whole response, false if client closed the connection
+     */
+    static bool send_all ( int fd, const std::string& data ) {
+        size_t sent = 0;
+        while ( sent < data.size() ) {
+            ssize_t n = send ( fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL );
+            if ( n <= 0 ) return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    static void respond ( int fd, int status, const std::string& body ) {
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << " Stub\r\n";
+        response << "Content-Type: text/plain\r\n";
+        response << "Content-Length: " << body.size() << "\r\n";
+        response << "Connection: close\r\n\r\n";
+        response << body;
+        send_all ( fd, response.str() );
+    }
+
+    /**
+     * \~french \brief Attente sans répondre, jusqu'à l'arrêt du serveur ou au délai donné
+     * \~english \brief Wait without answering, until server stops or given delay
+     */
+    void hold ( int ms ) {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds ( ms );
+        while ( ! stopping && std::chrono::steady_clock::now() < end ) {
+            std::this_thread::sleep_for ( std::chrono::milliseconds ( 20 ) );
+        }
+    }
+
+private:
+
+    Handler handler;
+    std::atomic<bool> stopping;
+    int fd;
+    int port;
+    std::thread acceptor;
+    std::vector<std::thread> connections;
+    std::mutex mtx;
+    std::map<std::string, int> hits;
+
+    void accept_loop() {
+        while ( ! stopping ) {
+            struct pollfd p = { fd, POLLIN, 0 };
+            if ( poll ( &p, 1, 50 ) <= 0 ) continue;
+            int client = accept ( fd, NULL, NULL );
+            if ( client < 0 ) continue;
+            connections.push_back ( std::thread ( &HttpStub::serve, this, client ) );
+        }
+    }
+
+    void serve ( int client ) {
+        std::string request;
+        char buffer[1024];
+        while ( request.find ( "\r\n\r\n" ) == std::string::npos ) {
+            ssize_t n = recv ( client, buffer, sizeof ( buffer ), 0 );
+            if ( n <= 0 ) break;
+            request.append ( buffer, n );
+        }
+
+        // Première ligne : GET <chemin> HTTP/1.1
+        size_t start = request.find ( ' ' ) + 1;
+        std::string path = request.substr ( start, request.find ( ' ', start ) - start );
+
+        int hit;
+        {
+            std::lock_guard<std::mutex> lock ( mtx );
+            hit = ++hits[path];
+        }
+
+        handler ( this, client, path, hit );
+        close ( client );
+    }
+};
+
+class CppUnitUpstreamClient : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitUpstreamClient );
+
+    CPPUNIT_TEST ( hedge );
+    CPPUNIT_TEST ( header_timeout );
+    CPPUNIT_TEST ( pause_resume );
+    CPPUNIT_TEST ( cache );
+    CPPUNIT_TEST ( error_status );
+
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    HttpStub* stub;
+    std::string large_body;
+
+    static std::string read_all ( DataStream* d ) {
+        std::string content;
+        uint8_t buffer[4096];
+        size_t n;
+        while ( ( n = d->read ( buffer, sizeof ( buffer ) ) ) > 0 ) {
+            content.append ( ( const char* ) buffer, n );
+        }
+        return content;
+    }
+
+    static long elapsed_ms ( std::chrono::steady_clock::time_point start ) {
+        return std::chrono::duration_cast<std::chrono::milliseconds> ( std::chrono::steady_clock::now() - start ).count();
+    }
+
+public:
+
+    void setUp() {
+        // Contenu plus gros que le volume de données en attente d'envoi
+        large_body.resize ( 3 * UpstreamClient::MAX_QUEUED_BYTES );
+        for ( size_t i = 0; i < large_body.size(); i++ ) {
+            large_body[i] = 'a' + ( i % 26 );
+        }
+
+        stub = new HttpStub ( [this] ( HttpStub* s, int fd, const std::string& path, int hit ) {
+            if ( path == "/hedge" && hit == 1 ) {
+                // La première tentative répond trop tard
+                s->hold ( 3000 );
+                HttpStub::respond ( fd, 200, "first" );
+            } else if ( path == "/hedge" ) {
+                HttpStub::respond ( fd, 200, "second" );
+            } else if ( path == "/silent" ) {
+                s->hold ( 10000 );
+            } else if ( path == "/large" ) {
+                HttpStub::respond ( fd, 200, large_body );
+            } else if ( path == "/missing" ) {
+                HttpStub::respond ( fd, 404, "not found" );
+            } else {
+                HttpStub::respond ( fd, 200, "content of " + path );
+            }
+        } );
+    }
+
+    void tearDown() {
+        // Les transferts en cours sont abandonnés avant l'arrêt du serveur, qui attend ses connexions
+        UpstreamClient::stop();
+        delete stub;
+    }
+
+    void hedge() {
+        UpstreamClient::configure ( 5, 0, 100, 0, 0 );
+        unsigned long hedged = UpstreamClient::hedged;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DataStream* d = UpstreamClient::fetch ( stub->url ( "/hedge" ), false, 0 );
+        CPPUNIT_ASSERT ( d != NULL );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "second" ), read_all ( d ) );
+        delete d;
+
+        // La relance est partie après hedge_delay, sans attendre la première tentative
+        CPPUNIT_ASSERT ( elapsed_ms ( start ) >= 100 );
+        CPPUNIT_ASSERT ( elapsed_ms ( start ) < 2000 );
+        CPPUNIT_ASSERT_EQUAL ( 2, stub->get_hits ( "/hedge" ) );
+        CPPUNIT_ASSERT_EQUAL ( hedged + 1, UpstreamClient::hedged.load() );
+    }
+
+    void header_timeout() {
+        UpstreamClient::configure ( 5, 0, 0, 0, 0 );
+        unsigned long failures = UpstreamClient::failures;
+
+        // Aucun en-tête de réponse dans le délai de la requête
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DataStream* d = UpstreamClient::fetch ( stub->url ( "/silent" ), false, 1 );
+        CPPUNIT_ASSERT ( d == NULL );
+        CPPUNIT_ASSERT ( elapsed_ms ( start ) >= 1000 );
+        CPPUNIT_ASSERT ( elapsed_ms ( start ) < 4000 );
+        CPPUNIT_ASSERT_EQUAL ( 1, stub->get_hits ( "/silent" ) );
+        CPPUNIT_ASSERT_EQUAL ( failures + 1, UpstreamClient::failures.load() );
+    }
+
+    void pause_resume() {
+        UpstreamClient::configure ( 5, 0, 0, 0, 0 );
+
+        DataStream* d = UpstreamClient::fetch ( stub->url ( "/large" ), false, 0 );
+        CPPUNIT_ASSERT ( d != NULL );
+        std::shared_ptr<UpstreamClient::Transfer> t = ( ( UpstreamDataStream* ) d )->transfer;
+
+        // Le lecteur ne suit pas : le transfert est suspendu une fois MAX_QUEUED_BYTES en attente
+        uint8_t byte;
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 1, d->read ( &byte, 1 ) );
+        std::this_thread::sleep_for ( std::chrono::milliseconds ( 500 ) );
+        {
+            std::lock_guard<std::mutex> lock ( t->group->mtx );
+            CPPUNIT_ASSERT ( t->paused );
+            CPPUNIT_ASSERT ( ! t->done );
+            CPPUNIT_ASSERT ( t->queued >= UpstreamClient::MAX_QUEUED_BYTES );
+            CPPUNIT_ASSERT ( t->queued < 2 * UpstreamClient::MAX_QUEUED_BYTES );
+        }
+
+        // La lecture relance le transfert, le contenu est reçu en entier et dans l'ordre
+        std::string content = std::string ( 1, ( char ) byte ) + read_all ( d );
+        CPPUNIT_ASSERT_EQUAL ( large_body.size(), content.size() );
+        CPPUNIT_ASSERT ( content == large_body );
+        CPPUNIT_ASSERT ( d->eof() );
+        delete d;
+    }
+
+    void cache() {
+        UpstreamClient::configure ( 5, 0, 0, 60, 10 );
+        std::string url = stub->url ( "/cached" );
+        unsigned long hits = UpstreamClient::cache_hits;
+
+        DataStream* d = UpstreamClient::fetch ( url, false, 0 );
+        CPPUNIT_ASSERT ( d != NULL );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "content of /cached" ), read_all ( d ) );
+        delete d;
+
+        // Réponse complète lue : la requête suivante est servie par le cache
+        d = UpstreamClient::fetch ( url, false, 0 );
+        CPPUNIT_ASSERT ( d != NULL );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "content of /cached" ), read_all ( d ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "text/plain" ), d->get_type() );
+        delete d;
+        CPPUNIT_ASSERT_EQUAL ( 1, stub->get_hits ( "/cached" ) );
+        CPPUNIT_ASSERT_EQUAL ( hits + 1, UpstreamClient::cache_hits.load() );
+
+        // Réponse expirée : la requête est de nouveau jouée
+        {
+            std::lock_guard<std::mutex> lock ( UpstreamClient::cache_mtx );
+            UpstreamClient::cache_index.at ( url )->second.expiration = std::time ( NULL ) - 1;
+        }
+        d = UpstreamClient::fetch ( url, false, 0 );
+        CPPUNIT_ASSERT ( d != NULL );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "content of /cached" ), read_all ( d ) );
+        delete d;
+        CPPUNIT_ASSERT_EQUAL ( 2, stub->get_hits ( "/cached" ) );
+        CPPUNIT_ASSERT_EQUAL ( hits + 1, UpstreamClient::cache_hits.load() );
+    }
+
+    void error_status() {
+        UpstreamClient::configure ( 5, 0, 0, 60, 10 );
+        unsigned long failures = UpstreamClient::failures;
+
+        CPPUNIT_ASSERT ( UpstreamClient::fetch ( stub->url ( "/missing" ), false, 0 ) == NULL );
+        CPPUNIT_ASSERT_EQUAL ( failures + 1, UpstreamClient::failures.load() );
+
+        // Une réponse en erreur n'est pas mise en cache
+        CPPUNIT_ASSERT ( UpstreamClient::fetch ( stub->url ( "/missing" ), false, 0 ) == NULL );
+        CPPUNIT_ASSERT_EQUAL ( 2, stub->get_hits ( "/missing" ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitUpstreamClient );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitUpstreamClient, "CppUnitUpstreamClient" );